@@ -0,0 +1,84 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Per-frame scratch memory (Headers/Utils/FrameArena.h) - what a draw routine's transient data costs
+from Window::framearena against the global heap. One op is one frame: a vertex array and a sorted
+item list built with push_back, and a text buffer, then the arena's Reset as Present does it.*/
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "Utils/FrameArena.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+
+namespace
+{
+    struct Vertex
+    {
+        float x, y;
+        uint32_t color;
+    };
+
+    const size_t vertices = 256;
+    const size_t items    = 32;
+    const size_t text     = 128;
+
+    template <class Vertices, class Items>
+    uint64_t Draw(Vertices &v, Items &list, char *buffer, uint64_t frame)
+    {
+        for (size_t i = 0; i < vertices; i++)
+        {
+            v.push_back(Vertex{ static_cast<float>(i), static_cast<float>(frame), 0xFF000000u });
+        }
+        for (size_t i = 0; i < items; i++)
+        {
+            list.push_back(static_cast<uint32_t>((i * 2654435761u) ^ frame));
+        }
+        std::sort(list.begin(), list.end());
+        snprintf(buffer, text, "frame %llu", static_cast<unsigned long long>(frame));
+        return list.front() + static_cast<uint64_t>(buffer[6]) + v.size();
+    }
+}
+
+BENCH(FrameArenaFrame)
+{
+    WUIF::FrameArena arena;
+    uint64_t frame = 0;
+    uint64_t result = 0;
+    while (state.Running())
+    {
+        arena.Reset();
+        std::vector<Vertex, WUIF::ArenaAllocator<Vertex>> v{ WUIF::ArenaAllocator<Vertex>(arena) };
+        std::vector<uint32_t, WUIF::ArenaAllocator<uint32_t>> list{ WUIF::ArenaAllocator<uint32_t>(arena) };
+        char *buffer = arena.Allocate<char>(text);
+        result += Draw(v, list, buffer, frame++);
+        Keep(result);
+    }
+}
+
+BENCH(HeapFrame)
+{
+    uint64_t frame = 0;
+    uint64_t result = 0;
+    while (state.Running())
+    {
+        std::vector<Vertex> v;
+        std::vector<uint32_t> list;
+        char *buffer = new char[text];
+        result += Draw(v, list, buffer, frame++);
+        delete[] buffer;
+        Keep(result);
+    }
+}
@@ -0,0 +1,200 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h> //needed for _ReadWriteBarrier
+#endif
+
+/*Benchmark harness for the portable headers, the counterpart of Tests/Test.h.
+
+    BENCH(name)       - defines a benchmark, registered with the executable it is linked into. The
+                        body sets up, then runs the code being measured in while (state.Running())
+    state.Pause()     - stops the clock and the allocation count, e.g. to drain a queue the
+    state.Resume()      measured code fills
+    Keep(value)       - stops the compiler from optimising away a result
+    Contenders        - runs a function on other threads while the benchmark's loop is timed
+
+Running() repeats the loop in growing batches until it has run for at least the time BenchMain.cpp
+asks for, then the time and the number of allocations (counted by the global operator new in
+BenchMain.cpp) are divided by the number of iterations.*/
+namespace WUIF {
+    namespace Bench {
+
+        typedef std::chrono::steady_clock clock;
+
+        //operator new calls on every thread, kept by BenchMain.cpp
+        inline std::atomic<unsigned long long>& Allocations()
+        {
+            static std::atomic<unsigned long long> allocations(0);
+            return allocations;
+        }
+
+        class State
+        {
+        public:
+            explicit State(clock::duration mintime) noexcept : _mintime(mintime), _batch(1), _left(0), _iterations(0),
+                _started(false), _paused(0), _pausedallocat(0), _pausedallocs(0), _allocs(0), nsperop(0.0), allocsperop(0.0) {}
+
+            //true while the loop should run another iteration
+            inline bool Running()
+            {
+                if (_left != 0)
+                {
+                    _left--;
+                    return true;
+                }
+                return Next();
+            }
+
+            void Pause()
+            {
+                _pausedat      = clock::now();
+                _pausedallocat = Allocations().load(std::memory_order_relaxed);
+            }
+            void Resume()
+            {
+                _pausedallocs += Allocations().load(std::memory_order_relaxed) - _pausedallocat;
+                _paused       += clock::now() - _pausedat;
+            }
+
+            inline unsigned long long iterations() const noexcept { return _iterations; }
+
+        private:
+            bool Next()
+            {
+                const clock::time_point now = clock::now();
+                if (!_started)
+                {
+                    _started = true;
+                    _start   = now;
+                    _allocs  = Allocations().load(std::memory_order_relaxed);
+                    _left    = _batch - 1;
+                    return true;
+                }
+                _iterations += _batch;
+                const clock::duration elapsed = (now - _start) - _paused;
+                if (elapsed < _mintime)
+                {
+                    //aim past mintime, but never more than 10 times the last batch
+                    const double ns     = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+                    const double target = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(_mintime).count()) * 1.2;
+                    const double next   = (ns > 0.0) ? (target * static_cast<double>(_iterations) / ns) - static_cast<double>(_iterations) : 0.0;
+                    _batch = ((next <= 0.0) || (next > static_cast<double>(_batch) * 10.0)) ? (_batch * 10) :
+                             ((next < static_cast<double>(_batch)) ? _batch : static_cast<unsigned long long>(next));
+                    _left  = _batch - 1;
+                    return true;
+                }
+                const unsigned long long allocs = Allocations().load(std::memory_order_relaxed) - _allocs - _pausedallocs;
+                nsperop     = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+                              static_cast<double>(_iterations);
+                allocsperop = static_cast<double>(allocs) / static_cast<double>(_iterations);
+                return false;
+            }
+
+            clock::duration    _mintime;
+            unsigned long long _batch;
+            unsigned long long _left;
+            unsigned long long _iterations;
+            bool               _started;
+            clock::time_point  _start;
+            clock::duration    _paused;
+            clock::time_point  _pausedat;
+            unsigned long long _pausedallocat;
+            unsigned long long _pausedallocs;
+            unsigned long long _allocs;
+
+        public:
+            double nsperop;     //results, set when Running returns false
+            double allocsperop;
+        };
+
+        struct Case
+        {
+            const char *name;
+            void      (*run)(State&);
+        };
+
+        inline std::vector<Case>& Cases()
+        {
+            static std::vector<Case> cases;
+            return cases;
+        }
+
+        struct Register
+        {
+            Register(const char *name, void (*run)(State&)) { Cases().push_back({ name, run }); }
+        };
+
+        #if defined(_MSC_VER)
+        template <class T>
+        inline void Keep(const T &value)
+        {
+            static const void *volatile sink;
+            sink = &value;
+            _ReadWriteBarrier();
+        }
+        #else
+        template <class T>
+        inline void Keep(const T &value)
+        {
+            __asm__ __volatile__("" : : "g"(&value) : "memory");
+        }
+        #endif
+
+        /*runs fn() in a loop on other threads until it is destroyed, so the loop the benchmark
+        times competes with them. ns/op is still per op of the measuring thread - with fewer cores
+        than threads it includes the time slices the other threads get*/
+        class Contenders
+        {
+        public:
+            template <class Fn>
+            Contenders(unsigned threads, Fn fn) : _stop(false)
+            {
+                for (unsigned i = 0; i < threads; i++)
+                {
+                    _threads.emplace_back([this, fn]()
+                    {
+                        while (!_stop.load(std::memory_order_relaxed))
+                            fn();
+                    });
+                }
+            }
+            ~Contenders()
+            {
+                _stop.store(true, std::memory_order_relaxed);
+                for (std::thread &thread : _threads)
+                {
+                    thread.join();
+                }
+            }
+
+            Contenders(const Contenders&) = delete;
+            Contenders& operator=(const Contenders&) = delete;
+
+        private:
+            std::atomic<bool>        _stop;
+            std::vector<std::thread> _threads;
+        };
+    }
+}
+
+#define BENCH(name)                                                                  \
+    static void name(WUIF::Bench::State&);                                           \
+    static const WUIF::Bench::Register name##_registered(#name, name);               \
+    static void name(WUIF::Bench::State &state)
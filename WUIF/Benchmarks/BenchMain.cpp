@@ -0,0 +1,223 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Runs the BENCHes linked into the executable and compares them with stored baselines
+
+    Benchmarks [--quick] [--baseline file] [--save file] [--tolerance percent] [name ...]
+
+    --quick             - run each benchmark once for 20 ms instead of the fastest of five 200 ms
+                          runs, times are printed but not compared (ctest runs this to catch new
+                          allocations)
+    --baseline file     - compare with the results in file (baseline.txt next to this file)
+    --save file         - write the results to file in the baseline format
+    --tolerance percent - how much slower than the baseline counts as a regression (default 25)
+
+Without names every benchmark is run. The exit code is non-zero if a benchmark allocates more per
+operation than its baseline or, without --quick, is slower than the baseline by more than the
+tolerance. Baseline files have one "name ns/op allocs/op" line per benchmark, # starts a comment.*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <string>
+#include "Bench.h"
+
+//every allocation in the process is counted, whichever thread makes it
+void* operator new(size_t size)
+{
+    WUIF::Bench::Allocations().fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc((size != 0) ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    WUIF::Bench::Allocations().fetch_add(1, std::memory_order_relaxed);
+    return malloc((size != 0) ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t &tag) noexcept { return operator new(size, tag); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { free(p); }
+
+namespace
+{
+    struct Result
+    {
+        double ns;
+        double allocs;
+    };
+
+    bool Load(const char *path, std::map<std::string, Result> &results)
+    {
+        FILE *f = fopen(path, "r");
+        if (f == nullptr)
+        {
+            return false;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), f) != nullptr)
+        {
+            char   name[128];
+            Result r;
+            if ((line[0] != '#') && (sscanf(line, "%127s %lf %lf", name, &r.ns, &r.allocs) == 3))
+            {
+                results[name] = r;
+            }
+        }
+        fclose(f);
+        return true;
+    }
+
+    bool Save(const char *path, const std::map<std::string, Result> &results)
+    {
+        FILE *f = fopen(path, "w");
+        if (f == nullptr)
+        {
+            return false;
+        }
+        //times only compare with a baseline from the same machine and compiler
+        #if defined(_MSC_VER)
+        fprintf(f, "#MSVC %d", _MSC_FULL_VER);
+        #elif defined(__clang__)
+        fprintf(f, "#clang %s", __clang_version__);
+        #elif defined(__GNUC__)
+        fprintf(f, "#GCC %s", __VERSION__);
+        #else
+        fprintf(f, "#unknown compiler");
+        #endif
+        #if defined(_M_AMD64) || defined(__x86_64__)
+        fprintf(f, ", x64");
+        #elif defined(_M_IX86) || defined(__i386__)
+        fprintf(f, ", x86");
+        #endif
+        #if defined(NDEBUG)
+        fprintf(f, ", release\n");
+        #else
+        fprintf(f, ", debug\n");
+        #endif
+        fprintf(f, "#name ns/op allocs/op - written by Benchmarks --save\n");
+        for (const std::pair<const std::string, Result> &r : results)
+        {
+            fprintf(f, "%s %.2f %.3f\n", r.first.c_str(), r.second.ns, r.second.allocs);
+        }
+        fclose(f);
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    bool        quick     = false;
+    const char *baseline  = nullptr;
+    const char *save      = nullptr;
+    double      tolerance = 25.0;
+    std::vector<const char*> names;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--quick") == 0)
+        {
+            quick = true;
+        }
+        else if ((strcmp(argv[i], "--baseline") == 0) && (i + 1 < argc))
+        {
+            baseline = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--save") == 0) && (i + 1 < argc))
+        {
+            save = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--tolerance") == 0) && (i + 1 < argc))
+        {
+            tolerance = atof(argv[++i]);
+        }
+        else
+        {
+            names.push_back(argv[i]);
+        }
+    }
+    std::map<std::string, Result> baselines;
+    if ((baseline != nullptr) && (!Load(baseline, baselines)))
+    {
+        fprintf(stderr, "can't read %s\n", baseline);
+        return 1;
+    }
+
+    const WUIF::Bench::clock::duration mintime = std::chrono::milliseconds(quick ? 20 : 200);
+    const int repeats = quick ? 1 : 5;
+    std::map<std::string, Result> results;
+    unsigned long regressions = 0;
+    printf("%-32s %12s %10s %12s %10s\n", "", "ns/op", "allocs/op", "baseline", "change");
+    for (const WUIF::Bench::Case &bench : WUIF::Bench::Cases())
+    {
+        bool selected = names.empty();
+        for (const char *name : names)
+        {
+            selected |= (strcmp(name, bench.name) == 0);
+        }
+        if (!selected)
+        {
+            continue;
+        }
+        //the fastest run is the one least disturbed by the rest of the machine
+        Result r = { 0.0, 0.0 };
+        for (int run = 0; run < repeats; run++)
+        {
+            WUIF::Bench::State state(mintime);
+            bench.run(state);
+            if ((run == 0) || (state.nsperop < r.ns))
+            {
+                r.ns = state.nsperop;
+            }
+            if ((run == 0) || (state.allocsperop < r.allocs))
+            {
+                r.allocs = state.allocsperop;
+            }
+        }
+        results[bench.name] = r;
+        printf("%-32s %12.2f %10.3f", bench.name, r.ns, r.allocs);
+        const std::map<std::string, Result>::const_iterator base = baselines.find(bench.name);
+        if (base != baselines.end())
+        {
+            const double change = (base->second.ns > 0.0) ? ((r.ns / base->second.ns) - 1.0) * 100.0 : 0.0;
+            printf(" %12.2f %+9.1f%%", base->second.ns, change);
+            //allocation counts don't depend on the machine, a small margin covers rounding
+            if (r.allocs > base->second.allocs + 0.001)
+            {
+                printf("  MORE ALLOCATIONS (%.3f)", base->second.allocs);
+                regressions++;
+            }
+            else if ((!quick) && (change > tolerance))
+            {
+                printf("  SLOWER");
+                regressions++;
+            }
+        }
+        printf("\n");
+    }
+    if ((save != nullptr) && (!Save(save, results)))
+    {
+        fprintf(stderr, "can't write %s\n", save);
+        return 1;
+    }
+    printf("%lu benchmarks, %lu regressions\n", static_cast<unsigned long>(results.size()), regressions);
+    return ((regressions == 0) && (!results.empty())) ? 0 : 1;
+}
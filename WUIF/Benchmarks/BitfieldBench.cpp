@@ -0,0 +1,109 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Bit field operations (Headers/Bitfield.h) over plain integers. BitfieldCheckedBench.cpp includes
+this file with _BITFIELD defined, as the framework is built, so checked_bit_field is measured
+against the integers it should compile down to. One op is a set, a clear, two toggles and a test on
+a field of Window_Flags' shape, or the fetch_or, test and test_and_clear Window::Present and
+App::EndLayout do on Window::state. AtomicBitfieldContended2/4 do a fetch_or, test_and_set and
+test_and_clear of their own bit of one shared field on 2 and 4 threads (see Bench::Contenders).*/
+#include <cstdint>
+#include "Bitfield.h"
+#include "Bench.h"
+
+#ifdef _BITFIELD
+#define BITFIELD_BENCH(name) BENCH(name##Checked)
+#else
+#define BITFIELD_BENCH(name) BENCH(name##Plain)
+#endif
+
+using WUIF::Bench::Contenders;
+using WUIF::Bench::Keep;
+
+namespace
+{
+    BIT_FIELD(uint_fast8_t, BenchFlags);
+    #ifdef _BITFIELD
+    bitfield_unique_id ui_BenchFlags;
+    #endif
+    BIT_MASK(BenchFlags, FIRST,  1);
+    BIT_MASK(BenchFlags, SECOND, 2);
+    BIT_MASK(BenchFlags, THIRD,  3);
+    BIT_MASK(BenchFlags, FOURTH, 4);
+    ATOMIC_BIT_FIELD(BenchFlags, AtomicBenchFlags);
+
+    //one thread's share of the contended benchmarks, on its own bit of the shared word
+    template <class Mask>
+    unsigned Contend(AtomicBenchFlags &field, const Mask &bit)
+    {
+        field.fetch_or(bit, std::memory_order_release);
+        unsigned set = field.test_and_set(bit, std::memory_order_acq_rel) ? 1 : 0;
+        set += field.test_and_clear(bit, std::memory_order_acq_rel) ? 1 : 0;
+        return set;
+    }
+}
+
+BITFIELD_BENCH(BitfieldOps)
+{
+    BenchFlags field = FIRST;
+    unsigned   set   = 0;
+    while (state.Running())
+    {
+        field |= SECOND;
+        field &= ~FIRST;
+        field ^= THIRD;
+        set   += (field & FOURTH) ? 1 : 0;
+        field ^= FIRST;
+        Keep(field);
+    }
+    Keep(set);
+}
+
+BITFIELD_BENCH(AtomicBitfieldOps)
+{
+    AtomicBenchFlags field;
+    unsigned         set = 0;
+    while (state.Running())
+    {
+        field.fetch_or(SECOND, std::memory_order_release);
+        set += field.test(SECOND, std::memory_order_acquire) ? 1 : 0;
+        set += field.test_and_clear(SECOND, std::memory_order_acq_rel) ? 1 : 0;
+    }
+    Keep(set);
+}
+
+BITFIELD_BENCH(AtomicBitfieldContended2)
+{
+    AtomicBenchFlags field;
+    Contenders others(1, [&field]() { Contend(field, SECOND); });
+    unsigned set = 0;
+    while (state.Running())
+    {
+        set += Contend(field, FIRST);
+    }
+    Keep(set);
+}
+
+BITFIELD_BENCH(AtomicBitfieldContended4)
+{
+    AtomicBenchFlags field;
+    Contenders second(1, [&field]() { Contend(field, SECOND); });
+    Contenders third(1, [&field]() { Contend(field, THIRD); });
+    Contenders fourth(1, [&field]() { Contend(field, FOURTH); });
+    unsigned set = 0;
+    while (state.Running())
+    {
+        set += Contend(field, FIRST);
+    }
+    Keep(set);
+}
@@ -0,0 +1,157 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*checked_bit_set (Headers/Bitset.h) against std::bitset on 1024 bit sets with 40 bits set, the size
+and density of a message filter. Ops times and, or, xor and andnot (a &= ~b for std::bitset) on two
+sets; Count counts the bits; FindNext walks the set bits with find_first/find_next and ForEach with
+for_each, where std::bitset has nothing better than testing every bit.*/
+#include <bitset>
+#include <cstddef>
+#include <random>
+#include "Bitset.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+
+namespace
+{
+    const size_t bits = 1024;
+    BIT_SET(BenchSet, bits);
+    bitset_unique_id ui_BenchSet;
+    typedef std::bitset<bits> StdSet;
+
+    //the same 40 random bits in both representations
+    template <class Set>
+    void Fill(Set &set, unsigned seed)
+    {
+        std::mt19937 random(seed);
+        for (int i = 0; i < 40; i++)
+        {
+            set.set(random() % bits);
+        }
+    }
+}
+
+BENCH(BitsetOps)
+{
+    BenchSet a, b;
+    Fill(a, 1);
+    Fill(b, 2);
+    Keep(b);
+    while (state.Running())
+    {
+        //Keep after every operation so they aren't folded into one
+        a |= b;
+        Keep(a);
+        a &= b;
+        Keep(a);
+        a ^= b;
+        Keep(a);
+        a.andnot(b);
+        Keep(a);
+    }
+}
+
+BENCH(StdBitsetOps)
+{
+    StdSet a, b;
+    Fill(a, 1);
+    Fill(b, 2);
+    Keep(b);
+    while (state.Running())
+    {
+        //Keep after every operation so they aren't folded into one
+        a |= b;
+        Keep(a);
+        a &= b;
+        Keep(a);
+        a ^= b;
+        Keep(a);
+        a &= ~b;
+        Keep(a);
+    }
+}
+
+BENCH(BitsetCount)
+{
+    BenchSet a;
+    Fill(a, 1);
+    size_t n = 0;
+    while (state.Running())
+    {
+        Keep(a);
+        n += a.count();
+    }
+    Keep(n);
+}
+
+BENCH(StdBitsetCount)
+{
+    StdSet a;
+    Fill(a, 1);
+    size_t n = 0;
+    while (state.Running())
+    {
+        Keep(a);
+        n += a.count();
+    }
+    Keep(n);
+}
+
+BENCH(BitsetFindNext)
+{
+    BenchSet a;
+    Fill(a, 1);
+    size_t n = 0;
+    while (state.Running())
+    {
+        Keep(a);
+        for (size_t i = a.find_first(); i < bits; i = a.find_next(i))
+        {
+            n += i;
+        }
+    }
+    Keep(n);
+}
+
+BENCH(BitsetForEach)
+{
+    BenchSet a;
+    Fill(a, 1);
+    size_t n = 0;
+    while (state.Running())
+    {
+        Keep(a);
+        a.for_each([&n](size_t i) { n += i; });
+    }
+    Keep(n);
+}
+
+BENCH(StdBitsetTestLoop)
+{
+    StdSet a;
+    Fill(a, 1);
+    size_t n = 0;
+    while (state.Running())
+    {
+        Keep(a);
+        for (size_t i = 0; i < bits; i++)
+        {
+            if (a.test(i))
+            {
+                n += i;
+            }
+        }
+    }
+    Keep(n);
+}
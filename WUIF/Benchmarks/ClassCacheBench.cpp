@@ -0,0 +1,99 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Window class registration (Source/Window/WindowClassCache.cpp) built against the fake Win32
+functions in Tests/Win32. One op is a window created and destroyed:
+
+    WindowClassCacheShared     - Acquire and Release of a class another window already holds
+    WindowClassCacheRegister   - Acquire and Release of a class nothing else uses, so it is
+                                 registered and unregistered
+    WindowClassPerWindow       - a uniquely named RegisterClassEx/UnregisterClass pair, what every
+                                 window did before the cache
+
+The fakes keep classes in a std::map and make no system call, so only the shared case compares
+with what Windows does - the real RegisterClassEx and UnregisterClass are much slower than the
+fakes, every op that registers costs at least that.*/
+#include "stdafx.h"
+#include "Window/Window.h"
+#include "Window/WindowClassCache.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+using WUIF::WindowClassCache;
+
+namespace WUIF {
+    namespace App {
+        extern const volatile HINSTANCE hInstance = reinterpret_cast<HINSTANCE>(static_cast<uintptr_t>(0x400000));
+    }
+}
+
+namespace
+{
+    template <class Handle>
+    Handle MakeHandle(uintptr_t value) { return reinterpret_cast<Handle>(value * 16); }
+}
+
+BENCH(WindowClassCacheShared)
+{
+    const HICON   icon   = MakeHandle<HICON>(1);
+    const HCURSOR cursor = MakeHandle<HCURSOR>(2);
+    const ATOM    held   = WindowClassCache::Acquire(icon, icon, cursor, 0);
+    if (held == 0)
+    {
+        return;
+    }
+    while (state.Running())
+    {
+        const ATOM atom = WindowClassCache::Acquire(icon, icon, cursor, 0);
+        Keep(atom);
+        WindowClassCache::Release(atom);
+    }
+    WindowClassCache::Release(held);
+}
+
+BENCH(WindowClassCacheRegister)
+{
+    const HICON   icon   = MakeHandle<HICON>(3);
+    const HCURSOR cursor = MakeHandle<HCURSOR>(4);
+    while (state.Running())
+    {
+        const ATOM atom = WindowClassCache::Acquire(icon, icon, cursor, 0);
+        Keep(atom);
+        WindowClassCache::Release(atom);
+    }
+}
+
+BENCH(WindowClassPerWindow)
+{
+    const HICON   icon   = MakeHandle<HICON>(5);
+    const HCURSOR cursor = MakeHandle<HCURSOR>(6);
+    unsigned long classnames = 0;
+    while (state.Running())
+    {
+        //as Window::Window registered its class before WindowClassCache
+        TCHAR classname[16];
+        StringCchPrintf(classname, ARRAYSIZE(classname), TEXT("WUIFB%lu"), ++classnames);
+        WNDCLASSEX wndclass    = {};
+        wndclass.lpszClassName = classname;
+        wndclass.cbSize        = sizeof(WNDCLASSEX);
+        wndclass.lpfnWndProc   = WUIF::Window::T_SC_WindowProc;
+        wndclass.hInstance     = WUIF::App::hInstance;
+        wndclass.hIcon         = icon;
+        wndclass.hCursor       = cursor;
+        wndclass.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
+        wndclass.hIconSm       = icon;
+        const ATOM atom = RegisterClassEx(&wndclass);
+        Keep(atom);
+        UnregisterClass(MAKEINTATOM(atom), WUIF::App::hInstance);
+    }
+}
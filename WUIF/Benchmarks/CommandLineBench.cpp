@@ -0,0 +1,98 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Command line splitting (Headers/Utils/CommandLineSplit.h). CommandLineToArgvA itself needs
+Windows.h, so the Argv benchmarks do what it does around the split - one block for argv and the
+strings, filled by CommandLine::Parse - with new[] in place of HeapAlloc. One op is one command line,
+a typical one and one of 32 KB (the longest Windows allows).*/
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "Utils/CommandLineSplit.h"
+#include "Bench.h"
+
+using WUIF::ArgView;
+using WUIF::Bench::Keep;
+using WUIF::CommandLine;
+
+namespace
+{
+    const char typical[] = "\"C:\\Program Files\\WUIF Sample\\Sample.exe\" --width 1280 --height 720 "
+                           "/config \"C:\\Users\\someone\\AppData\\Local\\WUIF Sample\\settings.ini\" "
+                           "-v \"title=\\\"Main window\\\"\" C:\\Users\\someone\\Documents\\scene.dat";
+
+    std::string Long()
+    {
+        std::string s = "\"C:\\Program Files\\WUIF Launcher\\launcher.exe\"";
+        char arg[96];
+        for (int i = 0; s.size() < 32000; i++)
+        {
+            if ((i % 3) == 0)
+                snprintf(arg, sizeof(arg), " \"C:\\Users\\someone\\Documents\\Project Files\\asset %05d.png\"", i);
+            else
+                snprintf(arg, sizeof(arg), " C:\\Users\\someone\\Documents\\build\\objects\\module_%05d.obj", i);
+            s += arg;
+        }
+        return s;
+    }
+
+    void Split(WUIF::Bench::State &state, const std::string &cmdline)
+    {
+        std::vector<char>    buffer(cmdline.size() + 1);
+        std::vector<ArgView> args(CommandLine::MaxArgs(cmdline.size()));
+        while (state.Running())
+        {
+            const size_t argc = CommandLine::Split(cmdline.c_str(), buffer.data(), args.data(), args.size());
+            Keep(argc);
+            Keep(args[argc - 1]);
+        }
+    }
+
+    void Argv(WUIF::Bench::State &state, const std::string &cmdline)
+    {
+        while (state.Running())
+        {
+            const size_t length  = cmdline.size();
+            const size_t maxargs = CommandLine::MaxArgs(length);
+            char **argv    = reinterpret_cast<char**>(new char[(sizeof(char*) * (maxargs + 1)) + length + 1]);
+            char *strings  = reinterpret_cast<char*>(argv + maxargs + 1);
+            const size_t argc = CommandLine::Parse(cmdline.c_str(), strings, true, [argv](size_t i, char *begin, size_t)
+            {
+                argv[i] = begin;
+            });
+            argv[argc] = nullptr;
+            Keep(argv[argc - 1][0]);
+            delete[] reinterpret_cast<char*>(argv);
+        }
+    }
+}
+
+BENCH(CommandLineSplit)
+{
+    Split(state, typical);
+}
+
+BENCH(CommandLineSplit32K)
+{
+    Split(state, Long());
+}
+
+BENCH(CommandLineArgv)
+{
+    Argv(state, typical);
+}
+
+BENCH(CommandLineArgv32K)
+{
+    Argv(state, Long());
+}
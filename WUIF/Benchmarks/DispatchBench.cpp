@@ -0,0 +1,81 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Message dispatch lookup - Window::_WndProc's MessageMap::handles test before the map lookup,
+against looking every message up in the unordered_map as it did before MessageMap. One op is one
+message of a recorded mix, most of which nothing handles.*/
+#include "stdafx.h"
+#include <unordered_map>
+#include "Window/MessageMap.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+
+namespace
+{
+    typedef LRESULT (*Proc)(UINT);
+
+    LRESULT Handled(UINT message) { return static_cast<LRESULT>(message); }
+
+    //what a window gets while the mouse moves over it and it animates
+    const UINT trace[] = {
+        0x0200, 0x0084, 0x0020, 0x0200, 0x0084, 0x0020, 0x0113, 0x000F, //WM_MOUSEMOVE, WM_NCHITTEST, WM_SETCURSOR, WM_TIMER, WM_PAINT
+        0x0200, 0x0084, 0x0020, 0x0014, 0x0200, 0x0084, 0x0020, 0x0113, //WM_ERASEBKGND
+        0x02A3, 0x0086, 0x0006, 0x001C, 0x0007, 0x0281, 0x0282, 0x0008, //WM_MOUSELEAVE, activation and focus
+        0x0100, 0x0102, 0x0101, 0x0046, 0x0024, 0x0047, 0x0005, 0x0003  //keys, WM_WINDOWPOSCHANGING/ED, WM_SIZE, WM_MOVE
+    };
+    const size_t tracesize = sizeof(trace) / sizeof(trace[0]);
+    static_assert((tracesize & (tracesize - 1)) == 0, "the trace is indexed with a mask");
+
+    //handlers a typical application installs
+    const UINT handled[] = { 0x0005, 0x000F, 0x0100, 0x0102, 0x0111, 0x0113, 0x0201, 0x0202 };
+}
+
+BENCH(MessageMapDispatch)
+{
+    WUIF::MessageMap<Proc> map;
+    for (UINT message : handled)
+    {
+        map[message] = Handled;
+    }
+    size_t i = 0;
+    LRESULT result = 0;
+    while (state.Running())
+    {
+        const UINT message = trace[i++ & (tracesize - 1)];
+        if (map.handles(message))
+        {
+            const Proc proc = map.find(message);
+            result += (proc != nullptr) ? proc(message) : 0;
+        }
+        Keep(result);
+    }
+}
+
+BENCH(UnorderedMapDispatch)
+{
+    std::unordered_map<UINT, Proc> map;
+    for (UINT message : handled)
+    {
+        map[message] = Handled;
+    }
+    size_t i = 0;
+    LRESULT result = 0;
+    while (state.Running())
+    {
+        const UINT message = trace[i++ & (tracesize - 1)];
+        const std::unordered_map<UINT, Proc>::const_iterator proc = map.find(message);
+        result += (proc != map.end()) ? proc->second(message) : 0;
+        Keep(result);
+    }
+}
@@ -0,0 +1,88 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Logging - what DebugPrint costs the thread that logs. AsyncLogPut queues a message for the
+consumer thread (Headers/Utils/AsyncLog.h), draining the ring with the clock stopped so no message is
+dropped. AsyncLogThroughput keeps the clock running through the drains, so it is the cost of a
+message from Log to the sink. LogFormatSync formats the same message on the calling thread as
+DebugPrintSync does, with a sink that does nothing in place of OutputDebugString.*/
+#include <cstdio>
+#include "Utils/AsyncLog.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+
+namespace
+{
+    typedef WUIF::AsyncLog<char> Log;
+
+    const char format[] = "[WUIF] window %p resized to %dx%d at %u dpi (%s)";
+    const char reason[] = "WM_DPICHANGED";
+
+    unsigned long long sunk = 0;
+    void Sink(const char *line) { sunk += static_cast<unsigned char>(line[0]); }
+}
+
+BENCH(AsyncLogPut)
+{
+    if (!Log::Start(Sink, 1024 * 1024))
+    {
+        return;
+    }
+    const void *window = &sunk;
+    unsigned n = 0;
+    while (state.Running())
+    {
+        Log::Log(format, window, 1280, 720, 144u, reason);
+        if ((++n & 4095) == 0)
+        {
+            state.Pause();
+            Log::Flush();
+            state.Resume();
+        }
+    }
+    Log::Stop();
+    Keep(sunk);
+}
+
+BENCH(AsyncLogThroughput)
+{
+    if (!Log::Start(Sink, 1024 * 1024))
+    {
+        return;
+    }
+    const void *window = &sunk;
+    unsigned n = 0;
+    while (state.Running())
+    {
+        Log::Log(format, window, 1280, 720, 144u, reason);
+        if ((++n & 4095) == 0)
+        {
+            Log::Flush();
+        }
+    }
+    Log::Stop();
+    Keep(sunk);
+}
+
+BENCH(LogFormatSync)
+{
+    const void *window = &sunk;
+    char line[1024];
+    while (state.Running())
+    {
+        snprintf(line, sizeof(line), format, window, 1280, 720, 144u, reason);
+        Sink(line);
+    }
+    Keep(sunk);
+}
@@ -0,0 +1,149 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*The window registry and the per window callbacks. App::Windows and WINVECLOCK live in sources that
+need the Windows SDK, so Registry below copies them - a vector of Window pointers behind a mutex
+and a condition variable - and the benchmarks do what Window::Window and Window::~Window
+(insert, find and erase), App::BeginLayout (iterate) and App::EndLayout (copy) do with 32 windows
+open. DrawRoutines calls a window's draw routines in order, as Window::Present does.*/
+#include <condition_variable>
+#include <forward_list>
+#include <mutex>
+#include <vector>
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+
+namespace
+{
+    struct Window
+    {
+        unsigned long updates;
+        void BeginUpdate() { updates++; }
+    };
+    typedef void(*winptr)(Window*);
+
+    //App::Windows, App::veclock, App::vecready and App::vecwrite
+    struct Registry
+    {
+        std::vector<Window*>    windows;
+        std::mutex              lock;
+        std::condition_variable ready;
+        bool                    writable = true;
+    };
+
+    #define REGISTRYLOCK(r)   std::unique_lock<std::mutex> guard((r).lock);                \
+                              (r).ready.wait(guard, [&r]() { return (r).writable; });     \
+                              (r).writable = false;
+    #define REGISTRYUNLOCK(r) (r).writable = true;                                        \
+                              guard.unlock();                                             \
+                              (r).ready.notify_one();
+
+    const size_t open = 32;
+
+    void Fill(Registry &r, std::vector<Window> &windows)
+    {
+        for (Window &w : windows)
+        {
+            r.windows.push_back(&w);
+        }
+    }
+
+    void Draw(Window *w) { w->updates += 2; }
+}
+
+BENCH(WindowRegistryInsertErase)
+{
+    Registry r;
+    std::vector<Window> windows(open + 1);
+    Fill(r, windows);
+    r.windows.pop_back();
+    size_t next = open;
+    while (state.Running())
+    {
+        //a window is created, and the oldest one is destroyed
+        Window *created = &windows[next];
+        {
+            REGISTRYLOCK(r)
+            r.windows.push_back(created);
+            REGISTRYUNLOCK(r)
+        }
+        next = (next + 1) % windows.size();
+        Window *destroyed = &windows[next];
+        {
+            REGISTRYLOCK(r)
+            for (std::vector<Window*>::iterator win = r.windows.begin(); win != r.windows.end(); ++win)
+            {
+                if (*win == destroyed)
+                {
+                    r.windows.erase(win);
+                    break;
+                }
+            }
+            REGISTRYUNLOCK(r)
+        }
+    }
+    Keep(r.windows.size());
+}
+
+BENCH(WindowRegistryIterate)
+{
+    Registry r;
+    std::vector<Window> windows(open);
+    Fill(r, windows);
+    while (state.Running())
+    {
+        REGISTRYLOCK(r)
+        for (std::vector<Window*>::iterator win = r.windows.begin(); win != r.windows.end(); ++win)
+        {
+            (*win)->BeginUpdate();
+        }
+        REGISTRYUNLOCK(r)
+    }
+    Keep(windows[0].updates);
+}
+
+BENCH(WindowRegistryCopy)
+{
+    Registry r;
+    std::vector<Window> windows(open);
+    Fill(r, windows);
+    while (state.Running())
+    {
+        std::vector<Window*> wins;
+        {
+            REGISTRYLOCK(r)
+            wins = r.windows;
+            REGISTRYUNLOCK(r)
+        }
+        Keep(wins.back());
+    }
+}
+
+BENCH(DrawRoutines)
+{
+    Window window = {};
+    std::forward_list<winptr> drawroutines;
+    for (int i = 0; i < 4; i++)
+    {
+        drawroutines.push_front(Draw);
+    }
+    while (state.Running())
+    {
+        for (std::forward_list<winptr>::iterator dr = drawroutines.begin(); dr != drawroutines.end(); ++dr)
+        {
+            (*dr)(&window);
+        }
+        Keep(window.updates);
+    }
+}
@@ -0,0 +1,105 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*DPI scaling - WindowProperties::ScalePoints (MulDivArray) against calling Scale (MulDiv) per
+coordinate, one op being 256 points at 150%, and the two DPI lookups behind getWindowDPI: the
+window's own value checked against DPICache::Epoch, and DPICache::Lookup (Source/Window/DPICache.cpp,
+built against the stand-in stdafx.h in Tests/Win32).*/
+#include "stdafx.h"
+#include <cstdint>
+#include <vector>
+#include "Utils/MulDivArray.h"
+#include "Window/DPICache.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+using WUIF::DPICache;
+
+namespace
+{
+    const size_t points = 256;
+
+    std::vector<int32_t> Coordinates()
+    {
+        std::vector<int32_t> values(points * 2);
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            values[i] = static_cast<int32_t>((i * 37) % 1920);
+        }
+        return values;
+    }
+
+    HMONITOR Monitor(uintptr_t i) { return reinterpret_cast<HMONITOR>(0x1000 + (i * 0x10)); }
+}
+
+BENCH(ScalePoints256)
+{
+    const std::vector<int32_t> in = Coordinates();
+    std::vector<int32_t> out(in.size());
+    while (state.Running())
+    {
+        WUIF::MulDivArray(in.data(), out.data(), in.size(), 150, 100);
+        Keep(out[0]);
+    }
+}
+
+BENCH(ScalePoints256MulDiv)
+{
+    const std::vector<int32_t> in = Coordinates();
+    std::vector<int32_t> out(in.size());
+    while (state.Running())
+    {
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            out[i] = MulDiv(in[i], 150, 100);
+        }
+        Keep(out[0]);
+    }
+}
+
+BENCH(WindowDPIHit)
+{
+    //Window::getWindowDPI while nothing has changed
+    const unsigned long dpiepoch = DPICache::Epoch();
+    const UINT          dpi      = 144;
+    UINT                total    = 0;
+    while (state.Running())
+    {
+        if ((dpiepoch == DPICache::Epoch()) && (dpi != 0))
+        {
+            DPICache::WindowHit();
+            total += dpi;
+        }
+        Keep(total);
+    }
+}
+
+BENCH(DPICacheLookup)
+{
+    for (uintptr_t i = 0; i < 4; i++)
+    {
+        DPICache::Store(Monitor(i), { static_cast<UINT>(96 + (i * 24)), DPICache::ScaleFromDPI(static_cast<UINT>(96 + (i * 24))) });
+    }
+    uintptr_t i = 0;
+    UINT total = 0;
+    while (state.Running())
+    {
+        DPICache::Entry entry;
+        if (DPICache::Lookup(Monitor(i++ & 3), entry))
+        {
+            total += entry.scale;
+        }
+        Keep(total);
+    }
+    DPICache::InvalidateAll();
+}
@@ -0,0 +1,44 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Scoped tracing spans (Headers/Utils/TraceSpan.h) - what WUIF_TRACE_SPAN costs in TRACESPANS builds,
+for the spans _WndProc opens around every message. The TraceSpan objects are used directly so the
+benchmark doesn't depend on how it is compiled. One op is one span.*/
+#if defined(_WIN32)
+#include <Windows.h> //TraceSpan.h reads QueryPerformanceCounter
+#endif
+#include <cstdint>
+#include "Utils/TraceSpan.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+
+BENCH(TraceSpan)
+{
+    uint64_t work = 0;
+    while (state.Running())
+    {
+        ::WUIF::TraceSpan span("Present");
+        Keep(++work);
+    }
+}
+
+BENCH(TraceSpanArg)
+{
+    uint64_t message = 0;
+    while (state.Running())
+    {
+        ::WUIF::TraceSpan span("_WndProc", (message++ & 0x3FF));
+        Keep(message);
+    }
+}
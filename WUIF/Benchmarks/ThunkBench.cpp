@@ -0,0 +1,177 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Getting from a window handle to its Window - calling through the window's WndProc thunk (the
+ThunkEmitter::Native back end, as Window::Window sets it up) against looking the handle up in a map
+of 64 windows. One op is one message.
+
+ThunkSlab* time the slab handing out and taking back a thunk (one op is an Allocate and a Free) on
+its own and with three other threads doing the same, against malloc/free of the same size.*/
+#if defined(_WIN32)
+#include <Windows.h> //ThunkSlab.h uses VirtualAlloc and VirtualProtect
+#endif
+#include <cstdint>
+#include <cstdlib>
+#include <unordered_map>
+#include <vector>
+#include "Utils/ThunkEmitter.h"
+#include "Bench.h"
+
+using WUIF::Bench::Contenders;
+using WUIF::Bench::Keep;
+using WUIF::ThunkSlab;
+
+#if defined(__x86_64__) || defined(_M_AMD64) || defined(_M_IX86)
+namespace
+{
+    struct Handle__ { int unused; };
+    typedef Handle__ *Handle;
+
+    struct Target
+    {
+        uintptr_t messages;
+    };
+
+    const size_t windows = 64;
+
+    //the object is the fifth parameter on x64 and the first on x86, as for Window::_WndProc
+    #if defined(_M_IX86)
+    intptr_t __stdcall Bound(Target *target, Handle, unsigned message, uintptr_t, intptr_t)
+    {
+        target->messages += message;
+        return 0;
+    }
+    typedef intptr_t (__stdcall *Thunk)(Handle, unsigned, uintptr_t, intptr_t);
+    #else
+    intptr_t Bound(Handle, unsigned message, uintptr_t, intptr_t, Target *target)
+    {
+        target->messages += message;
+        return 0;
+    }
+    typedef intptr_t (*Thunk)(Handle, unsigned, uintptr_t, intptr_t);
+    #endif
+
+    intptr_t Looked(Target *target, unsigned message)
+    {
+        target->messages += message;
+        return 0;
+    }
+
+    Handle MakeHandle(size_t i) { return reinterpret_cast<Handle>(static_cast<uintptr_t>(0x10000 + (i * 0x2a))); }
+
+    const unsigned contenders = 3;
+
+    void AllocateFree(ThunkSlab &slab)
+    {
+        ThunkSlab::Slot slot;
+        if (slab.Allocate(slot))
+        {
+            Keep(slot.code);
+            slab.Free(slot);
+        }
+    }
+
+    void HeapAllocateFree()
+    {
+        void *p = malloc(ThunkSlab::codesize);
+        Keep(p);
+        free(p);
+    }
+}
+
+BENCH(ThunkDispatch)
+{
+    ThunkSlab slab(WUIF::ThunkEmitter::Native<4>);
+    std::vector<ThunkSlab::Slot> slots(windows);
+    std::vector<Target> targets(windows);
+    for (size_t i = 0; i < windows; i++)
+    {
+        if (!slab.Allocate(slots[i]))
+        {
+            return;
+        }
+        slots[i].data->object.store(reinterpret_cast<uintptr_t>(&targets[i]));
+        slots[i].data->target.store(reinterpret_cast<uintptr_t>(&Bound));
+    }
+    size_t i = 0;
+    while (state.Running())
+    {
+        const size_t w = (i++ * 7) & (windows - 1);
+        reinterpret_cast<Thunk>(slots[w].code)(MakeHandle(w), 0x0200, 0, 0);
+    }
+    Keep(targets[0].messages);
+    for (ThunkSlab::Slot &slot : slots)
+    {
+        slab.Free(slot);
+    }
+}
+
+BENCH(WindowMapDispatch)
+{
+    std::unordered_map<Handle, Target*> map;
+    std::vector<Target> targets(windows);
+    for (size_t i = 0; i < windows; i++)
+    {
+        map[MakeHandle(i)] = &targets[i];
+    }
+    size_t i = 0;
+    while (state.Running())
+    {
+        const size_t w = (i++ * 7) & (windows - 1);
+        const std::unordered_map<Handle, Target*>::const_iterator target = map.find(MakeHandle(w));
+        if (target != map.end())
+        {
+            Looked(target->second, 0x0200);
+        }
+    }
+    Keep(targets[0].messages);
+}
+
+BENCH(ThunkSlabAllocateFree)
+{
+    ThunkSlab slab(WUIF::ThunkEmitter::Native<4>);
+    AllocateFree(slab); //maps the first block
+    while (state.Running())
+    {
+        AllocateFree(slab);
+    }
+}
+
+BENCH(ThunkSlabAllocateFree4Threads)
+{
+    ThunkSlab slab(WUIF::ThunkEmitter::Native<4>);
+    AllocateFree(slab);
+    Contenders others(contenders, [&slab]() { AllocateFree(slab); });
+    while (state.Running())
+    {
+        AllocateFree(slab);
+    }
+}
+
+BENCH(MallocFree)
+{
+    while (state.Running())
+    {
+        HeapAllocateFree();
+    }
+}
+
+BENCH(MallocFree4Threads)
+{
+    Contenders others(contenders, HeapAllocateFree);
+    while (state.Running())
+    {
+        HeapAllocateFree();
+    }
+}
+#endif
@@ -0,0 +1,90 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Binary tracing (Headers/Utils/BinaryTrace.h) - what a DebugPrint call site costs in BINARYTRACE
+builds, with the same site definition DebugPrintAt does. The file is reopened with the clock
+stopped before it fills, so no event is dropped. One op is one event.*/
+#if defined(_WIN32)
+#include <Windows.h> //BinaryTrace.h maps the file with CreateFileMapping
+#endif
+#include <cstdio>
+#include "Utils/BinaryTrace.h"
+#include "Bench.h"
+
+using WUIF::BinaryTrace;
+
+namespace
+{
+    #if defined(_WIN32)
+    const TCHAR tracefile[] = TEXT("BenchTrace.trc");
+    void RemoveTrace() { DeleteFile(tracefile); }
+    #else
+    const char tracefile[] = "BenchTrace.trc";
+    void RemoveTrace() { remove(tracefile); }
+    #endif
+
+    const uint64_t capacity = 64 * 1024;
+
+    //WUIF::DebugPrintAt
+    template <uint32_t Site, class... Args>
+    inline void TracePrint(const char *file, unsigned line, const char *format, const Args&... args)
+    {
+        static const bool defined = BinaryTrace::Define(Site, file, line, format);
+        (void)defined;
+        BinaryTrace::Event(Site, args...);
+    }
+
+    //runs the loop with an open trace file, reopening it before it fills
+    template <class Fn>
+    void Trace(WUIF::Bench::State &state, unsigned recordsperop, Fn fn)
+    {
+        if (!BinaryTrace::Open(tracefile, capacity))
+        {
+            return;
+        }
+        const uint64_t ops = (capacity / 2) / recordsperop;
+        uint64_t n = 0;
+        while (state.Running())
+        {
+            fn();
+            if (++n == ops)
+            {
+                state.Pause();
+                BinaryTrace::Close();
+                BinaryTrace::Open(tracefile, capacity);
+                state.Resume();
+                n = 0;
+            }
+        }
+        BinaryTrace::Close();
+        RemoveTrace();
+    }
+}
+
+BENCH(BinaryTraceEvent)
+{
+    const void *window = &state;
+    Trace(state, 1, [window]()
+    {
+        TracePrint<WUIF::TraceSiteId(__FILE__, __LINE__)>(__FILE__, __LINE__, "window %p resized to %dx%d at %u dpi", window, 1280, 720, 144u);
+    });
+}
+
+BENCH(BinaryTraceEventString)
+{
+    //a string argument adds a TEXT record
+    Trace(state, 2, []()
+    {
+        TracePrint<WUIF::TraceSiteId(__FILE__, __LINE__)>(__FILE__, __LINE__, "message %s for window %d", "WM_DPICHANGED", 3);
+    });
+}
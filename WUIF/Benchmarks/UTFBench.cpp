@@ -0,0 +1,221 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*UTF-8 <-> UTF-16 transcoding (Headers/Utils/UTF.h) - a window title through UTF16Buffer, as
+SetWindowTextW gets it, and 4 KB of ASCII and of accented text each way. The *Scalar benchmarks
+convert the same text with a plain one code point at a time loop that validates as much, the
+reference UTF::ToUTF16 and UTF::ToUTF8 have to beat.*/
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Utils/UTF.h"
+#include "Bench.h"
+
+using WUIF::Bench::Keep;
+using WUIF::UTF;
+using WUIF::UTF16Char;
+
+namespace
+{
+    std::string Text(const char *repeat)
+    {
+        std::string s;
+        while (s.size() < 4096)
+        {
+            s += repeat;
+        }
+        s.resize(4096);
+        //don't end in the middle of a sequence
+        while ((static_cast<unsigned char>(s.back()) & 0xc0) == 0x80)
+        {
+            s.pop_back();
+        }
+        if (static_cast<unsigned char>(s.back()) >= 0xc0)
+        {
+            s.pop_back();
+        }
+        return s;
+    }
+
+    const char ascii[]  = "Window 12 - C:\\Users\\someone\\Documents\\report final (v2).txt ";
+    const char latin[]  = "Fen\xc3\xaatre principale - r\xc3\xa9sum\xc3\xa9 d\xc3\xa9j\xc3\xa0 vu, na\xc3\xafve caf\xc3\xa9 ";
+
+    //the reference - strict, one code point at a time
+    size_t ScalarToUTF16(const char *src, size_t length, UTF16Char *dst)
+    {
+        const unsigned char *s   = reinterpret_cast<const unsigned char*>(src);
+        const unsigned char *end = s + length;
+        UTF16Char *d = dst;
+        while (s < end)
+        {
+            const unsigned char c = *s;
+            uint32_t cp;
+            size_t   n;
+            if (c < 0x80)      { cp = c;          n = 1; }
+            else if (c < 0xc2) { return UTF::invalid; }
+            else if (c < 0xe0) { cp = c & 0x1fU;  n = 2; }
+            else if (c < 0xf0) { cp = c & 0x0fU;  n = 3; }
+            else if (c < 0xf5) { cp = c & 0x07U;  n = 4; }
+            else               { return UTF::invalid; }
+            if (static_cast<size_t>(end - s) < n)
+            {
+                return UTF::invalid;
+            }
+            for (size_t i = 1; i < n; i++)
+            {
+                if ((s[i] & 0xc0) != 0x80)
+                {
+                    return UTF::invalid;
+                }
+                cp = (cp << 6) | (s[i] & 0x3fU);
+            }
+            static const uint32_t minimum[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+            if ((cp < minimum[n]) || (cp > 0x10ffff) || ((cp - 0xd800) < 0x800))
+            {
+                return UTF::invalid;
+            }
+            if (cp >= 0x10000)
+            {
+                cp -= 0x10000;
+                *d++ = static_cast<UTF16Char>(0xd800 + (cp >> 10));
+                *d++ = static_cast<UTF16Char>(0xdc00 + (cp & 0x3ff));
+            }
+            else
+            {
+                *d++ = static_cast<UTF16Char>(cp);
+            }
+            s += n;
+        }
+        return static_cast<size_t>(d - dst);
+    }
+
+    size_t ScalarToUTF8(const UTF16Char *src, size_t length, char *dst)
+    {
+        const UTF16Char *s   = src;
+        const UTF16Char *end = src + length;
+        unsigned char *d = reinterpret_cast<unsigned char*>(dst);
+        while (s < end)
+        {
+            uint32_t cp = static_cast<uint16_t>(*s++);
+            if ((cp - 0xd800) < 0x800)
+            {
+                if ((cp >= 0xdc00) || (s == end) || ((static_cast<uint16_t>(*s) - 0xdc00U) >= 0x400))
+                {
+                    return UTF::invalid;
+                }
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (static_cast<uint16_t>(*s++) - 0xdc00);
+            }
+            if (cp < 0x80)
+            {
+                *d++ = static_cast<unsigned char>(cp);
+            }
+            else if (cp < 0x800)
+            {
+                *d++ = static_cast<unsigned char>(0xc0 | (cp >> 6));
+                *d++ = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+            }
+            else if (cp < 0x10000)
+            {
+                *d++ = static_cast<unsigned char>(0xe0 | (cp >> 12));
+                *d++ = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3f));
+                *d++ = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+            }
+            else
+            {
+                *d++ = static_cast<unsigned char>(0xf0 | (cp >> 18));
+                *d++ = static_cast<unsigned char>(0x80 | ((cp >> 12) & 0x3f));
+                *d++ = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3f));
+                *d++ = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+            }
+        }
+        return static_cast<size_t>(d - reinterpret_cast<unsigned char*>(dst));
+    }
+
+    template <size_t (*Convert)(const char*, size_t, UTF16Char*)>
+    void ToUTF16(WUIF::Bench::State &state, const std::string &text)
+    {
+        std::vector<UTF16Char> out(text.size());
+        while (state.Running())
+        {
+            Keep(Convert(text.data(), text.size(), out.data()));
+            Keep(out[0]);
+        }
+    }
+
+    template <size_t (*Convert)(const UTF16Char*, size_t, char*)>
+    void ToUTF8(WUIF::Bench::State &state, const std::string &text)
+    {
+        std::vector<UTF16Char> in(text.size());
+        in.resize(UTF::ToUTF16(text.data(), text.size(), in.data()));
+        std::vector<char> out(UTF::UTF8Length(in.data(), in.size()));
+        while (state.Running())
+        {
+            Keep(Convert(in.data(), in.size(), out.data()));
+            Keep(out[0]);
+        }
+    }
+
+    //UTF's functions have a defaulted replace parameter
+    size_t LibraryToUTF16(const char *src, size_t length, UTF16Char *dst) { return UTF::ToUTF16(src, length, dst); }
+    size_t LibraryToUTF8(const UTF16Char *src, size_t length, char *dst)  { return UTF::ToUTF8(src, length, dst); }
+}
+
+BENCH(UTF16BufferTitle)
+{
+    const char *title = "R\xc3\xa9sum\xc3\xa9 - Window 3";
+    while (state.Running())
+    {
+        WUIF::UTF16Buffer<> buffer(title);
+        Keep(buffer.c_str()[0]);
+    }
+}
+
+BENCH(UTF8To16Ascii4K)
+{
+    ToUTF16<LibraryToUTF16>(state, Text(ascii));
+}
+
+BENCH(UTF8To16Ascii4KScalar)
+{
+    ToUTF16<ScalarToUTF16>(state, Text(ascii));
+}
+
+BENCH(UTF8To16Latin4K)
+{
+    ToUTF16<LibraryToUTF16>(state, Text(latin));
+}
+
+BENCH(UTF8To16Latin4KScalar)
+{
+    ToUTF16<ScalarToUTF16>(state, Text(latin));
+}
+
+BENCH(UTF16To8Ascii4K)
+{
+    ToUTF8<LibraryToUTF8>(state, Text(ascii));
+}
+
+BENCH(UTF16To8Ascii4KScalar)
+{
+    ToUTF8<ScalarToUTF8>(state, Text(ascii));
+}
+
+BENCH(UTF16To8Latin4K)
+{
+    ToUTF8<LibraryToUTF8>(state, Text(latin));
+}
+
+BENCH(UTF16To8Latin4KScalar)
+{
+    ToUTF8<ScalarToUTF8>(state, Text(latin));
+}
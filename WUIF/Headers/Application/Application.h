@@ -17,6 +17,7 @@ limitations under the License.*/
 #include <d3dcommon.h>       //needed for D3D_FEATURE_LEVEL
 #include <ShellScalingApi.h> //needed for PROCESS_DPI_AWARENESS
 #include "WUIF_Const.h"
+#include "Window/MessageMap.h"
 
 namespace WUIF {
     extern void __fastcall changeconst(_In_ void *var, _In_ const void *value);
@@ -36,9 +37,14 @@ namespace WUIF {
 
         //functions
         extern inline const std::vector<Window*>& GetWindows();
+        /*Layout transaction - geometry (and other property) changes made to any window between
+        BeginLayout and EndLayout are applied with a single Begin/Defer/EndDeferWindowPos batch and
+        swap chains are resized once after the batch*/
+        extern void BeginLayout();
+        extern BOOL EndLayout();
         extern void(*ExceptionHandler)(void); //pointer to user created exception handling routine
 
         /*Global user WindowProcedure function - this is a general WndProc for all windows of the application*/
-        extern std::unordered_map<int, WNDPROC> GWndProc_map;
+        extern MessageMap<WNDPROC> GWndProc_map;
     };
 }
@@ -0,0 +1,130 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <ShellScalingApi.h> //needed for PROCESS_DPI_AWARENESS, MONITOR_DPI_TYPE
+#include "Utils/dllhelper.h"
+#include "Application/Application.h"
+
+namespace
+{
+    //DPI Awareness typedefs needed since we are compiling for Win7 and up compatibility they are defined out in the .H files
+                                     STDAPI GetProcessDpiAwareness             (HANDLE, PROCESS_DPI_AWARENESS*);
+                                     STDAPI SetProcessDpiAwareness             (PROCESS_DPI_AWARENESS);
+                                     STDAPI GetDpiForMonitor                   (HMONITOR, MONITOR_DPI_TYPE, UINT*, UINT*);
+    WINUSERAPI BOOL                  WINAPI IsValidDpiAwarenessContext         (DPI_AWARENESS_CONTEXT);
+    WINUSERAPI BOOL                  WINAPI SetProcessDpiAwarenessContext      (DPI_AWARENESS_CONTEXT);
+    WINUSERAPI DPI_AWARENESS         WINAPI GetAwarenessFromDpiAwarenessContext(DPI_AWARENESS_CONTEXT);
+    WINUSERAPI BOOL                  WINAPI IsProcessDPIAware                  (VOID);
+    WINUSERAPI BOOL                  WINAPI SetProcessDPIAware                 (VOID);
+    WINUSERAPI DPI_AWARENESS_CONTEXT WINAPI GetThreadDpiAwarenessContext       (VOID);
+    WINUSERAPI DPI_AWARENESS_CONTEXT WINAPI SetThreadDpiAwarenessContext       (DPI_AWARENESS_CONTEXT);
+    WINUSERAPI BOOL                  WINAPI AreDpiAwarenessContextsEqual       (DPI_AWARENESS_CONTEXT, DPI_AWARENESS_CONTEXT);
+    WINUSERAPI BOOL                  WINAPI EnableNonClientDpiScaling          (HWND);
+    WINUSERAPI UINT                  WINAPI GetDpiForWindow                    (HWND);
+}
+
+namespace WUIF {
+
+    /*HighDPIAPI
+    Loads user32.dll and shcore.dll and resolves every DPI related entry point WUIF uses. A missing
+    library or entry point throws a WUIF_exception if the running OS version should have it,
+    otherwise the entry point is nullptr. SetDPIAwareness uses one while it sets the process
+    awareness, DPIAPI keeps one for the life of the process.*/
+    class HighDPIAPI
+    {
+        ModuleHelper _user32dll{ TEXT("user32.dll"), OSVersion::WIN7 };
+        DllHelper _shcoredll{ TEXT("shcore.dll"), OSVersion::WIN8 }; //not available in Windows 7
+    public:
+        decltype(SetProcessDpiAwareness)              *SetProcessDpiAwareness              = _shcoredll.assign("SetProcessDpiAwareness", OSVersion::WIN8_1);
+        decltype(GetProcessDpiAwareness)              *GetProcessDpiAwareness              = _shcoredll.assign("GetProcessDpiAwareness", OSVersion::WIN8_1);
+        decltype(GetDpiForMonitor)                    *GetDpiForMonitor                    = _shcoredll.assign("GetDpiForMonitor", OSVersion::WIN8_1);
+        decltype(IsProcessDPIAware)                   *IsProcessDPIAware                   = _user32dll.assign("IsProcessDPIAware", OSVersion::WIN7);
+        decltype(SetProcessDPIAware)                  *SetProcessDPIAware                  = _user32dll.assign("SetProcessDPIAware", OSVersion::WIN7);
+        decltype(IsValidDpiAwarenessContext)          *IsValidDpiAwarenessContext          = _user32dll.assign("IsValidDpiAwarenessContext", OSVersion::WIN10_1607);
+        decltype(GetThreadDpiAwarenessContext)        *GetThreadDpiAwarenessContext        = _user32dll.assign("GetThreadDpiAwarenessContext", OSVersion::WIN10_1607);
+        decltype(SetThreadDpiAwarenessContext)        *SetThreadDpiAwarenessContext        = _user32dll.assign("SetThreadDpiAwarenessContext", OSVersion::WIN10_1607);
+        decltype(AreDpiAwarenessContextsEqual)        *AreDpiAwarenessContextsEqual        = _user32dll.assign("AreDpiAwarenessContextsEqual", OSVersion::WIN10_1607);
+        decltype(EnableNonClientDpiScaling)           *EnableNonClientDpiScaling           = _user32dll.assign("EnableNonClientDpiScaling", OSVersion::WIN10_1607);
+        decltype(GetDpiForWindow)                     *GetDpiForWindow                     = _user32dll.assign("GetDpiForWindow", OSVersion::WIN10_1607);
+        decltype(SetProcessDpiAwarenessContext)       *SetProcessDpiAwarenessContext       = _user32dll.assign("SetProcessDpiAwarenessContext", OSVersion::WIN10_1703);
+        decltype(GetAwarenessFromDpiAwarenessContext) *GetAwarenessFromDpiAwarenessContext = _user32dll.assign("GetAwarenessFromDpiAwarenessContext", OSVersion::WIN10_1607);
+    };
+
+    /*DPIAPI
+    Process-wide table of the DPI related entry points in user32.dll and shcore.dll along with
+    values derived from the process' DPI awareness. The entry points are resolved once (by the
+    table's HighDPIAPI) and the table is never modified afterwards, so the DPI code paths in
+    Window and _WndProc only need to test a pointer instead of calling GetModuleHandle and
+    GetProcAddress every time they run. Entry points that don't exist on the running OS version
+    are nullptr.
+
+    SetDPIAwareness calls Initialize once OSCheck has determined the OS version and the process
+    awareness has been set. If Get is called first the table is built from the current
+    App::processdpiawareness and App::processdpiawarenesscontext values. Only the first call builds
+    the table, later calls return the existing table.*/
+    class DPIAPI
+    {
+    private:
+        //must be declared before the entry points so it is initialized first, keeps shcore.dll loaded
+        HighDPIAPI _api;
+
+    public:
+        using PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL = BOOL(WINAPI*)(DPI_AWARENESS_CONTEXT, DPI_AWARENESS_CONTEXT);
+        using PFN_GET_THREAD_DPI_AWARENESS_CONTEXT = DPI_AWARENESS_CONTEXT(WINAPI*)(void);
+        using PFN_SET_THREAD_DPI_AWARENESS_CONTEXT = DPI_AWARENESS_CONTEXT(WINAPI*)(DPI_AWARENESS_CONTEXT);
+        using PFN_ENABLE_NON_CLIENT_DPI_SCALING    = BOOL(WINAPI*)(HWND);
+        using PFN_GET_DPI_FOR_WINDOW               = UINT(WINAPI*)(HWND);
+        using PFN_GET_DPI_FOR_MONITOR              = HRESULT(WINAPI*)(HMONITOR, MONITOR_DPI_TYPE, UINT*, UINT*);
+
+        //user32.dll - Windows 10 1607 (Anniversary Update) and greater
+        const PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL AreDpiAwarenessContextsEqual;
+        const PFN_GET_THREAD_DPI_AWARENESS_CONTEXT GetThreadDpiAwarenessContext;
+        const PFN_SET_THREAD_DPI_AWARENESS_CONTEXT SetThreadDpiAwarenessContext;
+        const PFN_ENABLE_NON_CLIENT_DPI_SCALING    EnableNonClientDpiScaling;
+        const PFN_GET_DPI_FOR_WINDOW               GetDpiForWindow;
+        //shcore.dll - Windows 8.1 and greater
+        const PFN_GET_DPI_FOR_MONITOR              GetDpiForMonitor;
+
+        //copies of the process DPI awareness values, these live for the life of the process
+        const PROCESS_DPI_AWARENESS processdpiawareness;
+        const DPI_AWARENESS_CONTEXT processdpiawarenesscontext;
+        //precomputed values
+        const bool hasprocessdpiawareness;        //processdpiawareness was determined
+        const bool hasprocessdpiawarenesscontext; //processdpiawarenesscontext was determined (Win10 1607+)
+        const bool permonitoraware;               //process is per-monitor (or per-monitor v2) DPI aware
+        const bool dpiunaware;                    //process is DPI unaware - every window is 96 DPI
+
+        //functions
+        static const DPIAPI& Initialize(_In_opt_ const volatile PROCESS_DPI_AWARENESS *awareness,
+                                        _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context);
+        static inline const DPIAPI& Get()
+        {
+            return (instance != nullptr) ? *instance : Initialize(App::processdpiawareness, App::processdpiawarenesscontext);
+        }
+
+        DPIAPI(const DPIAPI&) = delete;
+        DPIAPI& operator=(const DPIAPI&) = delete;
+
+    private:
+        DPIAPI(_In_opt_ const volatile PROCESS_DPI_AWARENESS *awareness,
+               _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context);
+
+        static const DPIAPI *volatile instance;
+    };
+
+    namespace App {
+        //shorthand for DPIAPI::Get()
+        inline const DPIAPI& DPI() { return DPIAPI::Get(); }
+    }
+}
@@ -0,0 +1,64 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include "Utils/CounterRegistry.h"
+
+namespace WUIF {
+
+    /*PerfCounters
+    The framework's own counters, published in shared memory through CounterRegistry so ops
+    tooling can read every running UI process live - Tools/CounterView prints them:
+
+        frames.presented     COUNTER  Present calls that showed a frame
+        frames.skipped       COUNTER  Present calls that showed nothing (occluded or failed)
+        messages.dispatched  COUNTER  messages through _WndProc, all windows
+        swapchain.created    COUNTER  swap chains created
+        swapchain.resized    COUNTER  swap chains resized
+        device.lost          COUNTER  device removed or reset
+        windows              GAUGE    WUIF windows alive
+        memory.workingset    GAUGE    working set bytes
+        memory.private       GAUGE    private bytes
+        memory.tagged        GAUGE    live bytes of every AllocStats tag
+
+    The memory gauges are sampled at most once a second by WUIF::Run. WinMain calls Start before
+    any window exists and Stop on exit; updates before Start go to the sink. Apps add their own
+    counters with CounterRegistry::Register.*/
+    class PerfCounters
+    {
+    public:
+        /*BOOL Start()
+        Registers the framework counters, creating the shared memory segment
+
+        Return value
+        BOOL - FALSE if the segment couldn't be created, the counters then only count in process*/
+        static BOOL Start();
+        //removes the segment's name, counters keep counting
+        static void Stop();
+        //updates the memory gauges if a second has passed since the last update
+        static void Sample();
+
+        static Counter framespresented;
+        static Counter framesskipped;
+        static Counter messages;
+        static Counter swapchaincreated;
+        static Counter swapchainresized;
+        static Counter devicelost;
+        static Counter windows;
+        static Counter workingset;
+        static Counter privatebytes;
+        static Counter tagged;
+
+        PerfCounters() = delete;
+    };
+}
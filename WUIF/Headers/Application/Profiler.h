@@ -0,0 +1,82 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include "Utils/PhaseMarker.h"
+
+namespace WUIF {
+
+    /*Profiler
+    Sampling profiler for production builds. A sampler thread wakes rate times a second, captures
+    the stack of every profiled thread (StackSampler) along with the phases it is in (WUIF_PHASE -
+    _WndProc marks "dispatch", Present "present", "input" and "draw", ResizeSwapChain "resize")
+    and counts the sample in a StackHistogram whose memory is fixed by maxstacks. Export writes
+    the histogram as folded stacks for flame graph tools, symbolized with DbgHelp when the .pdb
+    files are found and as module+offset otherwise.
+
+    Start profiles the calling thread as "UI". A render thread (or any other) calls AddThread to
+    be profiled and RemoveThread before it exits. Rates above the system timer resolution (64 Hz
+    by default) need Windows 10 1803 or later, which has high resolution waitable timers.*/
+    class Profiler
+    {
+    public:
+        static const size_t maxthreads = 8;
+
+        struct Statistics
+        {
+            unsigned long long samples; //stacks captured
+            unsigned long long dropped; //samples that didn't fit in the histogram
+            unsigned long long failed;  //captures that failed (thread exited, stack unreadable)
+            size_t             stacks;  //distinct stacks
+            size_t             capacity;
+            UINT               threads; //profiled threads
+        };
+
+        /*BOOL Start(UINT rate, size_t maxstacks)
+        Starts sampling at rate samples per second and profiles the calling thread as "UI".
+        Discards the previous histogram
+
+        UINT rate        - samples per second per thread (1 - 1000)
+        size_t maxstacks - distinct stacks kept, memory is about 350 bytes per stack on x64
+
+        Return value
+        BOOL - FALSE if already running or the sampler could not be started, call GetLastError
+               for details*/
+        static BOOL Start(_In_ UINT rate = 100, _In_ size_t maxstacks = 4096);
+        //stops sampling, the histogram is kept for Export
+        static void Stop();
+        static bool Running();
+
+        /*BOOL AddThread(const char *name)
+        Profiles the calling thread - name must be a string literal
+
+        Return value
+        BOOL - FALSE if maxthreads threads are profiled or the thread could not be opened*/
+        static BOOL AddThread(_In_z_ const char *name);
+        //stops profiling the calling thread - call before a profiled thread exits
+        static void RemoveThread();
+
+        /*BOOL Export(LPCTSTR path)
+        Writes the histogram as folded stacks ("UI;present;draw;App.exe!Draw 42" per line).
+        Sampling pauses while the stacks are symbolized
+
+        Return value
+        BOOL - FALSE if there is no histogram or the file could not be written*/
+        static BOOL Export(_In_ LPCTSTR path);
+        //forgets the samples
+        static void Reset();
+        static Statistics GetStatistics();
+
+        Profiler() = delete;
+    };
+}
@@ -0,0 +1,65 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+
+namespace WUIF {
+
+    /*StackSampler
+    Captures the call stack of another thread of the process - used by the Watchdog and the
+    Profiler. Capture suspends the thread just long enough to read its registers and copy the top
+    of its stack and walks the copy after resuming it, so nothing that could take a lock the
+    sampled thread holds (the heap, the loader) runs while it is suspended. x64 unwinds with
+    RtlVirtualUnwind, x86 follows the EBP frame chain (frames built with /Oy are skipped).
+
+    A StackSampler is used by one thread at a time.*/
+    class StackSampler
+    {
+    public:
+        static const size_t maxframes = 48;        //frames per capture
+        static const size_t stackcopy = 64 * 1024; //bytes of the thread's stack copied per capture
+
+        //called while the thread is suspended - must not allocate or take locks
+        typedef void(*Suspended)(void *context);
+
+        StackSampler() noexcept : _thread(NULL), _threadid(0), _stack(nullptr) {}
+        ~StackSampler() { Close(); }
+
+        StackSampler(const StackSampler&) = delete;
+        StackSampler& operator=(const StackSampler&) = delete;
+
+        /*BOOL StackSampler::Open(_In_ DWORD threadid)
+        Opens the thread to sample. Return FALSE on failure, call GetLastError for details*/
+        BOOL Open(_In_ DWORD threadid);
+        void Close();
+
+        /*size_t StackSampler::Capture(_Out_writes_(maxframes) void **frames, _In_opt_ Suspended suspended, _In_opt_ void *context)
+        Captures the thread's stack, innermost frame first. suspended (if set) is called with
+        context while the thread is suspended, to read state the thread updates
+
+        Return value
+        size_t - frames captured, 0 if the thread could not be sampled*/
+        size_t Capture(_Out_writes_(maxframes) void **frames, _In_opt_ Suspended suspended = nullptr, _In_opt_ void *context = nullptr);
+
+        //writes "module+0xoffset" for address, or the bare address if it is in no module
+        static void Name(_In_opt_ const void *address, _Out_writes_(size) char *text, _In_ size_t size);
+
+        inline DWORD threadid() const noexcept { return _threadid; }
+        inline bool  opened() const noexcept { return (_thread != NULL); }
+
+    private:
+        HANDLE         _thread;
+        DWORD          _threadid;
+        unsigned char *_stack; //copy of the thread's stack
+    };
+}
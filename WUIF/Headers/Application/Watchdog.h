@@ -0,0 +1,68 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include "Utils/StallDetector.h"
+
+namespace WUIF {
+
+    /*Watchdog
+    UI thread stall watchdog. WUIF::Run beats every message loop iteration and _WndProc on every
+    message; when no beat is seen for the threshold a watchdog thread suspends the UI thread at
+    intervals, captures its stack and appends a report of the stall to a text file:
+
+        stall 1 thread 1234 - no heartbeat for 1000 ms
+        activity message 0x0111 handler App.exe+0x1a2b0 target 0x00000000000A0B12
+        sample 1 +1000 ms: App.exe+0x1a2f4 App.exe+0x1c010 USER32.dll+0x1a3d1 ...
+        sample 2 +1100 ms: same
+        recovered after 2350 ms
+
+    Frames are module+offset, symbolize them with the matching .pdb. Each line is written when
+    it is known so a report survives the process being killed while it hangs.
+
+    Start must be called on the UI thread (in main, before WUIF::Run). Run disarms the watchdog
+    when the message loop ends. Watchdog::Stop is called by WinMain on exit.*/
+    class Watchdog
+    {
+    public:
+        typedef StallDetector<> Detector;
+        typedef WatchScope<Detector> Scope;
+
+        /*BOOL Start(DWORD thresholdms, DWORD intervalms, UINT maxsamples, LPCTSTR report)
+        Starts the watchdog thread for the calling (UI) thread
+
+        DWORD thresholdms - time without a heartbeat that counts as a stall
+        DWORD intervalms  - time between stack samples during a stall
+        UINT maxsamples   - samples taken per stall
+        LPCTSTR report    - file the reports are appended to
+
+        Return value
+        BOOL - FALSE if already running or the thread could not be opened or started, call
+               GetLastError for details*/
+        static BOOL Start(_In_ DWORD thresholdms = 1000, _In_ DWORD intervalms = 100, _In_ UINT maxsamples = 20,
+                          _In_ LPCTSTR report = TEXT("WUIF.stall"));
+        //stops the watchdog thread, finishing the report of a stall in progress
+        static void Stop();
+        static bool Running();
+        //stalls found since Start
+        static unsigned long long Stalls();
+
+        //UI thread
+        static inline void Beat() noexcept { detector.Beat(); }
+        static inline void Disarm() noexcept { detector.Disarm(); }
+
+        static Detector detector;
+
+        Watchdog() = delete;
+    };
+}
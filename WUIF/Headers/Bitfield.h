@@ -15,6 +15,7 @@ limitations under the License.*/
 //this was inspired from http://www.artima.com/cppsource/safelabels.html
 #pragma once
 #include <assert.h>
+#include <atomic> //needed for std::atomic
 #ifdef _BITFIELD
 //used to create a unique id for the template
 struct bitfield_unique_id {};
@@ -25,6 +26,10 @@ struct bitfield_unique_id {};
 template <bitfield_unique_id* unique_id, typename word_t>
 class checked_bit_mask;
 
+//forward declaration of checked_atomic_bit_field
+template <bitfield_unique_id* unique_id, typename word_t>
+class checked_atomic_bit_field;
+
 //class declaration
 template <bitfield_unique_id* unique_id, typename word_t>
 class checked_bit_field
@@ -39,7 +44,9 @@ private:
 public:
     //For convenience with macros, we declare checked_bit_field::fieldbit_t
     friend class checked_bit_mask<unique_id, word_t>;
+    friend class checked_atomic_bit_field<unique_id, word_t>;
     typedef checked_bit_mask<unique_id, word_t> fieldbit_t;
+    typedef checked_atomic_bit_field<unique_id, word_t> atomic_field_t;
 
     //--Constructors--
     //default constructor - our "word" is zeroed
@@ -234,7 +241,7 @@ public:
 //multiple assignment operators specified
 #pragma warning(suppress : 4521 4522)
 };
-#elif
+#else
 };
 #endif
 
@@ -268,6 +275,7 @@ public:
 
     // Corresponding bit field type.
     friend class checked_bit_field<unique_id, word_t>;
+    friend class checked_atomic_bit_field<unique_id, word_t>;
     typedef checked_bit_field<unique_id, word_t> field_t;
 
     //--Constructors--
@@ -308,6 +316,51 @@ public:
     field_t operator^(const volatile field_t& rhs) const noexcept { return field_t(word ^ rhs.word); }
 };
 
+/*checked_atomic_bit_field keeps a checked_bit_field in a std::atomic so flags can be shared between
+threads (e.g. the UI thread and a render thread) - the volatile overloads of checked_bit_field give
+no atomicity. Only fields and masks of the same BIT_FIELD are accepted. Every operation takes a
+memory order, std::memory_order_seq_cst if none is given. Not copyable.*/
+template <bitfield_unique_id* unique_id, typename word_t>
+class checked_atomic_bit_field
+{
+private:
+    //the actual field.
+    std::atomic<word_t> word;
+
+public:
+    typedef checked_bit_field<unique_id, word_t> field_t;
+    typedef checked_bit_mask<unique_id, word_t>  fieldbit_t;
+
+    //--Constructors--
+    //default constructor - our "word" is zeroed
+    checked_atomic_bit_field() noexcept : word(static_cast<word_t>(0)) {}
+    //constructor from bitfield or bit mask
+    explicit checked_atomic_bit_field(const field_t& init) noexcept : word(init.word) {}
+    checked_atomic_bit_field(const checked_atomic_bit_field&) = delete;
+    checked_atomic_bit_field& operator=(const checked_atomic_bit_field&) = delete;
+
+    //--Operations--
+    field_t load(const std::memory_order order = std::memory_order_seq_cst) const noexcept { return field_t(word.load(order)); }
+    void    store(const field_t& v, const std::memory_order order = std::memory_order_seq_cst) noexcept { word.store(v.word, order); }
+    field_t exchange(const field_t& v, const std::memory_order order = std::memory_order_seq_cst) noexcept { return field_t(word.exchange(v.word, order)); }
+    //set, clear (pass ~mask) or toggle bits - returns the field before the change
+    field_t fetch_or (const fieldbit_t& mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return field_t(word.fetch_or(mask.word, order)); }
+    field_t fetch_and(const fieldbit_t& mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return field_t(word.fetch_and(mask.word, order)); }
+    field_t fetch_xor(const fieldbit_t& mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return field_t(word.fetch_xor(mask.word, order)); }
+    //true if any bit of mask is set
+    bool test(const fieldbit_t& mask, const std::memory_order order = std::memory_order_seq_cst) const noexcept { return ((word.load(order) & mask.word) != 0); }
+    //sets the bits of mask - true if any of them was already set
+    bool test_and_set(const fieldbit_t& mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return ((word.fetch_or(mask.word, order) & mask.word) != 0); }
+    //clears the bits of mask - true if any of them was set
+    bool test_and_clear(const fieldbit_t& mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return ((word.fetch_and(static_cast<word_t>(~mask.word), order) & mask.word) != 0); }
+    //on failure expected is updated with the current field
+    bool compare_exchange_weak(field_t& expected, const field_t& desired, const std::memory_order success, const std::memory_order failure) noexcept { return word.compare_exchange_weak(expected.word, desired.word, success, failure); }
+    bool compare_exchange_weak(field_t& expected, const field_t& desired, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.compare_exchange_weak(expected.word, desired.word, order); }
+    bool compare_exchange_strong(field_t& expected, const field_t& desired, const std::memory_order success, const std::memory_order failure) noexcept { return word.compare_exchange_strong(expected.word, desired.word, success, failure); }
+    bool compare_exchange_strong(field_t& expected, const field_t& desired, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.compare_exchange_strong(expected.word, desired.word, order); }
+    bool is_lock_free() const noexcept { return word.is_lock_free(); }
+};
+
 // All macros are conditionally defined to use the checked_bit_field classes if _BITFIELD is defined.
 //bit field type declaration - BIT_FIELD(long, mybitfield);
 #define BIT_FIELD( word_t,  bitfield_t )  extern bitfield_unique_id ui_##bitfield_t; typedef checked_bit_field<&ui_##bitfield_t, word_t> bitfield_t
@@ -317,7 +370,38 @@ public:
 #define INT_BIT_MASK( bitfield_t, label, int_mask) const bitfield_t::fieldbit_t label = bitfield_t::fieldbit_t::set_bits<int_mask>()
 //complex bit constant declaration - BIT_MASKS(mybitfield, complexbitmask) = mask1 | mask2;
 #define BIT_MASKS( bitfield_t, label ) const bitfield_t::fieldbit_t label
+//atomic bit field type declaration - ATOMIC_BIT_FIELD(mybitfield, myatomicbitfield);
+#define ATOMIC_BIT_FIELD( bitfield_t, atomic_t ) typedef bitfield_t::atomic_field_t atomic_t
 #else
+//same interface as checked_atomic_bit_field for plain integer fields and masks
+template <typename word_t>
+class atomic_bit_field
+{
+private:
+    std::atomic<word_t> word;
+
+public:
+    atomic_bit_field() noexcept : word(static_cast<word_t>(0)) {}
+    explicit atomic_bit_field(const word_t init) noexcept : word(init) {}
+    atomic_bit_field(const atomic_bit_field&) = delete;
+    atomic_bit_field& operator=(const atomic_bit_field&) = delete;
+
+    word_t load(const std::memory_order order = std::memory_order_seq_cst) const noexcept { return word.load(order); }
+    void   store(const word_t v, const std::memory_order order = std::memory_order_seq_cst) noexcept { word.store(v, order); }
+    word_t exchange(const word_t v, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.exchange(v, order); }
+    word_t fetch_or (const word_t mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.fetch_or(mask, order); }
+    word_t fetch_and(const word_t mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.fetch_and(mask, order); }
+    word_t fetch_xor(const word_t mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.fetch_xor(mask, order); }
+    bool test(const word_t mask, const std::memory_order order = std::memory_order_seq_cst) const noexcept { return ((word.load(order) & mask) != 0); }
+    bool test_and_set(const word_t mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return ((word.fetch_or(mask, order) & mask) != 0); }
+    bool test_and_clear(const word_t mask, const std::memory_order order = std::memory_order_seq_cst) noexcept { return ((word.fetch_and(static_cast<word_t>(~mask), order) & mask) != 0); }
+    bool compare_exchange_weak(word_t& expected, const word_t desired, const std::memory_order success, const std::memory_order failure) noexcept { return word.compare_exchange_weak(expected, desired, success, failure); }
+    bool compare_exchange_weak(word_t& expected, const word_t desired, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.compare_exchange_weak(expected, desired, order); }
+    bool compare_exchange_strong(word_t& expected, const word_t desired, const std::memory_order success, const std::memory_order failure) noexcept { return word.compare_exchange_strong(expected, desired, success, failure); }
+    bool compare_exchange_strong(word_t& expected, const word_t desired, const std::memory_order order = std::memory_order_seq_cst) noexcept { return word.compare_exchange_strong(expected, desired, order); }
+    bool is_lock_free() const noexcept { return word.is_lock_free(); }
+};
+
 //bit field type declaration - BIT_FIELD(long, mybitfield);
 #define BIT_FIELD(word_t, bitfield_t ) typedef word_t bitfield_t
 //bit mask declaration - BIT_MASK(mybitfield, mask1, 0); BIT_MASK(mybitfield, mask2, 1);
@@ -327,4 +411,6 @@ inline constexpr unsigned int returnbit(unsigned int i) { return (i > 0) ? (1u <
 #define INT_BIT_MASK( bitfield_t, label, int_mask) static constexpr bitfield_t label = int_mask
 //complex bit constant declaration - BIT_MASKS(mybitfield, complexbitmask) = mask1 | mask2;
 #define BIT_MASKS( field_t, label ) static const field_t label
+//atomic bit field type declaration - ATOMIC_BIT_FIELD(mybitfield, myatomicbitfield);
+#define ATOMIC_BIT_FIELD( bitfield_t, atomic_t ) typedef atomic_bit_field<bitfield_t> atomic_t
 #endif // SAFE_BIT_FIELD
\ No newline at end of file
@@ -0,0 +1,317 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+
+//the wide counterpart of checked_bit_field (Bitfield.h)
+#pragma once
+#include <assert.h>
+#include <stddef.h> //needed for size_t
+#include <stdint.h> //needed for uint64_t
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define WUIF_BITSET_SSE2
+    #include <emmintrin.h> //SSE2
+#endif
+#if defined(_MSC_VER)
+    #include <intrin.h> //needed for _BitScanForward
+#endif
+
+/*checked_bit_set<unique_id, N> is a set of N bits - one bit per message ID, per element and so on -
+where checked_bit_field is limited to one word. Like checked_bit_field every BIT_SET is its own type,
+so sets declared for different purposes can't be mixed. Bits past N are always zero.
+
+    set/reset/flip/test        - one bit, set<i>() checks the position at compile time
+    & | ^ ~ andnot             - whole set operations, 128 bits at a time with SSE2
+    count                      - population count, 128 bits at a time with SSE2
+    any/none/intersects        - early out on the first non-zero 128 bits
+    find_first/find_next/begin - the set bits in ascending order, for (size_t i : set) works
+
+Declare with BIT_SET(mybitset, 1024); - the storage is rounded up to a multiple of 128 bits.*/
+
+//used to create a unique id for the template
+struct bitset_unique_id {};
+
+template <bitset_unique_id* unique_id, size_t N>
+class checked_bit_set
+{
+    static_assert(N > 0, "a bit set needs at least one bit");
+
+public:
+    static const size_t bits  = N;
+    static const size_t words = ((N + 127) / 128) * 2; //64 bit words, a whole number of 128 bit blocks
+
+    //ascending indices of the set bits
+    class iterator
+    {
+    public:
+        iterator(const checked_bit_set *set, size_t pos) noexcept : _set(set), _pos(pos) {}
+        size_t    operator*() const noexcept { return _pos; }
+        iterator& operator++() noexcept { _pos = _set->find_next(_pos); return *this; }
+        bool operator==(const iterator& rhs) const noexcept { return _pos == rhs._pos; }
+        bool operator!=(const iterator& rhs) const noexcept { return _pos != rhs._pos; }
+    private:
+        const checked_bit_set *_set;
+        size_t                 _pos;
+    };
+
+    //--Constructors--
+    //default constructor - every bit is clear
+    checked_bit_set() noexcept { clear(); }
+    checked_bit_set(const checked_bit_set& rhs) noexcept = default;
+    checked_bit_set& operator=(const checked_bit_set& rhs) noexcept = default;
+
+    //--Single bits--
+    template <size_t i> void set() noexcept   { static_assert(i < N, "bit to set must be within bounds of set"); set(i); }
+    template <size_t i> void reset() noexcept { static_assert(i < N, "bit to reset must be within bounds of set"); reset(i); }
+    template <size_t i> bool test() const noexcept { static_assert(i < N, "bit to test must be within bounds of set"); return test(i); }
+    void set(const size_t i) noexcept   { assert(i < N); _word[i >> 6] |= (uint64_t(1) << (i & 63)); }
+    void reset(const size_t i) noexcept { assert(i < N); _word[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    void flip(const size_t i) noexcept  { assert(i < N); _word[i >> 6] ^= (uint64_t(1) << (i & 63)); }
+    void set(const size_t i, const bool v) noexcept { if (v) set(i); else reset(i); }
+    //bits past N are never set, so test doesn't need to check i outside of debug builds
+    bool test(const size_t i) const noexcept { assert(i < N); return ((_word[i >> 6] >> (i & 63)) & 1) != 0; }
+    bool operator[](const size_t i) const noexcept { return test(i); }
+
+    //--Whole set--
+    void clear() noexcept
+    {
+        for (size_t w = 0; w < words; w++)
+            _word[w] = 0;
+    }
+    void fill() noexcept
+    {
+        for (size_t w = 0; w < words; w++)
+            _word[w] = ~uint64_t(0);
+        trim();
+    }
+
+    checked_bit_set& operator&=(const checked_bit_set& rhs) noexcept { apply<op_and>(*this, rhs); return *this; }
+    checked_bit_set& operator|=(const checked_bit_set& rhs) noexcept { apply<op_or>(*this, rhs); return *this; }
+    checked_bit_set& operator^=(const checked_bit_set& rhs) noexcept { apply<op_xor>(*this, rhs); return *this; }
+    //removes the bits of rhs - *this &= ~rhs without the temporary
+    checked_bit_set& andnot(const checked_bit_set& rhs) noexcept { apply<op_andnot>(*this, rhs); return *this; }
+    checked_bit_set operator&(const checked_bit_set& rhs) const noexcept { checked_bit_set r(*this); return r &= rhs; }
+    checked_bit_set operator|(const checked_bit_set& rhs) const noexcept { checked_bit_set r(*this); return r |= rhs; }
+    checked_bit_set operator^(const checked_bit_set& rhs) const noexcept { checked_bit_set r(*this); return r ^= rhs; }
+    checked_bit_set operator~() const noexcept
+    {
+        checked_bit_set r;
+        for (size_t w = 0; w < words; w++)
+            r._word[w] = ~_word[w];
+        r.trim();
+        return r;
+    }
+
+    bool operator==(const checked_bit_set& rhs) const noexcept
+    {
+        #if defined(WUIF_BITSET_SSE2)
+        for (size_t w = 0; w < words; w += 2)
+        {
+            const __m128i eq = _mm_cmpeq_epi8(load(_word + w), load(rhs._word + w));
+            if (_mm_movemask_epi8(eq) != 0xffff)
+                return false;
+        }
+        return true;
+        #else
+        for (size_t w = 0; w < words; w++)
+        {
+            if (_word[w] != rhs._word[w])
+                return false;
+        }
+        return true;
+        #endif
+    }
+    bool operator!=(const checked_bit_set& rhs) const noexcept { return !(*this == rhs); }
+
+    bool any() const noexcept { return !none(); }
+    bool none() const noexcept
+    {
+        #if defined(WUIF_BITSET_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        for (size_t w = 0; w < words; w += 2)
+        {
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(load(_word + w), zero)) != 0xffff)
+                return false;
+        }
+        return true;
+        #else
+        for (size_t w = 0; w < words; w++)
+        {
+            if (_word[w] != 0)
+                return false;
+        }
+        return true;
+        #endif
+    }
+    //true if any bit is set in both - (*this & rhs).any() without the temporary
+    bool intersects(const checked_bit_set& rhs) const noexcept
+    {
+        #if defined(WUIF_BITSET_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        for (size_t w = 0; w < words; w += 2)
+        {
+            const __m128i both = _mm_and_si128(load(_word + w), load(rhs._word + w));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(both, zero)) != 0xffff)
+                return true;
+        }
+        return false;
+        #else
+        for (size_t w = 0; w < words; w++)
+        {
+            if ((_word[w] & rhs._word[w]) != 0)
+                return true;
+        }
+        return false;
+        #endif
+    }
+
+    //number of set bits
+    size_t count() const noexcept
+    {
+        #if defined(WUIF_BITSET_SSE2)
+        /*SSE2 has no popcnt - count within each byte with the usual bit twiddling, then add the
+        bytes up with psadbw (sum of absolute differences against zero)*/
+        const __m128i m1   = _mm_set1_epi8(0x55);
+        const __m128i m2   = _mm_set1_epi8(0x33);
+        const __m128i m4   = _mm_set1_epi8(0x0f);
+        const __m128i zero = _mm_setzero_si128();
+        __m128i total = zero;
+        for (size_t w = 0; w < words; w += 2)
+        {
+            __m128i v = load(_word + w);
+            v = _mm_sub_epi8(v, _mm_and_si128(_mm_srli_epi64(v, 1), m1));
+            v = _mm_add_epi8(_mm_and_si128(v, m2), _mm_and_si128(_mm_srli_epi64(v, 2), m2));
+            v = _mm_and_si128(_mm_add_epi8(v, _mm_srli_epi64(v, 4)), m4);
+            total = _mm_add_epi64(total, _mm_sad_epu8(v, zero));
+        }
+        return static_cast<size_t>(_mm_cvtsi128_si32(total)) + static_cast<size_t>(_mm_cvtsi128_si32(_mm_srli_si128(total, 8)));
+        #else
+        size_t total = 0;
+        for (size_t w = 0; w < words; w++)
+        {
+            uint64_t v = _word[w];
+            v = v - ((v >> 1) & 0x5555555555555555ULL);
+            v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+            v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+            total += static_cast<size_t>((v * 0x0101010101010101ULL) >> 56);
+        }
+        return total;
+        #endif
+    }
+
+    //index of the lowest set bit, N if none
+    size_t find_first() const noexcept { return scan(0, _word[0]); }
+    //index of the lowest set bit above i, N if none
+    size_t find_next(const size_t i) const noexcept
+    {
+        const size_t next = i + 1;
+        if (next >= N)
+            return N;
+        return scan(next >> 6, _word[next >> 6] & (~uint64_t(0) << (next & 63)));
+    }
+    iterator begin() const noexcept { return iterator(this, find_first()); }
+    iterator end() const noexcept   { return iterator(this, N); }
+
+    //calls f(index) for every set bit in ascending order
+    template <class F>
+    void for_each(F f) const
+    {
+        for (size_t w = 0; w < words; w++)
+        {
+            uint64_t v = _word[w];
+            while (v != 0)
+            {
+                f((w << 6) + lowest(v));
+                v &= v - 1;
+            }
+        }
+    }
+
+private:
+    uint64_t _word[words];
+
+    //clears the bits past N in the last words
+    void trim() noexcept
+    {
+        if ((N & 63) != 0)
+            _word[N >> 6] &= ~(~uint64_t(0) << (N & 63));
+        for (size_t w = (N + 63) >> 6; w < words; w++)
+            _word[w] = 0;
+    }
+
+    //first set bit starting with word w, whose remaining bits are first
+    size_t scan(size_t w, uint64_t first) const noexcept
+    {
+        if (first != 0)
+            return (w << 6) + lowest(first);
+        for (w++; w < words; w++)
+        {
+            if (_word[w] != 0)
+                return (w << 6) + lowest(_word[w]);
+        }
+        return N;
+    }
+
+    //index of the lowest set bit of a non-zero word
+    static size_t lowest(const uint64_t v) noexcept
+    {
+        #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_AMD64))
+        unsigned long index;
+        _BitScanForward64(&index, v);
+        return static_cast<size_t>(index);
+        #elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<unsigned long>(v)))
+            return static_cast<size_t>(index);
+        _BitScanForward(&index, static_cast<unsigned long>(v >> 32));
+        return static_cast<size_t>(index) + 32;
+        #else
+        return static_cast<size_t>(__builtin_ctzll(v));
+        #endif
+    }
+
+    struct op_and;
+    struct op_or;
+    struct op_xor;
+    struct op_andnot;
+
+    #if defined(WUIF_BITSET_SSE2)
+    //unaligned - new doesn't honor over-aligned types before C++17
+    static __m128i load(const uint64_t *p) noexcept { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint64_t *p, const __m128i v) noexcept { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static __m128i combine(op_and*, const __m128i a, const __m128i b) noexcept    { return _mm_and_si128(a, b); }
+    static __m128i combine(op_or*, const __m128i a, const __m128i b) noexcept     { return _mm_or_si128(a, b); }
+    static __m128i combine(op_xor*, const __m128i a, const __m128i b) noexcept    { return _mm_xor_si128(a, b); }
+    static __m128i combine(op_andnot*, const __m128i a, const __m128i b) noexcept { return _mm_andnot_si128(b, a); }
+    template <class Op>
+    static void apply(checked_bit_set& lhs, const checked_bit_set& rhs) noexcept
+    {
+        for (size_t w = 0; w < words; w += 2)
+            store(lhs._word + w, combine(static_cast<Op*>(nullptr), load(lhs._word + w), load(rhs._word + w)));
+    }
+    #else
+    static uint64_t combine(op_and*, const uint64_t a, const uint64_t b) noexcept    { return a & b; }
+    static uint64_t combine(op_or*, const uint64_t a, const uint64_t b) noexcept     { return a | b; }
+    static uint64_t combine(op_xor*, const uint64_t a, const uint64_t b) noexcept    { return a ^ b; }
+    static uint64_t combine(op_andnot*, const uint64_t a, const uint64_t b) noexcept { return a & ~b; }
+    template <class Op>
+    static void apply(checked_bit_set& lhs, const checked_bit_set& rhs) noexcept
+    {
+        for (size_t w = 0; w < words; w++)
+            lhs._word[w] = combine(static_cast<Op*>(nullptr), lhs._word[w], rhs._word[w]);
+    }
+    #endif
+};
+
+//bit set type declaration - BIT_SET(mybitset, 1024);
+#define BIT_SET( bitset_t, bit_count ) extern bitset_unique_id ui_##bitset_t; typedef checked_bit_set<&ui_##bitset_t, bit_count> bitset_t
@@ -16,10 +16,11 @@ limitations under the License.*/
 #include <d3d12.h>      //needed for D3D12 resources
 #include <d3d11on12.h>  //needed for D2D resources when using D3D12
 #include "Utils/dllhelper.h"
+#include "Utils/AllocTag.h"
 #include "GFX/D2D/D2D.h"
 
 namespace WUIF {
-    class D3D12libAPI
+    class D3D12libAPI : public AllocTagged<AllocTag::GFX>
     {
         DllHelper _d3d12{ TEXT("D3D12.dll"), OSVersion::WIN10 };
         DllHelper _d3d11{ TEXT("D3D11.dll"), OSVersion::UNKNOWN };
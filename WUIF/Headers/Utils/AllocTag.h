@@ -0,0 +1,303 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>      //needed for std::atomic
+#include <cstddef>     //needed for size_t
+#include <cstdint>     //needed for uint32_t, uint64_t, int64_t
+#include <cstdlib>     //needed for malloc, free
+#include <new>         //needed for std::bad_alloc
+#include <type_traits> //needed for std::is_trivially_destructible
+#if defined(_MSC_VER) && defined(_DEBUG)
+    #include <crtdbg.h> //needed for _malloc_dbg, _free_dbg
+#endif
+/*Allocation accounting by subsystem. Memory allocated through AllocStats carries a 16 byte header
+with its size and AllocTag, so every tag keeps live bytes and blocks, total allocations and frees
+and a high-water mark in release builds too. Ways to tag memory:
+
+    AllocTagged<Tag>          - base class with operator new/delete, so CRT_NEW and delete of the
+                                class are accounted (including the debug heap form of CRT_NEW)
+    TaggedAllocator<T, Tag>   - STL allocator, e.g. std::vector<T, TaggedAllocator<T, Tag>>
+    AllocStats::NewArray<T>   - arrays of trivial types (window names), freed with DeleteArray
+    AllocStats::Record/Erase  - memory the OS allocates directly (thunk blocks)
+
+Take() returns a Snapshot of every tag, Diff() the change between two - e.g. a snapshot before and
+after a frame shows whether drawing allocated. Allocations use malloc (the debug heap with file
+and line in MSVC debug builds), so this header has no Windows dependencies.*/
+
+namespace WUIF {
+
+    enum class AllocTag : uint32_t
+    {
+        Window  = 0,
+        GFX     = 1,
+        Thunk   = 2,
+        Logging = 3,
+        App     = 4,
+        Count   = 5
+    };
+
+    class AllocStats
+    {
+    public:
+        static const size_t tagcount = static_cast<size_t>(AllocTag::Count);
+
+        struct Counters
+        {
+            uint64_t bytes;  //live bytes
+            uint64_t blocks; //live allocations
+            uint64_t allocs; //allocations made
+            uint64_t frees;  //allocations freed
+            uint64_t peak;   //highest live bytes since start or ResetPeak
+        };
+
+        struct Snapshot
+        {
+            Counters tags[tagcount];
+
+            inline const Counters& operator[](AllocTag tag) const { return tags[static_cast<size_t>(tag)]; }
+        };
+
+        //change between two snapshots
+        struct Delta
+        {
+            int64_t  bytes;
+            int64_t  blocks;
+            uint64_t allocs;
+            uint64_t frees;
+        };
+
+        struct Difference
+        {
+            Delta tags[tagcount];
+
+            inline const Delta& operator[](AllocTag tag) const { return tags[static_cast<size_t>(tag)]; }
+            //true if anything was allocated between the snapshots
+            bool Allocated() const
+            {
+                for (size_t i = 0; i < tagcount; i++)
+                {
+                    if (tags[i].allocs != 0)
+                        return true;
+                }
+                return false;
+            }
+        };
+
+        /*void* Allocate(size_t size, AllocTag tag, const char *file, int line)
+        Allocates size bytes accounted to tag - file and line are passed to the debug heap
+
+        Return value
+        void* - the memory, throws std::bad_alloc on failure*/
+        static void* Allocate(size_t size, AllocTag tag, const char *file = __FILE__, int line = __LINE__)
+        {
+            #if defined(_MSC_VER) && defined(_DEBUG)
+            void *raw = _malloc_dbg(size + sizeof(Header), _NORMAL_BLOCK, file, line);
+            #else
+            (void)file;
+            (void)line;
+            void *raw = malloc(size + sizeof(Header));
+            #endif
+            if (raw == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            Header *header = static_cast<Header*>(raw);
+            header->size   = size;
+            header->tag    = static_cast<uint32_t>(tag);
+            header->magic  = magic;
+            Record(tag, size);
+            return (header + 1);
+        }
+
+        //frees memory from Allocate, nullptr is ignored
+        static void Free(void *p) noexcept
+        {
+            if (p == nullptr)
+            {
+                return;
+            }
+            Header *header = static_cast<Header*>(p) - 1;
+            Erase(static_cast<AllocTag>(header->tag), static_cast<size_t>(header->size));
+            header->magic = 0;
+            #if defined(_MSC_VER) && defined(_DEBUG)
+            _free_dbg(header, _NORMAL_BLOCK);
+            #else
+            free(header);
+            #endif
+        }
+
+        template <class T>
+        static T* NewArray(size_t count, AllocTag tag, const char *file = __FILE__, int line = __LINE__)
+        {
+            static_assert(std::is_trivially_destructible<T>::value, "NewArray is for trivial types");
+            return static_cast<T*>(Allocate(count * sizeof(T), tag, file, line));
+        }
+        static inline void DeleteArray(void *p) noexcept { Free(p); }
+
+        //unique_ptr deleter for memory from Allocate/NewArray
+        struct Deleter
+        {
+            void operator()(void *p) const noexcept { Free(p); }
+        };
+
+        //accounts size bytes allocated (Record) or freed (Erase) outside of Allocate
+        static void Record(AllocTag tag, size_t size) noexcept
+        {
+            Slot &slot = Get()[static_cast<size_t>(tag)];
+            slot.allocs.fetch_add(1, std::memory_order_relaxed);
+            const uint64_t bytes = slot.bytes.fetch_add(size, std::memory_order_relaxed) + size;
+            uint64_t peak = slot.peak.load(std::memory_order_relaxed);
+            while ((bytes > peak) && !slot.peak.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+            {
+            }
+        }
+        static void Erase(AllocTag tag, size_t size) noexcept
+        {
+            Slot &slot = Get()[static_cast<size_t>(tag)];
+            slot.frees.fetch_add(1, std::memory_order_relaxed);
+            slot.bytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        static Snapshot Take() noexcept
+        {
+            Snapshot snap;
+            Slot *slots = Get();
+            for (size_t i = 0; i < tagcount; i++)
+            {
+                //frees first, so a concurrent free can't make blocks negative
+                snap.tags[i].frees  = slots[i].frees.load(std::memory_order_relaxed);
+                snap.tags[i].allocs = slots[i].allocs.load(std::memory_order_relaxed);
+                snap.tags[i].blocks = snap.tags[i].allocs - snap.tags[i].frees;
+                snap.tags[i].bytes  = slots[i].bytes.load(std::memory_order_relaxed);
+                snap.tags[i].peak   = slots[i].peak.load(std::memory_order_relaxed);
+            }
+            return snap;
+        }
+
+        static Difference Diff(const Snapshot &before, const Snapshot &after) noexcept
+        {
+            Difference diff;
+            for (size_t i = 0; i < tagcount; i++)
+            {
+                diff.tags[i].bytes  = static_cast<int64_t>(after.tags[i].bytes - before.tags[i].bytes);
+                diff.tags[i].blocks = static_cast<int64_t>(after.tags[i].blocks - before.tags[i].blocks);
+                diff.tags[i].allocs = after.tags[i].allocs - before.tags[i].allocs;
+                diff.tags[i].frees  = after.tags[i].frees - before.tags[i].frees;
+            }
+            return diff;
+        }
+
+        //sets every tag's high-water mark to its current live bytes
+        static void ResetPeak() noexcept
+        {
+            Slot *slots = Get();
+            for (size_t i = 0; i < tagcount; i++)
+            {
+                slots[i].peak.store(slots[i].bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+
+        static const char* Name(AllocTag tag) noexcept
+        {
+            static const char *const names[tagcount] = { "Window", "GFX", "Thunk", "Logging", "App" };
+            return (static_cast<size_t>(tag) < tagcount) ? names[static_cast<size_t>(tag)] : "?";
+        }
+
+        AllocStats() = delete;
+
+    private:
+        static const uint32_t magic = 0x47415441; //"ATAG"
+
+        //keeps the memory after it 16 byte aligned
+        struct Header
+        {
+            uint64_t size;
+            uint32_t tag;
+            uint32_t magic;
+        };
+        static_assert(sizeof(Header) == 16, "header must keep 16 byte alignment");
+
+        //one cache line per tag
+        struct Slot
+        {
+            std::atomic<uint64_t> bytes;
+            std::atomic<uint64_t> allocs;
+            std::atomic<uint64_t> frees;
+            std::atomic<uint64_t> peak;
+            char                  pad[64 - (4 * sizeof(uint64_t))];
+        };
+
+        //zero initialized before any dynamic initialization, so statics may allocate
+        static Slot* Get() noexcept
+        {
+            static Slot slots[tagcount];
+            return slots;
+        }
+    };
+
+    /*AllocTagged<Tag>
+    Base class that accounts every new/delete of the derived class to Tag*/
+    template <AllocTag Tag>
+    class AllocTagged
+    {
+    public:
+        static void* operator new(size_t size)   { return AllocStats::Allocate(size, Tag); }
+        static void* operator new[](size_t size) { return AllocStats::Allocate(size, Tag); }
+        static void  operator delete(void *p) noexcept   { AllocStats::Free(p); }
+        static void  operator delete[](void *p) noexcept { AllocStats::Free(p); }
+        //placement new is hidden by the class operators, bring it back
+        static void* operator new(size_t, void *where) noexcept { return where; }
+        static void  operator delete(void*, void*) noexcept {}
+        #if defined(_MSC_VER) && defined(_DEBUG)
+        //CRT_NEW form - new(_NORMAL_BLOCK, __FILE__, __LINE__)
+        static void* operator new(size_t size, int, const char *file, int line)   { return AllocStats::Allocate(size, Tag, file, line); }
+        static void* operator new[](size_t size, int, const char *file, int line) { return AllocStats::Allocate(size, Tag, file, line); }
+        static void  operator delete(void *p, int, const char*, int) noexcept   { AllocStats::Free(p); }
+        static void  operator delete[](void *p, int, const char*, int) noexcept { AllocStats::Free(p); }
+        #endif
+    };
+
+    /*TaggedAllocator<T, Tag>
+    STL allocator accounting container memory to Tag*/
+    template <class T, AllocTag Tag>
+    class TaggedAllocator
+    {
+    public:
+        typedef T value_type;
+
+        template <class U>
+        struct rebind
+        {
+            typedef TaggedAllocator<U, Tag> other;
+        };
+
+        TaggedAllocator() noexcept {}
+        template <class U>
+        TaggedAllocator(const TaggedAllocator<U, Tag>&) noexcept {}
+
+        T* allocate(size_t n)
+        {
+            return static_cast<T*>(AllocStats::Allocate(n * sizeof(T), Tag));
+        }
+        void deallocate(T *p, size_t) noexcept
+        {
+            AllocStats::Free(p);
+        }
+
+        template <class U>
+        bool operator==(const TaggedAllocator<U, Tag>&) const noexcept { return true; }
+        template <class U>
+        bool operator!=(const TaggedAllocator<U, Tag>&) const noexcept { return false; }
+    };
+}
@@ -0,0 +1,626 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>             //needed for std::atomic
+#include <chrono>             //needed for std::chrono::steady_clock
+#include <condition_variable> //needed for std::condition_variable
+#include <cstddef>            //needed for size_t
+#include <cstdint>            //needed for uint32_t, uint64_t
+#include <cstdio>             //needed for snprintf
+#include <cstring>            //needed for memcpy
+#include <cwchar>             //needed for swprintf
+#include <memory>             //needed for std::unique_ptr
+#include <mutex>              //needed for std::mutex
+#include <thread>             //needed for std::thread
+#include <type_traits>        //needed for std::decay, std::is_trivially_copyable, std::true_type
+#include <vector>             //needed for std::vector
+#include "AllocTag.h"
+/*Asynchronous logging. A producer copies the format string pointer and its raw arguments into a
+ring buffer owned by the calling thread (single producer, single consumer, no locks) and returns.
+A consumer thread formats the records and passes each line to the sink, so a slow sink (e.g.
+OutputDebugString with a debugger attached) no longer blocks the thread that logged.
+
+    - the format string is stored as a pointer and must outlive the logger - use literals
+    - string arguments (char and wchar_t pointers and arrays, for %s/%ls) are copied, up to
+      maxstring characters, every other argument must be trivially copyable and is stored as is.
+      Other pointers are only good for %p - what they point to may be gone when the consumer
+      formats. Objects (std::string) and char16_t/char32_t strings don't compile, pass c_str() or
+      use DebugPrintSync.
+    - memory is bounded: each thread gets one ring of the size given to Start() and at most
+      maxthreads threads get a ring. A record that does not fit is dropped and counted, the
+      consumer reports the number of dropped records in the output.
+    - Flush() formats everything logged so far on the calling thread, ErrorExit uses it so the
+      last messages are written before the process terminates
+
+This header has no Windows dependencies.*/
+
+namespace WUIF {
+
+    namespace AsyncLogDetail {
+
+        inline size_t Align8(size_t v) { return ((v + 7) & ~static_cast<size_t>(7)); }
+
+        //printf for the character type
+        template <class CharT> struct Text;
+        template <> struct Text<char>
+        {
+            template <class... Args>
+            static int Print(char *out, size_t n, const char *format, Args... args)
+            {
+                return snprintf(out, n, format, args...);
+            }
+            static const char *Dropped() { return "[log] %llu messages dropped"; }
+        };
+        template <> struct Text<wchar_t>
+        {
+            template <class... Args>
+            static int Print(wchar_t *out, size_t n, const wchar_t *format, Args... args)
+            {
+                return swprintf(out, n, format, args...);
+            }
+            static const wchar_t *Dropped() { return L"[log] %llu messages dropped"; }
+        };
+
+        //argument types as they are stored - strings become const char*/const wchar_t*, float is promoted
+        template <class CharT, class T> struct Stored                { typedef T type; };
+        template <class CharT> struct Stored<CharT, char*>           { typedef const char *type; };
+        template <class CharT> struct Stored<CharT, wchar_t*>        { typedef const wchar_t *type; };
+        template <class CharT> struct Stored<CharT, float>           { typedef double type; };
+
+        //strings printf can't format, they would be stored as dangling pointers
+        template <class T> struct Unprintable                 : std::false_type {};
+        template <> struct Unprintable<const char16_t*>       : std::true_type {};
+        template <> struct Unprintable<const char32_t*>       : std::true_type {};
+        template <> struct Unprintable<char16_t*>             : std::true_type {};
+        template <> struct Unprintable<char32_t*>             : std::true_type {};
+
+        //raw arguments are copied
+        template <class CharT, class T>
+        struct Codec
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "log arguments must be trivially copyable - pass strings as c_str() or use DebugPrintSync");
+            static_assert(!Unprintable<T>::value, "char16_t and char32_t strings can't be logged, use DebugPrintSync");
+            static size_t Size(const T&) { return Align8(sizeof(T)); }
+            static void Encode(unsigned char *&p, const T &v)
+            {
+                memcpy(p, &v, sizeof(T));
+                p += Align8(sizeof(T));
+            }
+            static T Decode(const unsigned char *&p)
+            {
+                T v;
+                memcpy(&v, p, sizeof(T));
+                p += Align8(sizeof(T));
+                return v;
+            }
+        };
+
+        //strings are copied with a length prefix, Decode returns a pointer into the record
+        const size_t maxstring = 255;
+        template <class CharT>
+        struct StringCodec
+        {
+            static size_t Length(const CharT *s)
+            {
+                size_t len = 0;
+                if (s != nullptr)
+                {
+                    while ((len < maxstring) && (s[len] != 0))
+                        len++;
+                }
+                return len;
+            }
+            static size_t Size(const CharT *s) { return Align8(sizeof(uint32_t) + ((Length(s) + 1) * sizeof(CharT))); }
+            static void Encode(unsigned char *&p, const CharT *s)
+            {
+                const uint32_t len = static_cast<uint32_t>(Length(s));
+                memcpy(p, &len, sizeof(len));
+                if (len != 0)
+                {
+                    memcpy(p + sizeof(len), s, len * sizeof(CharT));
+                }
+                const CharT nul = 0;
+                memcpy(p + sizeof(len) + (len * sizeof(CharT)), &nul, sizeof(CharT));
+                p += Align8(sizeof(uint32_t) + ((len + 1) * sizeof(CharT)));
+            }
+            static const CharT* Decode(const unsigned char *&p)
+            {
+                uint32_t len;
+                memcpy(&len, p, sizeof(len));
+                const CharT *s = reinterpret_cast<const CharT*>(p + sizeof(len));
+                p += Align8(sizeof(uint32_t) + ((len + 1) * sizeof(CharT)));
+                return s;
+            }
+        };
+        //either character type, so %ls strings in a char log (%hs in a wchar_t log) are copied too
+        template <class CharT> struct Codec<CharT, const char*>    : public StringCodec<char> {};
+        template <class CharT> struct Codec<CharT, const wchar_t*> : public StringCodec<wchar_t> {};
+
+        //decodes the arguments in order and calls Text::Print with them
+        template <class CharT, class... Pending> struct Unpack;
+        template <class CharT>
+        struct Unpack<CharT>
+        {
+            template <class... Done>
+            static int Run(const CharT *format, const unsigned char *&, CharT *out, size_t n, Done... done)
+            {
+                return Text<CharT>::Print(out, n, format, done...);
+            }
+        };
+        template <class CharT, class T, class... Rest>
+        struct Unpack<CharT, T, Rest...>
+        {
+            template <class... Done>
+            static int Run(const CharT *format, const unsigned char *&p, CharT *out, size_t n, Done... done)
+            {
+                T v = Codec<CharT, T>::Decode(p);
+                return Unpack<CharT, Rest...>::Run(format, p, out, n, done..., v);
+            }
+        };
+
+        template <class CharT, class... Args>
+        int Format(const CharT *format, const unsigned char *args, CharT *out, size_t n)
+        {
+            return Unpack<CharT, Args...>::Run(format, args, out, n);
+        }
+
+        template <class CharT>
+        size_t ArgsSize() { return 0; }
+        template <class CharT, class T, class... Rest>
+        size_t ArgsSize(const T &v, const Rest&... rest)
+        {
+            return Codec<CharT, T>::Size(v) + ArgsSize<CharT>(rest...);
+        }
+
+        template <class CharT>
+        void Encode(unsigned char *&) {}
+        template <class CharT, class T, class... Rest>
+        void Encode(unsigned char *&p, const T &v, const Rest&... rest)
+        {
+            Codec<CharT, T>::Encode(p, v);
+            Encode<CharT>(p, rest...);
+        }
+
+        /*byte ring with one producer and one consumer - records are 8 byte aligned and never wrap,
+        a padding record fills the end of the buffer when the next record doesn't fit there*/
+        class Ring : public AllocTagged<AllocTag::Logging>
+        {
+        public:
+            struct Header
+            {
+                uint32_t size;    //record size including the header
+                uint32_t padding; //1 - skip to the start of the buffer
+            };
+
+            explicit Ring(size_t capacity) :
+                _buf(AllocStats::NewArray<unsigned char>(capacity, AllocTag::Logging)), _mask(capacity - 1), _head(0), _cachedtail(0), _tail(0),
+                dropped(0), writing(false), retired(false) {}
+
+            //producer - space for a record of size bytes, nullptr if the ring is full
+            unsigned char* Reserve(size_t size)
+            {
+                const size_t capacity = _mask + 1;
+                if (size > (capacity / 2))
+                {
+                    return nullptr;
+                }
+                size_t head       = _head.load(std::memory_order_relaxed);
+                size_t contiguous = capacity - (head & _mask);
+                const size_t need = (size > contiguous) ? (contiguous + size) : size;
+                if ((capacity - (head - _cachedtail)) < need)
+                {
+                    //only read the consumer's position when the cached one shows the ring full
+                    _cachedtail = _tail.load(std::memory_order_acquire);
+                }
+                const size_t free = capacity - (head - _cachedtail);
+                if (size > contiguous)
+                {
+                    if ((contiguous + size) > free)
+                    {
+                        return nullptr;
+                    }
+                    Header pad = { static_cast<uint32_t>(contiguous), 1 };
+                    memcpy(_buf.get() + (head & _mask), &pad, sizeof(pad));
+                    head += contiguous;
+                    _head.store(head, std::memory_order_release);
+                }
+                else if (size > free)
+                {
+                    return nullptr;
+                }
+                return _buf.get() + (head & _mask);
+            }
+
+            //producer - publishes the record written to Reserve's space
+            void Commit(size_t size)
+            {
+                _head.store(_head.load(std::memory_order_relaxed) + size, std::memory_order_release);
+            }
+
+            //consumer - calls fn(record header) for every published record
+            template <class Fn>
+            size_t Drain(Fn fn)
+            {
+                size_t count = 0;
+                size_t tail = _tail.load(std::memory_order_relaxed);
+                const size_t head = _head.load(std::memory_order_acquire);
+                while (tail != head)
+                {
+                    const unsigned char *record = _buf.get() + (tail & _mask);
+                    Header h;
+                    memcpy(&h, record, sizeof(h));
+                    if (h.padding == 0)
+                    {
+                        fn(record);
+                        count++;
+                    }
+                    tail += h.size;
+                }
+                _tail.store(tail, std::memory_order_release);
+                return count;
+            }
+
+            inline bool Empty() const
+            {
+                return (_tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire));
+            }
+
+        private:
+            std::unique_ptr<unsigned char[], AllocStats::Deleter> _buf;
+            size_t                           _mask;
+            //head and tail are kept on separate cache lines
+            char                             _pad0[64];
+            std::atomic<size_t>              _head;       //written by the producer
+            size_t                           _cachedtail; //producer's copy of _tail
+            char                             _pad1[64];
+            std::atomic<size_t>              _tail;       //written by the consumer
+            char                             _pad2[64];
+
+        public:
+            std::atomic<unsigned long long>  dropped; //records that didn't fit
+            unsigned long long               reported = 0; //dropped count already reported (consumer)
+            std::atomic<bool>                writing;  //the producer is in Put, Stop waits for it
+            std::atomic<bool>                retired;  //the thread exited, freed once drained
+        };
+    }
+
+    template <class CharT>
+    class AsyncLog
+    {
+    public:
+        typedef void (*Sink)(const CharT *line);
+
+        static const size_t maxthreads = 64;
+        static const size_t linesize   = 1024; //characters per formatted line, longer lines are cut
+
+        struct Statistics
+        {
+            unsigned long long logged;  //records written to a ring
+            unsigned long long written; //lines passed to the sink
+            unsigned long long dropped; //records that did not fit (ring full or no ring available)
+            unsigned long      threads; //threads with a ring
+        };
+
+        /*bool Start(Sink sink, size_t ringsize)
+        Starts the consumer thread
+
+        Sink sink       - called on the consumer thread with every formatted line (with newline)
+        size_t ringsize - bytes per thread ring, rounded up to a power of two (min 4096)
+
+        Return value
+        bool - false if already running*/
+        static bool Start(Sink sink, size_t ringsize = 64 * 1024)
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.control);
+            if (s.running.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            size_t size = 4096;
+            while (size < ringsize)
+                size <<= 1;
+            s.ringsize = size;
+            s.sink     = sink;
+            s.stop     = false;
+            s.running.store(true, std::memory_order_release);
+            s.consumer = std::thread(Consume);
+            return true;
+        }
+
+        /*void Stop()
+        Writes everything logged so far and stops the consumer thread. Log returns false afterwards
+        so callers fall back to writing synchronously - a Log that returned true before is written,
+        Stop waits for producers still inside Log before the last drain.*/
+        static void Stop()
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.control);
+            if (!s.running.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            s.running.store(false, std::memory_order_seq_cst);
+            {
+                //a producer that set writing before running was cleared commits before we drain
+                std::lock_guard<std::mutex> guard(s.ringlock);
+                for (AsyncLogDetail::Ring *ring : s.rings)
+                {
+                    while (ring->writing.load(std::memory_order_seq_cst))
+                        std::this_thread::yield();
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(s.wakelock);
+                s.stop = true;
+            }
+            s.wake.notify_one();
+            s.consumer.join();
+            std::lock_guard<std::mutex> drain(s.drainlock);
+            DrainAll();
+        }
+
+        static inline bool Running() { return Get().running.load(std::memory_order_acquire); }
+
+        /*bool Log(const CharT *format, const Args&... args)
+        Queues a message. Never blocks - if the thread's ring is full the message is dropped.
+
+        Return value
+        bool - false if the logger is not running (nothing was queued or dropped)*/
+        template <class... Args>
+        static bool Log(const CharT *format, const Args&... args)
+        {
+            return Put<typename AsyncLogDetail::Stored<CharT, typename std::decay<Args>::type>::type...>(format, args...);
+        }
+
+        /*bool Flush(unsigned timeoutms)
+        Formats and writes every queued message on the calling thread. Used on the crash path, so
+        it gives up if the consumer doesn't finish its current pass within timeoutms.
+
+        Return value
+        bool - true if everything queued before the call was written*/
+        static bool Flush(unsigned timeoutms = 1000)
+        {
+            State &s = Get();
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutms);
+            while (!s.drainlock.try_lock())
+            {
+                if (std::chrono::steady_clock::now() >= deadline)
+                {
+                    return false;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            DrainAll();
+            s.drainlock.unlock();
+            return true;
+        }
+
+        static Statistics GetStatistics()
+        {
+            State &s = Get();
+            Statistics stats;
+            stats.logged  = s.logged.load(std::memory_order_relaxed);
+            stats.written = s.written.load(std::memory_order_relaxed);
+            stats.dropped = s.nodrops.load(std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> guard(s.ringlock);
+                for (AsyncLogDetail::Ring *ring : s.rings)
+                    stats.dropped += ring->dropped.load(std::memory_order_relaxed);
+                stats.threads = static_cast<unsigned long>(s.rings.size());
+            }
+            return stats;
+        }
+
+        AsyncLog() = delete;
+
+    private:
+        typedef int (*FormatFn)(const CharT *format, const unsigned char *args, CharT *out, size_t n);
+
+        //record - Header, FormatFn, format, encoded arguments
+        struct Record
+        {
+            AsyncLogDetail::Ring::Header header;
+            FormatFn                     format;
+            const CharT                 *text;
+        };
+
+        struct State
+        {
+            std::mutex                         control;   //Start/Stop
+            std::atomic<bool>                  running{ false };
+            std::thread                        consumer;
+            Sink                               sink = nullptr;
+            size_t                             ringsize = 0;
+            std::mutex                         ringlock;  //rings
+            std::vector<AsyncLogDetail::Ring*> rings;
+            std::mutex                         drainlock; //one consumer at a time
+            std::mutex                         wakelock;
+            std::condition_variable            wake;
+            bool                               stop = false;
+            char                               pad0[64];  //logged is written by producers, written by the consumer
+            std::atomic<unsigned long long>    logged{ 0 };
+            char                               pad1[64];
+            std::atomic<unsigned long long>    written{ 0 };
+            std::atomic<unsigned long long>    nodrops{ 0 }; //dropped without a live ring (no ring or ring freed)
+        };
+
+        static State& Get()
+        {
+            static State state;
+            return state;
+        }
+
+        //marks the thread's ring retired when the thread exits
+        struct Local
+        {
+            AsyncLogDetail::Ring *ring    = nullptr;
+            bool                  refused = false; //maxthreads reached
+            ~Local()
+            {
+                if (ring != nullptr)
+                    ring->retired.store(true, std::memory_order_release);
+            }
+        };
+
+        static AsyncLogDetail::Ring* ThreadRing()
+        {
+            static thread_local Local local;
+            if ((local.ring == nullptr) && (!local.refused))
+            {
+                State &s = Get();
+                std::lock_guard<std::mutex> guard(s.ringlock);
+                if (s.rings.size() < maxthreads)
+                {
+                    local.ring = new AsyncLogDetail::Ring(s.ringsize);
+                    s.rings.push_back(local.ring);
+                }
+                else
+                {
+                    local.refused = true;
+                }
+            }
+            return local.ring;
+        }
+
+        template <class... Stored, class... Args>
+        static bool Put(const CharT *format, const Args&... args)
+        {
+            State &s = Get();
+            if (!s.running.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            AsyncLogDetail::Ring *ring = ThreadRing();
+            if (ring == nullptr)
+            {
+                s.nodrops.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            //Stop clears running and then waits for writing, so either it sees this record or we see running false
+            ring->writing.store(true, std::memory_order_seq_cst);
+            if (!s.running.load(std::memory_order_seq_cst))
+            {
+                ring->writing.store(false, std::memory_order_release);
+                return false;
+            }
+            const size_t size = AsyncLogDetail::Align8(sizeof(Record)) +
+                                AsyncLogDetail::ArgsSize<CharT, Stored...>(static_cast<const Stored&>(args)...);
+            unsigned char *p = ring->Reserve(size);
+            if (p == nullptr)
+            {
+                ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                ring->writing.store(false, std::memory_order_release);
+                return true;
+            }
+            Record record;
+            record.header.size    = static_cast<uint32_t>(size);
+            record.header.padding = 0;
+            record.format         = AsyncLogDetail::Format<CharT, Stored...>;
+            record.text           = format;
+            memcpy(p, &record, sizeof(record));
+            p += AsyncLogDetail::Align8(sizeof(Record));
+            AsyncLogDetail::Encode<CharT, Stored...>(p, static_cast<const Stored&>(args)...);
+            ring->Commit(size);
+            s.logged.fetch_add(1, std::memory_order_relaxed);
+            ring->writing.store(false, std::memory_order_release);
+            return true;
+        }
+
+        static void Write(State &s, CharT *line, int len)
+        {
+            //cut lines longer than the buffer and add the newline
+            size_t end = ((len < 0) || (static_cast<size_t>(len) > (linesize - 3))) ? (linesize - 3) : static_cast<size_t>(len);
+            #if defined(_WIN32)
+            line[end++] = '\r';
+            #endif
+            line[end++] = '\n';
+            line[end]   = 0;
+            s.sink(line);
+            s.written.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        //formats every queued record - drainlock must be held
+        static size_t DrainAll()
+        {
+            State &s = Get();
+            std::vector<AsyncLogDetail::Ring*> rings;
+            {
+                std::lock_guard<std::mutex> guard(s.ringlock);
+                rings = s.rings;
+            }
+            CharT line[linesize];
+            size_t count = 0;
+            for (AsyncLogDetail::Ring *ring : rings)
+            {
+                //read retired before draining so nothing logged before the thread exited is lost
+                const bool retired = ring->retired.load(std::memory_order_acquire);
+                count += ring->Drain([&s, &line](const unsigned char *p)
+                {
+                    Record record;
+                    memcpy(&record, p, sizeof(record));
+                    int len = record.format(record.text, p + AsyncLogDetail::Align8(sizeof(Record)), line, linesize);
+                    Write(s, line, len);
+                });
+                const unsigned long long dropped = ring->dropped.load(std::memory_order_relaxed);
+                if (dropped != ring->reported)
+                {
+                    int len = AsyncLogDetail::Text<CharT>::Print(line, linesize, AsyncLogDetail::Text<CharT>::Dropped(),
+                                                                 dropped - ring->reported);
+                    Write(s, line, len);
+                    ring->reported = dropped;
+                }
+                if (retired)
+                {
+                    std::lock_guard<std::mutex> guard(s.ringlock);
+                    for (auto it = s.rings.begin(); it != s.rings.end(); ++it)
+                    {
+                        if (*it == ring)
+                        {
+                            s.rings.erase(it);
+                            break;
+                        }
+                    }
+                    s.nodrops.fetch_add(dropped, std::memory_order_relaxed);
+                    delete ring;
+                }
+            }
+            return count;
+        }
+
+        static void Consume()
+        {
+            State &s = Get();
+            for (;;)
+            {
+                size_t count;
+                {
+                    std::lock_guard<std::mutex> drain(s.drainlock);
+                    count = DrainAll();
+                }
+                std::unique_lock<std::mutex> lock(s.wakelock);
+                if (s.stop)
+                {
+                    return;
+                }
+                if (count == 0)
+                {
+                    //producers don't signal, poll while idle
+                    s.wake.wait_for(lock, std::chrono::milliseconds(2));
+                }
+            }
+        }
+    };
+}
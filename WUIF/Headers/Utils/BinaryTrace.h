@@ -0,0 +1,610 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>      //needed for std::atomic
+#include <chrono>      //needed for std::chrono::steady_clock
+#include <cstddef>     //needed for size_t
+#include <cstdint>     //needed for uint8_t ... uint64_t
+#include <cstring>     //needed for memcpy, memset
+#include <mutex>       //needed for std::mutex
+#include <type_traits> //needed for std::decay, std::is_integral
+#include <vector>      //needed for std::vector
+#if !defined(_WIN32)
+    #include <fcntl.h>    //needed for open
+    #include <sys/mman.h> //needed for mmap, munmap
+    #include <unistd.h>   //needed for ftruncate, close
+    #if defined(__x86_64__) || defined(__i386__)
+        #define WUIF_TRACE_TSC
+        #include <x86intrin.h> //needed for __rdtsc
+    #endif
+#endif
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define WUIF_TRACE_SSE2
+    #include <emmintrin.h> //SSE2
+#endif
+/*Binary trace file. Every event is one or more fixed size Records appended to a memory mapped
+file, nothing is formatted in the process:
+
+    record 0   - FileHeader
+    SITE       - a trace site: args are the line, the format string and the source file name. The
+                 site ID is TraceSiteId(__FILE__, __LINE__), computed at compile time.
+    EVENT      - timestamp, thread, site ID and up to maxargs raw arguments
+    TEXT       - textbytes of a string argument of the SITE or EVENT before it, a string argument's
+                 slot holds its length in bytes and its TEXT records follow in argument order
+
+Each thread claims runs of runrecords slots with a single atomic add and fills them in order, so
+most events don't touch the shared counter. Events of different threads are therefore not in time
+order in the file, TraceDecode sorts them by timestamp. A record's type is written last so records
+that were being written when the process died, and the unused end of a run, read as EMPTY. With
+SSE2 the records a few events ahead are prefetched, so the next event doesn't wait for its line to
+be read into the cache. When the file is full further events are
+dropped and counted. Tools/TraceDecode turns the file back into text or CSV.
+
+The only OS calls are CreateFile/CreateFileMapping/MapViewOfFile and QueryPerformanceCounter on
+Windows and open/mmap on other systems, so the writer can be tested outside of Windows. There,
+timestamps are the x86 time stamp counter (a steady_clock read costs as much as the rest of an
+event), its rate is measured against steady_clock by Open and again over the whole trace by Close.
+Other CPUs use steady_clock.*/
+
+namespace WUIF {
+
+    /*uint32_t TraceSiteId(const char *file, unsigned line)
+    FNV-1a hash of a call site, use as a template argument to force compile time evaluation*/
+    constexpr uint32_t TraceSiteId(const char *file, unsigned line)
+    {
+        uint32_t hash = 2166136261u;
+        while (*file != 0)
+        {
+            hash = (hash ^ static_cast<unsigned char>(*file++)) * 16777619u;
+        }
+        for (unsigned i = 0; i < 4; i++)
+        {
+            hash = (hash ^ ((line >> (i * 8)) & 0xff)) * 16777619u;
+        }
+        return hash;
+    }
+
+    class BinaryTrace
+    {
+    public:
+        static const uint32_t version    = 1;
+        static const uint32_t recordsize = 64;
+        static const uint32_t textbytes  = 40; //string bytes per TEXT record
+        static const unsigned maxargs    = 5;  //arguments stored per EVENT, the rest are dropped
+        static const unsigned maxtext    = 4;  //TEXT records per EVENT string argument (160 bytes)
+        static const unsigned maxsitetext = 16; //TEXT records per SITE string
+        static const unsigned prefetch   = 8;  //records ahead of an event that are prefetched
+        static const unsigned runrecords = 32; //slots a thread claims at a time
+
+        enum Type : uint16_t
+        {
+            EMPTY = 0,
+            EVENT = 1,
+            SITE  = 2,
+            TEXT  = 3
+        };
+
+        enum Kind : uint8_t
+        {
+            NONE     = 0,
+            INT      = 1, //int64_t
+            UINT     = 2, //uint64_t
+            REAL     = 3, //double
+            POINTER  = 4, //uint64_t address
+            STRING8  = 5, //slot holds the length in bytes, char data in the TEXT records
+            STRING16 = 6  //slot holds the length in bytes, UTF-16 data in the TEXT records
+        };
+
+        enum Flags : uint8_t
+        {
+            TRUNCATED = 0x01 //arguments beyond maxargs or string data beyond maxtext was dropped
+        };
+
+        struct FileHeader
+        {
+            char     magic[8];   //"WUIFTRC1"
+            uint32_t version;
+            uint32_t recordsize;
+            uint64_t frequency;  //timestamp ticks per second
+            uint64_t start;      //timestamp when the file was opened
+            uint64_t capacity;   //records in the file including the header
+            uint64_t used;       //records claimed (by runs, some may be EMPTY), written by Close
+            uint64_t dropped;    //events dropped because the file was full, written by Close
+            uint64_t reserved;
+        };
+
+        struct Record
+        {
+            uint64_t timestamp;
+            uint32_t thread;
+            uint32_t site;
+            uint16_t type;          //Type, written last
+            uint8_t  count;         //EVENT/SITE - number of arguments, TEXT - bytes used
+            uint8_t  flags;         //Flags
+            uint32_t kinds;         //Kind of argument i in bits 4i..4i+3
+            uint64_t args[maxargs]; //TEXT - string data
+        };
+
+        static_assert(sizeof(FileHeader) == recordsize, "the header fills record 0");
+        static_assert(sizeof(Record) == recordsize, "records are fixed size");
+
+        struct Statistics
+        {
+            uint64_t used;     //records claimed, including the header
+            uint64_t capacity; //records in the file, 0 if no file is open
+            uint64_t dropped;  //events dropped because the file was full
+        };
+
+        #if defined(_WIN32)
+        typedef const TCHAR* Path;
+        #else
+        typedef const char* Path;
+        #endif
+
+        /*bool Open(Path path, uint64_t capacity)
+        Creates (or truncates) the trace file and maps it. Sites hit before Open are written to the
+        file now.
+
+        Path path         - file name
+        uint64_t capacity - file size in records (64 bytes), the default is a 64MB file
+
+        Return value
+        bool - false if a file is already open or the file couldn't be created or mapped*/
+        static bool Open(Path path, uint64_t capacity = 1024 * 1024)
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.sitelock);
+            if ((s.base.load(std::memory_order_acquire) != nullptr) || (capacity < 2))
+            {
+                return false;
+            }
+            const uint64_t bytes = capacity * recordsize;
+            unsigned char *base  = Map(s, path, bytes);
+            if (base == nullptr)
+            {
+                return false;
+            }
+            //touch every page now so events don't take the page faults
+            for (uint64_t offset = 0; offset < bytes; offset += 4096)
+            {
+                static_cast<volatile unsigned char*>(base)[offset] = 0;
+            }
+            FileHeader header;
+            memset(&header, 0, sizeof(header));
+            memcpy(header.magic, "WUIFTRC1", sizeof(header.magic));
+            header.version    = version;
+            header.recordsize = recordsize;
+            header.frequency  = Frequency();
+            header.start      = Now();
+            header.capacity   = capacity;
+            memcpy(base, &header, sizeof(header));
+            #if defined(WUIF_TRACE_TSC)
+            s.openticks = header.start;
+            s.opened    = std::chrono::steady_clock::now();
+            #endif
+            s.capacity = capacity;
+            s.generation.fetch_add(1, std::memory_order_relaxed); //runs claimed in an earlier file are dropped
+            s.next.store(1, std::memory_order_relaxed);
+            s.dropped.store(0, std::memory_order_relaxed);
+            s.base.store(reinterpret_cast<Record*>(base), std::memory_order_release);
+            for (const SiteInfo &info : s.sites)
+            {
+                WriteSite(info);
+            }
+            return true;
+        }
+
+        /*void Close()
+        Writes the header totals and unmaps the file. No other thread may be tracing.*/
+        static void Close()
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.sitelock);
+            Record *base = s.base.exchange(nullptr, std::memory_order_acq_rel);
+            if (base == nullptr)
+            {
+                return;
+            }
+            FileHeader header;
+            memcpy(&header, base, sizeof(header));
+            const uint64_t next = s.next.load(std::memory_order_relaxed);
+            header.used    = (next < s.capacity) ? next : s.capacity;
+            header.dropped = s.dropped.load(std::memory_order_relaxed);
+            #if defined(WUIF_TRACE_TSC)
+            if ((std::chrono::steady_clock::now() - s.opened) > std::chrono::seconds(1))
+            {
+                header.frequency = Rate(s.openticks, s.opened);
+            }
+            #endif
+            memcpy(base, &header, sizeof(header));
+            Unmap(s, reinterpret_cast<unsigned char*>(base), s.capacity * recordsize);
+            s.capacity = 0;
+        }
+
+        static inline bool IsOpen() { return (Get().base.load(std::memory_order_relaxed) != nullptr); }
+
+        /*bool Define(uint32_t site, const char *file, unsigned line, const CharT *format)
+        Records a trace site, called once per site. file and format must be string literals.
+
+        Return value
+        bool - always true, so it can initialize a function local static*/
+        template <class CharT>
+        static bool Define(uint32_t site, const char *file, unsigned line, const CharT *format)
+        {
+            static_assert((sizeof(CharT) == 1) || (sizeof(CharT) == 2), "format must be char or UTF-16");
+            SiteInfo info = { site, file, line, format, (sizeof(CharT) == 2) };
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.sitelock);
+            s.sites.push_back(info);
+            if (s.base.load(std::memory_order_acquire) != nullptr)
+            {
+                WriteSite(info);
+            }
+            return true;
+        }
+
+        /*void Event(uint32_t site, const Args&... args)
+        Appends an EVENT for site. Does nothing if no file is open.*/
+        template <class... Args>
+        static void Event(uint32_t site, const Args&... args)
+        {
+            if (Get().base.load(std::memory_order_acquire) == nullptr)
+            {
+                return;
+            }
+            Pending p;
+            int expand[] = { 0, (p.Add(static_cast<typename std::decay<const Args>::type>(args)), 0)... };
+            (void)expand;
+            Write(EVENT, site, p, maxtext);
+        }
+
+        static Statistics GetStatistics()
+        {
+            State &s = Get();
+            Statistics stats;
+            stats.capacity = IsOpen() ? s.capacity : 0;
+            const uint64_t next = s.next.load(std::memory_order_relaxed);
+            stats.used     = (next < stats.capacity) ? next : stats.capacity;
+            stats.dropped  = s.dropped.load(std::memory_order_relaxed);
+            return stats;
+        }
+
+        BinaryTrace() = delete;
+
+    private:
+        struct SiteInfo
+        {
+            uint32_t    site;
+            const char *file;
+            unsigned    line;
+            const void *format;
+            bool        wide;
+        };
+
+        struct State
+        {
+            std::atomic<Record*>  base{ nullptr };
+            char                  pad0[64];     //next is written by every tracing thread
+            std::atomic<uint64_t> next{ 0 };
+            char                  pad1[64];
+            std::atomic<uint64_t> dropped{ 0 };
+            std::atomic<uint64_t> generation{ 0 }; //files opened
+            uint64_t              capacity = 0;
+            std::mutex            sitelock;     //sites, Open and Close
+            std::vector<SiteInfo> sites;
+            #if defined(_WIN32)
+            HANDLE                file    = INVALID_HANDLE_VALUE;
+            HANDLE                mapping = NULL;
+            #else
+            int                   file    = -1;
+            #endif
+            #if defined(WUIF_TRACE_TSC)
+            uint64_t              openticks = 0; //Now() and steady_clock at Open
+            std::chrono::steady_clock::time_point opened;
+            #endif
+        };
+
+        static State& Get()
+        {
+            static State state;
+            return state;
+        }
+
+        //arguments of one record before they are written
+        struct Pending
+        {
+            uint64_t    args[maxargs];
+            uint32_t    kinds = 0;
+            unsigned    count = 0;
+            uint8_t     flags = 0;
+            const void *text[maxargs];
+
+            void Set(Kind kind, uint64_t value, const void *str = nullptr)
+            {
+                if (count == maxargs)
+                {
+                    flags |= TRUNCATED;
+                    return;
+                }
+                kinds |= (static_cast<uint32_t>(kind) << (count * 4));
+                args[count] = value;
+                text[count] = str;
+                count++;
+            }
+            template <class T>
+            typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type Add(T v)
+            {
+                if (std::is_signed<T>::value)
+                    Set(INT, static_cast<uint64_t>(static_cast<int64_t>(v)));
+                else
+                    Set(UINT, static_cast<uint64_t>(v));
+            }
+            void Add(double v)
+            {
+                uint64_t bits;
+                memcpy(&bits, &v, sizeof(bits));
+                Set(REAL, bits);
+            }
+            void Add(float v) { Add(static_cast<double>(v)); }
+            void Add(const char *s)     { AddString(s, STRING8); }
+            void Add(char *s)           { AddString(s, STRING8); }
+            #if defined(_WIN32)
+            void Add(const wchar_t *s)  { AddString(s, STRING16); }
+            void Add(wchar_t *s)        { AddString(s, STRING16); }
+            #endif
+            void Add(const void *v)     { Set(POINTER, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(v))); }
+            template <class CharT>
+            void AddString(const CharT *s, Kind kind)
+            {
+                static_assert(sizeof(CharT) <= 2, "UTF-32 strings are not supported");
+                size_t len = 0;
+                if (s != nullptr)
+                {
+                    while (s[len] != 0)
+                        len++;
+                }
+                Set(kind, static_cast<uint64_t>(len * sizeof(CharT)), s);
+            }
+        };
+
+        static void WriteSite(const SiteInfo &info)
+        {
+            Pending p;
+            p.Set(UINT, info.line);
+            if (info.wide)
+                p.AddString(static_cast<const char16_t*>(info.format), STRING16);
+            else
+                p.AddString(static_cast<const char*>(info.format), STRING8);
+            p.AddString(info.file, STRING8);
+            Write(SITE, info.site, p, maxsitetext);
+        }
+
+        static void Write(Type type, uint32_t site, Pending &p, unsigned maxstringtext)
+        {
+            State &s = Get();
+            Record *base = s.base.load(std::memory_order_acquire);
+            if (base == nullptr)
+            {
+                return;
+            }
+            //count the TEXT records, cutting strings that need more than maxstringtext
+            unsigned n = 1;
+            for (unsigned i = 0; i < p.count; i++)
+            {
+                if (p.text[i] != nullptr)
+                {
+                    if (p.args[i] > (static_cast<uint64_t>(maxstringtext) * textbytes))
+                    {
+                        p.args[i] = static_cast<uint64_t>(maxstringtext) * textbytes;
+                        p.flags |= TRUNCATED;
+                    }
+                    n += static_cast<unsigned>((p.args[i] + textbytes - 1) / textbytes);
+                }
+            }
+            //slots come from the thread's run, a new run is claimed when it is used up
+            Run &run = ThreadRun();
+            const uint64_t generation = s.generation.load(std::memory_order_relaxed);
+            if ((run.generation != generation) || ((run.next + n) > run.end))
+            {
+                const uint64_t take  = (n > runrecords) ? n : runrecords;
+                const uint64_t claim = s.next.fetch_add(take, std::memory_order_relaxed);
+                run.generation = generation;
+                run.next       = claim;
+                run.end        = ((claim + take) < s.capacity) ? (claim + take) : s.capacity;
+                run.thread     = ThreadId();
+            }
+            if ((run.next + n) > run.end)
+            {
+                s.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            const uint64_t index = run.next;
+            run.next += n;
+            /*records are written in place, the file is created zeroed so the type (EMPTY) and
+            unused arguments already are. String data first, the record's type last*/
+            const uint64_t timestamp = Now();
+            const uint32_t thread    = run.thread;
+            Record *out = base + index;
+            #if defined(WUIF_TRACE_SSE2)
+            //never faults, even past the end of the file
+            _mm_prefetch(reinterpret_cast<const char*>(out + prefetch), _MM_HINT_T0);
+            #endif
+            Record *text = out + 1;
+            for (unsigned i = 0; i < p.count; i++)
+            {
+                if (p.text[i] == nullptr)
+                {
+                    continue;
+                }
+                const unsigned char *str = static_cast<const unsigned char*>(p.text[i]);
+                for (uint64_t done = 0; done < p.args[i]; done += textbytes, text++)
+                {
+                    const uint64_t chunk = ((p.args[i] - done) < textbytes) ? (p.args[i] - done) : textbytes;
+                    text->timestamp = timestamp;
+                    text->thread    = thread;
+                    text->site      = site;
+                    text->count     = static_cast<uint8_t>(chunk);
+                    text->flags     = p.flags;
+                    memcpy(text->args, str + done, static_cast<size_t>(chunk));
+                    Publish(text, TEXT);
+                }
+            }
+            out->timestamp = timestamp;
+            out->thread    = thread;
+            out->site      = site;
+            out->count     = static_cast<uint8_t>(p.count);
+            out->flags     = p.flags;
+            out->kinds     = p.kinds;
+            for (unsigned i = 0; i < p.count; i++)
+            {
+                out->args[i] = p.args[i];
+            }
+            Publish(out, type);
+        }
+
+        //slots claimed by the calling thread and not yet written
+        struct Run
+        {
+            uint64_t generation = 0; //State::generation when claimed
+            uint64_t next       = 0;
+            uint64_t end        = 0;
+            uint32_t thread     = 0; //ThreadId(), looked up once a run
+        };
+
+        static inline Run& ThreadRun()
+        {
+            static thread_local Run run;
+            return run;
+        }
+
+        //sets the type of a record whose other fields are written
+        static inline void Publish(Record *out, Type type)
+        {
+            std::atomic_thread_fence(std::memory_order_release);
+            const uint16_t t = type;
+            memcpy(&out->type, &t, sizeof(t));
+        }
+
+        #if defined(_WIN32)
+        static inline uint64_t Now()
+        {
+            LARGE_INTEGER t;
+            QueryPerformanceCounter(&t);
+            return static_cast<uint64_t>(t.QuadPart);
+        }
+        static uint64_t Frequency()
+        {
+            LARGE_INTEGER f;
+            QueryPerformanceFrequency(&f);
+            return static_cast<uint64_t>(f.QuadPart);
+        }
+        static inline uint32_t ThreadId() { return GetCurrentThreadId(); }
+        static unsigned char* Map(State &s, Path path, uint64_t bytes)
+        {
+            s.file = CreateFile(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, NULL);
+            if (s.file == INVALID_HANDLE_VALUE)
+            {
+                return nullptr;
+            }
+            s.mapping = CreateFileMapping(s.file, NULL, PAGE_READWRITE, static_cast<DWORD>(bytes >> 32),
+                                          static_cast<DWORD>(bytes), NULL);
+            void *view = (s.mapping != NULL) ? MapViewOfFile(s.mapping, FILE_MAP_WRITE, 0, 0, 0) : nullptr;
+            if (view == nullptr)
+            {
+                if (s.mapping != NULL)
+                {
+                    CloseHandle(s.mapping);
+                    s.mapping = NULL;
+                }
+                CloseHandle(s.file);
+                s.file = INVALID_HANDLE_VALUE;
+            }
+            return static_cast<unsigned char*>(view);
+        }
+        static void Unmap(State &s, unsigned char *base, uint64_t)
+        {
+            FlushViewOfFile(base, 0);
+            UnmapViewOfFile(base);
+            CloseHandle(s.mapping);
+            CloseHandle(s.file);
+            s.mapping = NULL;
+            s.file    = INVALID_HANDLE_VALUE;
+        }
+        #else
+        #if defined(WUIF_TRACE_TSC)
+        static inline uint64_t Now() { return __rdtsc(); }
+
+        //ticks per second since the Now() and steady_clock values given
+        static uint64_t Rate(uint64_t ticks, std::chrono::steady_clock::time_point since)
+        {
+            const double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - since).count());
+            return static_cast<uint64_t>(static_cast<double>(Now() - ticks) * 1000000000.0 / ns);
+        }
+        static uint64_t Frequency()
+        {
+            //a millisecond is good to about 0.01%, Close measures traces of more than a second again
+            const std::chrono::steady_clock::time_point since = std::chrono::steady_clock::now();
+            const uint64_t ticks = Now();
+            while ((std::chrono::steady_clock::now() - since) < std::chrono::milliseconds(1))
+            {
+            }
+            return Rate(ticks, since);
+        }
+        #else
+        static inline uint64_t Now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+        static uint64_t Frequency() { return 1000000000ULL; }
+        #endif
+        static uint32_t ThreadId()
+        {
+            static std::atomic<uint32_t> counter{ 0 };
+            static thread_local uint32_t id = ++counter;
+            return id;
+        }
+        static unsigned char* Map(State &s, Path path, uint64_t bytes)
+        {
+            s.file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (s.file < 0)
+            {
+                return nullptr;
+            }
+            void *p = MAP_FAILED;
+            if (ftruncate(s.file, static_cast<off_t>(bytes)) == 0)
+            {
+                p = mmap(nullptr, static_cast<size_t>(bytes), PROT_READ | PROT_WRITE, MAP_SHARED, s.file, 0);
+            }
+            if (p == MAP_FAILED)
+            {
+                close(s.file);
+                s.file = -1;
+                return nullptr;
+            }
+            return static_cast<unsigned char*>(p);
+        }
+        static void Unmap(State &s, unsigned char *base, uint64_t bytes)
+        {
+            msync(base, static_cast<size_t>(bytes), MS_SYNC);
+            munmap(base, static_cast<size_t>(bytes));
+            close(s.file);
+            s.file = -1;
+        }
+        #endif
+    };
+}
@@ -0,0 +1,290 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uintptr_t
+#include <cstring> //needed for memcpy, strlen
+#if defined(_WIN32)
+    #include <mbctype.h>  //needed for _getmbcp
+    #include <mbstring.h> //needed for _ismbblead
+#endif
+/*Single pass command line splitter used by CommandLineToArgvA. The rules are those of
+CommandLineToArgvW:
+
+    program name - everything up to the first space or tab outside of double quotes, the quotes
+                   are removed and backslashes are literal
+    arguments    - separated by spaces and tabs outside of double quotes
+                   2N     backslashes + " ==> N backslashes and begin/end quote
+                   2N + 1 backslashes + " ==> N backslashes + literal "
+                   N      backslashes     ==> N backslashes
+                   "" inside quotes       ==> literal " and the quoted section ends
+
+Runs of ordinary characters are found 16 bytes at a time with SSE2 and copied with memcpy. Only
+quotes and (outside of quotes) spaces and tabs end a run - backslashes are copied with it and the
+ones just before a quote are counted back from the quote, so paths don't slow the scan down.
+Loads are aligned so they never cross into a page after the terminating null. When the CRT multibyte code page is a DBCS code page
+(_setmbcp) lead bytes are stopped at as well and the trail byte is copied with them, as the old
+_ismbblead handling did. This header has no other Windows dependencies.*/
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define WUIF_CMDLINE_SSE2
+    #include <emmintrin.h> //SSE2
+    #if defined(_MSC_VER)
+        #include <intrin.h> //needed for _BitScanForward
+    #endif
+#endif
+//the aligned loads read past the terminator (never past its 16 byte block)
+#if defined(__clang__) || defined(__GNUC__)
+    #define WUIF_CMDLINE_NO_ASAN __attribute__((no_sanitize_address))
+#else
+    #define WUIF_CMDLINE_NO_ASAN
+#endif
+
+namespace WUIF {
+
+    //an argument returned by CommandLine::Split - not null terminated
+    struct ArgView
+    {
+        const char *data;
+        size_t      size;
+    };
+
+    class CommandLine
+    {
+    public:
+        /*size_t CommandLine::MaxArgs(size_t length)
+        Most arguments a command line of length characters can hold - each argument after the
+        program name takes at least one separator and one character*/
+        static inline size_t MaxArgs(size_t length) { return (length / 2) + 1; }
+
+        /*size_t CommandLine::Split(const char *cmdline, char *buffer, ArgView *args, size_t maxargs)
+        Splits cmdline without allocating. The arguments are written one after the other into
+        buffer and args points into it.
+
+        const char *cmdline - null terminated command line, e.g. GetCommandLineA()
+        char *buffer        - receives the arguments, must hold strlen(cmdline) characters
+        ArgView *args       - receives up to maxargs arguments, args[0] is the program name
+        size_t maxargs      - size of args, MaxArgs(strlen(cmdline)) is always enough
+
+        Return value
+        size_t - the number of arguments (at least 1), if more than maxargs only the first maxargs
+                 are stored*/
+        static size_t Split(const char *cmdline, char *buffer, ArgView *args, size_t maxargs)
+        {
+            return Parse(cmdline, buffer, false, [args, maxargs](size_t i, char *begin, size_t size)
+            {
+                if (i < maxargs)
+                {
+                    args[i].data = begin;
+                    args[i].size = size;
+                }
+            });
+        }
+
+        /*size_t CommandLine::Parse(const char *cmdline, char *out, bool terminate, Store store)
+        Splits cmdline into out, calling store(index, begin, size) for each argument. If terminate
+        is set each argument is followed by a null character and out must hold strlen(cmdline) + 1
+        characters, otherwise strlen(cmdline).
+
+        Return value
+        size_t - the number of arguments*/
+        template <class Store>
+        static inline size_t Parse(const char *cmdline, char *out, bool terminate, Store store)
+        {
+            return Run(cmdline, out, terminate, DBCS(), store);
+        }
+
+        /*size_t CommandLine::ParseUTF8(const char *cmdline, char *out, bool terminate, Store store)
+        As Parse for a UTF-8 command line - the CRT code page is ignored, bytes of multibyte
+        sequences are never quotes, spaces or tabs so they are copied with the runs*/
+        template <class Store>
+        static inline size_t ParseUTF8(const char *cmdline, char *out, bool terminate, Store store)
+        {
+            return Run(cmdline, out, terminate, false, store);
+        }
+
+        CommandLine() = delete;
+
+    private:
+        template <class Store>
+        static size_t Run(const char *cmdline, char *out, bool terminate, bool dbcs, Store store)
+        {
+            const char *p    = cmdline;
+            char *begin      = out;
+            bool in_quotes   = false;
+            //program name - the first character is taken even if it is a space or tab
+            if (*p == '"')
+            {
+                in_quotes = true;
+                p++;
+            }
+            else if (*p != '\0')
+            {
+                *out++ = *p++;
+            }
+            for (;;)
+            {
+                const char *s = in_quotes ? Scan<'"', '"', '"', '"'>(p, false) : Scan<'"', ' ', '\t', '"'>(p, false);
+                Copy(out, p, s);
+                p = s;
+                if (*p != '"')
+                {
+                    break; //null or a space/tab outside of quotes
+                }
+                in_quotes = !in_quotes;
+                p++;
+            }
+            store(0, begin, static_cast<size_t>(out - begin));
+            if (terminate)
+            {
+                *out++ = '\0';
+            }
+            size_t argc = 1;
+            //arguments
+            for (;;)
+            {
+                while ((*p == ' ') || (*p == '\t'))
+                {
+                    p++;
+                }
+                if (*p == '\0')
+                {
+                    break;
+                }
+                begin     = out;
+                in_quotes = false;
+                for (;;)
+                {
+                    const char *run = p;
+                    const char *s   = in_quotes ? Scan<'"', '"', '"', '"'>(p, dbcs) : Scan<'"', ' ', '\t', '"'>(p, dbcs);
+                    Copy(out, p, s);
+                    p = s;
+                    const char c = *p;
+                    if ((c == '\0') || (!in_quotes && ((c == ' ') || (c == '\t'))))
+                    {
+                        break; //end of the argument
+                    }
+                    if (c == '"')
+                    {
+                        /*backslashes are only special before a quote, so they were copied with the
+                        run - 2N become N and begin/end quote, 2N + 1 become N and a literal quote*/
+                        size_t slashes = 0;
+                        while (((p - slashes) > run) && (*(p - slashes - 1) == '\\'))
+                        {
+                            slashes++;
+                        }
+                        out -= slashes - (slashes / 2);
+                        if (slashes & 1)
+                        {
+                            *out++ = '"';
+                            p++;
+                            continue;
+                        }
+                        if (in_quotes && (p[1] == '"'))
+                        {
+                            //"" inside quotes - literal " and quoting ends
+                            *out++ = '"';
+                            p += 2;
+                        }
+                        else
+                        {
+                            p++;
+                        }
+                        in_quotes = !in_quotes;
+                        continue;
+                    }
+                    //a DBCS lead byte
+                    *out++ = *p++;
+                    if (dbcs && IsLead(c) && (*p != '\0'))
+                    {
+                        *out++ = *p++;
+                    }
+                }
+                store(argc, begin, static_cast<size_t>(out - begin));
+                if (terminate)
+                {
+                    *out++ = '\0';
+                }
+                argc++;
+            }
+            return argc;
+        }
+
+        static inline void Copy(char *&out, const char *from, const char *to)
+        {
+            const size_t size = static_cast<size_t>(to - from);
+            memcpy(out, from, size);
+            out += size;
+        }
+
+        #if defined(_WIN32)
+        //_ismbblead is only ever true when the multibyte code page was set to a DBCS code page
+        static inline bool DBCS() { return (_getmbcp() != 0); }
+        static inline bool IsLead(char c) { return (_ismbblead(static_cast<unsigned char>(c)) != 0); }
+        #else
+        static inline bool DBCS() { return false; }
+        static inline bool IsLead(char) { return false; }
+        #endif
+
+        /*first character at or after p that is null, one of A-D or (if high is set) 0x80 or
+        above - needles can repeat when fewer than four are needed*/
+        #if defined(WUIF_CMDLINE_SSE2)
+        template <char A, char B, char C, char D>
+        static WUIF_CMDLINE_NO_ASAN const char* Scan(const char *p, bool high)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i a    = _mm_set1_epi8(A);
+            const __m128i b    = _mm_set1_epi8(B);
+            const __m128i c    = _mm_set1_epi8(C);
+            const __m128i d    = _mm_set1_epi8(D);
+            const unsigned highmask = high ? 0xffffU : 0;
+            const size_t offset = static_cast<size_t>(reinterpret_cast<uintptr_t>(p) & 15);
+            const __m128i *block = reinterpret_cast<const __m128i*>(p - offset);
+            __m128i v = _mm_load_si128(block);
+            __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(v, a)),
+                                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, b), _mm_cmpeq_epi8(v, c)), _mm_cmpeq_epi8(v, d)));
+            unsigned mask = (static_cast<unsigned>(_mm_movemask_epi8(m)) | (static_cast<unsigned>(_mm_movemask_epi8(v)) & highmask)) &
+                            (0xffffU << offset);
+            while (mask == 0)
+            {
+                v    = _mm_load_si128(++block);
+                m    = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, zero), _mm_cmpeq_epi8(v, a)),
+                                    _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, b), _mm_cmpeq_epi8(v, c)), _mm_cmpeq_epi8(v, d)));
+                mask = static_cast<unsigned>(_mm_movemask_epi8(m)) | (static_cast<unsigned>(_mm_movemask_epi8(v)) & highmask);
+            }
+            #if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            #else
+            const unsigned index = static_cast<unsigned>(__builtin_ctz(mask));
+            #endif
+            return reinterpret_cast<const char*>(block) + index;
+        }
+        #else
+        template <char A, char B, char C, char D>
+        static const char* Scan(const char *p, bool high)
+        {
+            for (;; p++)
+            {
+                const char ch = *p;
+                if ((ch == '\0') || (ch == A) || (ch == B) || (ch == C) || (ch == D) ||
+                    (high && (static_cast<unsigned char>(ch) >= 0x80)))
+                {
+                    return p;
+                }
+            }
+        }
+        #endif
+    };
+}
@@ -13,8 +13,30 @@ See the License for the specific language governing permissions and
 limitations under the License.*/
 #pragma once
 #include <Windows.h>
-#include <mbstring.h>        //needed for _ismbblead in CommandLineToArgvA
 #include "WUIF_Error.h"
+#include "CommandLineSplit.h"
+#include "UTF.h"
+
+/*void CompactArgv(LPSTR *argv, size_t argc, LPSTR strings, LPSTR end)
+Moves the strings split into strings..end down behind argv[argc], fixes up the pointers, sets
+argv[argc] to nullptr and shrinks the heap block to what is used*/
+static void CompactArgv(LPSTR *argv, size_t argc, LPSTR strings, LPSTR end)
+{
+    LPSTR dest = reinterpret_cast<LPSTR>(argv + argc + 1);
+    const size_t used = static_cast<size_t>(end - strings);
+    if (dest != strings)
+    {
+        memmove(dest, strings, used);
+        for (size_t i = 0; i < argc; i++)
+        {
+            argv[i] = dest + (argv[i] - strings);
+        }
+    }
+    argv[argc] = nullptr;
+    //shrinking in place never moves the block - a failure only means the slack is kept
+    HeapReAlloc(GetProcessHeap(), HEAP_REALLOC_IN_PLACE_ONLY, argv,
+                (sizeof(LPSTR) * (argc + 1)) + (used * sizeof(CHAR)));
+}
 
 /*LPSTR* CommandLineToArgvA(_In_ LPCSTR lpCmdLine, _Out_ int *pNumArgs)
 Takes the ASCII command line string and splits it into separate args.
@@ -36,23 +58,21 @@ LPSTR* CommandLineToArgvA(_In_ LPCSTR lpCmdLine, _Out_ int *pNumArgs)
         return NULL;
     }
     *pNumArgs = 0;
-    /*follow CommandLinetoArgvW and if lpCmdLine is NULL return the path to the executable.
-    Use 'programname' so that we don't have to allocate MAX_PATH * sizeof(CHAR) for argv
-    every time. Since this is ANSI the return can't be greater than MAX_PATH (260
-    characters)*/
-    CHAR programname[MAX_PATH] = {};
-    /*pnlength = the length of the string that is copied to the buffer, in characters, not
-    including the terminating null character*/
-    const DWORD pnlength = GetModuleFileNameA(NULL, programname, MAX_PATH);
-    if (pnlength == 0) //error getting program name
+    if ((lpCmdLine == nullptr) || (*lpCmdLine == '\0'))
     {
-        //GetModuleFileNameA will SetLastError
-        PrintExit(TEXT("::CommandLineToArgvA"));
-        return NULL;
-    }
-    if (lpCmdLine == nullptr)
-    {
-
+        /*follow CommandLinetoArgvW and if lpCmdLine is NULL (or empty) return the path to the
+        executable. Since this is ANSI the return can't be greater than MAX_PATH (260
+        characters)*/
+        CHAR programname[MAX_PATH] = {};
+        /*pnlength = the length of the string that is copied to the buffer, in characters, not
+        including the terminating null character*/
+        const DWORD pnlength = GetModuleFileNameA(NULL, programname, MAX_PATH);
+        if (pnlength == 0) //error getting program name
+        {
+            //GetModuleFileNameA will SetLastError
+            PrintExit(TEXT("::CommandLineToArgvA"));
+            return NULL;
+        }
         /*In keeping with CommandLineToArgvW the caller should make a single call to HeapFree
         to release the memory of argv. Allocate a single block of memory with space for two
         pointers (representing argv[0] and argv[1]). argv[0] will contain a pointer to argv+2
@@ -71,234 +91,97 @@ LPSTR* CommandLineToArgvA(_In_ LPCSTR lpCmdLine, _Out_ int *pNumArgs)
         PrintExit(TEXT("::CommandLineToArgvA"));
         return argv;
     }
-    /*We need to determine the number of arguments and the number of characters so that the
-    proper amount of memory can be allocated for argv. Our argument count starts at 1 as the
-    first "argument" is the program name even if there are no other arguments per specs.*/
-    int argc = 1;
-    int numchars = 0;
-    LPCSTR templpcl = lpCmdLine;
-    bool in_quotes = false;  //'in quotes' mode is off (false) or on (true)
-    /*first scan the program name and copy it. The handling is much simpler than for other
-    arguments. Basically, whatever lies between the leading double-quote and next one, or a
-    terminal null character is simply accepted. Fancier handling is not required because the
-    program name must be a legal NTFS/HPFS file name. Note that the double-quote characters are
-    not copied.*/
-    do
+    /*The command line is split in a single pass (see CommandLineSplit.h), so the number of
+    arguments isn't known until the end. Allocate a single block with room for the most pointers
+    the command line can hold (CommandLine::MaxArgs + 1 for the terminating nullptr) followed by
+    the strings, which never need more than the command line's length + 1 characters. Once
+    split the strings are moved down to just after argv[argc] and the block is shrunk in place,
+    so the caller still releases everything with a single call to HeapFree. HeapAlloc is called
+    with HEAP_GENERATE_EXCEPTIONS flag, so if there is a failure on allocating memory an
+    exception will be generated.*/
+    const size_t length  = strlen(lpCmdLine);
+    const size_t maxargs = WUIF::CommandLine::MaxArgs(length);
+    LPSTR *argv = static_cast<LPSTR*>(HeapAlloc(GetProcessHeap(), HEAP_GENERATE_EXCEPTIONS,
+                                                (sizeof(LPSTR) * (maxargs + 1)) + ((length + 1) * sizeof(CHAR))));
+    LPSTR strings = reinterpret_cast<LPSTR>(argv + maxargs + 1);
+    LPSTR end     = strings; //end of the last string including its null terminator
+    const size_t argc = WUIF::CommandLine::Parse(lpCmdLine, strings, true, [argv, &end](size_t i, LPSTR begin, size_t size)
     {
-        if (*templpcl == '"')
-        {
-            //don't add " to character count
-            in_quotes = !in_quotes;
-            templpcl++; //move to next character
-            continue;
-        }
-        ++numchars; //count character
-        templpcl++; //move to next character
-        if (_ismbblead(*templpcl) != 0) //handle MBCS
-        {
-            ++numchars;
-            templpcl++; //skip over trail byte
-        }
-    } while (*templpcl != '\0' && (in_quotes || (*templpcl != ' ' && *templpcl != '\t')));
-    //parsed first argument
-    if (*templpcl == '\0')
-    {
-        /*no more arguments, rewind and the next for statement will handle*/
-        templpcl--;
-    }
-    //loop through the remaining arguments
-    int slashcount = 0; //count of backslashes
-    bool countorcopychar = true; //count the character or not
-    for (;;)
-    {
-        if (*templpcl)
-        {
-            //next argument begins with next non-whitespace character
-            while (*templpcl == ' ' || *templpcl == '\t')
-                ++templpcl;
-        }
-        if (*templpcl == '\0')
-            break; //end of arguments
+        //C6011 - Dereferencing null pointer - dereferencing NULL pointer 'argv'
+        #pragma warning(suppress: 6011)
+        argv[i] = begin;
+        end     = begin + size + 1;
+    });
+    CompactArgv(argv, argc, strings, end);
+    *pNumArgs = static_cast<int>(argc);
+    PrintExit(TEXT("::CommandLineToArgvA"));
+    return argv;
+}
 
-        ++argc; //next argument - increment argument count
-        //loop through this argument
-        for (;;)
-        {
-            /*Rules:
-              2N     backslashes   + " ==> N backslashes and begin/end quote
-              2N + 1 backslashes   + " ==> N backslashes + literal "
-              N      backslashes       ==> N backslashes*/
-            slashcount = 0;
-            countorcopychar = true;
-            while (*templpcl == '\\')
-            {
-                //count the number of backslashes for use below
-                ++templpcl;
-                ++slashcount;
-            }
-            if (*templpcl == '"')
-            {
-                //if 2N backslashes before, start/end quote, otherwise count.
-                if (slashcount % 2 == 0) //even number of backslashes
-                {
-                    if (in_quotes && *(templpcl + 1) == '"')
-                    {
-                        in_quotes = !in_quotes; //NB: parse_cmdline omits this line
-                        templpcl++; //double quote inside quoted string
-                    }
-                    else
-                    {
-                        //skip first quote character and count second
-                        countorcopychar = false;
-                        in_quotes = !in_quotes;
-                    }
-                }
-                slashcount /= 2;
-            }
-            //count slashes
-            while (slashcount--)
-            {
-                ++numchars;
-            }
-            if (*templpcl == '\0' || (!in_quotes && (*templpcl == ' ' || *templpcl == '\t')))
-            {
-                //at the end of the argument - break
-                break;
-            }
-            if (countorcopychar)
-            {
-                if (_ismbblead(*templpcl) != 0) //should copy another character for MBCS
-                {
-                    ++templpcl; //skip over trail byte
-                    ++numchars;
-                }
-                ++numchars;
-            }
-            ++templpcl;
-        }
-        //add a count for the null-terminating character
-        ++numchars;
-    }
-    /*allocate memory for argv. Allocate a single block of memory with space for argc number of
-    pointers. argv[0] will contain a pointer to argv+argc where the actual program name will be
-    stored. argv[argc] will be nullptr per the C++ specifications. Hence space required is the
-    size of a LPSTR (char*) multiplied by argc + 1 pointers + the number of characters counted
-    above multiplied by the sizeof CHAR. HeapAlloc is called with HEAP_GENERATE_EXCEPTIONS
-    flag, so if there is a failure on allocating memory an exception will be generated.*/
-    LPSTR *argv = static_cast<LPSTR*>(HeapAlloc(GetProcessHeap(),
-                                                HEAP_ZERO_MEMORY | HEAP_GENERATE_EXCEPTIONS,
-                                                (sizeof(LPSTR) * (static_cast<size_t>(argc) + 1)) + (numchars * sizeof(CHAR))));
-    //now loop through the command line again and split out arguments
-    in_quotes = false;
-    templpcl = lpCmdLine;
-    //C6011 - Dereferencing null pointer - dereferencing NULL pointer 'argv'
-    #pragma warning(suppress: 6011)
-    argv[0] = reinterpret_cast<LPSTR>(argv + argc + 1);
-    LPSTR tempargv = reinterpret_cast<LPSTR>(argv + argc + 1);
-    do
-    {
-        if (*templpcl == '"')
-        {
-            in_quotes = !in_quotes;
-            templpcl++; //move to next character
-            continue;
-        }
-        *tempargv++ = *templpcl;
-        templpcl++; //move to next character
-        if (_ismbblead(*templpcl) != 0) //should copy another character for MBCS
-        {
-            *tempargv++ = *templpcl; //copy second byte
-            templpcl++; //skip over trail byte
-        }
-    } while (*templpcl != '\0' && (in_quotes || (*templpcl != ' ' && *templpcl != '\t')));
-    //parsed first argument
-    if (*templpcl == '\0')
-    {
-        //no more arguments, rewind and the next for statement will handle
-        templpcl--;
-    }
-    else
+/*LPSTR* CommandLineToArgvUTF8(_In_ LPCWSTR lpCmdLine, _Out_ int *pNumArgs)
+Takes the wide command line string and splits it into separate UTF-8 args, so arguments outside of
+the ANSI code page survive. Unpaired surrogates are replaced with U+FFFD. The split follows the same
+rules as CommandLineToArgvA and argv is released with a single call to HeapFree.
+
+LPCWSTR lpCmdLine[in] - should be GetCommandLineW()
+int *pNumArgs[out] - pointer to the number of args (ie. argc value of main(argc,argv[]) )
+
+Return results
+    LPSTR* - pointer to the argv[] array
+*/
+LPSTR* CommandLineToArgvUTF8(_In_ LPCWSTR lpCmdLine, _Out_ int *pNumArgs)
+{
+    PrintEnter(TEXT("::CommandLineToArgvUTF8"));
+    if (!pNumArgs)
     {
-        //end of program name - add null terminator
-        *tempargv = '\0';
+        SetLastError(ERROR_INVALID_PARAMETER);
+        PrintExit(TEXT("::CommandLineToArgvUTF8"));
+        return NULL;
     }
-    int currentarg = 1;
-    argv[currentarg] = ++tempargv;
-    //loop through the remaining arguments
-    slashcount = 0; //count of backslashes
-    countorcopychar = true; //count the character or not
-    for (;;)
+    *pNumArgs = 0;
+    if ((lpCmdLine == nullptr) || (*lpCmdLine == L'\0'))
     {
-        if (*templpcl)
-        {
-            //next argument begins with next non-whitespace character
-            while (*templpcl == ' ' || *templpcl == '\t')
-                ++templpcl;
-        }
-        if (*templpcl == '\0')
-            break; //end of arguments
-        argv[currentarg] = ++tempargv; //copy address of this argument string
-        //next argument - loop through it's characters
-        for (;;)
+        //as CommandLineToArgvA - the path to the executable is the only argument
+        WCHAR programname[MAX_PATH] = {};
+        const DWORD pnlength = GetModuleFileNameW(NULL, programname, MAX_PATH);
+        if (pnlength == 0) //error getting program name
         {
-            /*Rules:
-              2N     backslashes   + " ==> N backslashes and begin/end quote
-              2N + 1 backslashes   + " ==> N backslashes + literal "
-              N      backslashes       ==> N backslashes*/
-            slashcount = 0;
-            countorcopychar = true;
-            while (*templpcl == '\\')
-            {
-                //count the number of backslashes for use below
-                ++templpcl;
-                ++slashcount;
-            }
-            if (*templpcl == '"')
-            {
-                //if 2N backslashes before, start/end quote, otherwise copy literally.
-                if (slashcount % 2 == 0) //even number of backslashes
-                {
-                    if (in_quotes && *(templpcl + 1) == '"')
-                    {
-                        in_quotes = !in_quotes; //NB: parse_cmdline omits this line
-                        templpcl++; //double quote inside quoted string
-                    }
-                    else
-                    {
-                        //skip first quote character and count second
-                        countorcopychar = false;
-                        in_quotes = !in_quotes;
-                    }
-                }
-                slashcount /= 2;
-            }
-            //copy slashes
-            while (slashcount--)
-            {
-                *tempargv++ = '\\';
-            }
-            if (*templpcl == '\0' || (!in_quotes && (*templpcl == ' ' || *templpcl == '\t')))
-            {
-                //at the end of the argument - break
-                break;
-            }
-            if (countorcopychar)
-            {
-                *tempargv++ = *templpcl;
-                if (_ismbblead(*templpcl) != 0) //should copy another character for MBCS
-                {
-                    ++templpcl; //skip over trail byte
-                    *tempargv++ = *templpcl;
-                }
-            }
-            ++templpcl;
+            //GetModuleFileNameW will SetLastError
+            PrintExit(TEXT("::CommandLineToArgvUTF8"));
+            return NULL;
         }
-        //null-terminate the argument
-        *tempargv = '\0';
-        ++currentarg;
+        const size_t bytes = WUIF::UTF::UTF8Length(programname, pnlength, true);
+        LPSTR *argv = static_cast<LPSTR*>(HeapAlloc(GetProcessHeap(), HEAP_GENERATE_EXCEPTIONS,
+                                                    (sizeof(LPSTR) * 2) + ((bytes + 1) * sizeof(CHAR))));
+        LPSTR name = reinterpret_cast<LPSTR>(argv + 2);
+        name[WUIF::UTF::ToUTF8(programname, pnlength, name, true)] = '\0';
+        argv[0] = name;
+        argv[1] = nullptr;
+        *pNumArgs = 1;
+        PrintExit(TEXT("::CommandLineToArgvUTF8"));
+        return argv;
     }
-    argv[argc] = nullptr;
-    *pNumArgs = argc;
-    PrintExit(TEXT("::CommandLineToArgvA"));
+    /*As CommandLineToArgvA with the UTF-8 copy of the command line after the strings - the block
+    holds the pointers, room for the strings and the converted command line, the last of which is
+    dropped when the strings are moved down and the block is shrunk*/
+    const size_t wlength = WUIF::UTF::Length(lpCmdLine);
+    const size_t length  = WUIF::UTF::UTF8Length(lpCmdLine, wlength, true);
+    const size_t maxargs = WUIF::CommandLine::MaxArgs(length);
+    LPSTR *argv = static_cast<LPSTR*>(HeapAlloc(GetProcessHeap(), HEAP_GENERATE_EXCEPTIONS,
+                                                (sizeof(LPSTR) * (maxargs + 1)) + ((length + 1) * 2 * sizeof(CHAR))));
+    LPSTR strings = reinterpret_cast<LPSTR>(argv + maxargs + 1);
+    LPSTR utf8    = strings + length + 1;
+    utf8[WUIF::UTF::ToUTF8(lpCmdLine, wlength, utf8, true)] = '\0';
+    LPSTR end     = strings; //end of the last string including its null terminator
+    const size_t argc = WUIF::CommandLine::ParseUTF8(utf8, strings, true, [argv, &end](size_t i, LPSTR begin, size_t size)
+    {
+        //C6011 - Dereferencing null pointer - dereferencing NULL pointer 'argv'
+        #pragma warning(suppress: 6011)
+        argv[i] = begin;
+        end     = begin + size + 1;
+    });
+    CompactArgv(argv, argc, strings, end);
+    *pNumArgs = static_cast<int>(argc);
+    PrintExit(TEXT("::CommandLineToArgvUTF8"));
     return argv;
 }
\ No newline at end of file
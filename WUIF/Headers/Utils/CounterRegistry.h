@@ -0,0 +1,460 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>  //needed for std::atomic
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for int64_t, uint32_t, uint64_t
+#include <cstdio>  //needed for snprintf
+#include <cstring> //needed for memcpy, memset, strlen, strncmp
+#include <mutex>   //needed for std::mutex
+#include <new>     //needed for placement new
+#if !defined(_WIN32)
+    #include <fcntl.h>    //needed for O_* flags
+    #include <sys/mman.h> //needed for shm_open, mmap, munmap
+    #include <sys/stat.h> //needed for fstat
+    #include <unistd.h>   //needed for ftruncate, close, getpid
+#endif
+/*Process wide performance counters published in named shared memory, so other processes can read
+them live without attaching a debugger. A Counter is one named 64-bit value - COUNTER for totals
+that only grow (frames presented, messages dispatched), GAUGE for levels (windows open, bytes in
+use). Updating one is a single relaxed atomic operation on the shared memory, nothing else.
+
+    Counter frames = CounterRegistry::Register("frames.presented", CounterRegistry::COUNTER);
+    frames.Add();
+
+The segment is created by the first Register and is named after the process id (SegmentName) -
+CreateFileMapping in the session's Local namespace on Windows, shm_open on other systems. Its
+layout is fixed size slots of slotsize bytes:
+
+    slot 0   - Header: magic "WUIFCNTR", version, slotsize, capacity, pid and count, the number
+               of counter slots published
+    slot 1.. - Slot: value, kind and name
+
+A slot is written before count is raised past it (release), so a reader that loads count
+(acquire) sees complete names. Slots are never removed or reused. version changes only when an
+existing field changes meaning - new fields go in the reserved words or grow slotsize, which
+readers step over. CounterReader maps another process's segment read only and checks the layout.
+
+If the segment can't be created the counters live in process memory and still count. A Counter
+that was never registered (default constructed, bad name, registry full) writes to a sink nobody
+reads, so code can update counters unconditionally. This header has no Windows dependencies beyond
+the mapping calls, so writer and reader can be tested outside of Windows.*/
+
+namespace WUIF {
+
+    //the value unregistered Counters write to - a template so the header can define it
+    template <class T = void>
+    struct CounterSink
+    {
+        static std::atomic<int64_t> value;
+    };
+    template <class T>
+    std::atomic<int64_t> CounterSink<T>::value{ 0 };
+
+    //handle to one registered counter, cheap to copy
+    class Counter
+    {
+    public:
+        constexpr Counter() noexcept : _value(&CounterSink<>::value) {}
+
+        inline void    Add(int64_t n = 1) noexcept { _value->fetch_add(n, std::memory_order_relaxed); }
+        //gauges - the current level
+        inline void    Set(int64_t v) noexcept { _value->store(v, std::memory_order_relaxed); }
+        inline int64_t value() const noexcept { return _value->load(std::memory_order_relaxed); }
+        //false if the counter writes to the sink
+        inline bool    registered() const noexcept { return (_value != &CounterSink<>::value); }
+
+    private:
+        friend class CounterRegistry;
+        explicit Counter(std::atomic<int64_t> *value) noexcept : _value(value) {}
+
+        std::atomic<int64_t> *_value;
+    };
+
+    class CounterRegistry
+    {
+    public:
+        static const uint32_t version     = 1;
+        static const uint32_t slotsize    = 64;
+        static const uint32_t namesize    = 48;  //including the terminating null
+        static const uint32_t maxcounters = 255; //the segment is 16KB
+
+        enum Kind : uint32_t
+        {
+            EMPTY   = 0,
+            COUNTER = 1, //total since the process started, readers show the rate
+            GAUGE   = 2  //current level
+        };
+
+        struct Header
+        {
+            char                  magic[8]; //"WUIFCNTR"
+            uint32_t              version;
+            uint32_t              slotsize; //bytes per slot, Header included
+            uint32_t              capacity; //counter slots after the header
+            std::atomic<uint32_t> count;    //counter slots published
+            uint64_t              pid;      //process that created the segment
+            uint64_t              reserved[4];
+        };
+
+        struct Slot
+        {
+            std::atomic<int64_t> value;
+            uint32_t             kind;      //Kind
+            uint32_t             reserved;
+            char                 name[namesize];
+        };
+
+        static_assert(sizeof(Header) == slotsize, "the header fills slot 0");
+        static_assert(sizeof(Slot) == slotsize, "slots are fixed size");
+        static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "counters shared between processes must be lock free");
+
+        /*void CounterRegistry::SegmentName(char (&name)[64], uint64_t pid)
+        The shared memory name of process pid's counters*/
+        static void SegmentName(char (&name)[64], uint64_t pid) noexcept
+        {
+            #if defined(_WIN32)
+            snprintf(name, sizeof(name), "Local\\WUIF.Counters.%llu", static_cast<unsigned long long>(pid));
+            #else
+            snprintf(name, sizeof(name), "/WUIF.Counters.%llu", static_cast<unsigned long long>(pid));
+            #endif
+        }
+
+        /*Counter CounterRegistry::Register(const char *name, Kind kind)
+        Adds a counter, or returns the one already registered under name. The first call creates the
+        shared memory segment.
+
+        const char *name - 1 to namesize-1 characters, by convention lower case words joined by '.'
+        Kind kind        - COUNTER or GAUGE
+
+        Return value
+        Counter - unregistered (see Counter::registered) if name is invalid, was registered with
+                  another kind or the registry is full*/
+        static Counter Register(const char *name, Kind kind)
+        {
+            const size_t length = (name != nullptr) ? strlen(name) : 0;
+            if ((length == 0) || (length >= namesize) || ((kind != COUNTER) && (kind != GAUGE)))
+            {
+                return Counter();
+            }
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.lock);
+            Header *header = s.header;
+            Slot   *slots  = reinterpret_cast<Slot*>(header + 1);
+            const uint32_t count = header->count.load(std::memory_order_relaxed);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                if (strncmp(slots[i].name, name, namesize) == 0)
+                {
+                    return (slots[i].kind == kind) ? Counter(&slots[i].value) : Counter();
+                }
+            }
+            if (count == header->capacity)
+            {
+                return Counter();
+            }
+            Slot &slot = slots[count];
+            slot.value.store(0, std::memory_order_relaxed);
+            slot.kind     = kind;
+            slot.reserved = 0;
+            memset(slot.name, 0, sizeof(slot.name));
+            memcpy(slot.name, name, length);
+            header->count.store(count + 1, std::memory_order_release);
+            return Counter(&slot.value);
+        }
+
+        //true if the counters are in the named segment, false if they only live in this process
+        static bool Published()
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.lock);
+            return s.shared;
+        }
+
+        /*void CounterRegistry::Unpublish()
+        Removes the segment's name so no new reader can open it. The memory stays mapped, so
+        Counters keep working - call at exit, it matters on systems where shared memory names
+        outlive the process.*/
+        static void Unpublish()
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> guard(s.lock);
+            if (!s.shared)
+            {
+                return;
+            }
+            #if defined(_WIN32)
+            CloseHandle(s.mapping);
+            s.mapping = NULL;
+            #else
+            shm_unlink(s.name);
+            #endif
+            s.shared = false;
+        }
+
+        CounterRegistry() = delete;
+
+    private:
+        struct Block
+        {
+            Header header;
+            Slot   slots[maxcounters];
+        };
+
+        struct State
+        {
+            std::mutex lock;     //Register and Unpublish
+            Header    *header;   //the segment or local
+            bool       shared;
+            #if defined(_WIN32)
+            HANDLE     mapping;
+            #else
+            char       name[64];
+            #endif
+            Block      local;    //counters when no segment could be created
+
+            State() : header(nullptr), shared(false)
+            {
+                #if defined(_WIN32)
+                mapping = NULL;
+                #endif
+                void *base = Map(*this);
+                shared = (base != nullptr);
+                if (!shared)
+                {
+                    base = &local;
+                }
+                memset(base, 0, sizeof(Block));
+                Block *block = new (base) Block;
+                header = &block->header;
+                memcpy(header->magic, "WUIFCNTR", sizeof(header->magic));
+                header->version  = version;
+                header->slotsize = slotsize;
+                header->capacity = maxcounters;
+                header->pid      = ProcessId();
+                header->count.store(0, std::memory_order_release);
+            }
+        };
+
+        static State& Get()
+        {
+            static State state;
+            return state;
+        }
+
+        #if defined(_WIN32)
+        static uint64_t ProcessId() { return GetCurrentProcessId(); }
+        static void* Map(State &s)
+        {
+            char name[64];
+            SegmentName(name, ProcessId());
+            s.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(Block), name);
+            if (s.mapping == NULL)
+            {
+                return nullptr;
+            }
+            void *view = MapViewOfFile(s.mapping, FILE_MAP_WRITE, 0, 0, sizeof(Block));
+            if (view == nullptr)
+            {
+                CloseHandle(s.mapping);
+                s.mapping = NULL;
+            }
+            return view;
+        }
+        #else
+        static uint64_t ProcessId() { return static_cast<uint64_t>(getpid()); }
+        static void* Map(State &s)
+        {
+            SegmentName(s.name, ProcessId());
+            //a segment left by an earlier process with the same id is replaced
+            const int fd = shm_open(s.name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0)
+            {
+                return nullptr;
+            }
+            void *p = MAP_FAILED;
+            if (ftruncate(fd, static_cast<off_t>(sizeof(Block))) == 0)
+            {
+                p = mmap(nullptr, sizeof(Block), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            close(fd);
+            if (p == MAP_FAILED)
+            {
+                shm_unlink(s.name);
+                return nullptr;
+            }
+            return p;
+        }
+        #endif
+    };
+
+    //read only view of another process's counters
+    class CounterReader
+    {
+    public:
+        enum Status
+        {
+            OPENED,       //the segment is mapped
+            MISSING,      //no segment for the process
+            INCOMPATIBLE  //the segment's magic, version or size is wrong
+        };
+
+        struct Entry
+        {
+            char                     name[CounterRegistry::namesize];
+            CounterRegistry::Kind    kind;
+            int64_t                  value;
+        };
+
+        CounterReader() noexcept : _base(nullptr), _size(0), _capacity(0), _stride(0), _pid(0)
+        {
+            #if defined(_WIN32)
+            _mapping = NULL;
+            #endif
+        }
+        ~CounterReader() { Close(); }
+
+        CounterReader(const CounterReader&) = delete;
+        CounterReader& operator=(const CounterReader&) = delete;
+
+        /*Status CounterReader::Open(uint64_t pid)
+        Maps process pid's counters, closing any open before
+
+        Return value
+        Status - OPENED on success*/
+        Status Open(uint64_t pid)
+        {
+            Close();
+            char name[64];
+            CounterRegistry::SegmentName(name, pid);
+            #if defined(_WIN32)
+            _mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+            if (_mapping == NULL)
+            {
+                return MISSING;
+            }
+            _base = static_cast<const unsigned char*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0));
+            MEMORY_BASIC_INFORMATION info;
+            if ((_base == nullptr) || (VirtualQuery(_base, &info, sizeof(info)) == 0))
+            {
+                Close();
+                return MISSING;
+            }
+            _size = info.RegionSize;
+            #else
+            const int fd = shm_open(name, O_RDONLY, 0);
+            if (fd < 0)
+            {
+                return MISSING;
+            }
+            struct stat info;
+            void *p = MAP_FAILED;
+            if ((fstat(fd, &info) == 0) && (info.st_size >= static_cast<off_t>(sizeof(CounterRegistry::Header))))
+            {
+                _size = static_cast<size_t>(info.st_size);
+                p = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+            }
+            close(fd);
+            if (p == MAP_FAILED)
+            {
+                _size = 0;
+                return MISSING;
+            }
+            _base = static_cast<const unsigned char*>(p);
+            #endif
+            const CounterRegistry::Header *h = header();
+            if ((_size < sizeof(CounterRegistry::Header)) || (memcmp(h->magic, "WUIFCNTR", sizeof(h->magic)) != 0) ||
+                (h->version != CounterRegistry::version) || (h->slotsize < sizeof(CounterRegistry::Slot)) ||
+                (h->capacity > ((_size / h->slotsize) - 1)))
+            {
+                Close();
+                return INCOMPATIBLE;
+            }
+            _stride   = h->slotsize;
+            _capacity = h->capacity;
+            _pid      = pid;
+            return OPENED;
+        }
+
+        void Close() noexcept
+        {
+            #if defined(_WIN32)
+            if (_base != nullptr)
+            {
+                UnmapViewOfFile(_base);
+            }
+            if (_mapping != NULL)
+            {
+                CloseHandle(_mapping);
+                _mapping = NULL;
+            }
+            #else
+            if (_base != nullptr)
+            {
+                munmap(const_cast<unsigned char*>(_base), _size);
+            }
+            #endif
+            _base     = nullptr;
+            _size     = 0;
+            _capacity = 0;
+            _stride   = 0;
+            _pid      = 0;
+        }
+
+        inline bool     opened() const noexcept { return (_base != nullptr); }
+        inline uint64_t pid() const noexcept { return _pid; }
+
+        //counters published so far, more may follow
+        size_t count() const noexcept
+        {
+            if (!opened())
+            {
+                return 0;
+            }
+            const uint32_t count = header()->count.load(std::memory_order_acquire);
+            return (count < _capacity) ? count : _capacity;
+        }
+
+        /*bool CounterReader::Read(size_t index, Entry &entry) const
+        Copies counter index (below count()) and its current value
+
+        Return value
+        bool - false if index is out of range*/
+        bool Read(size_t index, Entry &entry) const noexcept
+        {
+            if (index >= count())
+            {
+                return false;
+            }
+            const CounterRegistry::Slot *slot = reinterpret_cast<const CounterRegistry::Slot*>(_base + ((index + 1) * _stride));
+            memcpy(entry.name, slot->name, sizeof(entry.name));
+            entry.name[sizeof(entry.name) - 1] = '\0';
+            entry.kind  = static_cast<CounterRegistry::Kind>(slot->kind);
+            entry.value = slot->value.load(std::memory_order_relaxed);
+            return true;
+        }
+
+    private:
+        const unsigned char *_base;
+        size_t               _size;
+        uint32_t             _capacity;
+        uint32_t             _stride;
+        uint64_t             _pid;
+        #if defined(_WIN32)
+        HANDLE               _mapping;
+        #endif
+
+        inline const CounterRegistry::Header* header() const noexcept { return reinterpret_cast<const CounterRegistry::Header*>(_base); }
+    };
+}
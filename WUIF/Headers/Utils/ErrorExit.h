@@ -29,6 +29,10 @@ void ErrorExit(_In_ LPTSTR lpszMessage)
     DWORD   numchars = 0;
     LPVOID  lpMsgBuf = nullptr;
     const DWORD   err = GetLastError();
+    #if defined (DEBUGOUTPUTFULL) || defined (DEBUGOUTPUTINFO)
+    //write queued debug messages before the MessageBox, the process may be killed while it is shown
+    WUIF::AsyncLog<TCHAR>::Flush(500);
+    #endif
 
     //if a WUIF error constant add appropriate text for error message
     if (err & 0x20000000L) //application defined error
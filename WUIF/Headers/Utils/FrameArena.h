@@ -0,0 +1,270 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef>     //needed for size_t, max_align_t
+#include <cstdint>     //needed for uintptr_t
+#include <new>         //needed for std::bad_alloc
+#include <type_traits> //needed for std::is_trivially_destructible
+#include "AllocTag.h"
+/*Linear (bump) allocator for data that lives for one frame. Window::Present calls Reset before
+the draw routines run, so anything a draw routine takes from Window::framearena - vertex arrays,
+text buffers, sorted item lists - is valid until the window's next Present and is never freed
+one by one. Nothing is allocated until the first Allocate. When the current chunk is full a new
+chunk at least twice the size of the last one is added; Reset keeps only one chunk, sized to
+hold everything the frame used, so a steady frame ends up allocating from a single chunk without
+touching the heap. Statistics::peak is the most any frame used - apps can pass it to Reserve at
+startup.
+
+A FrameArena is not thread safe - it belongs to the thread presenting the window. Destructors
+are never run, use it for trivially destructible types or with ArenaAllocator (whose containers
+must be destroyed before the next Reset).*/
+
+namespace WUIF {
+
+    class FrameArena
+    {
+    public:
+        static const size_t defaultsize = 64 * 1024;
+
+        struct Statistics
+        {
+            size_t             used;     //bytes allocated this frame, including alignment padding
+            size_t             peak;     //most bytes used in a frame since construction or ResetPeak
+            size_t             capacity; //bytes in all chunks
+            size_t             chunks;   //chunks held
+            unsigned long long frames;   //Reset calls
+            unsigned long long grows;    //chunks added because a frame didn't fit
+        };
+
+        explicit FrameArena(size_t initial = defaultsize) noexcept :
+            _chunks(nullptr), _top(nullptr), _end(nullptr), _initial(initial), _retired(0), _stats() {}
+        ~FrameArena() { Release(); }
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        /*void* FrameArena::Allocate(size_t size, size_t align)
+        Allocates size bytes aligned to align (a power of 2) from the current chunk, adding a chunk
+        if it is full
+
+        Return value
+        void* - the memory, valid until the next Reset. Throws std::bad_alloc on failure*/
+        inline void* Allocate(size_t size, size_t align = alignof(std::max_align_t))
+        {
+            const uintptr_t top = (reinterpret_cast<uintptr_t>(_top) + (align - 1)) & ~static_cast<uintptr_t>(align - 1);
+            const uintptr_t end = reinterpret_cast<uintptr_t>(_end);
+            if ((_top != nullptr) && (top <= end) && (size <= static_cast<size_t>(end - top)))
+            {
+                _top = reinterpret_cast<unsigned char*>(top) + size;
+                return reinterpret_cast<void*>(top);
+            }
+            return Grow(size, align);
+        }
+
+        //count uninitialized elements of T
+        template <class T>
+        inline T* Allocate(size_t count)
+        {
+            static_assert(std::is_trivially_destructible<T>::value, "FrameArena never runs destructors");
+            if (count > (static_cast<size_t>(-1) / sizeof(T)))
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        /*gives back size bytes at p if it is the most recent allocation (e.g. a vector that grew),
+        anything else is reclaimed by Reset*/
+        inline void Free(void *p, size_t size) noexcept
+        {
+            if ((static_cast<unsigned char*>(p) + size) == _top)
+            {
+                _top = static_cast<unsigned char*>(p);
+            }
+        }
+
+        /*void FrameArena::Reset()
+        Starts a new frame - every allocation made since the last Reset is released. If the frame
+        needed more than one chunk they are replaced by a single chunk holding all of it*/
+        void Reset()
+        {
+            const size_t used = Used();
+            if (used > _stats.peak)
+            {
+                _stats.peak = used;
+            }
+            _stats.frames++;
+            if ((_chunks != nullptr) && (_chunks->next != nullptr))
+            {
+                const size_t size = Capacity();
+                Release();
+                AddChunk(size);
+            }
+            else if (_chunks != nullptr)
+            {
+                _top = _chunks->Begin();
+            }
+            _retired = 0;
+        }
+
+        //makes sure the first chunk holds at least size bytes, e.g. Statistics::peak from an earlier run
+        void Reserve(size_t size)
+        {
+            if ((_chunks == nullptr) || (_chunks->size < size))
+            {
+                const bool empty = (Used() == 0);
+                if (empty)
+                {
+                    Release();
+                }
+                AddChunk(size);
+            }
+        }
+
+        //frees every chunk - the next Allocate starts again with the initial size
+        void Release() noexcept
+        {
+            while (_chunks != nullptr)
+            {
+                Chunk *next = _chunks->next;
+                AllocStats::Free(_chunks);
+                _chunks = next;
+            }
+            _top     = nullptr;
+            _end     = nullptr;
+            _retired = 0;
+        }
+
+        inline void ResetPeak() noexcept { _stats.peak = Used(); }
+
+        Statistics GetStatistics() const noexcept
+        {
+            Statistics stats = _stats;
+            stats.used     = Used();
+            stats.capacity = Capacity();
+            stats.chunks   = 0;
+            for (const Chunk *chunk = _chunks; chunk != nullptr; chunk = chunk->next)
+            {
+                stats.chunks++;
+            }
+            if (stats.used > stats.peak)
+            {
+                stats.peak = stats.used;
+            }
+            return stats;
+        }
+
+    private:
+        //chunks are a list, newest first, with the memory following the header
+        struct alignas(std::max_align_t) Chunk
+        {
+            Chunk  *next;
+            size_t  size;
+
+            inline unsigned char* Begin() { return reinterpret_cast<unsigned char*>(this + 1); }
+        };
+
+        Chunk         *_chunks;
+        unsigned char *_top;     //next free byte in _chunks
+        unsigned char *_end;     //end of _chunks
+        size_t         _initial; //size of the first chunk
+        size_t         _retired; //bytes used in chunks other than the newest this frame
+        Statistics     _stats;
+
+        inline size_t Used() const noexcept
+        {
+            return (_chunks != nullptr) ? (_retired + static_cast<size_t>(_top - reinterpret_cast<unsigned char*>(_chunks + 1))) : 0;
+        }
+
+        size_t Capacity() const noexcept
+        {
+            size_t size = 0;
+            for (const Chunk *chunk = _chunks; chunk != nullptr; chunk = chunk->next)
+            {
+                size += chunk->size;
+            }
+            return size;
+        }
+
+        void AddChunk(size_t size)
+        {
+            if (_chunks != nullptr)
+            {
+                _retired += static_cast<size_t>(_top - _chunks->Begin());
+            }
+            Chunk *chunk = static_cast<Chunk*>(AllocStats::Allocate(sizeof(Chunk) + size, AllocTag::Window, __FILE__, __LINE__));
+            chunk->next = _chunks;
+            chunk->size = size;
+            _chunks     = chunk;
+            _top        = chunk->Begin();
+            _end        = _top + size;
+        }
+
+        //adds a chunk at least twice the size of the last one that fits size bytes aligned to align
+        void* Grow(size_t size, size_t align)
+        {
+            if (size > (static_cast<size_t>(-1) / 2))
+            {
+                throw std::bad_alloc();
+            }
+            size_t chunksize = (_chunks != nullptr) ? (_chunks->size * 2) : _initial;
+            if (chunksize < (size + align))
+            {
+                chunksize = size + align;
+            }
+            if (_chunks != nullptr)
+            {
+                _stats.grows++;
+            }
+            AddChunk(chunksize);
+            return Allocate(size, align);
+        }
+    };
+
+    /*ArenaAllocator<T>
+    STL allocator taking memory from a FrameArena - deallocate only gives memory back when it was
+    the arena's last allocation*/
+    template <class T>
+    class ArenaAllocator
+    {
+    public:
+        typedef T value_type;
+
+        explicit ArenaAllocator(FrameArena &arena) noexcept : _arena(&arena) {}
+        template <class U>
+        ArenaAllocator(const ArenaAllocator<U> &other) noexcept : _arena(other._arena) {}
+
+        T* allocate(size_t n)
+        {
+            if (n > (static_cast<size_t>(-1) / sizeof(T)))
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<T*>(_arena->Allocate(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T *p, size_t n) noexcept
+        {
+            _arena->Free(p, n * sizeof(T));
+        }
+
+        template <class U>
+        bool operator==(const ArenaAllocator<U> &rhs) const noexcept { return (_arena == rhs._arena); }
+        template <class U>
+        bool operator!=(const ArenaAllocator<U> &rhs) const noexcept { return (_arena != rhs._arena); }
+
+    private:
+        template <class U> friend class ArenaAllocator;
+        FrameArena *_arena;
+    };
+}
@@ -0,0 +1,147 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for int32_t, uint32_t, uint16_t
+#include <vector>
+#include "AllocTag.h"
+/*Input collected between two frames. A 1000 Hz mouse or a pen sends several moves per frame, so
+Window::_WndProc adds WM_MOUSEMOVE, WM_POINTERUPDATE and raw mouse input to the window's
+InputBatch and Window::Present hands the batch to the window's input routine once per frame.
+
+Coalescing - a sample is merged into the previous one when both come from the same source and
+pointer and the button state didn't change. Relative raw motion is summed, anything else takes
+the newer position. The merged sample keeps the newer time and counts the samples in it. Button
+changes, wheel input and a different source or pointer start a new sample, so the order of
+presses and releases is kept. Handlers that need every sample (ink, gestures) set keepall and
+read all() - coalesced() is kept as well.
+
+This header has no Windows dependencies - InputSample's buttons and flags carry the message's
+own values.*/
+
+namespace WUIF {
+
+    enum class InputSource : uint16_t
+    {
+        Mouse    = 0, //WM_MOUSEMOVE - x, y in client coordinates, buttons are MK_* flags
+        Pointer  = 1, //WM_POINTERUPDATE - x, y in screen coordinates, buttons are POINTER_MESSAGE_FLAG_* flags
+        RawMouse = 2  //WM_INPUT mouse - x, y are RAWMOUSE::lLastX/lLastY, buttons are RI_MOUSE_* transitions
+    };
+
+    struct InputSample
+    {
+        int32_t     x;
+        int32_t     y;
+        uint32_t    time;    //message time in milliseconds
+        uint32_t    buttons; //see InputSource
+        uint32_t    id;      //pointer id (Pointer), RAWMOUSE::usButtonData (RawMouse), otherwise 0
+        uint16_t    flags;   //RAWMOUSE::usFlags (RawMouse), otherwise 0
+        InputSource source;
+        uint32_t    count;   //samples merged into this one
+
+        static const uint16_t absolute = 0x0001; //MOUSE_MOVE_ABSOLUTE - raw x, y are a position, not motion
+    };
+
+    class InputBatch
+    {
+    public:
+        typedef std::vector<InputSample, TaggedAllocator<InputSample, AllocTag::Window>> samples_t;
+
+        explicit InputBatch(bool keepall = false) : _keepall(keepall), _received(0) {}
+
+        //also keep every sample in all()
+        inline void keepall(bool v) noexcept { _keepall = v; }
+        inline bool keepall() const noexcept { return _keepall; }
+
+        /*void InputBatch::Add(const InputSample &sample)
+        Adds a sample, merging it into the last coalesced sample if the coalescing rules allow*/
+        void Add(const InputSample &sample)
+        {
+            _received++;
+            if (_keepall)
+            {
+                _all.push_back(sample);
+                _all.back().count = 1;
+            }
+            if (!_coalesced.empty())
+            {
+                InputSample &last = _coalesced.back();
+                if (Mergeable(last, sample))
+                {
+                    if ((sample.source == InputSource::RawMouse) && !(sample.flags & InputSample::absolute))
+                    {
+                        last.x += sample.x;
+                        last.y += sample.y;
+                    }
+                    else
+                    {
+                        last.x = sample.x;
+                        last.y = sample.y;
+                    }
+                    last.time = sample.time;
+                    last.count++;
+                    return;
+                }
+            }
+            _coalesced.push_back(sample);
+            _coalesced.back().count = 1;
+        }
+
+        //forgets the samples, keeping the memory for the next frame
+        void Clear() noexcept
+        {
+            _coalesced.clear();
+            _all.clear();
+            _received = 0;
+        }
+
+        //frees the memory as well - WindowPool uses it for idle windows
+        void Release()
+        {
+            Clear();
+            samples_t().swap(_coalesced);
+            samples_t().swap(_all);
+        }
+
+        inline const samples_t& coalesced() const noexcept { return _coalesced; }
+        //every sample in order - empty unless keepall is set
+        inline const samples_t& all() const noexcept { return _all; }
+        //samples added since the last Clear
+        inline size_t received() const noexcept { return _received; }
+        inline bool   empty() const noexcept { return (_received == 0); }
+
+        //the coalesced samples - for (const InputSample &s : batch)
+        inline samples_t::const_iterator begin() const noexcept { return _coalesced.begin(); }
+        inline samples_t::const_iterator end() const noexcept { return _coalesced.end(); }
+        inline size_t size() const noexcept { return _coalesced.size(); }
+        inline const InputSample& operator[](size_t i) const { return _coalesced[i]; }
+
+    private:
+        samples_t _coalesced;
+        samples_t _all;
+        bool      _keepall;
+        size_t    _received;
+
+        static inline bool Mergeable(const InputSample &last, const InputSample &sample) noexcept
+        {
+            if ((last.source != sample.source) || (last.id != sample.id) || (last.buttons != sample.buttons) ||
+                (last.flags != sample.flags))
+            {
+                return false;
+            }
+            //raw button transitions and wheel input always get their own sample
+            return (sample.source != InputSource::RawMouse) || (sample.buttons == 0);
+        }
+    };
+}
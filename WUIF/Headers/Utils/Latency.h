@@ -0,0 +1,305 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>  //needed for std::atomic
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uint32_t, uint64_t
+#ifdef _MSC_VER
+#include <intrin.h> //needed for _BitScanReverse
+#endif
+/*Input to photon latency. While Window::MeasureLatency is on, Window::_WndProc tags the first
+input message after a Present with the time the input happened and the tag is held through
+handler dispatch and input batching until the window's next Present, which records the time
+IDXGISwapChain1::Present returned and the present count. On later frames the present count is
+matched with IDXGISwapChain1::GetFrameStatistics to find the vblank (SyncQPCTime) the frame
+reached the screen at. Only the first input of a frame is tagged, so the latencies are those of
+the oldest input each frame shows.
+
+Times are QueryPerformanceCounter ticks and latencies are microseconds. This header has no
+Windows dependencies - the caller passes the counter values and the counter frequency.
+
+Input tags are set on the window's thread, everything else belongs to the thread presenting the
+window (like FrameArena) - read the histograms and Recent from that thread.*/
+
+namespace WUIF {
+
+    /*log-linear histogram of microsecond values - exact below 16 us, then 8 buckets per power of 2
+    (at most 12.5% wide) up to 16.7 seconds*/
+    class LatencyHistogram
+    {
+    public:
+        static const size_t   buckets  = 176;
+        static const uint32_t maxvalue = (uint32_t(1) << 24) - 1; //larger values are counted here
+
+        LatencyHistogram() noexcept { Clear(); }
+
+        void Add(uint32_t us) noexcept
+        {
+            if (us > maxvalue)
+            {
+                us = maxvalue;
+            }
+            _counts[index(us)]++;
+            _count++;
+            _sum += us;
+            _min = (us < _min) ? us : _min;
+            _max = (us > _max) ? us : _max;
+        }
+        void Clear() noexcept
+        {
+            for (size_t i = 0; i < buckets; i++)
+            {
+                _counts[i] = 0;
+            }
+            _count = 0;
+            _sum   = 0;
+            _min   = maxvalue;
+            _max   = 0;
+        }
+
+        inline uint64_t count() const noexcept { return _count; }
+        inline uint32_t min() const noexcept { return (_count != 0) ? _min : 0; }
+        inline uint32_t max() const noexcept { return _max; }
+        inline double   mean() const noexcept { return (_count != 0) ? (static_cast<double>(_sum) / static_cast<double>(_count)) : 0.0; }
+        inline uint32_t bucket(size_t i) const noexcept { return _counts[i]; }
+
+        /*uint32_t LatencyHistogram::percentile(double p) const
+        Value below which p percent (0 - 100) of the values lie, to the bucket's width
+
+        Return value
+        uint32_t - the upper bound of the bucket holding the value (within min() and max()), 0 if
+                   the histogram is empty*/
+        uint32_t percentile(double p) const noexcept
+        {
+            if (_count == 0)
+            {
+                return 0;
+            }
+            uint64_t target = static_cast<uint64_t>((p / 100.0) * static_cast<double>(_count) + 0.999999);
+            target = (target == 0) ? 1 : ((target > _count) ? _count : target);
+            uint64_t seen = 0;
+            for (size_t i = 0; i < buckets; i++)
+            {
+                seen += _counts[i];
+                if (seen >= target)
+                {
+                    const uint32_t v = upper(i);
+                    return (v > _max) ? _max : ((v < _min) ? _min : v);
+                }
+            }
+            return _max;
+        }
+
+        //bucket holding us (us <= maxvalue)
+        static inline size_t index(uint32_t us) noexcept
+        {
+            if (us < 16)
+            {
+                return us;
+            }
+            const unsigned e = msb(us);
+            return 16 + ((e - 4) * 8) + ((us >> (e - 3)) & 7);
+        }
+        //smallest and largest values in bucket i
+        static inline uint32_t lower(size_t i) noexcept
+        {
+            if (i < 16)
+            {
+                return static_cast<uint32_t>(i);
+            }
+            const size_t e = 4 + ((i - 16) / 8);
+            return static_cast<uint32_t>((8 + ((i - 16) & 7)) << (e - 3));
+        }
+        static inline uint32_t upper(size_t i) noexcept
+        {
+            return (i + 1 < buckets) ? (lower(i + 1) - 1) : maxvalue;
+        }
+
+    private:
+        uint32_t _counts[buckets];
+        uint64_t _count;
+        uint64_t _sum;
+        uint32_t _min;
+        uint32_t _max;
+
+        static inline unsigned msb(uint32_t v) noexcept
+        {
+            #ifdef _MSC_VER
+            unsigned long bit;
+            _BitScanReverse(&bit, v);
+            return static_cast<unsigned>(bit);
+            #else
+            return 31u - static_cast<unsigned>(__builtin_clz(v));
+            #endif
+        }
+    };
+
+    class LatencyStats
+    {
+    public:
+        static const size_t   history = 64;         //records kept for Recent
+        static const uint32_t unknown = 0xffffffff; //Record::tovblank of a frame whose vblank wasn't seen
+
+        struct Record
+        {
+            uint32_t presentid; //IDXGISwapChain1::GetLastPresentCount after the frame's Present
+            uint32_t topresent; //input to Present returning, microseconds
+            uint32_t tovblank;  //input to the vblank the frame was shown at, microseconds or unknown
+            uint32_t reserved;
+        };
+
+        LatencyStats() noexcept : _frequency(0), _enabled(false), _pending(0), _next(0), _stored(0), _waiting(0),
+            _frames(0), _missed(0) {}
+
+        LatencyStats(const LatencyStats&) = delete;
+        LatencyStats& operator=(const LatencyStats&) = delete;
+
+        /*void LatencyStats::Enable(long long frequency)
+        Starts measuring with the counter frequency (ticks per second), 0 stops. Clears the
+        histograms and records*/
+        void Enable(long long frequency) noexcept
+        {
+            _enabled.store(false, std::memory_order_relaxed);
+            Clear();
+            _frequency = frequency;
+            _enabled.store(frequency > 0, std::memory_order_release);
+        }
+        inline bool enabled() const noexcept { return _enabled.load(std::memory_order_relaxed); }
+
+        void Clear() noexcept
+        {
+            _pending.store(0, std::memory_order_relaxed);
+            _topresent.Clear();
+            _tovblank.Clear();
+            _next    = 0;
+            _stored  = 0;
+            _waiting = 0;
+            _frames  = 0;
+            _missed  = 0;
+        }
+
+        //window thread - tags an input that happened at time unless an earlier one waits for Present
+        inline void Input(long long time) noexcept
+        {
+            long long expected = 0;
+            _pending.compare_exchange_strong(expected, (time != 0) ? time : 1, std::memory_order_release, std::memory_order_relaxed);
+        }
+        //the input waiting for Present, 0 if none
+        inline long long pending() const noexcept { return _pending.load(std::memory_order_acquire); }
+
+        /*void LatencyStats::Presented(long long input, long long present, uint32_t presentid)
+        Records a Present that showed input (the value pending() returned before the frame was
+        drawn) and releases the tag so the next input is tagged*/
+        void Presented(long long input, long long present, uint32_t presentid) noexcept
+        {
+            if (input == 0)
+            {
+                return;
+            }
+            _pending.compare_exchange_strong(input, 0, std::memory_order_relaxed);
+            if (_waiting == history)
+            {
+                _missed++; //the oldest waiting record is overwritten
+                _waiting--;
+            }
+            const size_t slot = _next;
+            _records[slot].presentid = presentid;
+            _records[slot].topresent = Micro(present - input);
+            _records[slot].tovblank  = unknown;
+            _records[slot].reserved  = 0;
+            _input[slot]             = input;
+            _topresent.Add(_records[slot].topresent);
+            _next = (_next + 1) % history;
+            _stored += (_stored < history) ? 1 : 0;
+            _waiting++;
+            _frames++;
+        }
+
+        /*void LatencyStats::Displayed(uint32_t presentcount, long long synctime)
+        Resolves the waiting records with DXGI_FRAME_STATISTICS - the frame with presentcount was
+        shown at synctime, earlier frames that are still waiting were never seen and stay unknown*/
+        void Displayed(uint32_t presentcount, long long synctime) noexcept
+        {
+            while (_waiting != 0)
+            {
+                const size_t slot = (_next + history - _waiting) % history;
+                const int32_t ahead = static_cast<int32_t>(_records[slot].presentid - presentcount);
+                if (ahead > 0)
+                {
+                    break; //not shown yet
+                }
+                if (ahead == 0)
+                {
+                    _records[slot].tovblank = Micro(synctime - _input[slot]);
+                    _tovblank.Add(_records[slot].tovblank);
+                }
+                else
+                {
+                    _missed++;
+                }
+                _waiting--;
+            }
+        }
+        //records wait for a vblank - call GetFrameStatistics
+        inline bool waiting() const noexcept { return (_waiting != 0); }
+
+        /*size_t LatencyStats::Recent(Record *records, size_t count) const
+        Copies the most recent records, oldest first. Records whose vblank hasn't been seen yet
+        have tovblank set to unknown
+
+        Return value
+        size_t - records copied, at most history*/
+        size_t Recent(Record *records, size_t count) const noexcept
+        {
+            const size_t n = (count < _stored) ? count : _stored;
+            for (size_t i = 0; i < n; i++)
+            {
+                records[i] = _records[(_next + history - n + i) % history];
+            }
+            return n;
+        }
+
+        inline const LatencyHistogram& topresent() const noexcept { return _topresent; }
+        inline const LatencyHistogram& tovblank() const noexcept { return _tovblank; }
+        //frames that showed input
+        inline uint64_t frames() const noexcept { return _frames; }
+        //frames whose vblank was never seen (GetFrameStatistics failed or skipped them)
+        inline uint64_t missed() const noexcept { return _missed; }
+        inline long long frequency() const noexcept { return _frequency; }
+
+    private:
+        long long              _frequency;
+        std::atomic<bool>      _enabled;
+        std::atomic<long long> _pending;
+        Record                 _records[history];
+        long long              _input[history];
+        size_t                 _next;    //slot the next record goes in
+        size_t                 _stored;  //records in _records
+        size_t                 _waiting; //newest records waiting for their vblank
+        uint64_t               _frames;
+        uint64_t               _missed;
+        LatencyHistogram       _topresent;
+        LatencyHistogram       _tovblank;
+
+        inline uint32_t Micro(long long ticks) const noexcept
+        {
+            if ((ticks <= 0) || (_frequency <= 0))
+            {
+                return 0;
+            }
+            const long long us = (ticks / _frequency) * 1000000 + ((ticks % _frequency) * 1000000) / _frequency;
+            return (us >= static_cast<long long>(unknown)) ? (unknown - 1) : static_cast<uint32_t>(us);
+        }
+    };
+}
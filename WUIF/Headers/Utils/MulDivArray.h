@@ -0,0 +1,346 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef>     //needed for size_t
+#include <cstdint>     //needed for int32_t, uint32_t, uint64_t
+#include <type_traits> //needed for std::is_integral
+/*Batch MulDiv - applies the same multiply/divide to an array of 32-bit values, used for scaling
+points and rects between logical and physical (dpi scaled) coordinates. Results are identical to
+the Windows MulDiv function: the 64-bit intermediate is rounded half away from zero and -1 is
+returned for a zero denominator or a result that doesn't fit in an int.
+
+The division by the (constant) denominator is done with a multiply by a fixed-point reciprocal
+(Granlund & Montgomery, "Division by Invariant Integers using Multiplication") four lanes at a time
+with SSE2, or eight with AVX2 when the CPU and OS support it. A lane whose intermediate would not
+fit in 32 bits, and any negative numerator or non-positive denominator, is done by the scalar
+function. This header has no Windows dependencies.*/
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define WUIF_MULDIV_SSE2
+    #include <emmintrin.h> //SSE2
+    #include <immintrin.h> //AVX2
+    #if defined(_MSC_VER)
+        #include <intrin.h> //needed for __cpuidex and _xgetbv
+        #define WUIF_MULDIV_AVX2_TARGET
+    #else
+        #include <cpuid.h>  //needed for __get_cpuid_count
+        #define WUIF_MULDIV_AVX2_TARGET __attribute__((target("avx2")))
+    #endif
+#endif
+
+namespace WUIF {
+
+    /*int MulDivRound(int number, int numerator, int denominator)
+    Scalar reference with the same results as the Windows MulDiv function
+
+    int number      - the value to be multiplied
+    int numerator   - the multiplier
+    int denominator - the divisor
+
+    Return value
+    int - number * numerator / denominator rounded half away from zero, or -1 if denominator is 0
+          or the result doesn't fit in an int*/
+    inline int MulDivRound(int number, int numerator, int denominator)
+    {
+        if (denominator == 0)
+        {
+            return -1;
+        }
+        int64_t d = denominator;
+        int64_t p = static_cast<int64_t>(number) * numerator;
+        if (d < 0)
+        {
+            d = -d;
+            p = -p;
+        }
+        int64_t r = (p >= 0) ? ((p + (d / 2)) / d) : ((p - (d / 2)) / d);
+        if ((r > 2147483647LL) || (r < -2147483647LL))
+        {
+            return -1;
+        }
+        return static_cast<int>(r);
+    }
+
+    namespace MulDivDetail {
+        /*fixed-point reciprocal of the denominator - q = (t + ((n - t) >> sh1)) >> sh2 where
+        t = (n * magic) >> 32 gives n / denominator for any 32 bit unsigned n*/
+        struct Reciprocal
+        {
+            uint32_t numerator;
+            uint32_t half;  //denominator / 2, added before dividing so the result rounds
+            uint32_t limit; //largest |number| for which |number| * numerator + half fits in 32 bits
+            uint32_t magic;
+            uint32_t sh1;
+            uint32_t sh2;
+        };
+
+        inline Reciprocal MakeReciprocal(uint32_t numerator, uint32_t denominator)
+        {
+            Reciprocal rcp;
+            uint32_t l = 0; //ceil(log2(denominator))
+            while ((uint64_t(1) << l) < denominator)
+            {
+                l++;
+            }
+            rcp.numerator = numerator;
+            rcp.half      = denominator / 2;
+            rcp.limit     = (numerator != 0) ? ((0xFFFFFFFFu - rcp.half) / numerator) : 0xFFFFFFFFu;
+            rcp.magic     = static_cast<uint32_t>(((uint64_t(1) << 32) * ((uint64_t(1) << l) - denominator)) /
+                                                  denominator + 1);
+            rcp.sh1       = (l < 1) ? l : 1;
+            rcp.sh2       = (l > 1) ? l - 1 : 0;
+            return rcp;
+        }
+
+        //scalar version of the vector kernel, returns false if the value needs MulDivRound
+        inline bool Apply(const Reciprocal &rcp, int32_t x, int32_t &result)
+        {
+            uint32_t sign = static_cast<uint32_t>(x >> 31);
+            uint32_t ax   = (static_cast<uint32_t>(x) ^ sign) - sign;
+            if (ax > rcp.limit)
+            {
+                return false;
+            }
+            uint32_t n = ax * rcp.numerator + rcp.half;
+            uint32_t t = static_cast<uint32_t>((uint64_t(n) * rcp.magic) >> 32);
+            uint32_t q = (t + ((n - t) >> rcp.sh1)) >> rcp.sh2;
+            result = (q > 0x7FFFFFFFu) ? -1 : static_cast<int32_t>((q ^ sign) - sign);
+            return true;
+        }
+
+        template <typename T>
+        inline void ArrayScalar(const Reciprocal &rcp, const T *in, T *out, size_t count,
+                                int numerator, int denominator)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                int32_t r;
+                if (!Apply(rcp, static_cast<int32_t>(in[i]), r))
+                {
+                    r = MulDivRound(static_cast<int>(in[i]), numerator, denominator);
+                }
+                out[i] = static_cast<T>(r);
+            }
+        }
+
+        #ifdef WUIF_MULDIV_SSE2
+        //four lanes of the reciprocal, overlimit receives a mask of the lanes that need MulDivRound
+        inline __m128i Apply4(const Reciprocal &rcp, __m128i x, int &overlimit)
+        {
+            const __m128i bias  = _mm_set1_epi32(static_cast<int>(0x80000000u));
+            const __m128i mult  = _mm_set1_epi32(static_cast<int>(rcp.numerator));
+            const __m128i magic = _mm_set1_epi32(static_cast<int>(rcp.magic));
+            __m128i sign = _mm_srai_epi32(x, 31);
+            __m128i ax   = _mm_sub_epi32(_mm_xor_si128(x, sign), sign);
+            //SSE2 has no unsigned compare, bias both sides into signed range
+            __m128i over = _mm_cmpgt_epi32(_mm_xor_si128(ax, bias),
+                                           _mm_xor_si128(_mm_set1_epi32(static_cast<int>(rcp.limit)), bias));
+            overlimit = _mm_movemask_ps(_mm_castsi128_ps(over));
+            //n = ax * numerator + half (low 32 bits) - SSE2 has no 32-bit mullo
+            __m128i even = _mm_mul_epu32(ax, mult);
+            __m128i odd  = _mm_mul_epu32(_mm_srli_epi64(ax, 32), mult);
+            __m128i n    = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+            n = _mm_add_epi32(n, _mm_set1_epi32(static_cast<int>(rcp.half)));
+            //t = (n * magic) >> 32
+            even = _mm_mul_epu32(n, magic);
+            odd  = _mm_mul_epu32(_mm_srli_epi64(n, 32), magic);
+            __m128i t = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(3, 1, 3, 1)),
+                                           _mm_shuffle_epi32(odd, _MM_SHUFFLE(3, 1, 3, 1)));
+            __m128i q = _mm_srl_epi32(_mm_add_epi32(t, _mm_srl_epi32(_mm_sub_epi32(n, t),
+                                                                     _mm_cvtsi32_si128(static_cast<int>(rcp.sh1)))),
+                                      _mm_cvtsi32_si128(static_cast<int>(rcp.sh2)));
+            //a quotient of 2^31 or more doesn't fit, MulDiv returns -1
+            __m128i overflow = _mm_srai_epi32(q, 31);
+            __m128i r = _mm_sub_epi32(_mm_xor_si128(q, sign), sign);
+            return _mm_or_si128(r, overflow);
+        }
+
+        template <typename T>
+        inline void ArraySSE2(const Reciprocal &rcp, const T *in, T *out, size_t count,
+                              int numerator, int denominator)
+        {
+            size_t i = 0;
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                int overlimit;
+                __m128i r = Apply4(rcp, x, overlimit);
+                if (overlimit)
+                {
+                    //in and out may be the same array, keep the inputs before storing
+                    alignas(16) int32_t xs[4];
+                    _mm_store_si128(reinterpret_cast<__m128i*>(xs), x);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+                    for (int j = 0; j < 4; j++)
+                    {
+                        if (overlimit & (1 << j))
+                        {
+                            out[i + j] = static_cast<T>(MulDivRound(xs[j], numerator, denominator));
+                        }
+                    }
+                }
+                else
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), r);
+                }
+            }
+            ArrayScalar(rcp, in + i, out + i, count - i, numerator, denominator);
+        }
+
+        //eight lanes with AVX2 - same steps as Apply4 but AVX2 has mullo and an unsigned-safe blend
+        WUIF_MULDIV_AVX2_TARGET
+        inline __m256i Apply8(const Reciprocal &rcp, __m256i x, int &overlimit)
+        {
+            const __m256i bias  = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+            const __m256i magic = _mm256_set1_epi32(static_cast<int>(rcp.magic));
+            __m256i sign = _mm256_srai_epi32(x, 31);
+            __m256i ax   = _mm256_sub_epi32(_mm256_xor_si256(x, sign), sign);
+            __m256i over = _mm256_cmpgt_epi32(_mm256_xor_si256(ax, bias),
+                                              _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(rcp.limit)), bias));
+            overlimit = _mm256_movemask_ps(_mm256_castsi256_ps(over));
+            __m256i n = _mm256_add_epi32(_mm256_mullo_epi32(ax, _mm256_set1_epi32(static_cast<int>(rcp.numerator))),
+                                         _mm256_set1_epi32(static_cast<int>(rcp.half)));
+            __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(n, magic), 32);
+            __m256i odd  = _mm256_mul_epu32(_mm256_srli_epi64(n, 32), magic);
+            __m256i t    = _mm256_blend_epi32(even, odd, 0xAA);
+            __m256i q    = _mm256_srl_epi32(_mm256_add_epi32(t, _mm256_srl_epi32(_mm256_sub_epi32(n, t),
+                                                                   _mm_cvtsi32_si128(static_cast<int>(rcp.sh1)))),
+                                            _mm_cvtsi32_si128(static_cast<int>(rcp.sh2)));
+            __m256i overflow = _mm256_srai_epi32(q, 31);
+            __m256i r = _mm256_sub_epi32(_mm256_xor_si256(q, sign), sign);
+            return _mm256_or_si256(r, overflow);
+        }
+
+        template <typename T>
+        WUIF_MULDIV_AVX2_TARGET
+        inline void ArrayAVX2(const Reciprocal &rcp, const T *in, T *out, size_t count,
+                              int numerator, int denominator)
+        {
+            size_t i = 0;
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+                int overlimit;
+                __m256i r = Apply8(rcp, x, overlimit);
+                if (overlimit)
+                {
+                    alignas(32) int32_t xs[8];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(xs), x);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+                    for (int j = 0; j < 8; j++)
+                    {
+                        if (overlimit & (1 << j))
+                        {
+                            out[i + j] = static_cast<T>(MulDivRound(xs[j], numerator, denominator));
+                        }
+                    }
+                }
+                else
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), r);
+                }
+            }
+            //avoid AVX-SSE transition penalties before the SSE2 code handles the remainder
+            _mm256_zeroupper();
+            ArraySSE2(rcp, in + i, out + i, count - i, numerator, denominator);
+        }
+
+        //true if the CPU supports AVX2 and the OS saves the YMM registers
+        inline bool DetectAVX2()
+        {
+            #if defined(_MSC_VER)
+            int info[4];
+            __cpuidex(info, 1, 0);
+            bool osxsave = ((info[2] & (1 << 27)) != 0);
+            bool avx     = ((info[2] & (1 << 28)) != 0);
+            if (!osxsave || !avx)
+            {
+                return false;
+            }
+            if ((_xgetbv(0) & 0x6) != 0x6)
+            {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return ((info[1] & (1 << 5)) != 0);
+            #else
+            unsigned int a, b, c, d;
+            if (!__get_cpuid_count(1, 0, &a, &b, &c, &d))
+            {
+                return false;
+            }
+            if (!(c & (1u << 27)) || !(c & (1u << 28)))
+            {
+                return false;
+            }
+            unsigned int xcr0lo, xcr0hi;
+            __asm__ volatile("xgetbv" : "=a"(xcr0lo), "=d"(xcr0hi) : "c"(0));
+            if ((xcr0lo & 0x6) != 0x6)
+            {
+                return false;
+            }
+            if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+            {
+                return false;
+            }
+            return ((b & (1u << 5)) != 0);
+            #endif
+        }
+
+        inline bool HasAVX2()
+        {
+            static const bool avx2 = DetectAVX2();
+            return avx2;
+        }
+        #endif //WUIF_MULDIV_SSE2
+    }
+
+    /*void MulDivArray(const T *in, T *out, size_t count, int numerator, int denominator)
+    Computes out[i] = MulDiv(in[i], numerator, denominator) for every element. in and out may be
+    the same array.
+
+    const T *in     - array of 32-bit integers (int, LONG, the members of POINT or RECT)
+    T *out          - receives the results
+    size_t count    - number of elements
+    int numerator   - the multiplier
+    int denominator - the divisor*/
+    template <typename T>
+    inline void MulDivArray(const T *in, T *out, size_t count, int numerator, int denominator)
+    {
+        static_assert(std::is_integral<T>::value && (sizeof(T) == 4), "MulDivArray requires a 32-bit integer type");
+        if ((numerator < 0) || (denominator <= 0))
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                out[i] = static_cast<T>(MulDivRound(static_cast<int>(in[i]), numerator, denominator));
+            }
+            return;
+        }
+        const MulDivDetail::Reciprocal rcp = MulDivDetail::MakeReciprocal(static_cast<uint32_t>(numerator),
+                                                                           static_cast<uint32_t>(denominator));
+        #ifdef WUIF_MULDIV_SSE2
+        if ((count >= 16) && MulDivDetail::HasAVX2())
+        {
+            MulDivDetail::ArrayAVX2(rcp, in, out, count, numerator, denominator);
+        }
+        else
+        {
+            MulDivDetail::ArraySSE2(rcp, in, out, count, numerator, denominator);
+        }
+        #else
+        MulDivDetail::ArrayScalar(rcp, in, out, count, numerator, denominator);
+        #endif
+    }
+}
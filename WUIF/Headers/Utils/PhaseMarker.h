@@ -0,0 +1,83 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>  //needed for std::atomic_signal_fence
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uint32_t
+/*Phase markers for the Profiler. A thread the profiler samples owns a PhaseSlot holding the
+names of the phases it is in (outermost first), and every stack sampled from the thread is
+filed under them - "present;draw;shadow pass" - so a flame graph splits the time by WUIF phase
+(dispatch, input, draw, present, resize) and by the names apps give their draw passes:
+
+    WUIF_PHASE("shadow pass"); - phase from here to the end of the scope
+
+Names must be string literals, only the pointer is stored. On a thread without a slot a marker
+costs a thread local load, otherwise two plain stores. The profiler reads the slot while the
+thread is suspended, so the stores only need to be ordered against the thread itself
+(atomic_signal_fence). This header has no Windows dependencies.*/
+
+namespace WUIF {
+
+    struct PhaseSlot
+    {
+        static const uint32_t maxdepth = 8; //deeper phases are counted but not named
+
+        const char *names[maxdepth];
+        uint32_t    depth;
+    };
+
+    class PhaseMarker
+    {
+    public:
+        explicit PhaseMarker(const char *name) noexcept : _slot(Slot())
+        {
+            if (_slot != nullptr)
+            {
+                const uint32_t depth = _slot->depth;
+                if (depth < PhaseSlot::maxdepth)
+                {
+                    _slot->names[depth] = name;
+                }
+                std::atomic_signal_fence(std::memory_order_release);
+                _slot->depth = depth + 1;
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+            }
+        }
+        ~PhaseMarker()
+        {
+            if (_slot != nullptr)
+            {
+                std::atomic_signal_fence(std::memory_order_seq_cst);
+                _slot->depth--;
+            }
+        }
+
+        PhaseMarker(const PhaseMarker&) = delete;
+        PhaseMarker& operator=(const PhaseMarker&) = delete;
+
+        //the calling thread's slot, nullptr if the thread isn't profiled
+        static inline PhaseSlot*& Slot() noexcept
+        {
+            static thread_local PhaseSlot *slot = nullptr;
+            return slot;
+        }
+
+    private:
+        PhaseSlot *_slot;
+    };
+}
+
+#define WUIF_PHASE_CONCAT2(a, b) a##b
+#define WUIF_PHASE_CONCAT(a, b)  WUIF_PHASE_CONCAT2(a, b)
+#define WUIF_PHASE(name)         ::WUIF::PhaseMarker WUIF_PHASE_CONCAT(_phase, __LINE__)(name)
@@ -15,37 +15,11 @@ limitations under the License.*/
 #include <ShellScalingApi.h> //needed for PROCESS_DPI_AWARENESS, PROCESS_PER_MONITOR_DPI_AWARE, MONITOR_DPI_TYPE, MDT_EFFECTIVE_DPI
 #include "WUIF_Const.h"
 #include "WUIF_Error.h"
-#include "Utils/dllhelper.h"
 #include "Application/Application.h"
+#include "Application/DPIAPI.h"
 
 namespace
 {
-    //DPI Awareness typedefs needed since we are compiling for Win7 and up compatibility they are defined out in the .H files
-                                     STDAPI GetProcessDpiAwareness             (HANDLE, PROCESS_DPI_AWARENESS*);
-                                     STDAPI SetProcessDpiAwareness             (PROCESS_DPI_AWARENESS);
-    WINUSERAPI BOOL                  WINAPI IsValidDpiAwarenessContext         (DPI_AWARENESS_CONTEXT);
-    WINUSERAPI BOOL                  WINAPI SetProcessDpiAwarenessContext      (DPI_AWARENESS_CONTEXT);
-    WINUSERAPI DPI_AWARENESS         WINAPI GetAwarenessFromDpiAwarenessContext(DPI_AWARENESS_CONTEXT);
-    WINUSERAPI BOOL                  WINAPI IsProcessDPIAware                  (VOID);
-    WINUSERAPI BOOL                  WINAPI SetProcessDPIAware                 (VOID);
-    WINUSERAPI DPI_AWARENESS_CONTEXT WINAPI GetThreadDpiAwarenessContext       (VOID);
-    //WINUSERAPI BOOL                  WINAPI AreDpiAwarenessContextsEqual(DPI_AWARENESS_CONTEXT value, DPI_AWARENESS_CONTEXT value2);
-
-    class HighDPIAPI
-    {
-        WUIF::ModuleHelper _user32dll{ TEXT("user32.dll"), WUIF::OSVersion::WIN7 };
-        WUIF::DllHelper _shcoredll{ TEXT("shcore.dll"), WUIF::OSVersion::WIN8 }; //not available in Windows 7
-    public:
-        decltype(SetProcessDpiAwareness)              *SetProcessDpiAwareness              = _shcoredll.assign("SetProcessDpiAwareness", WUIF::OSVersion::WIN8_1);
-        decltype(GetProcessDpiAwareness)              *GetProcessDpiAwareness              = _shcoredll.assign("GetProcessDpiAwareness", WUIF::OSVersion::WIN8_1);
-        decltype(IsProcessDPIAware)                   *IsProcessDPIAware                   = _user32dll.assign("IsProcessDPIAware", WUIF::OSVersion::WIN7);
-        decltype(SetProcessDPIAware)                  *SetProcessDPIAware                  = _user32dll.assign("SetProcessDPIAware", WUIF::OSVersion::WIN7);
-        decltype(IsValidDpiAwarenessContext)          *IsValidDpiAwarenessContext          = _user32dll.assign("IsValidDpiAwarenessContext", WUIF::OSVersion::WIN10_1607);
-        decltype(GetThreadDpiAwarenessContext)        *GetThreadDpiAwarenessContext        = _user32dll.assign("GetThreadDpiAwarenessContext", WUIF::OSVersion::WIN10_1607);
-        decltype(SetProcessDpiAwarenessContext)       *SetProcessDpiAwarenessContext       = _user32dll.assign("SetProcessDpiAwarenessContext", WUIF::OSVersion::WIN10_1703);
-        decltype(GetAwarenessFromDpiAwarenessContext) *GetAwarenessFromDpiAwarenessContext = _user32dll.assign("GetAwarenessFromDpiAwarenessContext", WUIF::OSVersion::WIN10_1607);
-    };
-
     /*void SetDPIAwareness()
         Sets the DPI Awareness by the proper method for the OS Version. Attempts to set the highest dpi awareness Sets
         App::processdpiawareness and App::processdpiawarenesscontext (will be nullptr if not Win10 or supported). Using a manifest to set
@@ -56,7 +30,7 @@ namespace
         //internal pointers for App::processdpiawareness and App::processdpiawarenesscontext
         PROCESS_DPI_AWARENESS _processdpiawareness = PROCESS_DPI_UNAWARE;
         DPI_AWARENESS_CONTEXT _processdpiawarenesscontext = DPI_AWARENESS_CONTEXT_UNAWARE;
-        HighDPIAPI highDPIAPI;
+        WUIF::HighDPIAPI highDPIAPI;
         //get the current process wide DPI Awareness
         if (WUIF::App::winversion >= WUIF::OSVersion::WIN8_1)
         {
@@ -165,6 +139,22 @@ namespace
                 }
             }
         }
+        /*build the process-wide DPI API table while _processdpiawareness and
+        _processdpiawarenesscontext are still in scope. The table keeps its own copies of the values,
+        so point App::processdpiawareness and App::processdpiawarenesscontext at those copies as the
+        local variables are about to go out of scope*/
+        const WUIF::DPIAPI &dpiAPI = WUIF::DPIAPI::Initialize(WUIF::App::processdpiawareness,
+                                                              WUIF::App::processdpiawarenesscontext);
+        if (dpiAPI.hasprocessdpiawareness)
+        {
+            const void *val = &dpiAPI.processdpiawareness;
+            WUIF::changeconst(&const_cast<PROCESS_DPI_AWARENESS*&>(WUIF::App::processdpiawareness), &val);
+        }
+        if (dpiAPI.hasprocessdpiawarenesscontext)
+        {
+            const void *val = &dpiAPI.processdpiawarenesscontext;
+            WUIF::changeconst(&const_cast<DPI_AWARENESS_CONTEXT*&>(WUIF::App::processdpiawarenesscontext), &val);
+        }
         PrintExit(TEXT("::SetDPIAwareness"));
         return;
     }
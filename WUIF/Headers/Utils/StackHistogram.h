@@ -0,0 +1,260 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uint32_t, uint64_t, uintptr_t
+#include <string>  //needed for std::string
+#include <vector>  //needed for std::vector
+#include "AllocTag.h"
+/*Call stack histogram for the Profiler. Every sample is a thread, the phase names the thread was
+in (PhaseMarker) and its frames, innermost first; identical samples share one entry and a count.
+All memory is taken by the constructor - maxstacks distinct stacks and their frames - so Add never
+allocates and memory stays bounded however long the profiler runs. Samples that don't fit are
+counted as dropped.
+
+Folded writes the histogram in the folded stack format flame graph tools read (flamegraph.pl,
+speedscope, inferno), one stack per line, outermost first:
+
+    UI;present;draw;shadow pass;App.exe!DrawShadows;App.exe!Blur 42
+
+This header has no Windows dependencies - thread and frame names come from the caller.*/
+
+namespace WUIF {
+
+    class StackHistogram
+    {
+    public:
+        struct Statistics
+        {
+            uint64_t samples;  //samples added, including dropped ones
+            uint64_t dropped;  //samples that didn't fit
+            size_t   stacks;   //distinct stacks
+            size_t   capacity; //distinct stacks that fit
+            size_t   words;    //phase and frame words used
+        };
+
+        /*StackHistogram(size_t maxstacks, size_t maxwords)
+        size_t maxstacks - distinct stacks kept
+        size_t maxwords  - phase names and frames kept over all stacks, 0 for 32 per stack*/
+        explicit StackHistogram(size_t maxstacks = 4096, size_t maxwords = 0) :
+            _maxstacks((maxstacks != 0) ? maxstacks : 1), _stacks(0), _used(0), _samples(0), _dropped(0)
+        {
+            size_t slots = 16;
+            while (slots < _maxstacks * 2)
+            {
+                slots <<= 1;
+            }
+            _table.resize(slots);
+            _words.resize((maxwords != 0) ? maxwords : (_maxstacks * 32));
+        }
+
+        /*bool StackHistogram::Add(uint32_t thread, const char *const *phases, size_t nphases, const void *const *frames, size_t nframes)
+        Counts one sample - frames are innermost first
+
+        Return value
+        bool - false if the sample was dropped (the histogram is full)*/
+        bool Add(uint32_t thread, const char *const *phases, size_t nphases, const void *const *frames, size_t nframes) noexcept
+        {
+            _samples++;
+            const size_t words = nphases + nframes;
+            if ((nphases > 0xffff) || (nframes > 0xffff))
+            {
+                _dropped++;
+                return false;
+            }
+            uint64_t hash = Mix(0x84222325cbf29ce4ULL, (static_cast<uint64_t>(thread) << 32) | (nphases << 16) | nframes);
+            for (size_t i = 0; i < nphases; i++)
+            {
+                hash = Mix(hash, reinterpret_cast<uintptr_t>(phases[i]));
+            }
+            for (size_t i = 0; i < nframes; i++)
+            {
+                hash = Mix(hash, reinterpret_cast<uintptr_t>(frames[i]));
+            }
+            hash |= 1; //0 marks an empty slot
+            const size_t mask = _table.size() - 1;
+            for (size_t slot = static_cast<size_t>(hash) & mask;; slot = (slot + 1) & mask)
+            {
+                Entry &entry = _table[slot];
+                if (entry.hash == 0)
+                {
+                    if ((_stacks == _maxstacks) || (words > (_words.size() - _used)))
+                    {
+                        _dropped++;
+                        return false;
+                    }
+                    entry.hash    = hash;
+                    entry.count   = 1;
+                    entry.offset  = _used;
+                    entry.thread  = thread;
+                    entry.nphases = static_cast<uint16_t>(nphases);
+                    entry.nframes = static_cast<uint16_t>(nframes);
+                    for (size_t i = 0; i < nphases; i++)
+                    {
+                        _words[_used++] = reinterpret_cast<uintptr_t>(phases[i]);
+                    }
+                    for (size_t i = 0; i < nframes; i++)
+                    {
+                        _words[_used++] = reinterpret_cast<uintptr_t>(frames[i]);
+                    }
+                    _stacks++;
+                    return true;
+                }
+                if ((entry.hash == hash) && (entry.thread == thread) && (entry.nphases == nphases) &&
+                    (entry.nframes == nframes) && Same(entry, phases, frames))
+                {
+                    entry.count++;
+                    return true;
+                }
+            }
+        }
+
+        //forgets every sample, keeping the memory
+        void Clear() noexcept
+        {
+            for (Entry &entry : _table)
+            {
+                entry = Entry();
+            }
+            _stacks  = 0;
+            _used    = 0;
+            _samples = 0;
+            _dropped = 0;
+        }
+
+        Statistics statistics() const noexcept
+        {
+            Statistics stats;
+            stats.samples  = _samples;
+            stats.dropped  = _dropped;
+            stats.stacks   = _stacks;
+            stats.capacity = _maxstacks;
+            stats.words    = _used;
+            return stats;
+        }
+
+        /*void StackHistogram::Folded(std::string &out, ThreadName threadname, FrameName framename) const
+        Appends the histogram in folded stack format. Dropped samples are a "[dropped]" stack
+
+        ThreadName threadname - void(std::string &out, uint32_t thread), appends the thread's name
+        FrameName framename   - void(std::string &out, const void *frame), appends the frame's name*/
+        template <class ThreadName, class FrameName>
+        void Folded(std::string &out, ThreadName threadname, FrameName framename) const
+        {
+            char count[24];
+            for (const Entry &entry : _table)
+            {
+                if (entry.hash == 0)
+                {
+                    continue;
+                }
+                const uintptr_t *words = &_words[entry.offset];
+                size_t start = out.size();
+                threadname(out, entry.thread);
+                Clean(out, start);
+                for (size_t i = 0; i < entry.nphases; i++)
+                {
+                    out += ';';
+                    start = out.size();
+                    out += reinterpret_cast<const char*>(words[i]);
+                    Clean(out, start);
+                }
+                for (size_t i = entry.nframes; i-- > 0;)
+                {
+                    out += ';';
+                    start = out.size();
+                    framename(out, reinterpret_cast<const void*>(words[entry.nphases + i]));
+                    Clean(out, start);
+                }
+                out += ' ';
+                out += Decimal(count, entry.count);
+                out += '\n';
+            }
+            if (_dropped != 0)
+            {
+                out += "[dropped] ";
+                out += Decimal(count, _dropped);
+                out += '\n';
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            uint64_t hash;    //0 - empty
+            uint64_t count;
+            size_t   offset;  //first word in _words
+            uint32_t thread;
+            uint16_t nphases;
+            uint16_t nframes;
+
+            Entry() noexcept : hash(0), count(0), offset(0), thread(0), nphases(0), nframes(0) {}
+        };
+
+        std::vector<Entry, TaggedAllocator<Entry, AllocTag::Logging>>         _table;
+        std::vector<uintptr_t, TaggedAllocator<uintptr_t, AllocTag::Logging>> _words;
+        size_t   _maxstacks;
+        size_t   _stacks;
+        size_t   _used;
+        uint64_t _samples;
+        uint64_t _dropped;
+
+        static inline uint64_t Mix(uint64_t hash, uint64_t word) noexcept
+        {
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+            return hash ^ (hash >> 29);
+        }
+        inline bool Same(const Entry &entry, const char *const *phases, const void *const *frames) const noexcept
+        {
+            const uintptr_t *words = &_words[entry.offset];
+            for (size_t i = 0; i < entry.nphases; i++)
+            {
+                if (words[i] != reinterpret_cast<uintptr_t>(phases[i]))
+                {
+                    return false;
+                }
+            }
+            for (size_t i = 0; i < entry.nframes; i++)
+            {
+                if (words[entry.nphases + i] != reinterpret_cast<uintptr_t>(frames[i]))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+        //';' separates frames and the line ends the stack - neither may appear in a name
+        static inline void Clean(std::string &out, size_t start)
+        {
+            for (size_t i = start; i < out.size(); i++)
+            {
+                if ((out[i] == ';') || (out[i] == '\n') || (out[i] == '\r'))
+                {
+                    out[i] = '_';
+                }
+            }
+        }
+        static inline const char* Decimal(char (&buffer)[24], uint64_t value) noexcept
+        {
+            char *p = buffer + sizeof(buffer) - 1;
+            *p = '\0';
+            do
+            {
+                *--p = static_cast<char>('0' + (value % 10));
+                value /= 10;
+            } while (value != 0);
+            return p;
+        }
+    };
+}
@@ -0,0 +1,256 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>  //needed for std::atomic
+#include <chrono>  //needed for std::chrono::steady_clock
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uint32_t, uint64_t
+/*Heartbeat and stall detection for the Watchdog. The UI thread calls Beat every message loop
+iteration (and _WndProc on every message, so nested modal loops keep beating) and marks what it
+is running - a message handler, an input or draw routine, Present - with WatchScope. The watchdog
+thread calls Poll at the times Next returns. When no beat has been seen for threshold the
+UI thread is stalled: Poll returns Stalled, then Sample every interval (at most maxsamples times)
+and Recovered once beats resume.
+
+The detector is unarmed until the first Beat and again after Disarm, so the time before the
+message loop starts and after it ends never counts as a stall.
+
+Clock is any type with now(), time_point and duration like std::chrono::steady_clock - tests pass
+a fake clock. This header has no Windows dependencies.*/
+
+namespace WUIF {
+
+    //what the UI thread is running - read by the watchdog while the UI thread is stalled
+    struct WatchActivity
+    {
+        enum Kind : uint32_t
+        {
+            Idle         = 0, //message loop
+            Message      = 1, //_WndProc - handler is the WndProc_map or GWndProc_map handler, nullptr for the built in handling
+            InputRoutine = 2, //Window::BatchInput routine
+            DrawRoutine  = 3, //one of Window::drawroutines
+            Present      = 4  //Window::Present outside of the routines
+        };
+
+        uint32_t    kind;
+        uint32_t    message; //message number (Message)
+        const void *handler; //function being called, nullptr if none
+        const void *target;  //HWND (Message) or Window* the activity is for
+    };
+
+    template <class Clock = std::chrono::steady_clock>
+    class StallDetector
+    {
+    public:
+        typedef typename Clock::time_point time_point;
+        typedef typename Clock::duration   duration;
+
+        enum class Event
+        {
+            None,      //nothing to do
+            Stalled,   //a stall began - take the first sample
+            Sample,    //the stall continues - take another sample
+            Recovered  //beats resumed, lastduration() is how long the stall lasted
+        };
+
+        StallDetector() noexcept : StallDetector(std::chrono::milliseconds(1000), std::chrono::milliseconds(100), 20) {}
+        StallDetector(duration threshold, duration interval, size_t maxsamples) noexcept :
+            _beat(0), _kind(WatchActivity::Idle), _message(0), _handler(nullptr), _target(nullptr),
+            _threshold(threshold), _interval(interval), _maxsamples(maxsamples), _lastbeat(0), _lastchange(),
+            _stalled(false), _stallbegan(), _nextsample(), _samples(0), _stalls(0), _lastduration(duration::zero()) {}
+
+        StallDetector(const StallDetector&) = delete;
+        StallDetector& operator=(const StallDetector&) = delete;
+
+        //watchdog settings - call before the watchdog thread starts polling
+        void Configure(duration threshold, duration interval, size_t maxsamples) noexcept
+        {
+            _threshold  = threshold;
+            _interval   = interval;
+            _maxsamples = maxsamples;
+        }
+
+        /*UI thread*/
+
+        //the UI thread is alive - a relaxed load and a release store, only the UI thread writes _beat
+        inline void Beat() noexcept
+        {
+            const uint64_t beat = _beat.load(std::memory_order_relaxed) + 1;
+            _beat.store((beat != 0) ? beat : 1, std::memory_order_release);
+        }
+        //stops stall detection until the next Beat
+        inline void Disarm() noexcept { _beat.store(0, std::memory_order_release); }
+
+        //sets the activity and returns the previous one for Leave
+        inline WatchActivity Enter(const WatchActivity &activity) noexcept
+        {
+            const WatchActivity previous = activity_();
+            Set(activity);
+            return previous;
+        }
+        inline void Leave(const WatchActivity &previous) noexcept { Set(previous); }
+        //changes the running function (and kind) within the current activity
+        inline void Handler(uint32_t kind, const void *handler) noexcept
+        {
+            _kind.store(kind, std::memory_order_relaxed);
+            _handler.store(handler, std::memory_order_relaxed);
+        }
+
+        /*watchdog thread*/
+
+        //the UI thread's activity - consistent while the UI thread is stalled
+        inline WatchActivity activity() const noexcept { return activity_(); }
+
+        /*Event StallDetector::Poll(time_point now)
+        Checks the heartbeat at now and advances the stall state
+
+        Return value
+        Event - what the watchdog should do*/
+        Event Poll(time_point now) noexcept
+        {
+            const uint64_t beat = _beat.load(std::memory_order_acquire);
+            if ((beat != _lastbeat) || (beat == 0))
+            {
+                _lastbeat   = beat;
+                _lastchange = now;
+                if (_stalled)
+                {
+                    _stalled      = false;
+                    _lastduration = now - _stallbegan;
+                    return Event::Recovered;
+                }
+                return Event::None;
+            }
+            if (!_stalled)
+            {
+                if ((now - _lastchange) < _threshold)
+                {
+                    return Event::None;
+                }
+                _stalled    = true;
+                _stallbegan = _lastchange;
+                _samples    = 0;
+                _stalls++;
+                Sampled(now);
+                return Event::Stalled;
+            }
+            if ((_samples < _maxsamples) && (now >= _nextsample))
+            {
+                Sampled(now);
+                return Event::Sample;
+            }
+            return Event::None;
+        }
+
+        /*time_point StallDetector::Next(time_point now) const
+        When the watchdog should call Poll again - a quarter of the threshold while the UI thread is
+        beating (so a stall is found within 1.25 thresholds), the next sample time while it is
+        stalled*/
+        time_point Next(time_point now) const noexcept
+        {
+            const duration period = Period();
+            if (_stalled && (_samples < _maxsamples) && (_nextsample < now + period))
+            {
+                return _nextsample;
+            }
+            return now + period;
+        }
+
+        inline bool       stalled() const noexcept { return _stalled; }
+        //last beat seen before the stall (the stall began at most Next's period later)
+        inline time_point stallbegan() const noexcept { return _stallbegan; }
+        inline size_t     samples() const noexcept { return _samples; }
+        //stalls found since construction
+        inline uint64_t   stalls() const noexcept { return _stalls; }
+        //length of the last stall that ended
+        inline duration   lastduration() const noexcept { return _lastduration; }
+        inline duration   threshold() const noexcept { return _threshold; }
+        inline duration   interval() const noexcept { return _interval; }
+
+    private:
+        //UI thread
+        std::atomic<uint64_t>    _beat;
+        std::atomic<uint32_t>    _kind;
+        std::atomic<uint32_t>    _message;
+        std::atomic<const void*> _handler;
+        std::atomic<const void*> _target;
+        //watchdog thread
+        duration   _threshold;
+        duration   _interval;
+        size_t     _maxsamples;
+        uint64_t   _lastbeat;
+        time_point _lastchange;
+        bool       _stalled;
+        time_point _stallbegan;
+        time_point _nextsample;
+        size_t     _samples;
+        uint64_t   _stalls;
+        duration   _lastduration;
+
+        inline void Set(const WatchActivity &activity) noexcept
+        {
+            _kind.store(activity.kind, std::memory_order_relaxed);
+            _message.store(activity.message, std::memory_order_relaxed);
+            _handler.store(activity.handler, std::memory_order_relaxed);
+            _target.store(activity.target, std::memory_order_relaxed);
+        }
+        inline WatchActivity activity_() const noexcept
+        {
+            WatchActivity activity;
+            activity.kind    = _kind.load(std::memory_order_relaxed);
+            activity.message = _message.load(std::memory_order_relaxed);
+            activity.handler = _handler.load(std::memory_order_relaxed);
+            activity.target  = _target.load(std::memory_order_relaxed);
+            return activity;
+        }
+        inline duration Period() const noexcept
+        {
+            const duration period = _threshold / 4;
+            return (period > duration::zero()) ? period : duration(1);
+        }
+        inline void Sampled(time_point now) noexcept
+        {
+            _samples++;
+            _nextsample += _interval;
+            if ((_samples == 1) || (_nextsample <= now))
+            {
+                _nextsample = now + _interval; //don't catch up on samples missed while the watchdog was late
+            }
+        }
+    };
+
+    //sets the UI thread's activity for a scope and restores the previous one
+    template <class Detector>
+    class WatchScope
+    {
+    public:
+        WatchScope(Detector &detector, uint32_t kind, uint32_t message, const void *handler, const void *target) noexcept :
+            _detector(detector)
+        {
+            const WatchActivity activity = { kind, message, handler, target };
+            _previous = _detector.Enter(activity);
+        }
+        ~WatchScope() { _detector.Leave(_previous); }
+
+        WatchScope(const WatchScope&) = delete;
+        WatchScope& operator=(const WatchScope&) = delete;
+
+        //the function now being called
+        inline void Handler(uint32_t kind, const void *handler) noexcept { _detector.Handler(kind, handler); }
+
+    private:
+        Detector     &_detector;
+        WatchActivity _previous;
+    };
+}
@@ -0,0 +1,141 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstdint> //needed for int32_t, uint32_t, uintptr_t
+#include <cstring> //needed for memcpy and memset
+#include "ThunkSlab.h"
+/*Thunk code generators for ThunkSlab. A thunk binds an object pointer to a callback: the caller
+calls the thunk with the callback's other arguments and the thunk adds the object stored in its
+ThunkSlab::Data and jumps to the target stored there, so the callback sees the object as one of its
+parameters. Each back end is a ThunkSlab::EmitFn:
+
+    Win64<Arg>  - Microsoft x64, the object is passed as parameter Arg (0-based). The caller
+                  reserves register home space and the stack slots of the parameters it passes,
+                  so Arg must be a parameter the caller does not use (e.g. 4 for a WNDPROC, whose
+                  fifth parameter is at [rsp+28h]).
+    SysV<Arg>   - System V x86-64 (Linux, macOS), the object is passed as parameter Arg, one of the
+                  six register parameters (rdi, rsi, rdx, rcx, r8, r9) the caller does not use.
+    X86First    - x86 __stdcall, the object is inserted as the first parameter and the caller's
+                  parameters move up by one. The callee pops one more parameter than the caller
+                  pushed, which balances the extra return address the thunk pushes.
+
+Native<Arg> is the back end for the code being compiled (X86First ignores Arg). The generated code
+is at most 18 bytes and only reads Data, see ThunkSlab.h. This header has no Windows dependencies.*/
+
+namespace WUIF {
+
+    namespace ThunkEmitter {
+
+        namespace Detail {
+            //rel32 from the end of an instruction at next to target
+            inline void Rel32(unsigned char *&p, const void *target)
+            {
+                int32_t rel = static_cast<int32_t>(reinterpret_cast<const unsigned char*>(target) - (p + 4));
+                memcpy(p, &rel, sizeof(rel));
+                p += sizeof(rel);
+            }
+
+            inline void Abs32(unsigned char *&p, const void *target)
+            {
+                uint32_t abs = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(target));
+                memcpy(p, &abs, sizeof(abs));
+                p += sizeof(abs);
+            }
+
+            //mov reg, qword ptr [rip+rel] - reg is the register number (0 rax ... 15 r15)
+            inline void MovRegRip(unsigned char *&p, unsigned reg, const void *source)
+            {
+                *p++ = static_cast<unsigned char>((reg < 8) ? 0x48 : 0x4c); //REX.W (+REX.R)
+                *p++ = 0x8b;
+                *p++ = static_cast<unsigned char>(0x05 | ((reg & 7) << 3)); //modrm rip relative
+                Rel32(p, source);
+            }
+
+            //jmp qword ptr [rip+rel]
+            inline void JmpRip(unsigned char *&p, const void *target)
+            {
+                *p++ = 0xff;
+                *p++ = 0x25;
+                Rel32(p, target);
+            }
+
+            const unsigned rax = 0, rcx = 1, rdx = 2, rsi = 6, rdi = 7, r8 = 8, r9 = 9;
+        }
+
+        /*void Win64<Arg>(unsigned char *code, const ThunkSlab::Data *data)
+        Microsoft x64 back end, the object is passed as parameter Arg*/
+        template <unsigned Arg>
+        void Win64(unsigned char *code, const ThunkSlab::Data *data)
+        {
+            static_assert(Arg < 15, "stack parameter offset must fit in a disp8");
+            using namespace Detail;
+            memset(code, 0xcc, ThunkSlab::codesize); //unused bytes are int 3
+            unsigned char *p = code;
+            if (Arg < 4)
+            {
+                static const unsigned regs[4] = { rcx, rdx, r8, r9 };
+                MovRegRip(p, regs[Arg & 3], &data->object);
+            }
+            else
+            {
+                //parameter Arg is at [rsp + 8 + 8 * Arg] - after the return address
+                MovRegRip(p, rax, &data->object);
+                *p++ = 0x48; *p++ = 0x89; *p++ = 0x44; *p++ = 0x24; //mov qword ptr [rsp+disp8], rax
+                *p++ = static_cast<unsigned char>(8 + (8 * Arg));
+            }
+            JmpRip(p, &data->target);
+        }
+
+        /*void SysV<Arg>(unsigned char *code, const ThunkSlab::Data *data)
+        System V x86-64 back end, the object is passed as parameter Arg*/
+        template <unsigned Arg>
+        void SysV(unsigned char *code, const ThunkSlab::Data *data)
+        {
+            static_assert(Arg < 6, "the object must be passed in a register");
+            using namespace Detail;
+            static const unsigned regs[6] = { rdi, rsi, rdx, rcx, r8, r9 };
+            memset(code, 0xcc, ThunkSlab::codesize);
+            unsigned char *p = code;
+            MovRegRip(p, regs[Arg], &data->object);
+            JmpRip(p, &data->target);
+        }
+
+        /*void X86First(unsigned char *code, const ThunkSlab::Data *data)
+        x86 __stdcall back end, the object is inserted as the first parameter. Data must be below
+        4GB, which it always is in a 32-bit process.*/
+        inline void X86First(unsigned char *code, const ThunkSlab::Data *data)
+        {
+            using namespace Detail;
+            memset(code, 0xcc, ThunkSlab::codesize);
+            unsigned char *p = code;
+            *p++ = 0xff; *p++ = 0x34; *p++ = 0x24;              //push dword ptr [esp] ;push return address
+            *p++ = 0xa1;                                        //mov eax, dword ptr [object]
+            Abs32(p, &data->object);
+            *p++ = 0x89; *p++ = 0x44; *p++ = 0x24; *p++ = 0x04; //mov dword ptr [esp+4], eax ;replace the old return address
+            *p++ = 0xff; *p++ = 0x25;                           //jmp dword ptr [target]
+            Abs32(p, &data->target);
+        }
+
+        #if defined(_M_AMD64) || (defined(_WIN64) && defined(__x86_64__))
+        template <unsigned Arg>
+        inline void Native(unsigned char *code, const ThunkSlab::Data *data) { Win64<Arg>(code, data); }
+        #elif defined(__x86_64__)
+        template <unsigned Arg>
+        inline void Native(unsigned char *code, const ThunkSlab::Data *data) { SysV<Arg>(code, data); }
+        #elif defined(_M_IX86) || defined(__i386__)
+        template <unsigned Arg>
+        inline void Native(unsigned char *code, const ThunkSlab::Data *data) { X86First(code, data); }
+        #endif
+    }
+}
@@ -0,0 +1,291 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>  //needed for std::atomic
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uint32_t, uint64_t, uintptr_t
+#include <mutex>   //needed for std::mutex
+#include "AllocTag.h"
+#if !defined(_WIN32)
+    #include <sys/mman.h> //needed for mmap, mprotect and munmap
+    #include <unistd.h>   //needed for sysconf
+#endif
+/*Slab allocator for executable thunks. Memory is mapped in blocks of slotsperblock thunks, each
+block has a code region and a data region:
+
+    code region - one codesize slot per thunk, written while the pages are read/write and then
+                  switched to read/execute before any slot is handed out. The code is never
+                  written again, so pages are never writable and executable at the same time (W^X)
+                  and the instruction cache is flushed once per block.
+    data region - one Data per thunk (bound object and target function), always read/write and
+                  never executable. The code in a slot only reads its own Data, binding a thunk
+                  to an object is two stores to the data region.
+
+Free slots are kept on a lock-free (tagged index) free list, only mapping a new block takes a lock.
+Blocks stay mapped for the life of the slab. EmitFn writes the code for one slot, see
+WndProcThunk.h. The only OS calls are VirtualAlloc/VirtualProtect/FlushInstructionCache on Windows
+and mmap/mprotect on other systems, so the slab can be tested outside of Windows.*/
+
+namespace WUIF {
+
+    class ThunkSlab
+    {
+    public:
+        static const size_t codesize      = 32;   //bytes of code per thunk
+        static const size_t slotsperblock = 1024; //thunks per block
+        static const size_t maxblocks     = 256;  //blocks per slab (262144 thunks)
+
+        //per thunk data read by the thunk code - object is at offset 0, target at sizeof(void*)
+        struct Data
+        {
+            std::atomic<uintptr_t> object; //bound object, link to the next free slot while free
+            std::atomic<uintptr_t> target; //function the thunk jumps to
+        };
+
+        struct Slot
+        {
+            unsigned char *code;  //thunk entry point
+            Data          *data;  //the thunk's bound values
+            uint32_t       index; //slot number in the slab
+        };
+
+        //writes the code for one thunk at code that reads its values from data
+        typedef void (*EmitFn)(unsigned char *code, const Data *data);
+
+        explicit ThunkSlab(EmitFn emit) noexcept :
+            _emit(emit), _head(0), _blockcount(0), _inuse(0), _coderegion(0), _blocksize(0)
+        {
+            static_assert(sizeof(std::atomic<uintptr_t>) == sizeof(uintptr_t),
+                          "thunk code reads Data as plain pointers");
+            for (size_t i = 0; i < maxblocks; i++)
+            {
+                _blocks[i].store(nullptr, std::memory_order_relaxed);
+            }
+            const size_t page = PageSize();
+            _coderegion = RoundUp(codesize * slotsperblock, page);
+            _blocksize  = _coderegion + RoundUp(sizeof(Data) * slotsperblock, page);
+        }
+
+        //blocks are only unmapped if no thunk is in use
+        ~ThunkSlab()
+        {
+            if (_inuse.load(std::memory_order_acquire) != 0)
+            {
+                return;
+            }
+            for (size_t i = 0; i < maxblocks; i++)
+            {
+                unsigned char *block = _blocks[i].load(std::memory_order_relaxed);
+                if (block != nullptr)
+                {
+                    Unmap(block, _blocksize);
+                    AllocStats::Erase(AllocTag::Thunk, _blocksize);
+                }
+            }
+        }
+
+        ThunkSlab(const ThunkSlab&) = delete;
+        ThunkSlab& operator=(const ThunkSlab&) = delete;
+
+        /*bool Allocate(Slot &slot)
+        Takes a free slot, mapping a new block if there is none
+
+        Slot &slot - receives the slot's code and data addresses
+
+        Return value
+        bool - false if a block could not be mapped or the slab is full*/
+        bool Allocate(Slot &slot)
+        {
+            uint32_t index;
+            while (!Pop(index))
+            {
+                if (!Grow())
+                {
+                    return false;
+                }
+            }
+            _inuse.fetch_add(1, std::memory_order_relaxed);
+            slot.index = index;
+            slot.code  = Code(index);
+            slot.data  = DataFor(index);
+            return true;
+        }
+
+        /*void Free(const Slot &slot)
+        Returns a slot to the free list, the caller must make sure the thunk can no longer be
+        called*/
+        void Free(const Slot &slot)
+        {
+            Push(slot.index);
+            _inuse.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        inline size_t InUse()  const { return _inuse.load(std::memory_order_relaxed); }
+        inline size_t Blocks() const { return _blockcount.load(std::memory_order_acquire); }
+
+    private:
+        EmitFn                       _emit;
+        std::atomic<uint64_t>        _head;       //tag << 32 | (index + 1), 0 - empty
+        std::atomic<unsigned char*>  _blocks[maxblocks];
+        std::atomic<size_t>          _blockcount;
+        std::atomic<size_t>          _inuse;
+        std::mutex                   _growlock;
+        size_t                       _coderegion; //bytes of code per block, page aligned
+        size_t                       _blocksize;  //code and data region
+
+        static inline size_t RoundUp(size_t v, size_t to) { return ((v + to - 1) / to) * to; }
+
+        inline unsigned char* Block(uint32_t index) const
+        {
+            return _blocks[index / slotsperblock].load(std::memory_order_acquire);
+        }
+        inline unsigned char* Code(uint32_t index) const
+        {
+            return Block(index) + ((index % slotsperblock) * codesize);
+        }
+        inline Data* DataFor(uint32_t index) const
+        {
+            return reinterpret_cast<Data*>(Block(index) + _coderegion) + (index % slotsperblock);
+        }
+
+        bool Pop(uint32_t &index)
+        {
+            uint64_t old = _head.load(std::memory_order_acquire);
+            while ((old & 0xffffffffULL) != 0)
+            {
+                index = static_cast<uint32_t>(old) - 1;
+                /*the slot may be popped and reused by another thread before the exchange below,
+                the tag makes the exchange fail in that case so the value read here is discarded*/
+                uint64_t next    = DataFor(index)->object.load(std::memory_order_relaxed) & 0xffffffffULL;
+                uint64_t desired = ((old & 0xffffffff00000000ULL) + 0x100000000ULL) | next;
+                if (_head.compare_exchange_weak(old, desired, std::memory_order_acq_rel,
+                                                std::memory_order_acquire))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //pushes the chain first..last (already linked through Data::object) onto the free list
+        void PushChain(uint32_t first, uint32_t last)
+        {
+            Data *tail = DataFor(last);
+            uint64_t old = _head.load(std::memory_order_relaxed);
+            uint64_t desired;
+            do
+            {
+                tail->object.store(static_cast<uintptr_t>(old & 0xffffffffULL), std::memory_order_relaxed);
+                desired = ((old & 0xffffffff00000000ULL) + 0x100000000ULL) | (static_cast<uint64_t>(first) + 1);
+            } while (!_head.compare_exchange_weak(old, desired, std::memory_order_release,
+                                                  std::memory_order_relaxed));
+        }
+
+        inline void Push(uint32_t index) { PushChain(index, index); }
+
+        //maps, fills and publishes a new block - false if the slab is full or mapping failed
+        bool Grow()
+        {
+            std::lock_guard<std::mutex> guard(_growlock);
+            if ((_head.load(std::memory_order_acquire) & 0xffffffffULL) != 0)
+            {
+                return true; //another thread added a block or freed a slot
+            }
+            const size_t n = _blockcount.load(std::memory_order_relaxed);
+            if (n == maxblocks)
+            {
+                return false;
+            }
+            unsigned char *block = Map(_blocksize);
+            if (block == nullptr)
+            {
+                return false;
+            }
+            Data *data = reinterpret_cast<Data*>(block + _coderegion);
+            for (size_t i = 0; i < slotsperblock; i++)
+            {
+                _emit(block + (i * codesize), data + i);
+            }
+            if (!Protect(block, _coderegion))
+            {
+                Unmap(block, _blocksize);
+                return false;
+            }
+            AllocStats::Record(AllocTag::Thunk, _blocksize);
+            _blocks[n].store(block, std::memory_order_release);
+            _blockcount.store(n + 1, std::memory_order_release);
+            //link the new slots in order, the last one is linked to the current head by PushChain
+            const uint32_t first = static_cast<uint32_t>(n * slotsperblock);
+            const uint32_t last  = first + static_cast<uint32_t>(slotsperblock) - 1;
+            for (uint32_t i = first; i < last; i++)
+            {
+                data[i - first].object.store(static_cast<uintptr_t>(i) + 2, std::memory_order_relaxed);
+            }
+            PushChain(first, last);
+            return true;
+        }
+
+        #if defined(_WIN32)
+        static size_t PageSize()
+        {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return info.dwPageSize;
+        }
+        static unsigned char* Map(size_t size)
+        {
+            return static_cast<unsigned char*>(VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT,
+                                                            PAGE_READWRITE));
+        }
+        //switch the code region to read/execute and flush the instruction cache once
+        static bool Protect(unsigned char *code, size_t size)
+        {
+            DWORD old;
+            if (!VirtualProtect(code, size, PAGE_EXECUTE_READ, &old))
+            {
+                return false;
+            }
+            return (FlushInstructionCache(GetCurrentProcess(), code, size) != FALSE);
+        }
+        static void Unmap(unsigned char *block, size_t)
+        {
+            VirtualFree(block, 0, MEM_RELEASE);
+        }
+        #else
+        static size_t PageSize()
+        {
+            long page = sysconf(_SC_PAGESIZE);
+            return ((page > 0) ? static_cast<size_t>(page) : 4096);
+        }
+        static unsigned char* Map(size_t size)
+        {
+            void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            return ((p == MAP_FAILED) ? nullptr : static_cast<unsigned char*>(p));
+        }
+        static bool Protect(unsigned char *code, size_t size)
+        {
+            if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0)
+            {
+                return false;
+            }
+            __builtin___clear_cache(reinterpret_cast<char*>(code), reinterpret_cast<char*>(code + size));
+            return true;
+        }
+        static void Unmap(unsigned char *block, size_t size)
+        {
+            munmap(block, size);
+        }
+        #endif
+    };
+}
@@ -0,0 +1,369 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>  //needed for std::atomic
+#include <chrono>  //needed for std::chrono::steady_clock
+#include <cstdint> //needed for uint32_t, uint64_t
+#include <cstdio>  //needed for snprintf, fopen
+#include <mutex>   //needed for std::mutex
+#include <string>  //needed for std::string
+#include <vector>  //needed for std::vector
+#include "AllocTag.h"
+#if !defined(_WIN32)
+    #include <unistd.h> //needed for getpid
+#endif
+/*Scoped tracing spans. A span records its name, start and end time and one optional integer
+argument in a ring owned by the calling thread when it goes out of scope. Rings keep the last
+ringsize spans of each thread (a flight recorder), so tracing can stay on in production builds.
+TraceSpans::Dump writes every ring as Chrome trace-event JSON (load in chrome://tracing or
+Perfetto).
+
+Spans are only compiled in when TRACESPANS is defined, otherwise the macros expand to nothing:
+
+    WUIF_TRACE_SPAN("name");            - span from here to the end of the scope
+    WUIF_TRACE_SPAN_ARG("name", value); - same with an integer argument (e.g. a message number)
+
+Names must be string literals, only the pointer is stored. Writing a span is two clock reads and
+five relaxed stores, Dump may run while other threads trace - spans overwritten while they are
+being copied are skipped. This header has no Windows dependencies.*/
+
+namespace WUIF {
+
+    class TraceSpans
+    {
+    public:
+        static const size_t ringsize   = 8192; //spans kept per thread, a power of two
+        static const size_t maxthreads = 64;   //threads beyond this are not traced
+        static const uint64_t NOARG    = ~0ULL; //span without an argument
+
+        #if defined(_WIN32)
+        typedef const TCHAR* Path;
+        #else
+        typedef const char* Path;
+        #endif
+
+        //timestamp in clock ticks
+        #if defined(_WIN32)
+        static inline uint64_t Now()
+        {
+            LARGE_INTEGER t;
+            QueryPerformanceCounter(&t);
+            return static_cast<uint64_t>(t.QuadPart);
+        }
+        #else
+        static inline uint64_t Now()
+        {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+        #endif
+
+        /*void Write(const char *name, uint64_t begin, uint64_t end, uint64_t arg)
+        Records a finished span for the calling thread - begin and end are Now() values*/
+        static void Write(const char *name, uint64_t begin, uint64_t end, uint64_t arg = NOARG)
+        {
+            Ring *ring = ThreadRing();
+            if (ring == nullptr)
+            {
+                return;
+            }
+            const uint64_t index = ring->head.load(std::memory_order_relaxed);
+            Slot &slot = ring->slots[index & (ringsize - 1)];
+            slot.name.store(name, std::memory_order_relaxed);
+            slot.begin.store(begin, std::memory_order_relaxed);
+            slot.end.store(end, std::memory_order_relaxed);
+            slot.arg.store(arg, std::memory_order_relaxed);
+            ring->head.store(index + 1, std::memory_order_release);
+        }
+
+        /*void NameThread(const char *name)
+        Names the calling thread in the trace - name must be a string literal*/
+        static void NameThread(const char *name)
+        {
+            Ring *ring = ThreadRing();
+            if (ring != nullptr)
+            {
+                ring->threadname.store(name, std::memory_order_relaxed);
+            }
+        }
+
+        /*bool Dump(Path path)
+        Writes the spans of every thread as Chrome trace-event JSON. Rings of threads that have
+        exited are freed after they are written.
+
+        Return value
+        bool - false if the file could not be written*/
+        static bool Dump(Path path)
+        {
+            State &s = Get();
+            std::lock_guard<std::mutex> dumpguard(s.dumplock);
+            std::vector<Ring*> rings;
+            {
+                std::lock_guard<std::mutex> guard(s.ringlock);
+                rings = s.rings;
+            }
+            /*the first span of the process began before it made the State, so timestamps are
+            relative to the earliest span if that is before base*/
+            std::vector<std::vector<Span>> spans(rings.size());
+            std::vector<bool> retired(rings.size());
+            uint64_t base = s.base;
+            for (size_t i = 0; i < rings.size(); i++)
+            {
+                retired[i] = rings[i]->retired.load(std::memory_order_acquire);
+                Copy(*rings[i], spans[i]);
+                for (const Span &span : spans[i])
+                {
+                    base = (span.begin < base) ? span.begin : base;
+                }
+            }
+            const double tomicro = 1000000.0 / static_cast<double>(Frequency());
+            const unsigned long pid = ProcessId();
+            std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            char buf[256];
+            bool first = true;
+            for (size_t i = 0; i < rings.size(); i++)
+            {
+                Ring *ring = rings[i];
+                const char *threadname = ring->threadname.load(std::memory_order_relaxed);
+                if (threadname != nullptr)
+                {
+                    json += first ? "" : ",\n";
+                    first = false;
+                    snprintf(buf, sizeof(buf), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":",
+                             pid, static_cast<unsigned long>(ring->thread));
+                    json += buf;
+                    AppendString(json, threadname);
+                    json += "}}";
+                }
+                for (const Span &span : spans[i])
+                {
+                    json += first ? "" : ",\n";
+                    first = false;
+                    json += "{\"ph\":\"X\",\"name\":";
+                    AppendString(json, span.name);
+                    snprintf(buf, sizeof(buf), ",\"pid\":%lu,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f",
+                             pid, static_cast<unsigned long>(ring->thread),
+                             static_cast<double>(span.begin - base) * tomicro,
+                             static_cast<double>(span.end - span.begin) * tomicro);
+                    json += buf;
+                    if (span.arg != NOARG)
+                    {
+                        snprintf(buf, sizeof(buf), ",\"args\":{\"arg\":%llu}", static_cast<unsigned long long>(span.arg));
+                        json += buf;
+                    }
+                    json += "}";
+                }
+                if (retired[i])
+                {
+                    std::lock_guard<std::mutex> guard(s.ringlock);
+                    for (auto it = s.rings.begin(); it != s.rings.end(); ++it)
+                    {
+                        if (*it == ring)
+                        {
+                            s.rings.erase(it);
+                            break;
+                        }
+                    }
+                    delete ring;
+                }
+            }
+            json += "\n]}\n";
+            return WriteFile(path, json);
+        }
+
+        TraceSpans() = delete;
+
+    private:
+        struct Slot
+        {
+            std::atomic<const char*> name;
+            std::atomic<uint64_t>    begin;
+            std::atomic<uint64_t>    end;
+            std::atomic<uint64_t>    arg;
+        };
+
+        struct Ring : public AllocTagged<AllocTag::Logging>
+        {
+            std::atomic<uint64_t>    head{ 0 }; //spans written
+            uint32_t                 thread = 0;
+            std::atomic<const char*> threadname{ nullptr };
+            std::atomic<bool>        retired{ false };
+            Slot                     slots[ringsize];
+        };
+
+        struct Span
+        {
+            const char *name;
+            uint64_t    begin;
+            uint64_t    end;
+            uint64_t    arg;
+        };
+
+        struct State
+        {
+            std::mutex         ringlock; //rings
+            std::vector<Ring*> rings;
+            std::mutex         dumplock; //one Dump at a time
+            uint64_t           base = Now(); //timestamps are written relative to this (or an earlier span)
+        };
+
+        static State& Get()
+        {
+            static State state;
+            return state;
+        }
+
+        //marks the thread's ring retired when the thread exits, Dump frees it
+        struct Local
+        {
+            Ring *ring    = nullptr;
+            bool  refused = false;
+            ~Local()
+            {
+                if (ring != nullptr)
+                    ring->retired.store(true, std::memory_order_release);
+            }
+        };
+
+        static Ring* ThreadRing()
+        {
+            static thread_local Local local;
+            if ((local.ring == nullptr) && (!local.refused))
+            {
+                State &s = Get();
+                std::lock_guard<std::mutex> guard(s.ringlock);
+                if (s.rings.size() < maxthreads)
+                {
+                    local.ring = new Ring;
+                    local.ring->thread = ThreadId();
+                    s.rings.push_back(local.ring);
+                }
+                else
+                {
+                    local.refused = true;
+                }
+            }
+            return local.ring;
+        }
+
+        //copies the spans still in the ring, discarding slots the owner overwrote while copying
+        static void Copy(const Ring &ring, std::vector<Span> &spans)
+        {
+            spans.clear();
+            const uint64_t head  = ring.head.load(std::memory_order_acquire);
+            const uint64_t first = (head > ringsize) ? (head - ringsize) : 0;
+            for (uint64_t i = first; i < head; i++)
+            {
+                const Slot &slot = ring.slots[i & (ringsize - 1)];
+                Span span;
+                span.name  = slot.name.load(std::memory_order_relaxed);
+                span.begin = slot.begin.load(std::memory_order_relaxed);
+                span.end   = slot.end.load(std::memory_order_relaxed);
+                span.arg   = slot.arg.load(std::memory_order_relaxed);
+                spans.push_back(span);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t after = ring.head.load(std::memory_order_relaxed);
+            //slot i may have been rewritten once the owner started writing span i + ringsize
+            const uint64_t valid = (after >= ringsize) ? (after - ringsize + 1) : 0;
+            if (valid > first)
+            {
+                const size_t stale = static_cast<size_t>(((valid < head) ? valid : head) - first);
+                spans.erase(spans.begin(), spans.begin() + stale);
+            }
+        }
+
+        static void AppendString(std::string &json, const char *str)
+        {
+            json += '"';
+            for (; (str != nullptr) && (*str != 0); str++)
+            {
+                if ((*str == '"') || (*str == '\\'))
+                {
+                    json += '\\';
+                }
+                json += ((static_cast<unsigned char>(*str) < 0x20) ? ' ' : *str);
+            }
+            json += '"';
+        }
+
+        #if defined(_WIN32)
+        static uint64_t Frequency()
+        {
+            LARGE_INTEGER f;
+            QueryPerformanceFrequency(&f);
+            return static_cast<uint64_t>(f.QuadPart);
+        }
+        static inline uint32_t ThreadId()  { return GetCurrentThreadId(); }
+        static unsigned long   ProcessId() { return GetCurrentProcessId(); }
+        static bool WriteFile(Path path, const std::string &data)
+        {
+            HANDLE file = CreateFile(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+            DWORD written = 0;
+            const BOOL ok = ::WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, NULL);
+            CloseHandle(file);
+            return ((ok != FALSE) && (written == data.size()));
+        }
+        #else
+        static uint64_t Frequency() { return 1000000000ULL; }
+        static uint32_t ThreadId()
+        {
+            static std::atomic<uint32_t> counter{ 0 };
+            return ++counter;
+        }
+        static unsigned long ProcessId() { return static_cast<unsigned long>(getpid()); }
+        static bool WriteFile(Path path, const std::string &data)
+        {
+            FILE *file = fopen(path, "wb");
+            if (file == nullptr)
+            {
+                return false;
+            }
+            const bool ok = (fwrite(data.data(), 1, data.size(), file) == data.size());
+            return ((fclose(file) == 0) && ok);
+        }
+        #endif
+    };
+
+    //records a span from construction to destruction, use through WUIF_TRACE_SPAN
+    class TraceSpan
+    {
+    public:
+        explicit TraceSpan(const char *name, uint64_t arg = TraceSpans::NOARG) noexcept :
+            _name(name), _arg(arg), _begin(TraceSpans::Now()) {}
+        ~TraceSpan() { TraceSpans::Write(_name, _begin, TraceSpans::Now(), _arg); }
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+    private:
+        const char *_name;
+        uint64_t    _arg;
+        uint64_t    _begin;
+    };
+}
+
+#define WUIF_TRACE_CONCAT2(a, b) a##b
+#define WUIF_TRACE_CONCAT(a, b)  WUIF_TRACE_CONCAT2(a, b)
+#ifdef TRACESPANS
+    #define WUIF_TRACE_SPAN(name)          ::WUIF::TraceSpan WUIF_TRACE_CONCAT(_tracespan, __LINE__)(name)
+    #define WUIF_TRACE_SPAN_ARG(name, arg) ::WUIF::TraceSpan WUIF_TRACE_CONCAT(_tracespan, __LINE__)(name, static_cast<uint64_t>(arg))
+#else
+    #define WUIF_TRACE_SPAN(name)          ((void)0)
+    #define WUIF_TRACE_SPAN_ARG(name, arg) ((void)0)
+#endif
@@ -0,0 +1,531 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef> //needed for size_t
+#include <cstdint> //needed for uint16_t, uint32_t, uint64_t
+#include <cstring> //needed for memcpy, strlen
+#include "AllocTag.h"
+/*UTF-8 <-> UTF-16 conversion with validation, so applications can keep their strings in UTF-8 and
+convert at the Windows API boundary.
+
+    UTF::ToUTF16 / UTF::ToUTF8         - convert a buffer, the destination must hold length (to
+                                         UTF-16) or UTF8Length (to UTF-8) code units
+    UTF::UTF16Length / UTF::UTF8Length - exact converted length
+    UTF::Validate                      - true if a buffer is well formed UTF-8
+    UTF16Buffer<N> / UTF8Buffer<N>     - null terminated copy of a string in the other encoding,
+                                         kept in an N unit member array (on the stack for a local)
+                                         and only allocated on the heap when longer
+
+Ill-formed input (overlong or truncated sequences, surrogates encoded in UTF-8, unpaired UTF-16
+surrogates, code points above U+10FFFF) makes the strict functions return UTF::invalid. With
+replace set each maximal ill-formed subpart becomes U+FFFD instead, as MultiByteToWideChar does.
+Sixteen ASCII characters are checked and widened (or narrowed) at a time with SSE2, anything else
+goes through the scalar decoder one code point at a time. This header has no Windows dependencies -
+UTF16Char is wchar_t on Windows (usable as LPCWSTR) and char16_t elsewhere.*/
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__x86_64__) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+    #define WUIF_UTF_SSE2
+    #include <emmintrin.h> //SSE2
+    #if defined(_MSC_VER)
+        #include <intrin.h> //needed for _BitScanForward
+    #endif
+#endif
+//keeps the rarely taken decoder out of the conversion loops
+#if defined(_MSC_VER)
+    #define WUIF_UTF_NOINLINE __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+    #define WUIF_UTF_NOINLINE __attribute__((noinline))
+#else
+    #define WUIF_UTF_NOINLINE
+#endif
+
+namespace WUIF {
+
+    #if defined(_WIN32)
+    typedef wchar_t  UTF16Char;
+    #else
+    typedef char16_t UTF16Char;
+    #endif
+
+    class UTF
+    {
+    public:
+        static const size_t invalid = static_cast<size_t>(-1);
+
+        /*size_t UTF::ToUTF16(const char *src, size_t length, UTF16Char *dst, bool replace)
+        Converts length bytes of UTF-8 to UTF-16, no null terminator is added
+
+        const char *src - UTF-8 to convert
+        size_t length   - bytes in src
+        UTF16Char *dst  - receives the UTF-16, must hold length code units
+        bool replace    - replace ill-formed input with U+FFFD rather than failing
+
+        Return value
+        size_t - code units written, or UTF::invalid if src is ill-formed and replace is not set*/
+        static size_t ToUTF16(const char *src, size_t length, UTF16Char *dst, bool replace = false)
+        {
+            const unsigned char *s   = reinterpret_cast<const unsigned char*>(src);
+            const unsigned char *end = s + length;
+            UTF16Char *d = dst;
+            while (s < end)
+            {
+                const unsigned char c = *s;
+                if (c < 0x80)
+                {
+                    #if defined(WUIF_UTF_SSE2)
+                    if (((end - s) >= 16) && AsciiWord(s))
+                    {
+                        //widen 16 ASCII bytes at a time - a block with other bytes still stores its ASCII prefix
+                        do
+                        {
+                            const __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+                            const __m128i zero = _mm_setzero_si128();
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_unpacklo_epi8(v, zero));
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(d + 8), _mm_unpackhi_epi8(v, zero));
+                            const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(v));
+                            if (mask != 0)
+                            {
+                                const unsigned ascii = TrailingZeros(mask);
+                                s += ascii;
+                                d += ascii;
+                                break;
+                            }
+                            s += 16;
+                            d += 16;
+                        } while ((end - s) >= 16);
+                        continue;
+                    }
+                    #endif
+                    *d++ = static_cast<UTF16Char>(c);
+                    s++;
+                    continue;
+                }
+                //well formed 2 and 3 byte sequences inline, anything else through Decode
+                const size_t avail = static_cast<size_t>(end - s);
+                if (c < 0xe0)
+                {
+                    if ((c >= 0xc2) && (avail >= 2) && Continuation(s[1]))
+                    {
+                        *d++ = static_cast<UTF16Char>(((c & 0x1fU) << 6) | (s[1] & 0x3fU));
+                        s += 2;
+                        continue;
+                    }
+                }
+                else if ((c < 0xf0) && (avail >= 3) && Continuation(s[1]) && Continuation(s[2]))
+                {
+                    const uint32_t cp3 = ((c & 0x0fU) << 12) | ((s[1] & 0x3fU) << 6) | (s[2] & 0x3fU);
+                    if ((cp3 >= 0x800) && ((cp3 - 0xd800) >= 0x800))
+                    {
+                        *d++ = static_cast<UTF16Char>(cp3);
+                        s += 3;
+                        continue;
+                    }
+                }
+                uint32_t cp;
+                s += Decode(s, end, cp);
+                if (cp == badcp)
+                {
+                    if (!replace)
+                    {
+                        return invalid;
+                    }
+                    cp = replacement;
+                }
+                if (cp >= 0x10000)
+                {
+                    cp -= 0x10000;
+                    *d++ = static_cast<UTF16Char>(0xd800 + (cp >> 10));
+                    *d++ = static_cast<UTF16Char>(0xdc00 + (cp & 0x3ff));
+                }
+                else
+                {
+                    *d++ = static_cast<UTF16Char>(cp);
+                }
+            }
+            return static_cast<size_t>(d - dst);
+        }
+
+        /*size_t UTF::ToUTF8(const UTF16Char *src, size_t length, char *dst, bool replace)
+        Converts length code units of UTF-16 to UTF-8, no null terminator is added
+
+        const UTF16Char *src - UTF-16 to convert
+        size_t length        - code units in src
+        char *dst            - receives the UTF-8, must hold UTF8Length bytes (3 * length always does)
+        bool replace         - replace unpaired surrogates with U+FFFD rather than failing
+
+        Return value
+        size_t - bytes written, or UTF::invalid if src is ill-formed and replace is not set*/
+        static size_t ToUTF8(const UTF16Char *src, size_t length, char *dst, bool replace = false)
+        {
+            const UTF16Char *s   = src;
+            const UTF16Char *end = src + length;
+            unsigned char *d = reinterpret_cast<unsigned char*>(dst);
+            while (s < end)
+            {
+                uint32_t cp = static_cast<uint16_t>(*s);
+                if (cp < 0x80)
+                {
+                    #if defined(WUIF_UTF_SSE2)
+                    if (((end - s) >= 16) && AsciiWord(s))
+                    {
+                        //narrow 16 ASCII code units at a time
+                        do
+                        {
+                            const __m128i lo    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+                            const __m128i hi    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 8));
+                            const __m128i high  = _mm_set1_epi16(static_cast<short>(0xff80));
+                            const __m128i zero  = _mm_setzero_si128();
+                            //0xffff for every ASCII unit, packed to one byte per unit
+                            const __m128i ascii = _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(lo, high), zero),
+                                                                  _mm_cmpeq_epi16(_mm_and_si128(hi, high), zero));
+                            _mm_storeu_si128(reinterpret_cast<__m128i*>(d), _mm_packus_epi16(lo, hi));
+                            const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(ascii)) ^ 0xffffU;
+                            if (mask != 0)
+                            {
+                                const unsigned count = TrailingZeros(mask);
+                                s += count;
+                                d += count;
+                                break;
+                            }
+                            s += 16;
+                            d += 16;
+                        } while ((end - s) >= 16);
+                        continue;
+                    }
+                    #endif
+                    /*the few ASCII units before the next non-ASCII one (or the end), without going
+                    back through the checks above for each*/
+                    do
+                    {
+                        *d++ = static_cast<unsigned char>(cp);
+                    } while ((++s < end) && ((cp = static_cast<uint16_t>(*s)) < 0x80));
+                    if (s == end)
+                    {
+                        break;
+                    }
+                }
+                s++;
+                if (cp < 0x800)
+                {
+                    d[0] = static_cast<unsigned char>(0xc0 | (cp >> 6));
+                    d[1] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+                    d += 2;
+                    continue;
+                }
+                if ((cp - 0xd800) >= 0x800)
+                {
+                    d[0] = static_cast<unsigned char>(0xe0 | (cp >> 12));
+                    d[1] = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3f));
+                    d[2] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+                    d += 3;
+                    continue;
+                }
+                //surrogates
+                if ((cp < 0xdc00) && (s < end) && ((static_cast<uint16_t>(*s) - 0xdc00U) < 0x400))
+                {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (static_cast<uint16_t>(*s++) - 0xdc00);
+                }
+                else if (!replace)
+                {
+                    return invalid;
+                }
+                else
+                {
+                    cp = replacement;
+                }
+                d += Encode(cp, d);
+            }
+            return static_cast<size_t>(d - reinterpret_cast<unsigned char*>(dst));
+        }
+
+        //UTF-16 code units ToUTF16 would write, UTF::invalid if ill-formed and replace is not set
+        static size_t UTF16Length(const char *src, size_t length, bool replace = false)
+        {
+            const unsigned char *s   = reinterpret_cast<const unsigned char*>(src);
+            const unsigned char *end = s + length;
+            size_t units = 0;
+            while (s < end)
+            {
+                if (*s < 0x80)
+                {
+                    s++;
+                    units++;
+                    continue;
+                }
+                uint32_t cp;
+                s += Decode(s, end, cp);
+                if ((cp == badcp) && !replace)
+                {
+                    return invalid;
+                }
+                units += ((cp != badcp) && (cp >= 0x10000)) ? 2 : 1;
+            }
+            return units;
+        }
+
+        //UTF-8 bytes ToUTF8 would write, UTF::invalid if ill-formed and replace is not set
+        static size_t UTF8Length(const UTF16Char *src, size_t length, bool replace = false)
+        {
+            const UTF16Char *s   = src;
+            const UTF16Char *end = src + length;
+            size_t bytes = 0;
+            while (s < end)
+            {
+                const uint32_t cp = static_cast<uint16_t>(*s++);
+                if (cp < 0x80)
+                {
+                    bytes += 1;
+                }
+                else if (cp < 0x800)
+                {
+                    bytes += 2;
+                }
+                else if ((cp >= 0xd800) && (cp < 0xe000))
+                {
+                    if ((cp < 0xdc00) && (s < end) && (static_cast<uint16_t>(*s) >= 0xdc00) && (static_cast<uint16_t>(*s) < 0xe000))
+                    {
+                        s++;
+                        bytes += 4;
+                    }
+                    else if (!replace)
+                    {
+                        return invalid;
+                    }
+                    else
+                    {
+                        bytes += 3;
+                    }
+                }
+                else
+                {
+                    bytes += 3;
+                }
+            }
+            return bytes;
+        }
+
+        static inline bool Validate(const char *src, size_t length)
+        {
+            return (UTF16Length(src, length) != invalid);
+        }
+
+        static inline size_t Length(const UTF16Char *src)
+        {
+            const UTF16Char *s = src;
+            while (*s != 0)
+            {
+                s++;
+            }
+            return static_cast<size_t>(s - src);
+        }
+
+        UTF() = delete;
+
+    private:
+        static const uint32_t badcp       = 0xffffffff;
+        static const uint32_t replacement = 0xfffd;
+
+        static inline unsigned TrailingZeros(unsigned mask)
+        {
+            #if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+            #else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+            #endif
+        }
+
+        static inline bool Continuation(unsigned char c) { return ((c & 0xc0) == 0x80); }
+
+        /*true if the next four code units are ASCII - short runs between accented letters are
+        cheaper to copy one at a time than to start a 16 unit block for*/
+        static inline bool AsciiWord(const unsigned char *s)
+        {
+            uint32_t word;
+            memcpy(&word, s, sizeof(word));
+            return ((word & 0x80808080U) == 0);
+        }
+        static inline bool AsciiWord(const UTF16Char *s)
+        {
+            uint64_t word;
+            memcpy(&word, s, sizeof(word));
+            return ((word & 0xff80ff80ff80ff80ULL) == 0);
+        }
+
+        /*decodes the sequence at s (s[0] >= 0x80) into cp and returns the bytes used. An
+        ill-formed sequence sets cp to badcp and returns the length of its maximal subpart - the
+        lead byte plus any continuation bytes that were valid so far*/
+        static WUIF_UTF_NOINLINE size_t Decode(const unsigned char *s, const unsigned char *end, uint32_t &cp)
+        {
+            const unsigned char c = s[0];
+            const size_t avail    = static_cast<size_t>(end - s);
+            cp = badcp;
+            if ((c < 0xc2) || (c > 0xf4))
+            {
+                return 1; //continuation byte, overlong 2 byte lead or above U+10FFFF
+            }
+            if (c < 0xe0)
+            {
+                if ((avail < 2) || !Continuation(s[1]))
+                {
+                    return 1;
+                }
+                cp = ((c & 0x1fU) << 6) | (s[1] & 0x3fU);
+                return 2;
+            }
+            //range of the second byte excludes overlongs, surrogates and code points above U+10FFFF
+            const unsigned char lo = (c == 0xe0) ? 0xa0 : ((c == 0xf0) ? 0x90 : 0x80);
+            const unsigned char hi = (c == 0xed) ? 0x9f : ((c == 0xf4) ? 0x8f : 0xbf);
+            if ((avail < 2) || (s[1] < lo) || (s[1] > hi))
+            {
+                return 1;
+            }
+            if ((avail < 3) || !Continuation(s[2]))
+            {
+                return 2;
+            }
+            if (c < 0xf0)
+            {
+                cp = ((c & 0x0fU) << 12) | ((s[1] & 0x3fU) << 6) | (s[2] & 0x3fU);
+                return 3;
+            }
+            if ((avail < 4) || !Continuation(s[3]))
+            {
+                return 3;
+            }
+            cp = ((c & 0x07U) << 18) | ((s[1] & 0x3fU) << 12) | ((s[2] & 0x3fU) << 6) | (s[3] & 0x3fU);
+            return 4;
+        }
+
+        //writes cp (0x80 or above, not a surrogate) as UTF-8 and returns the bytes used
+        static inline size_t Encode(uint32_t cp, unsigned char *d)
+        {
+            if (cp < 0x800)
+            {
+                d[0] = static_cast<unsigned char>(0xc0 | (cp >> 6));
+                d[1] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+                return 2;
+            }
+            if (cp < 0x10000)
+            {
+                d[0] = static_cast<unsigned char>(0xe0 | (cp >> 12));
+                d[1] = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3f));
+                d[2] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+                return 3;
+            }
+            d[0] = static_cast<unsigned char>(0xf0 | (cp >> 18));
+            d[1] = static_cast<unsigned char>(0x80 | ((cp >> 12) & 0x3f));
+            d[2] = static_cast<unsigned char>(0x80 | ((cp >> 6) & 0x3f));
+            d[3] = static_cast<unsigned char>(0x80 | (cp & 0x3f));
+            return 4;
+        }
+    };
+
+    /*UTF16Buffer<N>
+    Null terminated UTF-16 copy of a UTF-8 string, e.g. SetWindowTextW(hWnd, UTF16Buffer<>(title).c_str()).
+    Strings shorter than N code units don't allocate. Ill-formed input is replaced with U+FFFD and
+    valid() returns false.*/
+    template <size_t N = 256>
+    class UTF16Buffer
+    {
+    public:
+        explicit UTF16Buffer(const char *utf8) : UTF16Buffer(utf8, (utf8 != nullptr) ? strlen(utf8) : 0) {}
+        UTF16Buffer(const char *utf8, size_t length) : _data(_inline), _size(0), _valid(true)
+        {
+            if (length >= N)
+            {
+                _data = static_cast<UTF16Char*>(AllocStats::Allocate((length + 1) * sizeof(UTF16Char), AllocTag::App, __FILE__, __LINE__));
+            }
+            _size = UTF::ToUTF16(utf8, length, _data);
+            if (_size == UTF::invalid)
+            {
+                _valid = false;
+                _size  = UTF::ToUTF16(utf8, length, _data, true);
+            }
+            _data[_size] = 0;
+        }
+        ~UTF16Buffer()
+        {
+            if (_data != _inline)
+            {
+                AllocStats::Free(_data);
+            }
+        }
+        UTF16Buffer(const UTF16Buffer&) = delete;
+        UTF16Buffer& operator=(const UTF16Buffer&) = delete;
+
+        inline const UTF16Char* c_str() const { return _data; }
+        inline size_t           size()  const { return _size; }
+        inline bool             valid() const { return _valid; }
+
+    private:
+        UTF16Char *_data;
+        size_t     _size;
+        bool       _valid;
+        UTF16Char  _inline[N];
+    };
+
+    /*UTF8Buffer<N>
+    Null terminated UTF-8 copy of a UTF-16 string. Strings needing fewer than N bytes don't
+    allocate. Unpaired surrogates are replaced with U+FFFD and valid() returns false.*/
+    template <size_t N = 256>
+    class UTF8Buffer
+    {
+    public:
+        explicit UTF8Buffer(const UTF16Char *utf16) : UTF8Buffer(utf16, (utf16 != nullptr) ? UTF::Length(utf16) : 0) {}
+        UTF8Buffer(const UTF16Char *utf16, size_t length) : _data(_inline), _size(0), _valid(true)
+        {
+            if ((length * 3) >= N)
+            {
+                //exact size rather than the 3 bytes per code unit worst case
+                size_t bytes = UTF::UTF8Length(utf16, length);
+                if (bytes == UTF::invalid)
+                {
+                    bytes = UTF::UTF8Length(utf16, length, true);
+                }
+                if (bytes >= N)
+                {
+                    _data = static_cast<char*>(AllocStats::Allocate(bytes + 1, AllocTag::App, __FILE__, __LINE__));
+                }
+            }
+            _size = UTF::ToUTF8(utf16, length, _data);
+            if (_size == UTF::invalid)
+            {
+                _valid = false;
+                _size  = UTF::ToUTF8(utf16, length, _data, true);
+            }
+            _data[_size] = '\0';
+        }
+        ~UTF8Buffer()
+        {
+            if (_data != _inline)
+            {
+                AllocStats::Free(_data);
+            }
+        }
+        UTF8Buffer(const UTF8Buffer&) = delete;
+        UTF8Buffer& operator=(const UTF8Buffer&) = delete;
+
+        inline const char* c_str() const { return _data; }
+        inline size_t      size()  const { return _size; }
+        inline bool        valid() const { return _valid; }
+
+    private:
+        char   *_data;
+        size_t  _size;
+        bool    _valid;
+        char    _inline[N];
+    };
+}
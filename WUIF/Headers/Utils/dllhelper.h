@@ -16,6 +16,7 @@ limitations under the License.*/
 #include <windows.h>
 #include <d3d12.h>
 #include "WUIF_Const.h"
+#include "UTF.h"
 
 namespace WUIF
 {
@@ -65,11 +66,9 @@ namespace WUIF
                 TCHAR* pszTxt = TEXT("Failed to find procedure");
                 TCHAR pszDest[MAXCHAR];
                 #ifdef _UNICODE
-                int wchars_num = MultiByteToWideChar(CP_ACP, MB_PRECOMPOSED, proc_name, -1, NULL, 0);
-                wchar_t* proc_nameW = new wchar_t[wchars_num];
-                MultiByteToWideChar(CP_ACP, MB_PRECOMPOSED, proc_name, -1, proc_nameW, wchars_num);
-                StringCchPrintf(pszDest, MAXCHAR, pszFormat, pszTxt, proc_nameW);
-                delete[] proc_nameW;
+                //export names are ASCII - converted on the stack
+                UTF16Buffer<> proc_nameW(proc_name);
+                StringCchPrintf(pszDest, MAXCHAR, pszFormat, pszTxt, proc_nameW.c_str());
                 #else
                 StringCchPrintf(pszDest, STRSAFE_MAX_CCH, pszFormat, pszTxt, proc_name);
                 #endif
@@ -111,11 +110,9 @@ namespace WUIF
                 TCHAR* pszTxt = TEXT("Failed to find procedure");
                 TCHAR pszDest[MAXCHAR];
                 #ifdef _UNICODE
-                int wchars_num = MultiByteToWideChar(CP_ACP, MB_PRECOMPOSED, proc_name, -1, NULL, 0);
-                wchar_t* proc_nameW = new wchar_t[wchars_num];
-                MultiByteToWideChar(CP_ACP, MB_PRECOMPOSED, proc_name, -1, proc_nameW, wchars_num);
-                StringCchPrintf(pszDest, MAXCHAR, pszFormat, pszTxt, proc_nameW);
-                delete[] proc_nameW;
+                //export names are ASCII - converted on the stack
+                UTF16Buffer<> proc_nameW(proc_name);
+                StringCchPrintf(pszDest, MAXCHAR, pszFormat, pszTxt, proc_nameW.c_str());
                 #else
                 StringCchPrintf(pszDest, STRSAFE_MAX_CCH, pszFormat, pszTxt, proc_name);
                 #endif
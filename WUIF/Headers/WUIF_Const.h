@@ -23,6 +23,12 @@ namespace WUIF {
         BIT_MASK(GFX_Flags, D2D,   2);
         BIT_MASK(GFX_Flags, D3D11, 3);
         BIT_MASK(GFX_Flags, D3D12, 4);
+
+        //window state shared between the UI thread and whichever thread presents the window
+        BIT_FIELD(uint_fast8_t, Window_Flags);
+        BIT_MASK(Window_Flags, STANDBY,       1); //window is occluded, Present only tests
+        BIT_MASK(Window_Flags, RESIZEPENDING, 2); //swap chain resize deferred until App::EndLayout
+        ATOMIC_BIT_FIELD(Window_Flags, Atomic_Window_Flags);
     }
 
     //make sure to add to OSCheck in OSCheck.h
@@ -66,13 +66,18 @@ constexpr unsigned long WE_D3D12_NOT_FOUND                  = 0xA87E0001L;
 constexpr unsigned long WE_WNDPROC_EXCEPTION                = 0xE007023EL;
 constexpr unsigned long WE_GRAPHICS_INVALID_DISPLAY_ADAPTER = 0xA0262002L;
 
+#if defined (DEBUGOUTPUTFULL) || defined (DEBUGOUTPUTINFO)
+#include "Utils/AsyncLog.h"
+#endif
+
 namespace WUIF {
 #if defined (DEBUGOUTPUTFULL) || defined (DEBUGOUTPUTINFO)
     #ifdef _MSC_VER
     #pragma warning(push)
     #pragma warning(disable: 26481) //don't use pointer arithmetic
     #endif
-    inline void DebugPrint(_In_ const TCHAR *format, ...)
+    //writes the message directly, used when the asynchronous log is not running
+    inline void DebugPrintSync(_In_ const TCHAR *format, ...)
     {
         /*max message length for use with OutputDebugString, first DWORD bytes contain process
         identifier the other is for the message*/
@@ -114,8 +119,24 @@ namespace WUIF {
     #pragma warning(pop)
     #endif //_MSC_VER
     }
+
+    //AsyncLog sink, called on the log thread with a formatted line
+    inline void DebugSink(_In_ const TCHAR *line) { OutputDebugString(line); }
+
+    /*void DebugPrint(const TCHAR *format, const Args&... args)
+    Queues a message on the asynchronous log (see Utils/AsyncLog.h) - the format must be a string
+    literal. Before AsyncLog<TCHAR>::Start and after Stop the message is written directly.*/
+    template <class... Args>
+    inline void DebugPrint(_In_ const TCHAR *format, const Args&... args)
+    {
+        if (!AsyncLog<TCHAR>::Log(format, args...))
+        {
+            DebugPrintSync(format, args...);
+        }
+    }
 #else
-    inline void DebugPrint(_In_ const TCHAR *format, ...) { UNREFERENCED_PARAMETER(format); }
+    template <class... Args>
+    inline void DebugPrint(_In_ const TCHAR *format, const Args&...) { UNREFERENCED_PARAMETER(format); }
 #endif //DEBUGOUTPUTFULL || DEBUGOUTPUTINFO
 
     //WUIF Exception structures
@@ -129,7 +150,27 @@ namespace WUIF {
     };
 } //end namespace WUIF
 
-#ifdef DEBUGOUTPUTFULL
+#ifdef BINARYTRACE
+#include "Utils/BinaryTrace.h"
+
+namespace WUIF {
+    /*void DebugPrintAt<Site>(const char *file, unsigned line, const TCHAR *format, const Args&... args)
+    Binary trace version of DebugPrint - the site is defined in the trace file the first time it is
+    hit and every call appends an EVENT with the raw arguments. Decode with Tools/TraceDecode.*/
+    template <uint32_t Site, class... Args>
+    inline void DebugPrintAt(_In_ const char *file, unsigned line, _In_ const TCHAR *format, const Args&... args)
+    {
+        static const bool defined = BinaryTrace::Define(Site, file, line, format);
+        UNREFERENCED_PARAMETER(defined);
+        BinaryTrace::Event(Site, args...);
+    }
+}
+
+//every DebugPrint call site becomes a trace site with an ID computed at compile time
+#define DebugPrint(format, ...) DebugPrintAt<::WUIF::TraceSiteId(__FILE__, __LINE__)>(__FILE__, __LINE__, format, __VA_ARGS__)
+#endif //BINARYTRACE
+
+#if defined (DEBUGOUTPUTFULL) || defined (BINARYTRACE)
     #define PrintEnter(expr) WUIF::DebugPrint(TEXT("Entering %s"), expr)
     #define PrintExit(expr)  WUIF::DebugPrint(TEXT("Exiting %s at line# %d"), expr, __LINE__)
 #else
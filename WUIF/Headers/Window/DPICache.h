@@ -0,0 +1,72 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <atomic>
+
+namespace WUIF {
+
+    /*DPICache
+    Process-wide cache of the effective DPI of each monitor (HMONITOR -> dpi, scale factor). Each
+    Window also keeps its own dpi together with the epoch it was read in, so
+    Window::getWindowDPI() only has to compare the window's epoch against the current epoch.
+
+    The epoch changes only when cached values can no longer be trusted:
+        WM_DPICHANGED    - Invalidate(monitor) drops the entry for the monitor the window moved to
+        WM_DISPLAYCHANGE - InvalidateAll() drops every entry, HMONITOR values are not stable across
+                           a change in monitor topology
+    Every window re-reads its dpi after the epoch changes, but windows on monitors that are still
+    cached take it from the cache instead of asking the OS.*/
+    class DPICache
+    {
+    public:
+        struct Entry
+        {
+            UINT dpi;
+            UINT scale; //scale factor in percent, 100 == 96 dpi
+        };
+
+        struct Statistics
+        {
+            unsigned long long windowhits;    //getWindowDPI() served from the window's cached value
+            unsigned long long monitorhits;   //window value refreshed from the monitor cache
+            unsigned long long misses;        //value had to be read from the OS
+            unsigned long long invalidations; //times the epoch was advanced
+        };
+
+        //functions
+        static inline unsigned long Epoch() { return epoch.load(std::memory_order_acquire); }
+        static bool       Lookup(_In_ HMONITOR monitor, _Out_ Entry &entry);
+        static void       Store(_In_ HMONITOR monitor, _In_ const Entry &entry);
+        static void       Invalidate(_In_ HMONITOR monitor);
+        static void       InvalidateAll();
+        static Statistics GetStatistics();
+        static void       ResetStatistics();
+
+        //record a hit on a window's cached value - approximate if several threads race, this keeps
+        //the hot path free of locked instructions
+        static inline void WindowHit()
+        {
+            windowhits.store(windowhits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        //convert a dpi to the scale factor used by WindowProperties::Scale
+        static inline UINT ScaleFromDPI(_In_ UINT dpi) { return ((dpi == 96) ? 100 : MulDiv(dpi, 100, 96)); }
+
+        DPICache() = delete;
+
+    private:
+        static std::atomic<unsigned long>      epoch;
+        static std::atomic<unsigned long long> windowhits;
+    };
+}
@@ -0,0 +1,95 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <unordered_map>
+#include "Bitset.h"
+
+namespace WUIF {
+
+    /*one bit per system message (below WM_USER) - Window::_WndProc sends a message straight to
+    cWndProc or DefWindowProc when neither its built in cases, App::GWndProc_map nor the window's
+    WndProc_map have its bit set*/
+    BIT_SET(MessageBits, 1024);
+
+    /*MessageMap<Proc>
+    Message handler map (Window::WndProc_map, App::GWndProc_map) that keeps a MessageBits of the
+    messages it holds up to date as handlers are added and removed. Messages from WM_USER up are
+    not in the bitmap and always take the full dispatch.*/
+    template <class Proc>
+    class MessageMap
+    {
+    public:
+        typedef std::unordered_map<UINT, Proc>        map_t;
+        typedef typename map_t::const_iterator        const_iterator;
+
+        //adds (or replaces) the handler for message - WndProc_map[WM_COMMAND] = MenuCommand;
+        Proc& operator[](_In_ const UINT message)
+        {
+            if (message < MessageBits::bits)
+            {
+                _bits.set(message);
+            }
+            return _map[message];
+        }
+        size_t erase(_In_ const UINT message)
+        {
+            const size_t erased = _map.erase(message);
+            if ((erased != 0) && (message < MessageBits::bits))
+            {
+                _bits.reset(message);
+            }
+            return erased;
+        }
+        void clear()
+        {
+            _map.clear();
+            _bits.clear();
+        }
+
+        //handler for message, nullptr if none
+        Proc find(_In_ const UINT message) const
+        {
+            const const_iterator proc = _map.find(message);
+            return (proc != _map.end()) ? proc->second : nullptr;
+        }
+        //false only if message has no handler - messages from WM_USER up always return true
+        inline bool handles(_In_ const UINT message) const noexcept
+        {
+            return (message >= MessageBits::bits) || _bits.test(message);
+        }
+
+        inline bool   empty() const noexcept { return _map.empty(); }
+        inline size_t size()  const noexcept { return _map.size(); }
+        inline size_t count(_In_ const UINT message) const { return _map.count(message); }
+        inline const MessageBits& bits() const noexcept { return _bits; }
+        const_iterator begin() const { return _map.begin(); }
+        const_iterator end()   const { return _map.end(); }
+
+    private:
+        map_t       _map;
+        MessageBits _bits;
+    };
+
+    //how many messages Window::_WndProc was sent and how many skipped dispatch
+    struct DispatchStats
+    {
+        unsigned long long messages; //every message
+        unsigned long long fastpath; //sent straight to cWndProc/DefWindowProc
+        unsigned long long batched;  //added to the window's InputBatch - see Window::BatchInput
+
+        DispatchStats() noexcept : messages(0), fastpath(0), batched(0) {}
+        //fraction of messages that took the fast path
+        inline double hitrate() const noexcept { return (messages != 0) ? (static_cast<double>(fastpath) / static_cast<double>(messages)) : 0.0; }
+    };
+}
@@ -17,17 +17,27 @@ limitations under the License.*/
 #include <forward_list>
 //#include <wrl/client.h> //needed for ComPtr
 //#include <dxgi1_5.h>    //needed for DXGI resources
+#include "WUIF_Const.h"
 #include "WindowProperties.h"
+#include "MessageMap.h"
 #include "GFX/GFX.h"
+#include "Utils/AllocTag.h"
+#include "Utils/FrameArena.h"
+#include "Utils/InputBatch.h"
+#include "Utils/Latency.h"
 
 namespace WUIF {
 
     class Window;
+    class WindowPool;
+    namespace App {
+        BOOL EndLayout();
+    }
 
     typedef void(*winptr)(Window*);
     struct wndprocThunk;
 
-    class Window : public WindowProperties, public GFXResources
+    class Window : public WindowProperties, public GFXResources, public AllocTagged<AllocTag::Window>
     {
     public:
         Window() noexcept(false);
@@ -39,7 +49,8 @@ namespace WUIF {
 
         //user WindowProcedure function
         typedef bool(*WndProc)(HWND, UINT, WPARAM, LPARAM, Window*);
-        std::unordered_map<int, WndProc> WndProc_map;
+        MessageMap<WndProc> WndProc_map;
+        DispatchStats       dispatchstats; //messages _WndProc was sent and how many skipped dispatch
 
         //functions
         void        DisplayWindow();
@@ -48,6 +59,18 @@ namespace WUIF {
         void        Present();
 
         std::forward_list<winptr> drawroutines;
+        FrameArena                framearena; //per frame scratch memory for drawroutines, reset by Present
+
+        /*input batching - while an input routine is set WM_MOUSEMOVE, WM_POINTERUPDATE and (with
+        rawmouse) WM_INPUT from the mouse are collected and passed to it once per frame by Present, before
+        the draw routines, instead of going to WndProc_map*/
+        typedef void(*InputProc)(Window*, const InputBatch&);
+        BOOL        BatchInput(_In_opt_ InputProc proc, _In_ bool keepall = false, _In_ bool rawmouse = false);
+
+        /*input to photon latency - histograms of input to Present and input to vblank plus the most
+        recent frames (latency().Recent), read them on the thread calling Present*/
+        void        MeasureLatency(_In_ bool enable);
+        inline const LatencyStats& latency() const noexcept { return latencystats; }
 
         //sub-classed substitute T_SC_WindowProc
         static LRESULT CALLBACK T_SC_WindowProc(_In_ HWND, _In_ UINT, _In_ WPARAM, _In_ LPARAM);
@@ -57,10 +80,29 @@ namespace WUIF {
         long          instance;  //number of window instances created
         wndprocThunk *thunk;	 //thunk for overloading WndProc with pointer to class object
 
-        bool          standby;   //if window is occluded we won't present any frames
+        FLAGS::Atomic_Window_Flags state; //STANDBY and RESIZEPENDING - Present may run off the UI thread
+        bool          pooled;    //idle in or handed out by WindowPool
+
+        UINT          _dpi;      //cached window dpi - see DPICache
+        unsigned long _dpiepoch; //DPICache epoch _dpi was read in
+
+        InputProc     inputroutine; //receives inputbatch each frame, nullptr when not batching
+        InputBatch    inputbatch;   //input since the last Present
+        bool          rawmouse;     //raw mouse input is registered to this window
+        LatencyStats  latencystats; //input to photon latency, see MeasureLatency
 
         //functions
         WNDPROC pWndProc();      //returns a pointer to the window's WndProc thunk
+        UINT    queryWindowDPI(); //reads the window's dpi from the monitor cache or the OS
+        void    setWindowDPI(_In_ UINT dpi, _In_ HMONITOR monitor); //WM_DPICHANGED
+        void    ResizeSwapChain(); //recreates the swap chain and size dependent resources
+        bool    BatchMessage(_In_ UINT message, _In_ WPARAM wParam, _In_ LPARAM lParam); //adds an input message to inputbatch
+        bool    ReadRawInput(_In_ HRAWINPUT input); //adds a WM_INPUT's mouse input and the mouse input queued behind it
+        BOOL    RegisterRawMouse(_In_ bool enable);
+        void    TagInput(_In_ UINT message, _In_ WPARAM wParam); //tags the first input after a Present
+        void    RecordPresent(_In_ long long input); //records the Present and the vblanks of earlier frames
+        friend BOOL App::EndLayout();
+        friend class WindowPool;
         //default WndProc for windows
         #if defined(_M_IX86)     //if compiling for x86
         static LRESULT CALLBACK _WndProc(_In_ Window*, _In_ HWND, _In_ UINT, _In_ WPARAM, _In_ LPARAM);
@@ -0,0 +1,49 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+
+namespace WUIF {
+
+    /*WindowClassCache
+    Window classes registered by WUIF, keyed by (icon, small icon, cursor, class style). Windows
+    whose class attributes are the same share one class atom instead of each registering its own.
+    Every Window holding the atom counts as a reference, the class is unregistered when the last
+    reference is released.
+
+    The classes use Window::T_SC_WindowProc as their WndProc - each window switches itself over to
+    its own thunk in WM_NCCREATE, so no window's thunk is tied to the class.
+
+    Changing the cursor of a shared class (WindowProperties::classcursor) changes it for every
+    window using the class, Detach() takes the class out of the lookup so windows created after
+    the change get a class with the requested cursor.*/
+    class WindowClassCache
+    {
+    public:
+        struct Statistics
+        {
+            unsigned long long registered;   //classes registered with RegisterClassEx
+            unsigned long long shared;       //Acquire calls served by an existing class
+            unsigned long long unregistered; //classes unregistered after their last Release
+            unsigned long      live;         //classes currently registered
+        };
+
+        //functions
+        static ATOM       Acquire(_In_ HICON icon, _In_ HICON iconsm, _In_ HCURSOR cursor, _In_ UINT style);
+        static void       Release(_In_ ATOM atom);
+        static void       Detach(_In_ ATOM atom);
+        static Statistics GetStatistics();
+
+        WindowClassCache() = delete;
+    };
+}
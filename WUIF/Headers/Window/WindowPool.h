@@ -0,0 +1,70 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+
+namespace WUIF {
+
+    class Window;
+
+    /*WindowPool
+    Keeps hidden, fully created windows (class, HWND, swap chain and D3D11/D2D resources) ready to
+    be handed out for popups such as tooltips and context menus. Windows are pooled by the width,
+    height, style and extended style they were requested with. Acquire() returns a pooled window
+    or creates one, Recycle() hides a window and keeps it for the next Acquire instead of
+    destroying it.
+
+    Settings::capacity limits the idle windows kept per (width, height, style, exstyle), windows
+    idle for longer than Settings::idletimeout are destroyed by Trim(). Acquire and Recycle trim,
+    an application that wants idle windows released sooner can call Trim() from a timer.
+
+    Windows belong to the thread that created them, the pool must only be used from the thread
+    running the message loop.*/
+    class WindowPool
+    {
+    public:
+        struct Settings
+        {
+            unsigned      capacity;    //idle windows kept per size and style, 0 disables pooling
+            unsigned long idletimeout; //milliseconds an idle window is kept, 0 - until Trim(true)
+        };
+
+        struct Statistics
+        {
+            unsigned long long hits;      //Acquire served by an idle window
+            unsigned long long misses;    //Acquire had to create a window
+            unsigned long long recycled;  //windows returned to the pool by Recycle
+            unsigned long long destroyed; //windows destroyed by Recycle or Trim
+            unsigned long      idle;      //windows currently in the pool
+        };
+
+        //functions
+        static void       Configure(_In_ const Settings &newsettings);
+        static Settings   GetSettings();
+        static void       Prewarm(_In_ int width, _In_ int height, _In_ unsigned count,
+                                  _In_ DWORD style = WS_POPUP, _In_ DWORD exstyle = WS_EX_TOOLWINDOW);
+        static Window*    Acquire(_In_ int width, _In_ int height, _In_ DWORD style = WS_POPUP,
+                                  _In_ DWORD exstyle = WS_EX_TOOLWINDOW);
+        static BOOL       Show(_In_ Window *win, _In_ int left, _In_ int top);
+        static void       Recycle(_In_ Window *win);
+        static unsigned   Trim(_In_ bool all = false);
+        static Statistics GetStatistics();
+
+        WindowPool() = delete;
+
+    private:
+        static Window* Create(_In_ int width, _In_ int height, _In_ DWORD style, _In_ DWORD exstyle);
+        static void    Forget(_In_ Window *win); //~Window - the window was destroyed
+        friend class Window;
+    };
+}
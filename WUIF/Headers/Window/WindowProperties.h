@@ -12,6 +12,8 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.*/
 #pragma once
+#include <vector>
+#include "WindowUpdate.h"
 
 namespace WUIF {
     class Window;
@@ -28,6 +30,7 @@ namespace WUIF {
 
         //class properties
         ATOM    _classatom; //class for window creation
+        bool    _sharedclass; //_classatom is from WindowClassCache
         HICON   _icon;
         HICON   _iconsm;
         HCURSOR _classcursor;
@@ -66,6 +69,10 @@ namespace WUIF {
         int     _cmdshow;
         bool    _fullscreen; //is window "fullscreen"
 
+        //BeginUpdate/Commit
+        unsigned     _updatedepth; //number of BeginUpdate calls without a matching Commit
+        WindowUpdate _update;      //changes made since the outermost BeginUpdate
+
     public:
         WindowProperties() noexcept;
        ~WindowProperties();
@@ -73,6 +80,11 @@ namespace WUIF {
         //functions
         inline bool    isInitialized() const { return initialized; }
         inline int     Scale(int x)    const { return (_fullscreen ? x : MulDiv(x, scaleFactor, 100)); }
+        //batch versions of Scale and its inverse, results are identical to calling MulDiv per value
+        void           ScalePoints  (_Inout_updates_(count) POINT *points, _In_ size_t count) const;
+        void           ScaleRects   (_Inout_updates_(count) RECT *rects, _In_ size_t count) const;
+        void           UnscalePoints(_Inout_updates_(count) POINT *points, _In_ size_t count) const;
+        void           UnscaleRects (_Inout_updates_(count) RECT *rects, _In_ size_t count) const;
 
         //class "getter" functions
         inline ATOM    classatom()     const { return _classatom; }
@@ -118,6 +130,7 @@ namespace WUIF {
         DWORD   hWndParent(_In_ const HWND v);
         DWORD   exstyle   (_In_ const DWORD v);
         HRESULT windowname(_In_ LPCTSTR v);
+        HRESULT windownameUTF8(_In_ const char *v);
         DWORD   style     (_In_ const DWORD v);
         BOOL    left      (_In_ const int v);
         BOOL    top       (_In_ const int v);
@@ -139,5 +152,35 @@ namespace WUIF {
 
         void background(_In_ const FLOAT v[4]);
         DPI_AWARENESS_CONTEXT threaddpiawarenesscontext(_In_ const DPI_AWARENESS_CONTEXT v);
+
+        //transactional updates - see WindowUpdate
+        struct DeferredPosition
+        {
+            HWND                   hWnd;
+            WindowUpdate::Position pos;
+        };
+        void  BeginUpdate();
+        DWORD Commit(_Inout_opt_ std::vector<DeferredPosition> *deferred = nullptr);
+        static UINT swpflags(_In_ const WindowUpdate::Position &pos); //SetWindowPos flags for pos
+        inline bool updating() const { return (_updatedepth != 0); }
+
+    private:
+        DWORD setstyle(_In_ const DWORD v); //applies the style immediately
+    };
+
+    /*WindowUpdateScope
+    RAII helper for WindowProperties::BeginUpdate/Commit - property changes made while the scope
+    is alive are applied together when it ends*/
+    class WindowUpdateScope
+    {
+    public:
+        explicit WindowUpdateScope(WindowProperties &props) : _props(props) { _props.BeginUpdate(); }
+        ~WindowUpdateScope() { _props.Commit(); }
+
+        WindowUpdateScope(const WindowUpdateScope&) = delete;
+        WindowUpdateScope& operator=(const WindowUpdateScope&) = delete;
+
+    private:
+        WindowProperties &_props;
     };
 }
\ No newline at end of file
@@ -0,0 +1,194 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstdint> //needed for uint32_t
+
+namespace WUIF {
+
+    /*WindowUpdate
+    Accumulates window property changes made between WindowProperties::BeginUpdate() and Commit()
+    and applies them with the fewest calls: one call per changed style word, one per changed
+    icon/cursor and a single SetWindowPos covering move, size, z-order and frame changes. Values
+    that end up equal to the window's current values are dropped.
+
+    The merge logic doesn't call Win32 directly, Apply() calls a Sink with these members (each
+    returns 0 on success or a system error code):
+        unsigned long SetStyle(uint32_t style);
+        unsigned long SetExStyle(uint32_t exstyle);
+        unsigned long SetCursor(void *cursor);
+        unsigned long SetIcon(bool big, void *icon);
+        unsigned long SetPosition(const WindowUpdate::Position &pos);
+    WindowProperties uses a sink that calls SetWindowLongPtr/SetClassLongPtr/WM_SETICON/
+    SetWindowPos, a recording sink can be used to check the merge logic without a window.*/
+    class WindowUpdate
+    {
+    public:
+        enum Field : unsigned
+        {
+            LEFT    = 0x001,
+            TOP     = 0x002,
+            WIDTH   = 0x004,
+            HEIGHT  = 0x008,
+            ZORDER  = 0x010,
+            SHOW    = 0x020,
+            STYLE   = 0x040,
+            EXSTYLE = 0x080,
+            ICON    = 0x100,
+            ICONSM  = 0x200,
+            CURSOR  = 0x400,
+            REFRESH = 0x800  //cached window data changed (e.g. menu), SetWindowPos must be called
+        };
+
+        //window values the update is compared against - width and height are in physical pixels
+        struct State
+        {
+            uint32_t style;
+            uint32_t exstyle;
+            int      left;
+            int      top;
+            int      width;
+            int      height;
+            void    *icon;
+            void    *iconsm;
+            void    *cursor;
+        };
+
+        //arguments for the single SetWindowPos call
+        struct Position
+        {
+            void *insertafter;
+            int   x;
+            int   y;
+            int   cx;
+            int   cy;
+            bool  move;         //false - SWP_NOMOVE
+            bool  size;         //false - SWP_NOSIZE
+            bool  zorder;       //false - SWP_NOZORDER
+            bool  framechanged; //SWP_FRAMECHANGED, styles changed
+            bool  show;         //SWP_SHOWWINDOW
+        };
+
+        //what Apply() did
+        struct Result
+        {
+            unsigned      applied; //Fields that were applied successfully
+            unsigned      calls;   //number of Sink calls made
+            unsigned long error;   //first error returned by the Sink, 0 if none
+        };
+
+        WindowUpdate() noexcept : _changed(0), _state(), _insertafter(nullptr) {}
+
+        //functions
+        inline void left   (int v)      { _state.left    = v; _changed |= LEFT; }
+        inline void top    (int v)      { _state.top     = v; _changed |= TOP; }
+        inline void width  (int v)      { _state.width   = v; _changed |= WIDTH; }   //physical pixels
+        inline void height (int v)      { _state.height  = v; _changed |= HEIGHT; }  //physical pixels
+        inline void style  (uint32_t v) { _state.style   = v; _changed |= STYLE; }
+        inline void exstyle(uint32_t v) { _state.exstyle = v; _changed |= EXSTYLE; }
+        inline void icon   (void *v)    { _state.icon    = v; _changed |= ICON; }
+        inline void iconsm (void *v)    { _state.iconsm  = v; _changed |= ICONSM; }
+        inline void cursor (void *v)    { _state.cursor  = v; _changed |= CURSOR; }
+        inline void zorder (void *insertafter) { _insertafter = insertafter; _changed |= ZORDER; }
+        inline void show   ()           { _changed |= SHOW; }
+        inline void refresh()           { _changed |= REFRESH; }
+
+        inline unsigned     changed() const { return _changed; }
+        inline bool         empty()   const { return (_changed == 0); }
+        inline const State& pending() const { return _state; } //only fields in changed() are valid
+        inline void         clear()         { _changed = 0; _insertafter = nullptr; }
+
+        /*Result Apply(const State &current, Sink &sink) const
+        Applies the pending changes that differ from current through sink. Styles are applied
+        before SetWindowPos as cached style data only takes effect with SWP_FRAMECHANGED. A failed
+        style, icon or cursor call does not stop the others, its Field is left out of
+        Result::applied.*/
+        template <class Sink>
+        Result Apply(const State &current, Sink &sink) const
+        {
+            Result res = { 0, 0, 0 };
+            auto call = [&res](unsigned field, unsigned long err)
+            {
+                res.calls++;
+                if (err == 0)
+                {
+                    res.applied |= field;
+                }
+                else if (res.error == 0)
+                {
+                    res.error = err;
+                }
+            };
+            bool framechanged = false;
+            if ((_changed & STYLE) && (_state.style != current.style))
+            {
+                call(STYLE, sink.SetStyle(_state.style));
+                framechanged |= ((res.applied & STYLE) != 0);
+            }
+            if ((_changed & EXSTYLE) && (_state.exstyle != current.exstyle))
+            {
+                call(EXSTYLE, sink.SetExStyle(_state.exstyle));
+                framechanged |= ((res.applied & EXSTYLE) != 0);
+            }
+            bool refresh = ((_changed & REFRESH) != 0);
+            if ((_changed & CURSOR) && (_state.cursor != current.cursor))
+            {
+                call(CURSOR, sink.SetCursor(_state.cursor));
+                //SetWindowPos ensures the new class cursor is used
+                refresh |= ((res.applied & CURSOR) != 0);
+            }
+            //ICON_SMALL must be set before ICON_BIG
+            if ((_changed & ICONSM) && (_state.iconsm != current.iconsm))
+            {
+                call(ICONSM, sink.SetIcon(false, _state.iconsm));
+            }
+            if ((_changed & ICON) && (_state.icon != current.icon))
+            {
+                call(ICON, sink.SetIcon(true, _state.icon));
+            }
+            Position pos;
+            pos.insertafter  = _insertafter;
+            pos.x            = (_changed & LEFT)   ? _state.left   : current.left;
+            pos.y            = (_changed & TOP)    ? _state.top    : current.top;
+            pos.cx           = (_changed & WIDTH)  ? _state.width  : current.width;
+            pos.cy           = (_changed & HEIGHT) ? _state.height : current.height;
+            pos.move         = ((pos.x != current.left) || (pos.y != current.top));
+            pos.size         = ((pos.cx != current.width) || (pos.cy != current.height));
+            pos.zorder       = ((_changed & ZORDER) != 0);
+            pos.framechanged = framechanged;
+            pos.show         = ((_changed & SHOW) != 0);
+            if (pos.move || pos.size || pos.zorder || pos.framechanged || pos.show || refresh)
+            {
+                unsigned fields = (_changed & (LEFT | TOP | WIDTH | HEIGHT | ZORDER | SHOW | REFRESH));
+                call(fields, sink.SetPosition(pos));
+            }
+            else
+            {
+                //nothing to do - values equal to the current ones count as applied
+                res.applied |= (_changed & (LEFT | TOP | WIDTH | HEIGHT | REFRESH));
+            }
+            //fields whose values equal the current ones are applied without a call
+            if ((_changed & STYLE)   && (_state.style   == current.style))   res.applied |= STYLE;
+            if ((_changed & EXSTYLE) && (_state.exstyle == current.exstyle)) res.applied |= EXSTYLE;
+            if ((_changed & CURSOR)  && (_state.cursor  == current.cursor))  res.applied |= CURSOR;
+            if ((_changed & ICONSM)  && (_state.iconsm  == current.iconsm))  res.applied |= ICONSM;
+            if ((_changed & ICON)    && (_state.icon    == current.icon))    res.applied |= ICON;
+            return res;
+        }
+
+    private:
+        unsigned _changed;
+        State    _state;
+        void    *_insertafter;
+    };
+}
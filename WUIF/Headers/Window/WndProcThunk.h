@@ -13,155 +13,61 @@ See the License for the specific language governing permissions and
 limitations under the License.*/
 // provides thunking code
 #pragma once
+#include "Utils/ThunkEmitter.h"
+#include "Utils/AllocTag.h"
 namespace WUIF {
-//thunk definition x86
-#if defined(_M_IX86)
-#pragma pack(push,1)
-    struct wndprocThunk
+    /*wndprocThunk
+    Binds a Window's *this to Window::_WndProc. The thunk code lives in a ThunkSlab slot and is
+    written once when the slab maps its block, the object and WndProc it uses are loaded from the
+    slot's data so Init only has to store two pointers. The wndprocThunk itself is an ordinary heap
+    object that owns the slot.*/
+    struct wndprocThunk : public AllocTagged<AllocTag::Thunk>
     {
-        unsigned short  m_push1;	    //push dword ptr [esp] ;push return address
-        unsigned short  m_push2;
-        unsigned short  m_mov1;         //mov dword ptr [esp+0x4], pThis ;set our new parameter by replacing old return address
-        unsigned char   m_mov2;         //(esp+0x4 is first parameter)
-        unsigned long   m_this;         //our object's *this to be moved to first parameter
-        unsigned char   m_jmp;          //jmp opcode
-        unsigned long   m_relproc;      //relative address for WndProc for jmp
-        static   HANDLE heapaddr;       //heap address this thunk will be initialized too
-        static   long   thunkInstances; //number of instances of this class
-        bool Init(_In_ const void *const pThis, _In_ DWORD_PTR proc)
-        {
-            m_push1   = 0x34ff; //ff 34 24 push DWORD PTR [esp]
-            m_push2   = 0xc724;
-            m_mov1    = 0x2444; //c7 44 24 04 mov dword ptr [esp+0x4],
-            m_mov2    = 0x04;
-            m_this    = PtrToUlong(pThis);
-            m_jmp     = 0xe9;   //jmp
-            //calculate relative address of proc to jump to
-            m_relproc = unsigned long((INT_PTR)proc - ((INT_PTR)this + sizeof(wndprocThunk)));
-            // write block from data cache and flush from instruction cache
-            return FlushInstructionCache(GetCurrentProcess(), this, sizeof(wndprocThunk));
-        }
-        WNDPROC GetThunkAddress()
-        {
-            //return the address for *this (wndprocThunk). Note: casted to WNDPROC
-            return reinterpret_cast<WNDPROC>(this);
-        }
-        #ifdef _DEBUG
-        static void* operator new(size_t size, int, char const*, int)
-        #else
-        static void* operator new(size_t size)
-        #endif
+        ThunkSlab::Slot slot;
+
+        wndprocThunk() noexcept : slot() {}
+        ~wndprocThunk()
         {
-            InterlockedIncrement(&thunkInstances);
-            //since we can't pass a value into delete we need to store our heap address for latter freeing
-            if (heapaddr == NULL)
+            if (slot.code != nullptr)
             {
-                heapaddr = HeapCreate(HEAP_GENERATE_EXCEPTIONS | HEAP_CREATE_ENABLE_EXECUTE, 0, 0);
-                if (heapaddr == NULL)
-                {
-                    SetLastError(WE_THUNK_HOOK_FAIL);
-                    throw WUIF::WUIF_exception(TEXT("HeapCreate failed for Window Thunk"));
-                }
+                Slab().Free(slot);
             }
-            return HeapAlloc(heapaddr, HEAP_ZERO_MEMORY, size);
         }
-        static void operator delete(void *pwndprocThunk) noexcept
+        wndprocThunk(const wndprocThunk&) = delete;
+        wndprocThunk& operator=(const wndprocThunk&) = delete;
+
+        bool Init(_In_ const void *const pThis, _In_ const DWORD_PTR proc)
         {
-            //decrement thunk instance count and if zero or negative (i.e. last thunk) destroy the heap
-            if (InterlockedDecrement(&thunkInstances) <= 0)
-            {
-                //check heapaddr is not NULL for added safety
-                if (heapaddr)
-                {
-                    //we do not need to call HeapFree first
-                    //if HeapDestroy fails we preserve the heapaddress and just to try to free the allocated heap memory
-                    if (HeapDestroy(heapaddr))
-                    {
-                        heapaddr = NULL;
-                    }
-                }
-            }
-            //if we have not destroyed the heap try to free this thunk's memory allocation
-            if (heapaddr != NULL)
+            if ((slot.code == nullptr) && (!Slab().Allocate(slot)))
             {
-                HeapFree(heapaddr, 0, pwndprocThunk);
+                return false;
             }
-        }
-    };
-#pragma pack(pop)
-    //thunk definition x64
-#elif defined(_M_AMD64)
-#pragma pack(push,2)
-    struct wndprocThunk
-    {
-        unsigned short     RaxMov;         //movabs rax, pThis ;push object *this into rax
-        unsigned long long RaxImm;
-        unsigned long      RspMov;         //mov [rsp+28], rax ;push *this into stack space as 5th function parameter
-        unsigned short     RspMov1;
-        unsigned short     Rax2Mov;        //movabs rax, proc ;load the address of WndProc function into rax
-        unsigned long long ProcImm;
-        unsigned short     RaxJmp;         //jmp rax ;jump to the start of WndProc function
-        static   HANDLE    heapaddr;       //heap address this thunk will be initialized too
-        static   long      thunkInstances; //number of instances of this class
-        bool Init(_In_ const void *const pThis, _In_ const DWORD_PTR proc)
-        {
-            RaxMov  = 0xb848;                    //movabs rax (48 B8), pThis
-            RaxImm  = reinterpret_cast<unsigned long long>(pThis);
-            RspMov  = 0x24448948;                //mov qword ptr [rsp+28h], rax (48 89 44 24 28)
-            RspMov1 = 0x9028;                    //to properly byte align the instruction we add a nop (no operation) (90)
-            Rax2Mov = 0xb848;                    //movabs rax (48 B8), proc
-            ProcImm = static_cast<unsigned long long>(proc);
-            RaxJmp  = 0xe0ff;                    //jmp rax (FF EO)
-            // write block from data cache and flush from instruction cache
-            return FlushInstructionCache(GetCurrentProcess(), this, sizeof(wndprocThunk));
+            slot.data->object.store(reinterpret_cast<uintptr_t>(pThis), std::memory_order_relaxed);
+            slot.data->target.store(static_cast<uintptr_t>(proc), std::memory_order_release);
+            return true;
         }
         WNDPROC GetThunkAddress()
         {
-            //return the address for *this (wndprocThunk). Note: casted to WNDPROC
-            return reinterpret_cast<WNDPROC>(this);
+            //return the address of the thunk code. Note: casted to WNDPROC
+            return reinterpret_cast<WNDPROC>(slot.code);
         }
-        #ifdef _DEBUG
-        static __declspec(allocator) void* operator new(size_t size, int, char const*, int)
-        #else
-        static __declspec(allocator) void* operator new(size_t size)
-        #endif
+
+        //the process-wide slab all window thunks are allocated from
+        static ThunkSlab& Slab()
         {
-            InterlockedIncrement(&thunkInstances);
-            //since we can't pass a value into delete we need to store our heap address for latter freeing
-            if (heapaddr == NULL)
-            {
-                heapaddr = HeapCreate(HEAP_GENERATE_EXCEPTIONS | HEAP_CREATE_ENABLE_EXECUTE, 0, 0);
-                if (heapaddr == NULL)
-                {
-                    SetLastError(WE_THUNK_HOOK_FAIL);
-                    throw WUIF::WUIF_exception(TEXT("HeapCreate failed for Window Thunk"));
-                }
-            }
-            return HeapAlloc(heapaddr, HEAP_ZERO_MEMORY, size);
+            static ThunkSlab slab(Emit);
+            return slab;
         }
-        static void operator delete(void *pwndprocThunk) noexcept
+
+        /*writes the thunk code for one slot - the x86 _WndProc takes the Window* as its first
+        parameter, the x64 _WndProc as its fifth, which the caller reserves at [rsp+28h]*/
+        static void Emit(unsigned char *code, const ThunkSlab::Data *data)
         {
-            //decrement thunk instance count and if zero or negative (i.e. last thunk) destroy the heap
-            if (InterlockedDecrement(&thunkInstances) <= 0)
-            {
-                //check heapaddr is not NULL for added safety
-                if (heapaddr)
-                {
-                    //we do not need to call HeapFree first
-                    //if HeapDestroy fails we preserve the heapaddress and just to try to free the allocated heap memory
-                    if (HeapDestroy(heapaddr))
-                    {
-                        heapaddr = NULL;
-                    }
-                }
-            }
-            //if we have not destroyed the heap try to free this thunk's memory allocation
-            if (heapaddr != NULL)
-            {
-                HeapFree(heapaddr, 0, pwndprocThunk);
-            }
+#if defined(_M_IX86)
+            ThunkEmitter::X86First(code, data);
+#elif defined(_M_AMD64)
+            ThunkEmitter::Win64<4>(code, data);
+#endif
         }
     };
-#pragma pack(pop)
-#endif
-};
\ No newline at end of file
+};
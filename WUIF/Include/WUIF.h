@@ -43,6 +43,12 @@ limitations under the License.*/
 #include "../Headers/Application/Application.h"
 #include "../Headers/Window/Window.h"
 #include "../Headers/GFX/GFX.h"
+#include "../Headers/Utils/TraceSpan.h" //WUIF_TRACE_SPAN, define TRACESPANS to enable
+#include "../Headers/Utils/AllocTag.h" //AllocStats::Take/Diff for allocation accounting
+#include "../Headers/Utils/UTF.h" //UTF16Buffer/UTF8Buffer for UTF-8 strings at the API boundary
+#include "../Headers/Application/Watchdog.h" //Watchdog::Start for UI thread stall reports
+#include "../Headers/Application/Profiler.h" //Profiler::Start/Export and WUIF_PHASE for flame graphs
+#include "../Headers/Application/PerfCounters.h" //CounterRegistry::Register for counters Tools/CounterView reads
 
 
 //define to indicate on hybrid graphics systems to prefer the discrete part by default
@@ -109,7 +115,7 @@ in assembly code. If we declare it here we get two definitions and now nothing w
 assign the value to "appgfxflag" and in WUIF_Main.h place appgfxflag's value into "WUIF::App::GFXflags" which is what is actually used. We
 use a class so that after the value is placed into WUIF::App::GFXflags we can delete the memory overhead of appgfxflag.*/
 namespace WUIF {
-    class tempInitializer {
+    class tempInitializer : public AllocTagged<AllocTag::App> {
     public:
         const FLAGS::GFX_Flags appgfxflag;
         const OSVersion minosversion;
@@ -22,4 +22,4 @@ Window *App::mainWindow = nullptr;
 
 void(*App::ExceptionHandler)(void) = nullptr;
 
-std::unordered_map<int, WNDPROC> App::GWndProc_map;
\ No newline at end of file
+MessageMap<WNDPROC> App::GWndProc_map;
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+
+#include "stdafx.h"
+#include "Application/Application.h"
+#include "Application/DPIAPI.h"
+
+using namespace WUIF;
+
+const DPIAPI *volatile DPIAPI::instance = nullptr;
+
+namespace {
+    /*bool ContextsEqual(_In_ DPIAPI::PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL pfnequal,
+                         _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context,
+                         _In_ DPI_AWARENESS_CONTEXT value)
+    returns true if the context pointer is set and the context it points to is equal to value*/
+    bool ContextsEqual(_In_opt_ DPIAPI::PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL pfnequal,
+                       _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context,
+                       _In_ DPI_AWARENESS_CONTEXT value)
+    {
+        if ((pfnequal == nullptr) || (context == nullptr))
+        {
+            return false;
+        }
+        return (pfnequal(*context, value) != FALSE);
+    }
+}
+
+DPIAPI::DPIAPI(_In_opt_ const volatile PROCESS_DPI_AWARENESS *awareness,
+               _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context) :
+    AreDpiAwarenessContextsEqual(_api.AreDpiAwarenessContextsEqual),
+    GetThreadDpiAwarenessContext(_api.GetThreadDpiAwarenessContext),
+    SetThreadDpiAwarenessContext(_api.SetThreadDpiAwarenessContext),
+    EnableNonClientDpiScaling(_api.EnableNonClientDpiScaling),
+    GetDpiForWindow(_api.GetDpiForWindow),
+    GetDpiForMonitor(_api.GetDpiForMonitor),
+    processdpiawareness((awareness != nullptr) ? *awareness : PROCESS_DPI_UNAWARE),
+    processdpiawarenesscontext((context != nullptr) ? *context : NULL),
+    hasprocessdpiawareness(awareness != nullptr),
+    hasprocessdpiawarenesscontext(context != nullptr),
+    //only per monitor aware processes need to respond to WM_DPICHANGED
+    permonitoraware(ContextsEqual(AreDpiAwarenessContextsEqual, context, DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2) ||
+                    ContextsEqual(AreDpiAwarenessContextsEqual, context, DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE) ||
+                    ((awareness != nullptr) && (*awareness == PROCESS_PER_MONITOR_DPI_AWARE))),
+    dpiunaware(ContextsEqual(AreDpiAwarenessContextsEqual, context, DPI_AWARENESS_CONTEXT_UNAWARE) ||
+               ((awareness != nullptr) && (*awareness == PROCESS_DPI_UNAWARE)))
+{ }
+
+/*const DPIAPI& DPIAPI::Initialize(_In_opt_ const volatile PROCESS_DPI_AWARENESS *awareness,
+                                   _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context)
+Builds the process-wide DPI API table. Only the first call builds the table, any later call
+ignores its parameters and returns the existing table. Must be called after OSCheck as the
+entry points that are required depend on App::winversion.
+
+PROCESS_DPI_AWARENESS *awareness - pointer to the process' DPI awareness or nullptr if unknown
+DPI_AWARENESS_CONTEXT *context   - pointer to the process' DPI awareness context or nullptr if
+                                   unknown or not supported
+
+Return value
+const DPIAPI& - the process-wide table
+*/
+const DPIAPI& DPIAPI::Initialize(_In_opt_ const volatile PROCESS_DPI_AWARENESS *awareness,
+                                 _In_opt_ const volatile DPI_AWARENESS_CONTEXT *context)
+{
+    //function static so construction is thread-safe and happens exactly once
+    static const DPIAPI table(awareness, context);
+    instance = &table;
+    return table;
+}
@@ -0,0 +1,95 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <psapi.h> //needed for GetProcessMemoryInfo (K32GetProcessMemoryInfo in kernel32)
+#include "Application/PerfCounters.h"
+#include "Utils/AllocTag.h"
+
+using namespace WUIF;
+
+//constant initialized to the sink, so counters can be updated before Start
+Counter PerfCounters::framespresented;
+Counter PerfCounters::framesskipped;
+Counter PerfCounters::messages;
+Counter PerfCounters::swapchaincreated;
+Counter PerfCounters::swapchainresized;
+Counter PerfCounters::devicelost;
+Counter PerfCounters::windows;
+Counter PerfCounters::workingset;
+Counter PerfCounters::privatebytes;
+Counter PerfCounters::tagged;
+
+namespace {
+    ULONGLONG lastsample = 0; //GetTickCount64 of the last Sample
+
+    //registers name unless counter already is (Start called twice)
+    void Bind(Counter &counter, const char *name, CounterRegistry::Kind kind)
+    {
+        if (counter.registered())
+        {
+            return;
+        }
+        counter = CounterRegistry::Register(name, kind);
+    }
+}
+
+/*BOOL PerfCounters::Start()
+Registers the framework counters. See PerfCounters.h*/
+BOOL PerfCounters::Start()
+{
+    Bind(framespresented,  "frames.presented",    CounterRegistry::COUNTER);
+    Bind(framesskipped,    "frames.skipped",      CounterRegistry::COUNTER);
+    Bind(messages,         "messages.dispatched", CounterRegistry::COUNTER);
+    Bind(swapchaincreated, "swapchain.created",   CounterRegistry::COUNTER);
+    Bind(swapchainresized, "swapchain.resized",   CounterRegistry::COUNTER);
+    Bind(devicelost,       "device.lost",         CounterRegistry::COUNTER);
+    Bind(windows,          "windows",             CounterRegistry::GAUGE);
+    Bind(workingset,       "memory.workingset",   CounterRegistry::GAUGE);
+    Bind(privatebytes,     "memory.private",      CounterRegistry::GAUGE);
+    Bind(tagged,           "memory.tagged",       CounterRegistry::GAUGE);
+    lastsample = 0;
+    Sample();
+    return CounterRegistry::Published() ? TRUE : FALSE;
+}
+
+void PerfCounters::Stop()
+{
+    CounterRegistry::Unpublish();
+}
+
+/*void PerfCounters::Sample()
+Updates the memory gauges, at most once a second - cheap enough to call every idle loop*/
+void PerfCounters::Sample()
+{
+    const ULONGLONG now = GetTickCount64();
+    if ((lastsample != 0) && ((now - lastsample) < 1000))
+    {
+        return;
+    }
+    lastsample = now;
+    PROCESS_MEMORY_COUNTERS_EX pmc = {};
+    pmc.cb = sizeof(pmc);
+    if (GetProcessMemoryInfo(GetCurrentProcess(), reinterpret_cast<PROCESS_MEMORY_COUNTERS*>(&pmc), sizeof(pmc)))
+    {
+        workingset.Set(static_cast<int64_t>(pmc.WorkingSetSize));
+        privatebytes.Set(static_cast<int64_t>(pmc.PrivateUsage));
+    }
+    const AllocStats::Snapshot snap = AllocStats::Take();
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < AllocStats::tagcount; i++)
+    {
+        bytes += snap.tags[i].bytes;
+    }
+    tagged.Set(static_cast<int64_t>(bytes));
+}
@@ -0,0 +1,403 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <DbgHelp.h>      //needed for SymFromAddr
+#include <memory>         //needed for std::unique_ptr
+#include <string>         //needed for std::string
+#include <thread>         //needed for std::thread
+#include <unordered_map>  //needed for std::unordered_map
+#include "Application/Application.h"
+#include "Application/Profiler.h"
+#include "Application/StackSampler.h"
+#include "Utils/StackHistogram.h"
+#include "Utils/dllhelper.h"
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+using namespace WUIF;
+
+namespace {
+    struct Thread
+    {
+        PhaseSlot    slot;
+        StackSampler sampler;
+        const char  *name = nullptr;
+        bool         used = false;
+    };
+
+    struct State
+    {
+        std::mutex                      control; //Start/Stop
+        std::atomic<bool>               running{ false };
+        std::thread                     sampler;
+        HANDLE                          stop  = NULL;
+        HANDLE                          timer = NULL;
+        std::mutex                      lock;    //threads, histogram and failed - held for a whole sampling pass
+        Thread                          threads[Profiler::maxthreads];
+        std::unique_ptr<StackHistogram> histogram;
+        unsigned long long              failed = 0;
+    };
+
+    State& Get()
+    {
+        static State state;
+        return state;
+    }
+
+    //phases of a thread, copied while it is suspended
+    struct Phases
+    {
+        const PhaseSlot *slot;
+        const char      *names[PhaseSlot::maxdepth];
+        size_t           depth;
+    };
+
+    void CopyPhases(void *context)
+    {
+        Phases &phases = *static_cast<Phases*>(context);
+        const uint32_t depth = phases.slot->depth;
+        phases.depth = (depth < PhaseSlot::maxdepth) ? depth : PhaseSlot::maxdepth;
+        for (size_t i = 0; i < phases.depth; i++)
+        {
+            phases.names[i] = phases.slot->names[i];
+        }
+    }
+
+    //sampler thread
+    void Sample()
+    {
+        State &s = Get();
+        const HANDLE handles[2] = { s.stop, s.timer };
+        void *frames[StackSampler::maxframes];
+        while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == (WAIT_OBJECT_0 + 1))
+        {
+            std::lock_guard<std::mutex> guard(s.lock);
+            for (size_t i = 0; i < Profiler::maxthreads; i++)
+            {
+                Thread &thread = s.threads[i];
+                if (!thread.used)
+                {
+                    continue;
+                }
+                Phases phases;
+                phases.slot  = &thread.slot;
+                phases.depth = 0;
+                const size_t count = thread.sampler.Capture(frames, CopyPhases, &phases);
+                if (count == 0)
+                {
+                    s.failed++;
+                    continue;
+                }
+                s.histogram->Add(static_cast<uint32_t>(i), phases.names, phases.depth, frames, count);
+            }
+        }
+    }
+
+    /*Symbols
+    DbgHelp symbolizer for Export - DbgHelp is loaded when a profile is exported and released
+    afterwards. Names are cached as stacks share most of their frames*/
+    class Symbols
+    {
+    public:
+        using PFN_SYM_SET_OPTIONS = DWORD(WINAPI*)(DWORD);
+        using PFN_SYM_INITIALIZE  = BOOL(WINAPI*)(HANDLE, PCSTR, BOOL);
+        using PFN_SYM_FROM_ADDR   = BOOL(WINAPI*)(HANDLE, DWORD64, PDWORD64, PSYMBOL_INFO);
+        using PFN_SYM_CLEANUP     = BOOL(WINAPI*)(HANDLE);
+
+        Symbols() :
+            _dbghelpdll(TEXT("dbghelp.dll"), OSVersion::WIN7),
+            SymSetOptions(_dbghelpdll.assign("SymSetOptions", OSVersion::WIN7)),
+            SymInitialize(_dbghelpdll.assign("SymInitialize", OSVersion::WIN7)),
+            SymFromAddr(_dbghelpdll.assign("SymFromAddr", OSVersion::WIN7)),
+            SymCleanup(_dbghelpdll.assign("SymCleanup", OSVersion::WIN7)),
+            _process(GetCurrentProcess()),
+            _initialized(false)
+        {
+            if (SymSetOptions && SymInitialize && SymFromAddr && SymCleanup)
+            {
+                SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS | SYMOPT_FAIL_CRITICAL_ERRORS);
+                _initialized = (SymInitialize(_process, nullptr, TRUE) != FALSE);
+            }
+        }
+        ~Symbols()
+        {
+            if (_initialized)
+            {
+                SymCleanup(_process);
+            }
+        }
+
+        Symbols(const Symbols&) = delete;
+        Symbols& operator=(const Symbols&) = delete;
+
+        //appends "module!function", or module+offset if there is no symbol
+        void Append(std::string &out, const void *frame)
+        {
+            const std::unordered_map<const void*, std::string>::const_iterator cached = _names.find(frame);
+            if (cached != _names.end())
+            {
+                out += cached->second;
+                return;
+            }
+            char text[MAX_PATH + 32];
+            StackSampler::Name(frame, text, ARRAYSIZE(text));
+            std::string name(text);
+            union
+            {
+                SYMBOL_INFO info;
+                char        buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+            } symbol;
+            symbol.info.SizeOfStruct = sizeof(SYMBOL_INFO);
+            symbol.info.MaxNameLen   = MAX_SYM_NAME;
+            DWORD64 displacement = 0;
+            if (_initialized && SymFromAddr(_process, reinterpret_cast<DWORD64>(frame), &displacement, &symbol.info))
+            {
+                const size_t plus = name.find('+');
+                if (plus != std::string::npos)
+                {
+                    name.erase(plus);
+                }
+                name += '!';
+                name.append(symbol.info.Name, symbol.info.NameLen);
+            }
+            out += name;
+            _names.emplace(frame, std::move(name));
+        }
+
+    private:
+        DllHelper _dbghelpdll;
+        const PFN_SYM_SET_OPTIONS SymSetOptions;
+        const PFN_SYM_INITIALIZE  SymInitialize;
+        const PFN_SYM_FROM_ADDR   SymFromAddr;
+        const PFN_SYM_CLEANUP     SymCleanup;
+        HANDLE _process;
+        bool   _initialized;
+        std::unordered_map<const void*, std::string> _names;
+    };
+
+    void Release(State &s)
+    {
+        if (s.timer != NULL)
+        {
+            CloseHandle(s.timer);
+            s.timer = NULL;
+        }
+        if (s.stop != NULL)
+        {
+            CloseHandle(s.stop);
+            s.stop = NULL;
+        }
+    }
+}
+
+/*BOOL Profiler::Start(_In_ UINT rate, _In_ size_t maxstacks)
+Starts the sampler thread. See Profiler.h*/
+BOOL Profiler::Start(_In_ UINT rate, _In_ size_t maxstacks)
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.control);
+    if (s.running.load(std::memory_order_acquire))
+    {
+        SetLastError(ERROR_ALREADY_INITIALIZED);
+        return FALSE;
+    }
+    if ((rate == 0) || (rate > 1000) || (maxstacks == 0))
+    {
+        SetLastError(WE_INVALIDARG);
+        return FALSE;
+    }
+    try
+    {
+        std::unique_ptr<StackHistogram> histogram(CRT_NEW StackHistogram(maxstacks));
+        std::lock_guard<std::mutex> lock(s.lock);
+        s.histogram = std::move(histogram);
+        s.failed    = 0;
+    }
+    catch (const std::bad_alloc&)
+    {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+    if ((PhaseMarker::Slot() == nullptr) && !AddThread("UI"))
+    {
+        return FALSE;
+    }
+    s.stop  = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+    s.timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (s.timer == NULL)
+    {
+        //high resolution timers need Windows 10 1803
+        s.timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+    }
+    const LONG period = static_cast<LONG>(1000 / rate);
+    LARGE_INTEGER due;
+    due.QuadPart = -10000LL * period; //relative, 100 ns units
+    if ((s.stop == NULL) || (s.timer == NULL) || !SetWaitableTimer(s.timer, &due, period, nullptr, nullptr, FALSE))
+    {
+        const DWORD error = GetLastError();
+        Release(s);
+        SetLastError(error);
+        return FALSE;
+    }
+    try
+    {
+        s.sampler = std::thread(Sample);
+    }
+    catch (...)
+    {
+        Release(s);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+    s.running.store(true, std::memory_order_release);
+    return TRUE;
+}
+
+/*void Profiler::Stop()
+Stops the sampler thread, the histogram is kept for Export*/
+void Profiler::Stop()
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.control);
+    if (!s.running.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    SetEvent(s.stop);
+    s.sampler.join();
+    CancelWaitableTimer(s.timer);
+    Release(s);
+    s.running.store(false, std::memory_order_release);
+}
+
+bool Profiler::Running()
+{
+    return Get().running.load(std::memory_order_acquire);
+}
+
+/*BOOL Profiler::AddThread(_In_z_ const char *name)
+Profiles the calling thread. See Profiler.h*/
+BOOL Profiler::AddThread(_In_z_ const char *name)
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (PhaseMarker::Slot() != nullptr)
+    {
+        return TRUE; //already profiled
+    }
+    for (size_t i = 0; i < maxthreads; i++)
+    {
+        Thread &thread = s.threads[i];
+        if (!thread.used)
+        {
+            if (!thread.sampler.Open(GetCurrentThreadId()))
+            {
+                return FALSE;
+            }
+            thread.slot.depth   = 0;
+            thread.name         = name;
+            thread.used         = true;
+            PhaseMarker::Slot() = &thread.slot;
+            return TRUE;
+        }
+    }
+    SetLastError(ERROR_TOO_MANY_THREADS);
+    return FALSE;
+}
+
+/*void Profiler::RemoveThread()
+Stops profiling the calling thread - its samples stay in the histogram*/
+void Profiler::RemoveThread()
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.lock);
+    PhaseSlot *&slot = PhaseMarker::Slot();
+    for (size_t i = 0; (slot != nullptr) && (i < maxthreads); i++)
+    {
+        Thread &thread = s.threads[i];
+        if (&thread.slot == slot)
+        {
+            thread.sampler.Close();
+            thread.used = false;
+            slot        = nullptr;
+        }
+    }
+}
+
+/*BOOL Profiler::Export(_In_ LPCTSTR path)
+Writes the folded stacks. See Profiler.h*/
+BOOL Profiler::Export(_In_ LPCTSTR path)
+{
+    State &s = Get();
+    std::string folded;
+    {
+        std::lock_guard<std::mutex> guard(s.lock);
+        if (!s.histogram)
+        {
+            SetLastError(ERROR_INVALID_STATE);
+            return FALSE;
+        }
+        Symbols symbols;
+        //a thread slot's name stays readable after RemoveThread until the slot is reused
+        s.histogram->Folded(folded,
+            [&s](std::string &out, uint32_t thread) { out += (s.threads[thread].name != nullptr) ? s.threads[thread].name : "thread"; },
+            [&symbols](std::string &out, const void *frame) { symbols.Append(out, frame); });
+    }
+    HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+    DWORD written = 0;
+    const BOOL ok = WriteFile(file, folded.data(), static_cast<DWORD>(folded.size()), &written, nullptr) &&
+                    (written == static_cast<DWORD>(folded.size()));
+    const DWORD error = GetLastError();
+    CloseHandle(file);
+    SetLastError(error);
+    return ok;
+}
+
+void Profiler::Reset()
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.lock);
+    if (s.histogram)
+    {
+        s.histogram->Clear();
+    }
+    s.failed = 0;
+}
+
+Profiler::Statistics Profiler::GetStatistics()
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.lock);
+    Statistics stats = {};
+    if (s.histogram)
+    {
+        const StackHistogram::Statistics histogram = s.histogram->statistics();
+        stats.samples  = histogram.samples;
+        stats.dropped  = histogram.dropped;
+        stats.stacks   = histogram.stacks;
+        stats.capacity = histogram.capacity;
+    }
+    stats.failed = s.failed;
+    for (size_t i = 0; i < maxthreads; i++)
+    {
+        stats.threads += s.threads[i].used ? 1 : 0;
+    }
+    return stats;
+}
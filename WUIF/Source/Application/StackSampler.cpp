@@ -0,0 +1,186 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <strsafe.h> //needed for StringCchPrintfA
+#include "Application/StackSampler.h"
+
+using namespace WUIF;
+
+namespace {
+    /*size_t Unwind(CONTEXT &context, uintptr_t low, uintptr_t high, unsigned char *copy, void **frames)
+    Walks the copy of the stack that was at [low, high) in the sampled thread. Stack addresses held
+    in registers and in the copy are moved into the copy first, so the walk never reads the live
+    stack. The walk can still run off the copy on a corrupt or truncated stack - the caller catches
+    that*/
+    size_t Unwind(CONTEXT &context, uintptr_t low, uintptr_t high, unsigned char *copy, void **frames)
+    {
+        const uintptr_t copylow  = reinterpret_cast<uintptr_t>(copy);
+        const uintptr_t copyhigh = copylow + (high - low);
+        for (uintptr_t *word = reinterpret_cast<uintptr_t*>(copy); word < reinterpret_cast<uintptr_t*>(copyhigh); ++word)
+        {
+            if ((*word >= low) && (*word < high))
+            {
+                *word = (*word - low) + copylow;
+            }
+        }
+        #define REBASE(r) if ((static_cast<uintptr_t>(r) >= low) && (static_cast<uintptr_t>(r) < high)) { r = (r - low) + copylow; }
+        size_t count = 0;
+        #if defined(_M_X64) || defined(_M_AMD64)
+        REBASE(context.Rsp) REBASE(context.Rbp) REBASE(context.Rbx) REBASE(context.Rsi) REBASE(context.Rdi)
+        REBASE(context.R12) REBASE(context.R13) REBASE(context.R14) REBASE(context.R15)
+        while ((count < StackSampler::maxframes) && (context.Rip != 0))
+        {
+            frames[count++] = reinterpret_cast<void*>(context.Rip);
+            if ((context.Rsp < copylow) || (context.Rsp >= copyhigh))
+            {
+                break;
+            }
+            DWORD64 imagebase = 0;
+            PRUNTIME_FUNCTION function = RtlLookupFunctionEntry(context.Rip, &imagebase, nullptr);
+            if (function == nullptr)
+            {
+                //leaf function - the return address is at rsp
+                context.Rip  = *reinterpret_cast<const DWORD64*>(context.Rsp);
+                context.Rsp += 8;
+            }
+            else
+            {
+                PVOID   handlerdata = nullptr;
+                DWORD64 establisher = 0;
+                RtlVirtualUnwind(UNW_FLAG_NHANDLER, imagebase, context.Rip, function, &context, &handlerdata, &establisher, nullptr);
+            }
+        }
+        #elif defined(_M_IX86)
+        REBASE(context.Esp) REBASE(context.Ebp)
+        frames[count++] = reinterpret_cast<void*>(context.Eip);
+        uintptr_t frame = context.Ebp;
+        while ((count < StackSampler::maxframes) && (frame >= copylow) && (frame + 8 <= copyhigh) && ((frame & 3) == 0))
+        {
+            const uintptr_t next    = reinterpret_cast<const uintptr_t*>(frame)[0];
+            const uintptr_t retaddr = reinterpret_cast<const uintptr_t*>(frame)[1];
+            if (retaddr == 0)
+            {
+                break;
+            }
+            frames[count++] = reinterpret_cast<void*>(retaddr);
+            if (next <= frame)
+            {
+                break;
+            }
+            frame = next;
+        }
+        #endif
+        #undef REBASE
+        return count;
+    }
+
+    //Unwind under SEH - kept free of C++ objects so __try can be used
+    size_t SafeUnwind(CONTEXT &context, uintptr_t low, uintptr_t high, unsigned char *copy, void **frames)
+    {
+        __try
+        {
+            return Unwind(context, low, high, copy, frames);
+        }
+        __except (EXCEPTION_EXECUTE_HANDLER)
+        {
+            return 0;
+        }
+    }
+}
+
+BOOL StackSampler::Open(_In_ DWORD threadid)
+{
+    Close();
+    _thread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, threadid);
+    _stack  = static_cast<unsigned char*>(VirtualAlloc(nullptr, stackcopy, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+    if ((_thread == NULL) || (_stack == nullptr))
+    {
+        const DWORD error = GetLastError();
+        Close();
+        SetLastError(error);
+        return FALSE;
+    }
+    _threadid = threadid;
+    return TRUE;
+}
+
+void StackSampler::Close()
+{
+    if (_thread != NULL)
+    {
+        CloseHandle(_thread);
+        _thread = NULL;
+    }
+    if (_stack != nullptr)
+    {
+        VirtualFree(_stack, 0, MEM_RELEASE);
+        _stack = nullptr;
+    }
+    _threadid = 0;
+}
+
+size_t StackSampler::Capture(_Out_writes_(maxframes) void **frames, _In_opt_ Suspended suspended, _In_opt_ void *context)
+{
+    if ((_thread == NULL) || (SuspendThread(_thread) == static_cast<DWORD>(-1)))
+    {
+        return 0;
+    }
+    CONTEXT registers = {};
+    registers.ContextFlags = CONTEXT_FULL;
+    uintptr_t low  = 0;
+    uintptr_t high = 0;
+    //SuspendThread is asynchronous, GetThreadContext waits until the thread is actually suspended
+    if (GetThreadContext(_thread, &registers))
+    {
+        #if defined(_M_X64) || defined(_M_AMD64)
+        low = static_cast<uintptr_t>(registers.Rsp);
+        #elif defined(_M_IX86)
+        low = static_cast<uintptr_t>(registers.Esp);
+        #endif
+        //the committed part of a stack is one region ending at the stack base
+        MEMORY_BASIC_INFORMATION mbi;
+        if ((VirtualQuery(reinterpret_cast<LPCVOID>(low), &mbi, sizeof(mbi)) != 0) && (mbi.State == MEM_COMMIT))
+        {
+            high = reinterpret_cast<uintptr_t>(mbi.BaseAddress) + mbi.RegionSize;
+            high = ((high - low) > stackcopy) ? (low + stackcopy) : high;
+            memcpy(_stack, reinterpret_cast<const void*>(low), high - low);
+        }
+        if (suspended != nullptr)
+        {
+            suspended(context);
+        }
+    }
+    ResumeThread(_thread);
+    return (high > low) ? SafeUnwind(registers, low, high, _stack, frames) : 0;
+}
+
+void StackSampler::Name(_In_opt_ const void *address, _Out_writes_(size) char *text, _In_ size_t size)
+{
+    HMODULE module = NULL;
+    char path[MAX_PATH];
+    if ((address != nullptr) &&
+        GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           static_cast<LPCSTR>(address), &module) &&
+        (GetModuleFileNameA(module, path, MAX_PATH) != 0))
+    {
+        const char *name = strrchr(path, '\\');
+        name = (name != nullptr) ? (name + 1) : path;
+        StringCchPrintfA(text, size, "%s+0x%llx", name,
+                         static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(module)));
+    }
+    else
+    {
+        StringCchPrintfA(text, size, "0x%p", address);
+    }
+}
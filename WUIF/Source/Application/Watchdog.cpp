@@ -0,0 +1,274 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <strsafe.h>           //needed for StringCchPrintfA
+#include <condition_variable>  //needed for std::condition_variable
+#include <mutex>               //needed for std::mutex
+#include <thread>              //needed for std::thread
+#include "Application/Watchdog.h"
+#include "Application/StackSampler.h"
+
+using namespace WUIF;
+
+Watchdog::Detector Watchdog::detector;
+
+namespace {
+    struct Sample
+    {
+        void  *frames[StackSampler::maxframes];
+        size_t count;
+    };
+
+    struct State
+    {
+        std::mutex                 control;  //Start/Stop
+        std::atomic<bool>          running{ false };
+        std::thread                watcher;
+        std::mutex                 wakelock;
+        std::condition_variable    wake;
+        bool                       stop = false;
+        StackSampler               uithread;
+        HANDLE                     report = INVALID_HANDLE_VALUE;
+        TCHAR                      reportpath[MAX_PATH] = {};
+        Sample                     last = {};       //previous sample of the current stall
+        WatchActivity              activity = {};   //activity written last
+        std::atomic<unsigned long long> stalls{ 0 };
+    };
+
+    State& Get()
+    {
+        static State state;
+        return state;
+    }
+
+    //appends "module+0xoffset" (or the bare address) for address to line
+    void Describe(char *line, size_t size, const void *address)
+    {
+        char text[MAX_PATH + 32];
+        StackSampler::Name(address, text, ARRAYSIZE(text));
+        StringCchCatA(line, size, text);
+    }
+
+    void Write(State &s, const char *line)
+    {
+        if (s.report == INVALID_HANDLE_VALUE)
+        {
+            s.report = CreateFile(s.reportpath, FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                  FILE_ATTRIBUTE_NORMAL, NULL);
+            if (s.report == INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+        }
+        DWORD written = 0;
+        WriteFile(s.report, line, static_cast<DWORD>(strlen(line)), &written, nullptr);
+    }
+
+    void WriteActivity(State &s, const WatchActivity &activity)
+    {
+        char line[512];
+        switch (activity.kind)
+        {
+        case WatchActivity::Message:
+            StringCchPrintfA(line, ARRAYSIZE(line), "activity message 0x%04x handler ", activity.message);
+            if (activity.handler != nullptr)
+            {
+                Describe(line, ARRAYSIZE(line), activity.handler);
+            }
+            else
+            {
+                StringCchCatA(line, ARRAYSIZE(line), "built in");
+            }
+            break;
+        case WatchActivity::InputRoutine:
+            StringCchCopyA(line, ARRAYSIZE(line), "activity input routine ");
+            Describe(line, ARRAYSIZE(line), activity.handler);
+            break;
+        case WatchActivity::DrawRoutine:
+            StringCchCopyA(line, ARRAYSIZE(line), "activity draw routine ");
+            Describe(line, ARRAYSIZE(line), activity.handler);
+            break;
+        case WatchActivity::Present:
+            StringCchCopyA(line, ARRAYSIZE(line), "activity present");
+            break;
+        default:
+            StringCchCopyA(line, ARRAYSIZE(line), "activity message loop");
+            break;
+        }
+        if (activity.target != nullptr)
+        {
+            char target[32];
+            StringCchPrintfA(target, ARRAYSIZE(target), " target 0x%p", activity.target);
+            StringCchCatA(line, ARRAYSIZE(line), target);
+        }
+        StringCchCatA(line, ARRAYSIZE(line), "\r\n");
+        Write(s, line);
+        s.activity = activity;
+    }
+
+    long long Milliseconds(std::chrono::steady_clock::duration d)
+    {
+        return static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(d).count());
+    }
+
+    void Report(State &s, Watchdog::Detector::Event event, std::chrono::steady_clock::time_point now)
+    {
+        typedef Watchdog::Detector::Event Event;
+        char line[4096];
+        if (event == Event::Recovered)
+        {
+            StringCchPrintfA(line, ARRAYSIZE(line), "recovered after %lld ms\r\n\r\n", Milliseconds(Watchdog::detector.lastduration()));
+            Write(s, line);
+            return;
+        }
+        Sample sample;
+        sample.count = s.uithread.Capture(sample.frames);
+        const WatchActivity activity = Watchdog::detector.activity();
+        if (event == Event::Stalled)
+        {
+            s.stalls.fetch_add(1, std::memory_order_relaxed);
+            StringCchPrintfA(line, ARRAYSIZE(line), "stall %llu thread %lu - no heartbeat for %lld ms\r\n",
+                             s.stalls.load(std::memory_order_relaxed), s.uithread.threadid(), Milliseconds(now - Watchdog::detector.stallbegan()));
+            Write(s, line);
+            s.last.count = 0;
+            WriteActivity(s, activity);
+        }
+        else if ((activity.kind != s.activity.kind) || (activity.message != s.activity.message) ||
+                 (activity.handler != s.activity.handler) || (activity.target != s.activity.target))
+        {
+            WriteActivity(s, activity);
+        }
+        StringCchPrintfA(line, ARRAYSIZE(line), "sample %u +%lld ms:", static_cast<unsigned>(Watchdog::detector.samples()),
+                         Milliseconds(now - Watchdog::detector.stallbegan()));
+        if ((sample.count != 0) && (sample.count == s.last.count) &&
+            (memcmp(sample.frames, s.last.frames, sample.count * sizeof(void*)) == 0))
+        {
+            StringCchCatA(line, ARRAYSIZE(line), " same");
+        }
+        else
+        {
+            for (size_t i = 0; i < sample.count; i++)
+            {
+                StringCchCatA(line, ARRAYSIZE(line), " ");
+                Describe(line, ARRAYSIZE(line), sample.frames[i]);
+            }
+            s.last = sample;
+        }
+        StringCchCatA(line, ARRAYSIZE(line), "\r\n");
+        Write(s, line);
+    }
+
+    //watchdog thread
+    void Watch()
+    {
+        State &s = Get();
+        std::unique_lock<std::mutex> lock(s.wakelock);
+        while (!s.stop)
+        {
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            const Watchdog::Detector::Event event = Watchdog::detector.Poll(now);
+            if (event != Watchdog::Detector::Event::None)
+            {
+                lock.unlock();
+                Report(s, event, now);
+                lock.lock();
+            }
+            s.wake.wait_until(lock, Watchdog::detector.Next(std::chrono::steady_clock::now()), [&s]() { return s.stop; });
+        }
+        if (Watchdog::detector.stalled())
+        {
+            char line[128];
+            StringCchPrintfA(line, ARRAYSIZE(line), "watchdog stopped during the stall after %lld ms\r\n\r\n",
+                             Milliseconds(std::chrono::steady_clock::now() - Watchdog::detector.stallbegan()));
+            Write(s, line);
+        }
+    }
+
+    void Release(State &s)
+    {
+        s.uithread.Close();
+        if (s.report != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(s.report);
+            s.report = INVALID_HANDLE_VALUE;
+        }
+    }
+}
+
+/*BOOL Watchdog::Start(_In_ DWORD thresholdms, _In_ DWORD intervalms, _In_ UINT maxsamples, _In_ LPCTSTR report)
+Starts the watchdog thread watching the calling thread. See Watchdog.h*/
+BOOL Watchdog::Start(_In_ DWORD thresholdms, _In_ DWORD intervalms, _In_ UINT maxsamples, _In_ LPCTSTR report)
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.control);
+    if (s.running.load(std::memory_order_acquire))
+    {
+        SetLastError(ERROR_ALREADY_INITIALIZED);
+        return FALSE;
+    }
+    if ((thresholdms == 0) || (report == nullptr) || FAILED(StringCchCopy(s.reportpath, MAX_PATH, report)))
+    {
+        SetLastError(WE_INVALIDARG);
+        return FALSE;
+    }
+    if (!s.uithread.Open(GetCurrentThreadId()))
+    {
+        return FALSE;
+    }
+    detector.Configure(std::chrono::milliseconds(thresholdms), std::chrono::milliseconds(intervalms), maxsamples);
+    s.stop = false;
+    s.stalls.store(0, std::memory_order_relaxed);
+    try
+    {
+        s.watcher = std::thread(Watch);
+    }
+    catch (...)
+    {
+        Release(s);
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return FALSE;
+    }
+    s.running.store(true, std::memory_order_release);
+    return TRUE;
+}
+
+/*void Watchdog::Stop()
+Stops the watchdog thread and closes the report*/
+void Watchdog::Stop()
+{
+    State &s = Get();
+    std::lock_guard<std::mutex> guard(s.control);
+    if (!s.running.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(s.wakelock);
+        s.stop = true;
+    }
+    s.wake.notify_one();
+    s.watcher.join();
+    Release(s);
+    s.running.store(false, std::memory_order_release);
+}
+
+bool Watchdog::Running()
+{
+    return Get().running.load(std::memory_order_acquire);
+}
+
+unsigned long long Watchdog::Stalls()
+{
+    return Get().stalls.load(std::memory_order_relaxed);
+}
@@ -15,7 +15,9 @@ limitations under the License.*/
 #include "Utils/dllhelper.h"
 #include "GFX/GFX.h"
 #include "Application/Application.h"
+#include "Application/PerfCounters.h"
 #include "Window/Window.h"
+#include "Utils/TraceSpan.h"
 
 #ifdef _DEBUG
 namespace
@@ -498,6 +500,7 @@ void DXGIResources::GetDXGIAdapterandFactory()
 
 void DXGIResources::CreateSwapChain()
 {
+    WUIF_TRACE_SPAN("CreateSwapChain");
     if (dxgiSwapChain1)
     {
         // If the swap chain already exists, resize it.
@@ -588,6 +591,7 @@ void DXGIResources::CreateSwapChain()
         {
             ThrowIfFailed(hr);
         }
+        PerfCounters::swapchainresized.Add();
     }
     else
     {
@@ -710,6 +714,7 @@ void DXGIResources::CreateSwapChain()
         {
             ThrowIfFailed(hr);
         }
+        PerfCounters::swapchaincreated.Add();
     }
 
     /*we'll handle ALT-ENTER for fullscreen toggle
@@ -14,7 +14,9 @@ limitations under the License.*/
 #include "stdafx.h"
 #include "GFX\GFX.h"
 #include "Application\Application.h"
+#include "Application\PerfCounters.h"
 #include "Window\Window.h"
+#include "Utils\TraceSpan.h"
 
 namespace WUIF {
 
@@ -31,7 +33,9 @@ namespace WUIF {
 
     void GFXResources::HandleDeviceLost()
     {
+        WUIF_TRACE_SPAN("HandleDeviceLost");
         DebugPrint(TEXT("Entering GFXResources::HandleDeviceLost"));
+        PerfCounters::devicelost.Add();
         #ifdef _DEBUG
         //get reason for device removal
         HRESULT reason = d3d11Device1->GetDeviceRemovedReason();
@@ -15,18 +15,22 @@ limitations under the License.*/
 #include "stdafx.h"
 #include "WUIF_Main.h"
 #include "Application/Application.h"
+#include "Application/PerfCounters.h"
+#include "Application/Profiler.h"
+#include "Application/Watchdog.h"
 #include "Window/Window.h"
 #include "GFX/GFX.h" //needed for InitResources
 #include "Utils/ErrorExit.h"
 #include "Utils/SetDPIAwareness.h"
 #include "Utils/OSCheck.h"
 #include "Utils/CommandLineToArgvA.h"
+#include "Utils/TraceSpan.h"
 
 
 namespace WUIF {
     //forward declaration - GFX_Flags is defined in WUIF_Const.h and appgfxflag is defined in WUIF.h
     //extern const FLAGS::GFX_Flags appgfxflag;
-    class tempInitializer {
+    class tempInitializer : public AllocTagged<AllocTag::App> {
     public:
         const FLAGS::GFX_Flags appgfxflag;
         const OSVersion minosversion;
@@ -91,6 +95,7 @@ namespace //private namespace for this file only
     */
     void ReleaseResources()
     {
+        WUIF_TRACE_SPAN("ReleaseResources");
         PrintEnter(TEXT("::ReleaseResources"));
         if (WUIF::d3d12libAPI)
         {
@@ -191,6 +196,19 @@ int APIENTRY  WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     PrintEnter(TEXT("::WinMain"));
     WUIF::DebugPrint(TEXT("Application Start - MBCS build"));
 #endif
+    #if defined (DEBUGOUTPUTFULL) || defined (DEBUGOUTPUTINFO)
+    //format debug messages on a background thread from here on
+    WUIF::AsyncLog<TCHAR>::Start(WUIF::DebugSink);
+    #endif
+    #ifdef BINARYTRACE
+    //DebugPrint call sites append to the binary trace file, decode it with Tools/TraceDecode
+    WUIF::BinaryTrace::Open(TEXT("WUIF.trace"));
+    #endif
+    #ifdef TRACESPANS
+    WUIF::TraceSpans::NameThread("WUIF main");
+    #endif
+    //frame, dispatch and memory counters in shared memory, read them with Tools/CounterView
+    WUIF::PerfCounters::Start();
 
     #if defined(_MSC_VER) && defined(_DEBUG)
     //setup debug heap manager
@@ -264,9 +282,14 @@ int APIENTRY  WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
         argc - An integer that contains the count of arguments that follow in argv. The argc parameter is always greater than or equal to 1.
         argv - an array of null-terminated strings representing command-line arguments entered by the user of the program. By convention,
                  argv[0] is the command with which the program is invoked, argv[1] is the first command-line argument, and so on, until
-                 argv[argc], which is always NULL. By standard these are multi-byte strings*/
+                 argv[argc], which is always NULL. By standard these are multi-byte strings, define UTF8ARGV
+                 to get UTF-8 strings instead - arguments the ANSI code page can't hold then survive*/
         int    argc  = 0;
+        #ifdef UTF8ARGV
+        LPSTR *argv  = CommandLineToArgvUTF8(GetCommandLineW(), &argc); //get command line as UTF-8 strings
+        #else
         LPSTR *argv  = CommandLineToArgvA(GetCommandLineA(), &argc); //get command line as multi-byte strings (NOT wide!)
+        #endif
 
         #ifdef DEBUGOUTPUTFULL
         //send to debug output contents of argc and argv
@@ -368,6 +391,15 @@ int APIENTRY  WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance
     #else
     PrintExit(TEXT("::WinMain"));
     #endif
+    WUIF::Profiler::Stop();
+    WUIF::Watchdog::Stop();
+    WUIF::PerfCounters::Stop();
+    #if defined (DEBUGOUTPUTFULL) || defined (DEBUGOUTPUTINFO)
+    WUIF::AsyncLog<TCHAR>::Stop();
+    #endif
+    #ifdef BINARYTRACE
+    WUIF::BinaryTrace::Close();
+    #endif
     //_CrtDumpMemoryLeaks();
     return retcode;
 }
@@ -406,6 +438,7 @@ int WUIF::Run(_In_opt_ int accelresource)
     MSG msg = {};
     while (WM_QUIT != msg.message)
     {
+        Watchdog::Beat(); //see Watchdog::Start
         if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
         {
             if ((!hAccelTable) || (!TranslateAcceleratorW(msg.hwnd, hAccelTable, &msg)))
@@ -422,8 +455,10 @@ int WUIF::Run(_In_opt_ int accelresource)
             //renderer->Render();
             //present the frame to the screen
             App::mainWindow->Present();
+            PerfCounters::Sample();
         }
     }
+    Watchdog::Disarm();
     if (msg.wParam == WE_WNDPROC_EXCEPTION)
     {
         SetLastError(WE_WNDPROC_EXCEPTION);
@@ -0,0 +1,126 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <unordered_map>
+#include "Window/DPICache.h"
+
+using namespace WUIF;
+
+std::atomic<unsigned long>      DPICache::epoch(0);
+std::atomic<unsigned long long> DPICache::windowhits(0);
+
+namespace {
+    //monitor cache - only touched when a window's cached value is out of date
+    std::mutex                                   monitorlock;
+    std::unordered_map<HMONITOR, DPICache::Entry> monitors;
+
+    std::atomic<unsigned long long> monitorhits(0);
+    std::atomic<unsigned long long> misses(0);
+    std::atomic<unsigned long long> invalidations(0);
+}
+
+/*bool DPICache::Lookup(_In_ HMONITOR monitor, _Out_ Entry &entry)
+Looks up the cached dpi for a monitor. Every lookup is counted as a monitor hit or a miss.
+
+HMONITOR monitor - the monitor to look up, NULL if the window's dpi does not follow its monitor
+                   (always a miss)
+Entry &entry     - receives the cached dpi and scale factor if found
+
+Return value
+bool - true if the monitor was in the cache, false if the value has to be read from the OS
+*/
+bool DPICache::Lookup(_In_ HMONITOR monitor, _Out_ Entry &entry)
+{
+    if (monitor != NULL)
+    {
+        std::lock_guard<std::mutex> guard(monitorlock);
+        auto it = monitors.find(monitor);
+        if (it != monitors.end())
+        {
+            entry = it->second;
+            monitorhits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    entry = { 0, 0 };
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+/*void DPICache::Store(_In_ HMONITOR monitor, _In_ const Entry &entry)
+Adds or replaces the cached dpi for a monitor
+
+HMONITOR monitor   - the monitor
+const Entry &entry - the monitor's dpi and scale factor
+*/
+void DPICache::Store(_In_ HMONITOR monitor, _In_ const Entry &entry)
+{
+    if (monitor == NULL)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(monitorlock);
+    monitors[monitor] = entry;
+}
+
+/*void DPICache::Invalidate(_In_ HMONITOR monitor)
+Drops the cached dpi for a monitor and advances the epoch so every window re-reads its dpi. Called
+for WM_DPICHANGED.
+
+HMONITOR monitor - the monitor whose dpi changed
+*/
+void DPICache::Invalidate(_In_ HMONITOR monitor)
+{
+    {
+        std::lock_guard<std::mutex> guard(monitorlock);
+        monitors.erase(monitor);
+    }
+    epoch.fetch_add(1, std::memory_order_acq_rel);
+    invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*void DPICache::InvalidateAll()
+Drops every cached monitor and advances the epoch. Called for WM_DISPLAYCHANGE as the monitor
+topology may have changed and HMONITOR values may have been reused.*/
+void DPICache::InvalidateAll()
+{
+    {
+        std::lock_guard<std::mutex> guard(monitorlock);
+        monitors.clear();
+    }
+    epoch.fetch_add(1, std::memory_order_acq_rel);
+    invalidations.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*DPICache::Statistics DPICache::GetStatistics()
+Returns a snapshot of the cache's hit and miss counters*/
+DPICache::Statistics DPICache::GetStatistics()
+{
+    Statistics stats;
+    stats.windowhits    = windowhits.load(std::memory_order_relaxed);
+    stats.monitorhits   = monitorhits.load(std::memory_order_relaxed);
+    stats.misses        = misses.load(std::memory_order_relaxed);
+    stats.invalidations = invalidations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/*void DPICache::ResetStatistics()
+Sets the cache's hit and miss counters back to zero*/
+void DPICache::ResetStatistics()
+{
+    windowhits.store(0, std::memory_order_relaxed);
+    monitorhits.store(0, std::memory_order_relaxed);
+    misses.store(0, std::memory_order_relaxed);
+    invalidations.store(0, std::memory_order_relaxed);
+}
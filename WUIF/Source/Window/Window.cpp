@@ -17,16 +17,24 @@ limitations under the License.*/
 MONITOR_DPI_TYPE, and MDT_EFFECTIVE_DPI*/
 #include <ShellScalingApi.h>
 #include "Application/Application.h"
+#include "Application/DPIAPI.h"
+#include "Application/PerfCounters.h"
+#include "Application/Watchdog.h"
+#include "Utils/PhaseMarker.h"
 #include "Window/Window.h"
+#include "Window/DPICache.h"
+#include "Window/WindowClassCache.h"
+#include "Window/WindowPool.h"
 #include "Window/WndProcThunk.h"
+#include "Utils/TraceSpan.h"
 //#include "GFX/GFX.h"
 
-HANDLE WUIF::wndprocThunk::heapaddr       = NULL;
-long   WUIF::wndprocThunk::thunkInstances = 0;
-
 namespace{
     //cumulative count of number of windows created
     static long numwininstances = 0;
+    /*window being created by DisplayWindow on this thread - T_SC_WindowProc forwards the messages
+    that arrive before WM_NCCREATE (e.g. WM_GETMINMAXINFO) to it*/
+    thread_local WUIF::Window *creatingwindow = nullptr;
 }
 
 namespace WUIF {
@@ -48,6 +56,103 @@ namespace WUIF {
         {
             return vecwrite;
         }
+
+        //layout transaction state
+        long layoutdepth  = 0;     //number of BeginLayout calls without a matching EndLayout
+        bool deferresize  = false; //WM_WINDOWPOSCHANGED defers swap chain resizes while true
+
+        /*void App::BeginLayout()
+        Starts a layout transaction by starting a transaction (BeginUpdate) on every window. Calls
+        may be nested, only the outermost EndLayout applies the changes.*/
+        void BeginLayout()
+        {
+            WINVECLOCK
+            for (std::vector<Window*>::iterator win = Windows.begin(); win != Windows.end(); ++win)
+            {
+                (*win)->BeginUpdate();
+            }
+            WINVECUNLOCK
+            layoutdepth++;
+        }
+
+        /*BOOL App::EndLayout()
+        Ends a layout transaction. The outermost EndLayout commits every window, applying style
+        changes directly and collecting the position changes. The positions are applied with one
+        Begin/Defer/EndDeferWindowPos batch, so all windows move together with a single repaint.
+        Swap chain resizes requested by WM_WINDOWPOSCHANGED during the batch are done once it has
+        landed.
+
+        Return value
+        BOOL - FALSE if there was no matching BeginLayout or a window position could not be applied
+        */
+        BOOL EndLayout()
+        {
+            if (layoutdepth == 0)
+            {
+                return FALSE;
+            }
+            if (--layoutdepth != 0)
+            {
+                return TRUE;
+            }
+            //copy the collection, messages sent during the batch may need the lock
+            std::vector<Window*> wins;
+            {
+                WINVECLOCK
+                wins = Windows;
+                WINVECUNLOCK
+            }
+            BOOL ret = TRUE;
+            std::vector<WindowProperties::DeferredPosition> deferred;
+            deferred.reserve(wins.size());
+            for (std::vector<Window*>::iterator win = wins.begin(); win != wins.end(); ++win)
+            {
+                if ((*win)->Commit(&deferred) != ERROR_SUCCESS)
+                {
+                    ret = FALSE;
+                }
+            }
+            if (deferred.empty())
+            {
+                return ret;
+            }
+            deferresize = true;
+            HDWP hdwp = BeginDeferWindowPos(static_cast<int>(deferred.size()));
+            for (auto def = deferred.begin(); (hdwp != NULL) && (def != deferred.end()); ++def)
+            {
+                /*if DeferWindowPos fails the application should abandon the window-positioning
+                operation and not call EndDeferWindowPos*/
+                hdwp = DeferWindowPos(hdwp, def->hWnd, static_cast<HWND>(def->pos.insertafter), def->pos.x,
+                                      def->pos.y, def->pos.cx, def->pos.cy, WindowProperties::swpflags(def->pos));
+            }
+            if ((hdwp == NULL) || (!EndDeferWindowPos(hdwp)))
+            {
+                //fall back to positioning the windows one at a time
+                for (auto def = deferred.begin(); def != deferred.end(); ++def)
+                {
+                    if (!SetWindowPos(def->hWnd, static_cast<HWND>(def->pos.insertafter), def->pos.x, def->pos.y,
+                                      def->pos.cx, def->pos.cy, WindowProperties::swpflags(def->pos)))
+                    {
+                        ret = FALSE;
+                    }
+                }
+            }
+            deferresize = false;
+            //the batch has landed, now resize the swap chains
+            {
+                WINVECLOCK
+                wins = Windows;
+                WINVECUNLOCK
+            }
+            for (std::vector<Window*>::iterator win = wins.begin(); win != wins.end(); ++win)
+            {
+                if ((*win)->state.test_and_clear(FLAGS::RESIZEPENDING, std::memory_order_acq_rel))
+                {
+                    (*win)->ResizeSwapChain();
+                }
+            }
+            return ret;
+        }
     }
 
     //constructor
@@ -57,7 +162,11 @@ namespace WUIF {
         cWndProc(NULL),
         instance(0),
         thunk(nullptr),
-        standby(false)
+        pooled(false),
+        _dpi(0),
+        _dpiepoch(0),
+        inputroutine(nullptr),
+        rawmouse(false)
     {
         //initialize thunk
         thunk = CRT_NEW wndprocThunk;
@@ -74,6 +183,7 @@ namespace WUIF {
         //add to Windows collection
         WINVECLOCK
         App::Windows.push_back(this);
+        PerfCounters::windows.Set(static_cast<int64_t>(App::Windows.size()));
         WINVECUNLOCK
     }
 
@@ -85,6 +195,10 @@ namespace WUIF {
     #endif
     Window::~Window()
     {
+        if (pooled)
+        {
+            WindowPool::Forget(this);
+        }
         int i = 0;
         WINVECLOCK
             for (std::vector<Window*>::iterator winlist = App::Windows.begin();
@@ -99,23 +213,19 @@ namespace WUIF {
             }
             if (App::Windows.size() == 0)
                 App::Windows.shrink_to_fit();
+            PerfCounters::windows.Set(static_cast<int64_t>(App::Windows.size()));
         WINVECUNLOCK
         if (thunk != nullptr)
         {
             delete thunk;
             thunk = nullptr;
         }
-        if (_classatom)
+        if ((_classatom) && (_sharedclass))
         {
-            if (!cWndProc)
-            {
-                /*Before calling this function, an application must destroy all windows created
-                with the specified class.*/
-                if (UnregisterClass(MAKEINTATOM(_classatom), App::hInstance))
-                {
-                    _classatom = NULL;
-                }
-            }
+            //classes registered by WUIF are shared, unregistered when the last window releases it
+            WindowClassCache::Release(_classatom);
+            _classatom   = NULL;
+            _sharedclass = false;
         }
         #ifdef _MSC_VER
         #pragma warning(pop)
@@ -138,10 +248,12 @@ namespace WUIF {
 
     /*LRESULT CALLBACK App::T_SC_WindowProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam,
                                             _In_ LPARAM lParam)
-    This is a temporary WindowProc to assist with sub-classing. It will change the original
-    window's class WndProc pointer to the window's thunk, which points to the default _WndProc.
-    This must happen in WM_NCCREATE. The *this is passed as lpCreateParams from the CreateWindowEx
-    call in DisplayWindow(). It's a static class function so we can keep pWndProc private*/
+    This is a temporary WindowProc to assist with sub-classing and is the WndProc of the classes in
+    WindowClassCache. It will change the original window's class WndProc pointer to the window's
+    thunk, which points to the default _WndProc. This must happen in WM_NCCREATE. The *this is
+    passed as lpCreateParams from the CreateWindowEx call in DisplayWindow(). Messages sent before
+    WM_NCCREATE go to the thunk of the window DisplayWindow is creating on this thread. It's a
+    static class function so we can keep pWndProc private*/
     LRESULT CALLBACK Window::T_SC_WindowProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam,
                                              _In_ LPARAM lParam)
     {
@@ -153,12 +265,17 @@ namespace WUIF {
             SetWindowLongPtr(hwnd, GWLP_WNDPROC, reinterpret_cast<LONG_PTR>(
                 reinterpret_cast<WUIF::Window*>(
                     reinterpret_cast<CREATESTRUCT*>(lParam)->lpCreateParams)->pWndProc()));
+            creatingwindow = nullptr;
             //now call the WM_NCCREATE function of _WndProc to finish
             return SendMessage(hwnd, WM_NCCREATE, wParam, lParam);
         }
         break;
         default:
         {
+            if (creatingwindow != nullptr)
+            {
+                return CallWindowProc(creatingwindow->pWndProc(), hwnd, uMsg, wParam, lParam);
+            }
             return DefWindowProc(hwnd, uMsg, wParam, lParam);
         }
         }
@@ -182,38 +299,6 @@ namespace WUIF {
             }
             if (!_classatom)
             {
-                /*assign values to the WNDCLASSEX structure prior to calling RegisterClassEx
-                cbSize        - size, in bytes, of this structure. Set this member to
-                                    sizeof(WNDCLASSEX)
-                style         - Window Class Styles to be applied - using CS_HREDRAW | CS_VREDRAW
-                lpfnWndProc   - a pointer to the window procedure, here it is a pointer to
-                                    wndprocThunk
-                cbClsExtra    - number of extra bytes to allocate following the structure- not used
-                cbWndExtra    - number of extra bytes to allocate following the window instance-
-                                    not used
-                hInstance     - handle to the instance that contains the window procedure for the
-                                    class
-                hIcon         - handle to the class icon
-                hCursor       - handle to the class cursor
-                hbrBackground - handle to the class background brush - ignored but using default of
-                                    (HBRUSH)(COLOR_WINDOW + 1) - background handled by D3D or D2D
-                lpszMenuName  - pointer to a null-terminated character string that specifies the
-                                    resource name of the class menu - not used
-                lpszClassName - pointer to a null-terminated string specifying the window class name
-                hIconSm       - handle to a small icon that is associated with the window class
-                */
-
-                /*create a unique string for the class name. Write 'W + [character equivalent of
-                instance number]' to classname, thus guaranteeing uniqueness (i.e. 'W1'). Use
-                StringCchPrintf as the mechanism to convert instance to a character equivalent.
-                Size of array is calculated as digits +1 for 'W' and +1 for null terminator, so
-                digits + 2. A unique pointer is used just in case an exception is thrown.*/
-                std::unique_ptr<TCHAR[]> classname(CRT_NEW TCHAR[static_cast<size_t>(digits) + 2]);
-                ThrowIfFailed(StringCchPrintf(classname.get(),
-                                              static_cast<size_t>(digits) + 2,
-                                              TEXT("W%d"),
-                                              instance));
-
                 //set defaults for _icon, _iconsm, and _classcursor if they are NULL
                 if (_icon == NULL)
                 {
@@ -230,26 +315,18 @@ namespace WUIF {
                     _classcursor = LoadCursor(NULL, IDC_ARROW);
                 }
 
-                WNDCLASSEX wndclass    = {}; //zero out
-                wndclass.lpszClassName = classname.get();
-                wndclass.cbSize        = sizeof(WNDCLASSEX);
-                wndclass.style         = CS_HREDRAW | CS_VREDRAW;
-                wndclass.lpfnWndProc   = pWndProc();
-                wndclass.hInstance     = App::hInstance;
-                wndclass.hIcon         = _icon;
-                wndclass.hCursor       = _classcursor;
-                wndclass.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
-                wndclass.hIconSm       = _iconsm;
-
-
-                /*register our WNDCLASSEX (wndclass) for the window and store result in our class
-                atom variable. We will use the class atom instead of the class name*/
-                _classatom = RegisterClassEx(&wndclass);
+                /*use the registered class with the same icons, cursor and class styles (CS_HREDRAW |
+                CS_VREDRAW) or register one. The class WndProc is T_SC_WindowProc which installs
+                this window's thunk in WM_NCCREATE. We will use the class atom instead of the class
+                name*/
+                _classatom = WindowClassCache::Acquire(_icon, _iconsm, _classcursor,
+                                                       CS_HREDRAW | CS_VREDRAW);
                 if (_classatom == 0)
                 {
                     //failed
                     throw WUIF_exception(TEXT("Unable to register window class!"));
                 }
+                _sharedclass = true;
             }
             else
             {
@@ -296,7 +373,7 @@ namespace WUIF {
             if (_windowname == nullptr)
             {
                 //create a string for the window name. Use 'Window' and append the instance
-                _windowname = CRT_NEW TCHAR[static_cast<size_t>(digits) + 8]; //+7 for 'Window%20' and +1 for null terminator
+                _windowname = AllocStats::NewArray<TCHAR>(static_cast<size_t>(digits) + 8, AllocTag::Window, __FILE__, __LINE__); //+7 for 'Window%20' and +1 for null terminator
                 ThrowIfFailed(StringCchPrintf(_windowname, static_cast<size_t>(digits) + 8, TEXT("Window %d"), instance));
             }
 
@@ -304,33 +381,15 @@ namespace WUIF {
             in Win10 1607). If it's different change the thread context prior to creating the
             window and then change back*/
             DPI_AWARENESS_CONTEXT dpicontext = NULL;
-            HMODULE lib = NULL;
-            using PFN_SET_THREAD_DPI_AWARENESS_CONTEXT = DPI_AWARENESS_CONTEXT(WINAPI*)(DPI_AWARENESS_CONTEXT);
-            PFN_SET_THREAD_DPI_AWARENESS_CONTEXT pfnsetthreaddpiawarenesscontext = nullptr;
-            if ((App::winversion >= OSVersion::WIN10_1607) && (_threaddpiawarenesscontext != NULL)
-                    && (_hWndParent == NULL))
+            const DPIAPI &dpiAPI = App::DPI();
+            if ((dpiAPI.AreDpiAwarenessContextsEqual) && (dpiAPI.GetThreadDpiAwarenessContext) &&
+                (dpiAPI.SetThreadDpiAwarenessContext) && (_threaddpiawarenesscontext != NULL) &&
+                (_hWndParent == NULL))
             {
-                lib = GetModuleHandle(TEXT("user32.dll"));
-                if (lib)
+                if ((dpiAPI.AreDpiAwarenessContextsEqual(dpiAPI.GetThreadDpiAwarenessContext(),
+                                                         _threaddpiawarenesscontext)) == FALSE)
                 {
-                    using PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL = BOOL(WINAPI*)(DPI_AWARENESS_CONTEXT, DPI_AWARENESS_CONTEXT);
-                    PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL pfnaredpiawarenesscontextsequal = (PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL)GetProcAddress(lib, "AreDpiAwarenessContextsEqual");
-                    if (pfnaredpiawarenesscontextsequal)
-                    {
-                        using PFN_GET_THREAD_DPI_AWARENESS_CONTEXT = DPI_AWARENESS_CONTEXT(WINAPI*)(void);
-                        PFN_GET_THREAD_DPI_AWARENESS_CONTEXT pfngetthreaddpiawarenesscontext = (PFN_GET_THREAD_DPI_AWARENESS_CONTEXT)GetProcAddress(lib, "GetThreadDpiAwarenessContext");
-                        if (pfngetthreaddpiawarenesscontext)
-                        {
-                            if ((pfnaredpiawarenesscontextsequal(pfngetthreaddpiawarenesscontext(),                             _threaddpiawarenesscontext)) == FALSE)
-                            {
-                                pfnsetthreaddpiawarenesscontext = (PFN_SET_THREAD_DPI_AWARENESS_CONTEXT)GetProcAddress(lib, "SetThreadDpiAwarenessContext");
-                                if (pfnsetthreaddpiawarenesscontext)
-                                {
-                                    dpicontext = pfnsetthreaddpiawarenesscontext(_threaddpiawarenesscontext);
-                                }
-                            }
-                        }
-                    }
+                    dpicontext = dpiAPI.SetThreadDpiAwarenessContext(_threaddpiawarenesscontext);
                 }
             }
             /*CreateWindowEx:
@@ -356,6 +415,8 @@ namespace WUIF {
             Returns handle for the create window and it's stored in this->_hWnd. NB: It is also
             assigned in NCCREATE of this->_WndProc,  but it is also assigned here for instances
             such as sub-classing where this might not happen.*/
+            Window *prevcreating = creatingwindow; //a window may be created during WM_CREATE
+            creatingwindow = this;
             _hWnd = CreateWindowEx(_exstyle,
                                    MAKEINTATOM(_classatom),
                                    _windowname,
@@ -368,15 +429,16 @@ namespace WUIF {
                                    _menu,
                                    App::hInstance,
                                    reinterpret_cast<LPVOID>(this));
+            creatingwindow = prevcreating;
             if (_hWnd == NULL)
             {
                 throw WUIF_exception(TEXT("Unable to create window"));
             }
             if (dpicontext != NULL) //restore dpi thread context
             {
-                if (pfnsetthreaddpiawarenesscontext)
+                if (dpiAPI.SetThreadDpiAwarenessContext)
                 {
-                    pfnsetthreaddpiawarenesscontext(dpicontext);
+                    dpiAPI.SetThreadDpiAwarenessContext(dpicontext);
                 }
             }
             initialized = true; //window class is registered and window is "created"
@@ -388,76 +450,104 @@ namespace WUIF {
         return;
     }
 
+    /*UINT Window::getWindowDPI()
+    Returns the window's dpi and sets scaleFactor. The dpi is cached along with the DPICache epoch
+    it was read in, so unless a WM_DPICHANGED or WM_DISPLAYCHANGE has been processed since the last
+    call this is a plain load.
+
+    Return value
+    UINT - the window's dpi
+    */
     UINT Window::getWindowDPI()
     {
-        //Windows 10 provides GetDpiForWindow, a per monitor DPI scaling
-        if (App::winversion >= OSVersion::WIN10)
+        if ((_dpiepoch == DPICache::Epoch()) && (_dpi != 0))
         {
-            //on windows 10_1607 and greater we check for
-            if (App::winversion >= OSVersion::WIN10_1607)
-            {
-                if (App::processdpiawarenesscontext != nullptr)
-                {
-                    HMODULE lib = GetModuleHandle(TEXT("user32.dll"));
-                    if (lib)
-                    {
-                        using PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL = BOOL(WINAPI*)(DPI_AWARENESS_CONTEXT, DPI_AWARENESS_CONTEXT);
-                        PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL pfnaredpiawarenesscontextsequal = (PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL)GetProcAddress(lib, "AreDpiAwarenessContextsEqual");
-                        if (pfnaredpiawarenesscontextsequal)
-                        {
-                            if (pfnaredpiawarenesscontextsequal(*App::processdpiawarenesscontext, DPI_AWARENESS_CONTEXT_UNAWARE))
-                            {
-                                scaleFactor = 100;
-                                return 96;
-                            }
-                        }
+            DPICache::WindowHit();
+            return _dpi;
+        }
+        //read the epoch before the dpi so an invalidation while reading leaves the value out of date
+        unsigned long epoch = DPICache::Epoch();
+        UINT dpi = queryWindowDPI();
+        scaleFactor = DPICache::ScaleFromDPI(dpi);
+        if (_hWnd != NULL) //don't cache until the window exists
+        {
+            _dpi      = dpi;
+            _dpiepoch = epoch;
+        }
+        return dpi;
+    }
 
-                    }
-                }
+    /*void Window::setWindowDPI(_In_ UINT dpi, _In_ HMONITOR monitor)
+    Called for WM_DPICHANGED. Drops the monitor's cached dpi (this advances the DPICache epoch so
+    every window re-reads its dpi) and caches the new dpi for this window.
+
+    UINT dpi         - the window's new dpi
+    HMONITOR monitor - the monitor the window is now on
+    */
+    void Window::setWindowDPI(_In_ UINT dpi, _In_ HMONITOR monitor)
+    {
+        DPICache::Invalidate(monitor);
+        scaleFactor = DPICache::ScaleFromDPI(dpi);
+        _dpi        = dpi;
+        _dpiepoch   = DPICache::Epoch();
+    }
+
+    /*UINT Window::queryWindowDPI()
+    Reads the window's dpi when the cached value is out of date. A per monitor aware window has the
+    dpi of the monitor it is on so that is shared between windows through the DPICache, anything
+    else is read from the OS.
+
+    Return value
+    UINT - the window's dpi
+    */
+    UINT Window::queryWindowDPI()
+    {
+        const DPIAPI &dpiAPI = App::DPI();
+        //a DPI unaware process is always scaled by the system so every window is 96 DPI
+        if (dpiAPI.dpiunaware)
+        {
+            return 96;
+        }
+        HMONITOR hMonitor = NULL; //stays NULL if the window's dpi does not follow its monitor
+        if (dpiAPI.permonitoraware)
+        {
+            bool followsmonitor = true;
+            if ((dpiAPI.AreDpiAwarenessContextsEqual) && (_threaddpiawarenesscontext != NULL))
+            {
+                followsmonitor = ((dpiAPI.AreDpiAwarenessContextsEqual(_threaddpiawarenesscontext,
+                                       DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2)) ||
+                                  (dpiAPI.AreDpiAwarenessContextsEqual(_threaddpiawarenesscontext,
+                                       DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE)));
             }
-            HMODULE lib = GetModuleHandle(TEXT("user32.dll"));
-            if (lib)
+            if (followsmonitor)
             {
-                //Windows 10 uses GetDpiForWindow to get the dynamic DPI
-                using GETDPIFORWINDOW = UINT(WINAPI *)(HWND);
-                GETDPIFORWINDOW getdpiforwindow = (GETDPIFORWINDOW)GetProcAddress(lib, "GetDpiForWindow");
-                if (getdpiforwindow)
-                {
-                    UINT dpi = getdpiforwindow(_hWnd);
-                    scaleFactor = ((dpi == 96) ? 100 : MulDiv(dpi, 100, 96));
-                    return dpi;
-                }
+                hMonitor = MonitorFromWindow(_hWnd, MONITOR_DEFAULTTONEAREST);
             }
         }
-        if ((App::processdpiawareness != nullptr) && (*App::processdpiawareness == PROCESS_DPI_UNAWARE))
+        DPICache::Entry entry;
+        if (DPICache::Lookup(hMonitor, entry))
         {
-            scaleFactor = 100;
-            return 96;
+            return entry.dpi;
+        }
+        UINT dpi = 0;
+        //Windows 10 uses GetDpiForWindow to get the dynamic DPI
+        if (dpiAPI.GetDpiForWindow)
+        {
+            dpi = dpiAPI.GetDpiForWindow(_hWnd);
         }
         //either not Win10 or GetDpiForWindow didn't load, try Win 8.1 function
-        if (App::winversion >= OSVersion::WIN8_1)
+        else if (dpiAPI.GetDpiForMonitor)
         {
-            //Windows 8.1 has the GetDpiForMonitor function
-            HINSTANCE lib = LoadLibrary(TEXT("shcore.dll"));
-            if (lib)
+            UINT dpiy = 0;
+            UINT dpix = 0;
+            /*MDT_EFFECTIVE_DPI - The effective DPI. This value should be used when
+            determining the correct scale factor for scaling UI elements. This incorporates
+            the scale factor set by the user for this specific display. dpix will be set to
+            the monitor's dpi*/
+            if (SUCCEEDED(dpiAPI.GetDpiForMonitor((hMonitor != NULL) ? hMonitor :
+                    MonitorFromWindow(_hWnd, MONITOR_DEFAULTTONEAREST), MDT_EFFECTIVE_DPI, &dpix, &dpiy)))
             {
-                using GETDPIFORMONITOR = HRESULT(WINAPI *)(HMONITOR, MONITOR_DPI_TYPE, UINT*, UINT*);
-                GETDPIFORMONITOR getdpi = (GETDPIFORMONITOR)GetProcAddress(lib, "GetDpiForMonitor");
-                if (getdpi)
-                {
-                    HMONITOR hMonitor = MonitorFromWindow(_hWnd, MONITOR_DEFAULTTONEAREST);
-                    UINT dpiy = 0;
-                    UINT dpix = 0;
-                    /*MDT_EFFECTIVE_DPI - The effective DPI. This value should be used when
-                    determining the correct scale factor for scaling UI elements. This incorporates
-                    the scale factor set by the user for this specific display. dpix will be set to
-                    the monitor's dpi*/
-                    getdpi(hMonitor, MDT_EFFECTIVE_DPI, &dpix, &dpiy);
-                    scaleFactor = ((dpix == 96) ? 100 : MulDiv(dpix, 100, 96));
-                    FreeLibrary(lib);
-                    return dpix;
-                }
-                FreeLibrary(lib);
+                dpi = dpix;
             }
         }
         /*
@@ -469,11 +559,39 @@ namespace WUIF {
         scaleFactor = MulDiv(static_cast<int>(dpiX), 100, 96);
         return static_cast<int>(dpiX);
         }*/
-        int dpi = GetDeviceCaps(GetDC(_hWnd), LOGPIXELSX);
-        scaleFactor = ((dpi == 96) ? 100 : MulDiv(dpi, 100, 96));
+        if (dpi == 0)
+        {
+            HDC hdc = GetDC(_hWnd);
+            dpi = static_cast<UINT>(GetDeviceCaps(hdc, LOGPIXELSX));
+            ReleaseDC(_hWnd, hdc);
+        }
+        DPICache::Store(hMonitor, { dpi, DPICache::ScaleFromDPI(dpi) });
         return dpi;
     }
 
+    /*void Window::ResizeSwapChain()
+    Recreates the swap chain and the D3D/D2D resources that depend on the window size*/
+    void Window::ResizeSwapChain()
+    {
+        WUIF_PHASE("resize");
+        //App::paintmutex.lock();
+        CreateSwapChain();
+        //setup D3D dependent resources
+        if (App::GFXflags & FLAGS::D3D12)
+        {
+            //GFX->D3D12->CreateD12Resources();
+        }
+        else //use D3D11
+        {
+            CreateD3D11DeviceResources();
+        }
+        if (App::GFXflags & FLAGS::D2D)
+        {
+            CreateD2DDeviceResources();
+        }
+        //App::paintmutex.unlock();
+    }
+
     void Window::ToggleFullScreen()
     {
         /*You may not release a swap chain in full-screen mode because doing so may create
@@ -628,19 +746,25 @@ namespace WUIF {
             else //non fs exclusive
             {
                 //set the values to the fullscreen, borderless "windowed" mode
-                //don't use the function as we are changing multiple values, just make one SetWindowPos call
+                //changing multiple values, collect them so they are applied with one SetWindowPos call
                 _prevwidth = _width;
                 _prevheight = _height;
                 _prevleft = _left;
                 _prevtop = _top;
+                BeginUpdate();
                 //set the styles
                 exstyle(WS_EX_APPWINDOW | WS_EX_TOPMOST);
                 //style(WS_POPUP | WS_VISIBLE);
                 DWORD newstyle = _style & ~(WS_CAPTION | WS_MAXIMIZEBOX | WS_MINIMIZEBOX | WS_SYSMENU | WS_THICKFRAME);
                 style(newstyle);
-                //set the window position
-                SetWindowPos(_hWnd, HWND_TOPMOST, info.rcMonitor.left, info.rcMonitor.top, info.rcMonitor.right - info.rcMonitor.left,
-                    info.rcMonitor.bottom - info.rcMonitor.top, SWP_SHOWWINDOW);
+                //set the window position - _fullscreen is already set so width and height are not scaled
+                left(info.rcMonitor.left);
+                top(info.rcMonitor.top);
+                width(info.rcMonitor.right - info.rcMonitor.left);
+                height(info.rcMonitor.bottom - info.rcMonitor.top);
+                _update.zorder(HWND_TOPMOST);
+                _update.show();
+                Commit();
             }
         }
         return;
@@ -648,6 +772,23 @@ namespace WUIF {
 
     void Window::Present()
     {
+        WUIF_TRACE_SPAN("Present");
+        Watchdog::Scope activity(Watchdog::detector, WatchActivity::Present, 0, nullptr, this);
+        WUIF_PHASE("present");
+        framearena.Reset();
+        //input tagged before the frame is drawn is shown by this Present
+        const long long inputtime = latencystats.enabled() ? latencystats.pending() : 0;
+        if (!inputbatch.empty())
+        {
+            if (inputroutine != nullptr)
+            {
+                WUIF_TRACE_SPAN("InputRoutine");
+                WUIF_PHASE("input");
+                activity.Handler(WatchActivity::InputRoutine, reinterpret_cast<const void*>(inputroutine));
+                inputroutine(this, inputbatch);
+            }
+            inputbatch.Clear();
+        }
         if (App::GFXflags & FLAGS::D3D12)
         {
             //clear backbuffer
@@ -664,8 +805,12 @@ namespace WUIF {
         {
             for (std::forward_list<winptr>::iterator dr = drawroutines.begin(); dr != drawroutines.end(); ++dr)
             {
+                WUIF_TRACE_SPAN("DrawRoutine");
+                WUIF_PHASE("draw"); //draw routines name their passes with WUIF_PHASE
+                activity.Handler(WatchActivity::DrawRoutine, reinterpret_cast<const void*>(*dr));
                 (*dr)(this);
             }
+            activity.Handler(WatchActivity::Present, nullptr);
         }
 
         /*
@@ -688,18 +833,36 @@ namespace WUIF {
                 presentflags |= DXGI_PRESENT_ALLOW_TEARING;
             }
         }
+        const bool standby = state.test(FLAGS::STANDBY, std::memory_order_acquire);
         if (standby)
         {
             presentflags |= DXGI_PRESENT_TEST;
         }
-        HRESULT hr = dxgiSwapChain1->Present(0, presentflags);
+        HRESULT hr;
+        {
+            WUIF_TRACE_SPAN("IDXGISwapChain1::Present");
+            hr = dxgiSwapChain1->Present(0, presentflags);
+        }
         if ((hr == S_OK) && (standby))
         {
             //take window out of standby
-            standby = false;
+            state.fetch_and(~FLAGS::STANDBY, std::memory_order_release);
             presentflags &= ~DXGI_PRESENT_TEST;
             hr = dxgiSwapChain1->Present(0, presentflags);
         }
+        if ((hr == S_OK) && !(presentflags & DXGI_PRESENT_TEST))
+        {
+            PerfCounters::framespresented.Add();
+            if (latencystats.enabled())
+            {
+                RecordPresent(inputtime);
+            }
+        }
+        else
+        {
+            //occluded (standby test only) or failed
+            PerfCounters::framesskipped.Add();
+        }
         if (hr == DXGI_ERROR_DEVICE_REMOVED || hr == DXGI_ERROR_DEVICE_RESET)
         {
             // If the device was removed for any reason, a new device and swap chain will need to be created.
@@ -714,7 +877,7 @@ namespace WUIF {
         mode as doing so can leave the swap chain unable to relinquish full-screen mode.*/
         if (hr == DXGI_STATUS_OCCLUDED)
         {
-            standby = true;
+            state.fetch_or(FLAGS::STANDBY, std::memory_order_release);
         }
         if (!dxgiFactory->IsCurrent())
         {
@@ -0,0 +1,182 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <map>
+#include <unordered_map>
+#include "Application/Application.h"
+#include "Window/Window.h"
+#include "Window/WindowClassCache.h"
+
+using namespace WUIF;
+
+namespace {
+    struct ClassKey
+    {
+        HICON   icon;
+        HICON   iconsm;
+        HCURSOR cursor;
+        UINT    style;
+
+        bool operator<(const ClassKey &rhs) const
+        {
+            if (icon != rhs.icon)     return (icon < rhs.icon);
+            if (iconsm != rhs.iconsm) return (iconsm < rhs.iconsm);
+            if (cursor != rhs.cursor) return (cursor < rhs.cursor);
+            return (style < rhs.style);
+        }
+    };
+
+    struct ClassEntry
+    {
+        ClassKey      key;
+        unsigned long refs;     //windows holding the atom
+        bool          attached; //false once Detach removed the class from the lookup
+    };
+
+    //registry memory is accounted to the Window tag
+    typedef std::map<ClassKey, ATOM, std::less<ClassKey>,
+                     TaggedAllocator<std::pair<const ClassKey, ATOM>, AllocTag::Window>> LookupMap;
+    typedef std::unordered_map<ATOM, ClassEntry, std::hash<ATOM>, std::equal_to<ATOM>,
+                               TaggedAllocator<std::pair<const ATOM, ClassEntry>, AllocTag::Window>> ClassMap;
+
+    //only touched when a window is created or destroyed
+    std::mutex                            classlock;
+    LookupMap                             lookup;
+    ClassMap                              classes;
+    unsigned long                         classnames = 0; //used to build unique class names
+    WindowClassCache::Statistics          stats = {};
+
+    /*unregister every class that has no references left - classlock must be held. The last
+    Release normally happens in ~Window during WM_NCDESTROY, while the window still exists, so
+    UnregisterClass fails with ERROR_CLASS_HAS_WINDOWS. Such a class stays registered (and can be
+    shared again) until a later Acquire or Release finds it unused.*/
+    void Sweep()
+    {
+        for (auto it = classes.begin(); it != classes.end();)
+        {
+            if ((it->second.refs == 0) && (UnregisterClass(MAKEINTATOM(it->first), App::hInstance)))
+            {
+                if (it->second.attached)
+                {
+                    lookup.erase(it->second.key);
+                }
+                it = classes.erase(it);
+                stats.unregistered++;
+                stats.live--;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
+
+/*ATOM WindowClassCache::Acquire(_In_ HICON icon, _In_ HICON iconsm, _In_ HCURSOR cursor,
+                                 _In_ UINT style)
+Returns a class with the given attributes, registering it if no window uses one yet, and adds a
+reference to it. Every successful Acquire must be matched by a Release.
+
+HICON icon     - class icon
+HICON iconsm   - class small icon
+HCURSOR cursor - class cursor
+UINT style     - class styles (CS_*)
+
+Return value
+ATOM - the class atom, 0 if RegisterClassEx failed (GetLastError has the reason)
+*/
+ATOM WindowClassCache::Acquire(_In_ HICON icon, _In_ HICON iconsm, _In_ HCURSOR cursor, _In_ UINT style)
+{
+    const ClassKey key = { icon, iconsm, cursor, style };
+    std::lock_guard<std::mutex> guard(classlock);
+    auto found = lookup.find(key);
+    if (found != lookup.end())
+    {
+        classes[found->second].refs++;
+        stats.shared++;
+        return found->second;
+    }
+    Sweep();
+    //'WUIF' + counter, the counter is never reused so names stay unique within the process
+    TCHAR classname[16];
+    if (FAILED(StringCchPrintf(classname, ARRAYSIZE(classname), TEXT("WUIF%lu"), ++classnames)))
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return 0;
+    }
+    /*hbrBackground is ignored but using default of (HBRUSH)(COLOR_WINDOW + 1) - background
+    handled by D3D or D2D*/
+    WNDCLASSEX wndclass    = {}; //zero out
+    wndclass.lpszClassName = classname;
+    wndclass.cbSize        = sizeof(WNDCLASSEX);
+    wndclass.style         = style;
+    wndclass.lpfnWndProc   = Window::T_SC_WindowProc;
+    wndclass.hInstance     = App::hInstance;
+    wndclass.hIcon         = icon;
+    wndclass.hCursor       = cursor;
+    wndclass.hbrBackground = (HBRUSH)(COLOR_WINDOW + 1);
+    wndclass.hIconSm       = iconsm;
+    ATOM atom = RegisterClassEx(&wndclass);
+    if (atom == 0)
+    {
+        return 0;
+    }
+    lookup[key]   = atom;
+    classes[atom] = { key, 1, true };
+    stats.registered++;
+    stats.live++;
+    return atom;
+}
+
+/*void WindowClassCache::Release(_In_ ATOM atom)
+Drops a reference taken by Acquire. The class is unregistered once no window uses it.
+
+ATOM atom - atom returned by Acquire
+*/
+void WindowClassCache::Release(_In_ ATOM atom)
+{
+    std::lock_guard<std::mutex> guard(classlock);
+    auto it = classes.find(atom);
+    if ((it == classes.end()) || (it->second.refs == 0))
+    {
+        return; //not one of ours
+    }
+    it->second.refs--;
+    Sweep();
+}
+
+/*void WindowClassCache::Detach(_In_ ATOM atom)
+Stops sharing a class, called before a class attribute is changed with SetClassLongPtr. Windows
+already using the class keep it, Acquire registers a new class for the old attributes.
+
+ATOM atom - atom returned by Acquire
+*/
+void WindowClassCache::Detach(_In_ ATOM atom)
+{
+    std::lock_guard<std::mutex> guard(classlock);
+    auto it = classes.find(atom);
+    if ((it != classes.end()) && (it->second.attached))
+    {
+        lookup.erase(it->second.key);
+        it->second.attached = false;
+    }
+}
+
+/*WindowClassCache::Statistics WindowClassCache::GetStatistics()
+Returns a snapshot of the cache's counters*/
+WindowClassCache::Statistics WindowClassCache::GetStatistics()
+{
+    std::lock_guard<std::mutex> guard(classlock);
+    return stats;
+}
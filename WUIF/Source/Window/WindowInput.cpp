@@ -0,0 +1,216 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <windowsx.h> //needed for GET_X_LPARAM, GET_Y_LPARAM
+#include "Window/Window.h"
+
+using namespace WUIF;
+
+namespace {
+    //raw input read per GetRawInputBuffer call
+    const size_t rawblocks = 32;
+
+    /*GetRawInputBuffer lays RAWINPUT out as a 64 bit process would, so a 32 bit process on 64 bit
+    Windows finds the data 8 bytes further on than RAWINPUT::data*/
+    size_t RawBufferPadding()
+    {
+        #if defined(_M_IX86)
+        static const size_t padding = []()
+        {
+            BOOL wow64 = FALSE;
+            return (IsWow64Process(GetCurrentProcess(), &wow64) && wow64) ? size_t(8) : size_t(0);
+        }();
+        return padding;
+        #else
+        return 0;
+        #endif
+    }
+
+    //true if the mouse is the only raw input device the process registered
+    bool OnlyRawMouse()
+    {
+        UINT devices = 0;
+        return (GetRegisteredRawInputDevices(NULL, &devices, sizeof(RAWINPUTDEVICE)) == 0) && (devices == 1);
+    }
+
+    void AddRawMouse(InputBatch &batch, const RAWMOUSE &mouse, DWORD time)
+    {
+        InputSample sample = {};
+        sample.x       = static_cast<int32_t>(mouse.lLastX);
+        sample.y       = static_cast<int32_t>(mouse.lLastY);
+        sample.time    = static_cast<uint32_t>(time);
+        sample.buttons = mouse.usButtonFlags;
+        sample.id      = mouse.usButtonData;
+        sample.flags   = static_cast<uint16_t>(mouse.usFlags & MOUSE_MOVE_ABSOLUTE);
+        sample.source  = InputSource::RawMouse;
+        batch.Add(sample);
+    }
+}
+
+/*BOOL Window::BatchInput(_In_opt_ InputProc proc, _In_ bool keepall, _In_ bool rawmouse)
+Sets the input routine Present calls once per frame with the input collected since the previous
+frame. While it is set WM_MOUSEMOVE and WM_POINTERUPDATE no longer reach WndProc_map.
+
+InputProc proc - the input routine, nullptr stops batching
+bool keepall   - keep every sample in InputBatch::all() as well as the coalesced ones (ink)
+bool rawmouse  - register for raw mouse input (WM_INPUT), read in bulk with GetRawInputBuffer while
+                 the mouse is the only raw input device registered. Raw input registration is per
+                 process, the last window to register receives it. WM_INPUT from other devices
+                 (keyboards, HIDs an application registered) is dispatched as usual
+
+Return value
+BOOL - FALSE if registering or removing raw mouse input failed, call GetLastError for details
+*/
+BOOL Window::BatchInput(_In_opt_ InputProc proc, _In_ bool keepall, _In_ bool rawmouse)
+{
+    inputroutine = proc;
+    inputbatch.keepall(keepall);
+    inputbatch.Clear();
+    const bool raw = rawmouse && (proc != nullptr);
+    if (raw == this->rawmouse)
+    {
+        return TRUE;
+    }
+    this->rawmouse = raw;
+    if (_hWnd == NULL)
+    {
+        return TRUE; //registered in WM_CREATE
+    }
+    return RegisterRawMouse(raw);
+}
+
+/*BOOL Window::RegisterRawMouse(_In_ bool enable)
+Registers (or removes) raw mouse input for the window*/
+BOOL Window::RegisterRawMouse(_In_ bool enable)
+{
+    RAWINPUTDEVICE device = {};
+    device.usUsagePage = 0x01; //HID_USAGE_PAGE_GENERIC
+    device.usUsage     = 0x02; //HID_USAGE_GENERIC_MOUSE
+    device.dwFlags     = enable ? 0 : RIDEV_REMOVE;
+    device.hwndTarget  = enable ? _hWnd : NULL;
+    return RegisterRawInputDevices(&device, 1, sizeof(device));
+}
+
+/*bool Window::BatchMessage(_In_ UINT message, _In_ WPARAM wParam, _In_ LPARAM lParam)
+Adds WM_MOUSEMOVE, WM_POINTERUPDATE or WM_INPUT to inputbatch. The first sample of a batch
+invalidates the window, so a window that is only presented from WM_PAINT draws a frame and the
+input routine gets the batch
+
+Return value
+bool - false if the message was not batched (WM_INPUT that isn't raw mouse input) and must be
+       dispatched
+*/
+bool Window::BatchMessage(_In_ UINT message, _In_ WPARAM wParam, _In_ LPARAM lParam)
+{
+    const bool first = inputbatch.empty();
+    InputSample sample = {};
+    sample.time = static_cast<uint32_t>(GetMessageTime());
+    switch (message)
+    {
+    case WM_MOUSEMOVE:
+        sample.x       = GET_X_LPARAM(lParam);
+        sample.y       = GET_Y_LPARAM(lParam);
+        sample.buttons = GET_KEYSTATE_WPARAM(wParam);
+        sample.source  = InputSource::Mouse;
+        inputbatch.Add(sample);
+        break;
+    case WM_POINTERUPDATE:
+        sample.x       = GET_X_LPARAM(lParam);
+        sample.y       = GET_Y_LPARAM(lParam);
+        sample.buttons = HIWORD(wParam); //POINTER_MESSAGE_FLAG_* - in range, in contact and buttons
+        sample.id      = GET_POINTERID_WPARAM(wParam);
+        sample.source  = InputSource::Pointer;
+        inputbatch.Add(sample);
+        break;
+    case WM_INPUT:
+        if (!rawmouse || !ReadRawInput(reinterpret_cast<HRAWINPUT>(lParam)))
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+    if (first)
+    {
+        InvalidateRect(_hWnd, NULL, FALSE);
+    }
+    return true;
+}
+
+/*bool Window::ReadRawInput(_In_ HRAWINPUT input)
+Adds the raw input of a WM_INPUT message if it comes from a mouse, then the raw input queued behind
+it, read in bulk with GetRawInputBuffer so the queued WM_INPUT messages are never dispatched. The
+queue is only drained while the mouse is the only raw input device registered - the records of a
+keyboard or HID the application registered would be taken from their WM_INPUT handlers. Drained
+records that are not from a mouse go to DefRawInputProc
+
+Return value
+bool - false if the input is not from a mouse (or can't be read)
+*/
+bool Window::ReadRawInput(_In_ HRAWINPUT input)
+{
+    const DWORD time = static_cast<DWORD>(GetMessageTime());
+    RAWINPUT raw;
+    UINT size = sizeof(raw);
+    //one read - HID records larger than RAWINPUT fail and are dispatched
+    if ((GetRawInputData(input, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) == static_cast<UINT>(-1)) ||
+        (raw.header.dwType != RIM_TYPEMOUSE))
+    {
+        return false;
+    }
+    AddRawMouse(inputbatch, raw.data.mouse, time);
+    if (!OnlyRawMouse())
+    {
+        return true;
+    }
+    const size_t padding = RawBufferPadding();
+    RAWINPUT buffer[rawblocks];
+    for (;;)
+    {
+        size = sizeof(buffer);
+        const UINT count = GetRawInputBuffer(buffer, &size, sizeof(RAWINPUTHEADER));
+        if ((count == 0) || (count == static_cast<UINT>(-1)))
+        {
+            break;
+        }
+        PRAWINPUT others[rawblocks];
+        INT       other = 0;
+        PRAWINPUT block = buffer;
+        for (UINT i = 0; i < count; i++)
+        {
+            if (block->header.dwType == RIM_TYPEMOUSE)
+            {
+                const BYTE *data = reinterpret_cast<const BYTE*>(&block->data) + padding;
+                AddRawMouse(inputbatch, *reinterpret_cast<const RAWMOUSE*>(data), time);
+            }
+            else
+            {
+                //short keyboard records can outnumber the blocks the buffer holds
+                if (other == static_cast<INT>(rawblocks))
+                {
+                    DefRawInputProc(others, other, sizeof(RAWINPUTHEADER));
+                    other = 0;
+                }
+                others[other++] = block;
+            }
+            block = NEXTRAWINPUTBLOCK(block);
+        }
+        if (other != 0)
+        {
+            DefRawInputProc(others, other, sizeof(RAWINPUTHEADER));
+        }
+    }
+    return true;
+}
@@ -0,0 +1,119 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include "Window/Window.h"
+#include "Utils/dllhelper.h"
+
+using namespace WUIF;
+
+namespace {
+    using PFN_GET_POINTER_INFO = BOOL(WINAPI*)(UINT32, POINTER_INFO*);
+
+    //GetPointerInfo - Windows 8 and greater, nullptr on Windows 7 (which sends no WM_POINTER messages)
+    PFN_GET_POINTER_INFO PointerInfo()
+    {
+        static const ModuleHelper user32dll(TEXT("user32.dll"), OSVersion::WIN7);
+        static const PFN_GET_POINTER_INFO getpointerinfo = user32dll.assign("GetPointerInfo", OSVersion::WIN8);
+        return getpointerinfo;
+    }
+
+    //messages older than this are from before the window was visible, their time is ignored
+    const DWORD maxmessageage = 10000;
+}
+
+/*void Window::MeasureLatency(_In_ bool enable)
+Starts or stops measuring input to photon latency. The first input message after each Present
+is tagged with the time the input happened and the next Present records how long the input took
+to reach Present and, from IDXGISwapChain1::GetFrameStatistics, the vblank. Starting clears the
+previous measurements. Call it on the thread that calls Present.
+
+Pointer input has the input's own QueryPerformanceCounter time (POINTER_INFO::PerformanceCount).
+Mouse, keyboard and raw input only have GetMessageTime, which has the resolution of GetTickCount
+(10 - 16 ms), so their latencies are that much less precise.
+
+GetFrameStatistics only reports vblanks for flip model swap chains, with other swap chains only
+the input to Present histogram is filled.
+
+bool enable - true to start measuring, false to stop*/
+void Window::MeasureLatency(_In_ bool enable)
+{
+    LARGE_INTEGER frequency = {};
+    if (enable)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+    latencystats.Enable(frequency.QuadPart);
+}
+
+/*void Window::TagInput(_In_ UINT message, _In_ WPARAM wParam)
+Tags an input message with the time the input happened unless an earlier input is already
+waiting for Present - later input in the same frame costs only the pending check*/
+void Window::TagInput(_In_ UINT message, _In_ WPARAM wParam)
+{
+    if (latencystats.pending() != 0)
+    {
+        return;
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    long long time = now.QuadPart;
+    bool stamped = false;
+    if ((message >= WM_POINTERUPDATE) && (message <= WM_POINTERHWHEEL))
+    {
+        const PFN_GET_POINTER_INFO getpointerinfo = PointerInfo();
+        POINTER_INFO info;
+        if ((getpointerinfo != nullptr) && getpointerinfo(GET_POINTERID_WPARAM(wParam), &info) &&
+            (info.PerformanceCount != 0) && (info.PerformanceCount <= static_cast<UINT64>(now.QuadPart)))
+        {
+            time    = static_cast<long long>(info.PerformanceCount);
+            stamped = true;
+        }
+    }
+    if (!stamped)
+    {
+        //message times are GetTickCount values
+        const DWORD age = GetTickCount() - static_cast<DWORD>(GetMessageTime());
+        if (age <= maxmessageage)
+        {
+            time -= (static_cast<long long>(age) * latencystats.frequency()) / 1000;
+        }
+    }
+    latencystats.Input(time);
+}
+
+/*void Window::RecordPresent(_In_ long long input)
+Called by Present after IDXGISwapChain1::Present returned S_OK. Records the frame if it showed
+tagged input and resolves the vblanks of frames waiting for one with GetFrameStatistics
+
+long long input - the tagged input time read before the frame was drawn, 0 if none*/
+void Window::RecordPresent(_In_ long long input)
+{
+    if (input != 0)
+    {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        UINT presentid = 0;
+        dxgiSwapChain1->GetLastPresentCount(&presentid);
+        latencystats.Presented(input, now.QuadPart, presentid);
+    }
+    if (latencystats.waiting())
+    {
+        //fails until the first vblank after a mode change and for bitblt model swap chains
+        DXGI_FRAME_STATISTICS stats;
+        if (SUCCEEDED(dxgiSwapChain1->GetFrameStatistics(&stats)))
+        {
+            latencystats.Displayed(stats.PresentCount, stats.SyncQPCTime.QuadPart);
+        }
+    }
+}
@@ -0,0 +1,378 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#include "stdafx.h"
+#include <vector>
+#include "Window/Window.h"
+#include "Window/WindowPool.h"
+
+using namespace WUIF;
+
+namespace {
+    //what a pooled window was requested with
+    struct PoolKey
+    {
+        int   width;
+        int   height;
+        DWORD style;
+        DWORD exstyle;
+
+        bool operator==(const PoolKey &rhs) const
+        {
+            return ((width == rhs.width) && (height == rhs.height) && (style == rhs.style) &&
+                    (exstyle == rhs.exstyle));
+        }
+    };
+
+    struct PoolEntry
+    {
+        Window   *win;
+        PoolKey   key;
+        DWORD     createdstyle;   //styles after creation - a changed window isn't recycled
+        DWORD     createdexstyle;
+        ULONGLONG idlesince;      //GetTickCount64 when the window was returned
+    };
+
+    typedef std::vector<PoolEntry, TaggedAllocator<PoolEntry, AllocTag::Window>> PoolList;
+
+    std::mutex             poollock;
+    WindowPool::Settings   settings = { 4, 30000 };
+    WindowPool::Statistics stats    = {};
+    PoolList               idle;   //hidden windows ready for Acquire, oldest first
+    PoolList               issued; //windows handed out by Acquire
+
+    //number of idle windows for key - poollock must be held
+    unsigned IdleCount(const PoolKey &key)
+    {
+        unsigned count = 0;
+        for (const PoolEntry &entry : idle)
+        {
+            if (entry.key == key)
+                count++;
+        }
+        return count;
+    }
+
+    /*remove the idle windows that timed out or are over capacity (oldest first) and add them to
+    expired - poollock must be held, the windows are destroyed after it is released as
+    DestroyWindow calls back into the pool through ~Window*/
+    void CollectExpired(bool all, std::vector<Window*> &expired)
+    {
+        const ULONGLONG now = GetTickCount64();
+        for (size_t i = idle.size(); i-- > 0;)
+        {
+            const PoolEntry &entry = idle[i];
+            bool expire = all ||
+                ((settings.idletimeout != 0) && ((now - entry.idlesince) >= settings.idletimeout));
+            if (!expire)
+            {
+                //newer windows are later in the vector, count the ones kept after this one
+                unsigned newer = 0;
+                for (size_t j = i + 1; j < idle.size(); j++)
+                {
+                    if (idle[j].key == entry.key)
+                        newer++;
+                }
+                expire = (newer >= settings.capacity);
+            }
+            if (expire)
+            {
+                expired.push_back(entry.win);
+                idle.erase(idle.begin() + static_cast<std::ptrdiff_t>(i));
+                stats.destroyed++;
+            }
+        }
+    }
+}
+
+/*void WindowPool::Configure(_In_ const Settings &newsettings)
+Changes the pool settings. Idle windows over the new capacity are destroyed.
+
+const Settings &newsettings - the new capacity and idle timeout
+*/
+void WindowPool::Configure(_In_ const Settings &newsettings)
+{
+    {
+        std::lock_guard<std::mutex> guard(poollock);
+        settings = newsettings;
+    }
+    Trim();
+}
+
+/*WindowPool::Settings WindowPool::GetSettings()
+Returns the current pool settings*/
+WindowPool::Settings WindowPool::GetSettings()
+{
+    std::lock_guard<std::mutex> guard(poollock);
+    return settings;
+}
+
+/*void WindowPool::Prewarm(_In_ int width, _In_ int height, _In_ unsigned count, _In_ DWORD style,
+                           _In_ DWORD exstyle)
+Creates hidden windows so the next count Acquire calls with the same arguments don't have to. The
+number of idle windows is limited by Settings::capacity.
+
+int width     - window width (before dpi scaling)
+int height    - window height (before dpi scaling)
+unsigned count - number of idle windows wanted
+DWORD style   - window style
+DWORD exstyle - extended window style
+*/
+void WindowPool::Prewarm(_In_ int width, _In_ int height, _In_ unsigned count, _In_ DWORD style,
+                         _In_ DWORD exstyle)
+{
+    const PoolKey key = { width, height, style, exstyle };
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> guard(poollock);
+            if (IdleCount(key) >= ((count < settings.capacity) ? count : settings.capacity))
+            {
+                return;
+            }
+        }
+        Window *win = Create(width, height, style, exstyle);
+        std::lock_guard<std::mutex> guard(poollock);
+        idle.push_back({ win, key, win->style(), win->exstyle(), GetTickCount64() });
+    }
+}
+
+/*Window* WindowPool::Acquire(_In_ int width, _In_ int height, _In_ DWORD style, _In_ DWORD exstyle)
+Returns a hidden window with the given size and styles, taken from the pool if one is idle or
+created otherwise. The window has its swap chain and D3D11/D2D resources, use Show() to position
+and show it and Recycle() when done with it.
+
+int width     - window width (before dpi scaling)
+int height    - window height (before dpi scaling)
+DWORD style   - window style
+DWORD exstyle - extended window style
+
+Return value
+Window* - the window, exceptions from creating a window are not caught
+*/
+Window* WindowPool::Acquire(_In_ int width, _In_ int height, _In_ DWORD style, _In_ DWORD exstyle)
+{
+    const PoolKey key = { width, height, style, exstyle };
+    Window *win = nullptr;
+    std::vector<Window*> expired;
+    {
+        std::lock_guard<std::mutex> guard(poollock);
+        CollectExpired(false, expired);
+        //most recently recycled first - its resources are the most likely to still be warm
+        for (size_t i = idle.size(); i-- > 0;)
+        {
+            if (idle[i].key == key)
+            {
+                win = idle[i].win;
+                issued.push_back(idle[i]);
+                idle.erase(idle.begin() + static_cast<std::ptrdiff_t>(i));
+                stats.hits++;
+                break;
+            }
+        }
+    }
+    for (Window *old : expired)
+    {
+        old->pooled = false;
+        DestroyWindow(old->hWnd());
+    }
+    if (win != nullptr)
+    {
+        return win;
+    }
+    win = Create(width, height, style, exstyle);
+    std::lock_guard<std::mutex> guard(poollock);
+    issued.push_back({ win, key, win->style(), win->exstyle(), 0 });
+    stats.misses++;
+    return win;
+}
+
+/*Window* WindowPool::Create(_In_ int width, _In_ int height, _In_ DWORD style, _In_ DWORD exstyle)
+Creates a hidden window for the pool. WM_CREATE creates the swap chain and D3D11/D2D resources,
+SW_HIDE keeps the window hidden.*/
+Window* WindowPool::Create(_In_ int width, _In_ int height, _In_ DWORD style, _In_ DWORD exstyle)
+{
+    Window *win = CRT_NEW Window();
+    try
+    {
+        win->width(width);
+        win->height(height);
+        win->style(style);
+        win->exstyle(exstyle);
+        win->cmdshow(SW_HIDE);
+        win->DisplayWindow();
+    }
+    catch (...)
+    {
+        if (win->hWnd() != NULL)
+        {
+            DestroyWindow(win->hWnd()); //deletes win in WM_NCDESTROY
+        }
+        else
+        {
+            delete win;
+        }
+        throw;
+    }
+    win->pooled = true;
+    return win;
+}
+
+/*BOOL WindowPool::Show(_In_ Window *win, _In_ int left, _In_ int top)
+Moves and shows a window with one SetWindowPos, without activating it
+
+Window *win - window returned by Acquire
+int left    - screen position of the left edge in physical pixels
+int top     - screen position of the top edge in physical pixels
+
+Return value
+BOOL - result of SetWindowPos
+*/
+BOOL WindowPool::Show(_In_ Window *win, _In_ int left, _In_ int top)
+{
+    return SetWindowPos(win->hWnd(), HWND_TOP, left, top, 0, 0,
+                        (SWP_NOSIZE | SWP_NOACTIVATE | SWP_SHOWWINDOW));
+}
+
+/*void WindowPool::Recycle(_In_ Window *win)
+Hides a window returned by Acquire and keeps it for a later Acquire. Draw routines, input batching,
+latency measurement and WndProc_map handlers are removed and the size is set back to the requested one. The window is destroyed
+instead if the pool is full for its size, if its style was changed, if it is fullscreen or if it
+did not come from Acquire.
+
+Window *win - the window
+*/
+void WindowPool::Recycle(_In_ Window *win)
+{
+    if (win == nullptr)
+    {
+        return;
+    }
+    PoolEntry entry = {};
+    bool      found = false;
+    bool      keep  = false;
+    {
+        std::lock_guard<std::mutex> guard(poollock);
+        for (auto it = issued.begin(); it != issued.end(); ++it)
+        {
+            if (it->win == win)
+            {
+                entry = *it;
+                issued.erase(it);
+                found = true;
+                keep  = (IdleCount(entry.key) < settings.capacity);
+                break;
+            }
+        }
+    }
+    keep = keep && (win->isInitialized()) && (!win->fullscreen()) &&
+           (win->style() == entry.createdstyle) && (win->exstyle() == entry.createdexstyle);
+    if (!keep)
+    {
+        if (found)
+        {
+            win->pooled = false;
+        }
+        if (win->hWnd() != NULL)
+        {
+            DestroyWindow(win->hWnd()); //deletes win in WM_NCDESTROY
+        }
+        else
+        {
+            delete win;
+        }
+        std::lock_guard<std::mutex> guard(poollock);
+        stats.destroyed++;
+        return;
+    }
+    ShowWindow(win->hWnd(), SW_HIDE);
+    win->drawroutines.clear();
+    win->framearena.Release();
+    win->BatchInput(nullptr);
+    win->inputbatch.Release();
+    win->MeasureLatency(false);
+    win->WndProc_map.clear();
+    if ((win->width() != entry.key.width) || (win->height() != entry.key.height))
+    {
+        //one SetWindowPos (and swap chain resize) while hidden rather than on the next Show
+        WindowUpdateScope update(*win);
+        win->width(entry.key.width);
+        win->height(entry.key.height);
+    }
+    std::vector<Window*> expired;
+    {
+        std::lock_guard<std::mutex> guard(poollock);
+        entry.idlesince = GetTickCount64();
+        idle.push_back(entry);
+        stats.recycled++;
+        CollectExpired(false, expired);
+    }
+    for (Window *old : expired)
+    {
+        old->pooled = false;
+        DestroyWindow(old->hWnd());
+    }
+}
+
+/*unsigned WindowPool::Trim(_In_ bool all)
+Destroys idle windows that have been in the pool longer than Settings::idletimeout or that are
+over Settings::capacity
+
+bool all - true to destroy every idle window (e.g. before the message loop ends)
+
+Return value
+unsigned - number of windows destroyed
+*/
+unsigned WindowPool::Trim(_In_ bool all)
+{
+    std::vector<Window*> expired;
+    {
+        std::lock_guard<std::mutex> guard(poollock);
+        CollectExpired(all, expired);
+    }
+    for (Window *old : expired)
+    {
+        old->pooled = false;
+        DestroyWindow(old->hWnd());
+    }
+    return static_cast<unsigned>(expired.size());
+}
+
+/*WindowPool::Statistics WindowPool::GetStatistics()
+Returns a snapshot of the pool's counters*/
+WindowPool::Statistics WindowPool::GetStatistics()
+{
+    std::lock_guard<std::mutex> guard(poollock);
+    Statistics snapshot = stats;
+    snapshot.idle = static_cast<unsigned long>(idle.size());
+    return snapshot;
+}
+
+/*void WindowPool::Forget(_In_ Window *win)
+Called by ~Window for a window the pool knows about, e.g. a handed out window closed by the user
+or an idle window destroyed with its owner*/
+void WindowPool::Forget(_In_ Window *win)
+{
+    std::lock_guard<std::mutex> guard(poollock);
+    for (PoolList *list : { &idle, &issued })
+    {
+        for (auto it = list->begin(); it != list->end(); ++it)
+        {
+            if (it->win == win)
+            {
+                list->erase(it);
+                return;
+            }
+        }
+    }
+}
@@ -15,16 +15,96 @@ limitations under the License.*/
 
 #include "Window\WindowProperties.h"
 #include "Window\Window.h"
+#include "Window\WindowClassCache.h"
 #include "Application\Application.h"
+#include "Application\DPIAPI.h"
 #include "GFX\GFX.h"
+#include "Utils\MulDivArray.h"
+#include "Utils\UTF.h"
 
 using namespace WUIF;
 
+namespace {
+    /*WindowUpdate sink that applies a WindowProperties transaction to a window. Error handling
+    follows the individual setters - SetWindowLongPtr and SetClassLongPtr can return 0 on success
+    so the last error is cleared before each call*/
+    class Win32UpdateSink
+    {
+    public:
+        Win32UpdateSink(_In_ HWND hWnd, _In_ HICON iconsm,
+                        _Inout_opt_ std::vector<WindowProperties::DeferredPosition> *deferred) :
+            _hWnd(hWnd), _iconsm(iconsm), _deferred(deferred) {}
+
+        unsigned long SetStyle(uint32_t v)   { return SetLong(GWL_STYLE, v); }
+        unsigned long SetExStyle(uint32_t v) { return SetLong(GWL_EXSTYLE, v); }
+
+        unsigned long SetCursor(void *v)
+        {
+            SetLastError(0);
+            if (SetClassLongPtr(_hWnd, GCLP_HCURSOR, reinterpret_cast<LONG_PTR>(v)) == 0)
+            {
+                return GetLastError();
+            }
+            return ERROR_SUCCESS;
+        }
+
+        unsigned long SetIcon(bool big, void *v)
+        {
+            if (big)
+            {
+                //must set ICON_SMALL first and then ICON_BIG or ICON_BIG will fail
+                SendMessage(_hWnd, WM_SETICON, ICON_SMALL, reinterpret_cast<LPARAM>(_iconsm));
+            }
+            SetLastError(0);
+            SendMessage(_hWnd, WM_SETICON, (big ? ICON_BIG : ICON_SMALL), reinterpret_cast<LPARAM>(v));
+            DWORD err = GetLastError();
+            if ((!big) && (err == ERROR_SUCCESS))
+            {
+                _iconsm = static_cast<HICON>(v);
+            }
+            return err;
+        }
+
+        unsigned long SetPosition(const WindowUpdate::Position &pos)
+        {
+            if (_deferred != nullptr)
+            {
+                //App::EndLayout applies every window's position with one DeferWindowPos batch
+                _deferred->push_back({ _hWnd, pos });
+                return ERROR_SUCCESS;
+            }
+            if (SetWindowPos(_hWnd, static_cast<HWND>(pos.insertafter), pos.x, pos.y, pos.cx, pos.cy,
+                             WindowProperties::swpflags(pos)))
+            {
+                return ERROR_SUCCESS;
+            }
+            DWORD err = GetLastError();
+            return ((err != ERROR_SUCCESS) ? err : ERROR_INVALID_WINDOW_HANDLE);
+        }
+
+    private:
+        HWND  _hWnd;
+        HICON _iconsm;
+        std::vector<WindowProperties::DeferredPosition> *_deferred;
+
+        unsigned long SetLong(int index, uint32_t v)
+        {
+            SetLastError(0);
+            if (!SetWindowLongPtr(_hWnd, index, static_cast<LONG_PTR>(v)))
+            {
+                return GetLastError();
+            }
+            return ERROR_SUCCESS;
+        }
+    };
+}
+
 WindowProperties::WindowProperties() noexcept :
     //win(winptr),
     initialized(false),
     scaleFactor(100),
     _classatom(NULL),
+    _sharedclass(false),
     _icon(NULL),
     _iconsm(NULL),
     _classcursor(NULL),
@@ -55,24 +135,18 @@ WindowProperties::WindowProperties() noexcept :
     _threaddpiawarenesscontext(NULL),
     _allowfsexclusive(false),
     _cmdshow(SW_SHOWNORMAL),
-    _fullscreen(false) 
+    _fullscreen(false),
+    _updatedepth(0),
+    _update()
 {
     _background[0] = 0.000000000f;
     _background[1] = 0.000000000f;
     _background[2] = 0.000000000f;
     _background[3] = 1.000000000f; //black
-    if (App::winversion >= OSVersion::WIN10_1607)
+    const DPIAPI &dpiAPI = App::DPI();
+    if (dpiAPI.GetThreadDpiAwarenessContext)
     {
-        HMODULE lib = GetModuleHandle(TEXT("user32.dll"));
-        if (lib)
-        {
-            using PFN_GET_THREAD_DPI_CONTEXT = DPI_AWARENESS_CONTEXT(WINAPI*)(void);
-            PFN_GET_THREAD_DPI_CONTEXT pfngetthreaddpiawarenesscontext = (PFN_GET_THREAD_DPI_CONTEXT)GetProcAddress(lib, "GetThreadDpiAwarenessContext");
-            if (pfngetthreaddpiawarenesscontext)
-            {
-                _threaddpiawarenesscontext = pfngetthreaddpiawarenesscontext();
-            }
-        }
+        _threaddpiawarenesscontext = dpiAPI.GetThreadDpiAwarenessContext();
     }
 }
 
@@ -80,7 +154,7 @@ WindowProperties::~WindowProperties()
 {
     //if (_windowname != nullptr)
     //{
-        delete[] _windowname;
+        AllocStats::DeleteArray(_windowname);
         _windowname = nullptr;
     //}
     if (_menu)
@@ -121,6 +195,11 @@ DWORD WindowProperties::icon(_In_ const HICON v)
 {
     /*You can override the large or small class icon for a particular window by using the
     WM_SETICON message*/
+    if ((initialized) && (_updatedepth))
+    {
+        _update.icon(v);
+        return ERROR_SUCCESS;
+    }
     if (initialized)
     {
         //must set ICON_SMALL first and then ICON_BIG or ICON_BIG will fail
@@ -155,6 +234,11 @@ DWORD WindowProperties::iconsm(_In_ const HICON v)
 {
     /*You can override the large or small class icon for a particular window by using the
     WM_SETICON message*/
+    if ((initialized) && (_updatedepth))
+    {
+        _update.iconsm(v);
+        return ERROR_SUCCESS;
+    }
     if (initialized)
     {
         SetLastError(0);
@@ -175,6 +259,8 @@ DWORD WindowProperties::iconsm(_In_ const HICON v)
 
 /*DWORD WindowProperties::iconsm(_In_ const HCURSOR v)
 Updates the class cursor. This will update the cursor for the WHOLE class, not just this window!
+Windows with the same icons and cursor share a class (see WindowClassCache), they all get the new
+cursor.
 
 HCURSOR v - handle to the cursor
 
@@ -183,8 +269,18 @@ System Error value (DWORD)
 */
 DWORD WindowProperties::classcursor(_In_ const HCURSOR v)
 {
+    if ((initialized) && (_updatedepth))
+    {
+        _update.cursor(v);
+        return ERROR_SUCCESS;
+    }
     if (initialized)
     {
+        if ((_sharedclass) && (v != _classcursor))
+        {
+            //other windows keep sharing the class but new windows won't pick up this cursor
+            WindowClassCache::Detach(_classatom);
+        }
         SetLastError(0);
         ULONG_PTR ret = SetClassLongPtr(_hWnd, GCLP_HCURSOR, reinterpret_cast<LONG_PTR>(v));
         if (ret == 0)
@@ -233,7 +329,7 @@ DWORD WindowProperties::hWndParent(_In_ const HWND v)
             SetLastError(0);
             DWORD newstyle = _style & ~WS_POPUP;
             newstyle |= WS_CHILD;
-            DWORD err = style(newstyle);
+            DWORD err = setstyle(newstyle);
             if (err)
                 return err;
         }
@@ -247,7 +343,7 @@ DWORD WindowProperties::hWndParent(_In_ const HWND v)
                 WS_POPUP style after calling SetParent.*/
                 DWORD newstyle = _style & ~WS_CHILD;
                 newstyle |= WS_POPUP;
-                DWORD err = style(newstyle);
+                DWORD err = setstyle(newstyle);
                 if (err)
                     return err;
                 /*When you change the parent of a window, you should synchronize the UISTATE of
@@ -302,6 +398,11 @@ System Error value (DWORD)
 */
 DWORD WindowProperties::exstyle(_In_ const DWORD v)
 {
+    if ((initialized) && (_updatedepth))
+    {
+        _update.exstyle(v);
+        return ERROR_SUCCESS;
+    }
     if (initialized)
     {
         /*If the function succeeds, the return value is the previous value of the specified offset.
@@ -359,7 +460,7 @@ HRESULT WindowProperties::windowname(_In_ LPCTSTR v)
     }
     if (_windowname != nullptr)
     {
-        delete[] _windowname;
+        AllocStats::DeleteArray(_windowname);
     }
     size_t length = 0;
     if (FAILED(StringCchLength(v, STRSAFE_MAX_CCH - 1, &length)))
@@ -367,11 +468,52 @@ HRESULT WindowProperties::windowname(_In_ LPCTSTR v)
         length = STRSAFE_MAX_CCH - 1; //account for last character must be null-terminator
 
     }
-    _windowname = CRT_NEW TCHAR[length + 1];
+    _windowname = AllocStats::NewArray<TCHAR>(length + 1, AllocTag::Window, __FILE__, __LINE__);
     //copy 'v' to '_windowname' - if a failure _windowname will be empty string
     return StringCchCopyEx(_windowname, length + 1, v, nullptr, nullptr, STRSAFE_NULL_ON_FAILURE);
 }
 
+/*HRESULT WindowProperties::windownameUTF8(_In_ const char *v)
+Sets the window name from a UTF-8 string. Ill-formed UTF-8 is replaced with U+FFFD. In MBCS builds
+the name is converted to the ANSI code page, characters it lacks become '?'.
+
+const char *v - source string, must be null-terminated UTF-8
+
+Return value
+HRESULT
+E_POINTER if 'v' is NULL, otherwise as windowname
+*/
+HRESULT WindowProperties::windownameUTF8(_In_ const char *v)
+{
+    if (v == nullptr)
+    {
+        return E_POINTER;
+    }
+    UTF16Buffer<> wide(v);
+    #ifdef _UNICODE
+    return windowname(wide.c_str());
+    #else
+    char  local[512];
+    char *name = local;
+    int   size = WideCharToMultiByte(CP_ACP, 0, wide.c_str(), -1, nullptr, 0, nullptr, nullptr);
+    if (size <= 0)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+    if (size > static_cast<int>(sizeof(local)))
+    {
+        name = AllocStats::NewArray<char>(static_cast<size_t>(size), AllocTag::Window, __FILE__, __LINE__);
+    }
+    WideCharToMultiByte(CP_ACP, 0, wide.c_str(), -1, name, size, nullptr, nullptr);
+    const HRESULT hr = windowname(name);
+    if (name != local)
+    {
+        AllocStats::DeleteArray(name);
+    }
+    return hr;
+    #endif
+}
+
 /*DWORD WindowProperties::style(_In_ const DWORD v)
 Update the window's style.
 
@@ -381,6 +523,25 @@ Return value
 System Error value (DWORD)
 */
 DWORD WindowProperties::style(_In_ const DWORD v)
+{
+    if ((initialized) && (_updatedepth))
+    {
+        _update.style(v);
+        return ERROR_SUCCESS;
+    }
+    return setstyle(v);
+}
+
+/*DWORD WindowProperties::setstyle(_In_ const DWORD v)
+Applies the window's style immediately, even inside BeginUpdate/Commit. Used by hWndParent as the
+style has to be changed before or after SetParent is called.
+
+DWORD v - the new window style
+
+Return value
+System Error value (DWORD)
+*/
+DWORD WindowProperties::setstyle(_In_ const DWORD v)
 {
     if (initialized)
     {
@@ -424,6 +585,11 @@ BOOL if window position updated
 */
 BOOL WindowProperties::left(_In_ const int v)
 {
+    if ((initialized) && (_updatedepth))
+    {
+        _update.left(v);
+        return TRUE;
+    }
     if (initialized)
     {
         //save our current x position and set _prevleft if SetWindowPos succeeds
@@ -453,6 +619,11 @@ BOOL if window position updated
 */
 BOOL WindowProperties::top(_In_ const int v)
 {
+    if ((initialized) && (_updatedepth))
+    {
+        _update.top(v);
+        return TRUE;
+    }
     if (initialized)
     {
         //save our current y position and set _prevtop if SetWindowPos succeeds
@@ -482,6 +653,12 @@ BOOL if window width updated
 */
 BOOL WindowProperties::width(_In_ const int v)
 {
+    if ((initialized) && (_updatedepth))
+    {
+        //(v > 0 ? v : 1) = don't allow 0 size value
+        _update.width(Scale((v > 0) ? v : 1));
+        return TRUE;
+    }
     if (initialized)
     {
         int oldwidth = _width;
@@ -504,6 +681,12 @@ BOOL WindowProperties::width(_In_ const int v)
 
 BOOL WindowProperties::height(_In_ const int v)
 {
+    if ((initialized) && (_updatedepth))
+    {
+        //(v > 1 ? v : 1) = don't allow 0 size value
+        _update.height(Scale((v > 1) ? v : 1));
+        return TRUE;
+    }
     if (initialized)
     {
         _prevheight = _height;
@@ -545,7 +728,14 @@ bool WindowProperties::menu(_In_ LPCTSTR v)
             return false;
         }
         //clear any cached data
-        SetWindowPos(_hWnd, 0, 0, 0, 0, 0, (SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER)); //no move, resize, or zorder changes
+        if (_updatedepth)
+        {
+            _update.refresh();
+        }
+        else
+        {
+            SetWindowPos(_hWnd, 0, 0, 0, 0, 0, (SWP_NOMOVE | SWP_NOSIZE | SWP_NOZORDER)); //no move, resize, or zorder changes
+        }
     }
     if (_menu != NULL)
         DestroyMenu(_menu);
@@ -593,4 +783,194 @@ DPI_AWARENESS_CONTEXT WindowProperties::threaddpiawarenesscontext(_In_ const DPI
         }
     }
     return reinterpret_cast<DPI_AWARENESS_CONTEXT>(retval);
+}
+
+static_assert(sizeof(POINT) == 2 * sizeof(LONG), "POINT must be two packed LONGs");
+static_assert(sizeof(RECT)  == 4 * sizeof(LONG), "RECT must be four packed LONGs");
+
+/*void WindowProperties::ScalePoints(_Inout_updates_(count) POINT *points, _In_ size_t count) const
+Scales an array of points from logical to physical (dpi scaled) coordinates in place - the same
+as calling Scale on each coordinate. In fullscreen coordinates are not scaled.
+
+POINT *points - the points to scale
+size_t count  - number of points
+*/
+void WindowProperties::ScalePoints(_Inout_updates_(count) POINT *points, _In_ size_t count) const
+{
+    if (!_fullscreen)
+    {
+        LONG *values = reinterpret_cast<LONG*>(points);
+        MulDivArray(values, values, count * 2, static_cast<int>(scaleFactor), 100);
+    }
+}
+
+/*void WindowProperties::ScaleRects(_Inout_updates_(count) RECT *rects, _In_ size_t count) const
+Scales an array of rects from logical to physical (dpi scaled) coordinates in place - the same as
+calling Scale on each coordinate. In fullscreen coordinates are not scaled.
+
+RECT *rects  - the rects to scale
+size_t count - number of rects
+*/
+void WindowProperties::ScaleRects(_Inout_updates_(count) RECT *rects, _In_ size_t count) const
+{
+    if (!_fullscreen)
+    {
+        LONG *values = reinterpret_cast<LONG*>(rects);
+        MulDivArray(values, values, count * 4, static_cast<int>(scaleFactor), 100);
+    }
+}
+
+/*void WindowProperties::UnscalePoints(_Inout_updates_(count) POINT *points, _In_ size_t count) const
+Converts an array of points from physical (dpi scaled) to logical coordinates in place - the same
+as MulDiv(x, 100, scaleFactor) on each coordinate. In fullscreen coordinates are not scaled.
+
+POINT *points - the points to convert
+size_t count  - number of points
+*/
+void WindowProperties::UnscalePoints(_Inout_updates_(count) POINT *points, _In_ size_t count) const
+{
+    if (!_fullscreen)
+    {
+        LONG *values = reinterpret_cast<LONG*>(points);
+        MulDivArray(values, values, count * 2, 100, static_cast<int>(scaleFactor));
+    }
+}
+
+/*void WindowProperties::UnscaleRects(_Inout_updates_(count) RECT *rects, _In_ size_t count) const
+Converts an array of rects from physical (dpi scaled) to logical coordinates in place - the same
+as MulDiv(x, 100, scaleFactor) on each coordinate. In fullscreen coordinates are not scaled.
+
+RECT *rects  - the rects to convert
+size_t count - number of rects
+*/
+void WindowProperties::UnscaleRects(_Inout_updates_(count) RECT *rects, _In_ size_t count) const
+{
+    if (!_fullscreen)
+    {
+        LONG *values = reinterpret_cast<LONG*>(rects);
+        MulDivArray(values, values, count * 4, 100, static_cast<int>(scaleFactor));
+    }
+}
+
+/*UINT WindowProperties::swpflags(_In_ const WindowUpdate::Position &pos)
+Converts a WindowUpdate position change to SetWindowPos/DeferWindowPos flags
+
+const WindowUpdate::Position &pos - the position change
+
+Return value
+UINT - SWP_ flags
+*/
+UINT WindowProperties::swpflags(_In_ const WindowUpdate::Position &pos)
+{
+    UINT flags = 0;
+    if (!pos.move)
+        flags |= SWP_NOMOVE;
+    if (!pos.size)
+        flags |= SWP_NOSIZE;
+    if (!pos.zorder)
+        flags |= SWP_NOZORDER;
+    if (pos.framechanged)
+        flags |= SWP_FRAMECHANGED;
+    if (pos.show)
+        flags |= SWP_SHOWWINDOW;
+    //only activate the window if it's being shown or brought to the top
+    if ((!pos.zorder) && (!pos.show))
+        flags |= SWP_NOACTIVATE;
+    return flags;
+}
+
+/*void WindowProperties::BeginUpdate()
+Starts a transaction. Until the matching Commit, changes made with left, top, width, height,
+style, exstyle, icon, iconsm, classcursor and menu on an initialized window are collected instead
+of being applied one at a time. Calls may be nested, only the outermost Commit applies the
+changes.*/
+void WindowProperties::BeginUpdate()
+{
+    _updatedepth++;
+}
+
+/*DWORD WindowProperties::Commit(_Inout_opt_ std::vector<DeferredPosition> *deferred)
+Ends a transaction started by BeginUpdate. The outermost Commit applies the collected changes with
+one SetWindowLongPtr per changed style word and a single SetWindowPos, so the window gets one frame
+change and one WM_WINDOWPOSCHANGED (and one swap chain resize) however many properties changed.
+
+std::vector<DeferredPosition> *deferred - nullptr to call SetWindowPos, otherwise the position
+                                          change is added to deferred and the caller applies it
+                                          (used by App::EndLayout)
+
+Return value
+System Error value (DWORD) - the first error encountered, changes that failed are not stored
+*/
+DWORD WindowProperties::Commit(_Inout_opt_ std::vector<DeferredPosition> *deferred)
+{
+    if (_updatedepth == 0)
+    {
+        return ERROR_SUCCESS; //unmatched Commit
+    }
+    if (--_updatedepth != 0)
+    {
+        return ERROR_SUCCESS; //nested - the outermost Commit applies the changes
+    }
+    if ((!initialized) || (_update.empty()))
+    {
+        _update.clear();
+        return ERROR_SUCCESS;
+    }
+    WindowUpdate::State current;
+    current.style   = _style;
+    current.exstyle = _exstyle;
+    current.left    = _left;
+    current.top     = _top;
+    current.width   = _actualwidth;
+    current.height  = _actualheight;
+    current.icon    = _icon;
+    current.iconsm  = _iconsm;
+    current.cursor  = _classcursor;
+    //WM_WINDOWPOSCHANGED updates the position variables during SetWindowPos, keep the old values
+    int oldwidth  = _width;
+    int oldheight = _height;
+    if ((_sharedclass) && (_update.changed() & WindowUpdate::CURSOR) &&
+        (_update.pending().cursor != current.cursor))
+    {
+        WindowClassCache::Detach(_classatom); //see classcursor
+    }
+    Win32UpdateSink sink(_hWnd, _iconsm, deferred);
+    WindowUpdate::Result res = _update.Apply(current, sink);
+    const WindowUpdate::State &pending = _update.pending();
+    //update the stored values the same way the individual setters do
+    if (res.applied & WindowUpdate::STYLE)
+    {
+        _prevstyle = current.style;
+        _style     = pending.style;
+    }
+    if (res.applied & WindowUpdate::EXSTYLE)
+    {
+        _prevexstyle = current.exstyle;
+        _exstyle     = pending.exstyle;
+    }
+    if (res.applied & WindowUpdate::ICON)
+        _icon = static_cast<HICON>(pending.icon);
+    if (res.applied & WindowUpdate::ICONSM)
+        _iconsm = static_cast<HICON>(pending.iconsm);
+    if (res.applied & WindowUpdate::CURSOR)
+        _classcursor = static_cast<HCURSOR>(pending.cursor);
+    if (res.applied & WindowUpdate::LEFT)
+        _prevleft = current.left;
+    if (res.applied & WindowUpdate::TOP)
+        _prevtop = current.top;
+    //when deferred WM_WINDOWPOSCHANGED has not happened yet and updates the actual size itself
+    if (res.applied & WindowUpdate::WIDTH)
+    {
+        _prevwidth = oldwidth;
+        if (deferred == nullptr)
+            _actualwidth = pending.width;
+    }
+    if (res.applied & WindowUpdate::HEIGHT)
+    {
+        _prevheight = oldheight;
+        if (deferred == nullptr)
+            _actualheight = pending.height;
+    }
+    _update.clear();
+    return res.error;
 }
\ No newline at end of file
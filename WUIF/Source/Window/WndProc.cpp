@@ -16,10 +16,66 @@ limitations under the License.*/
 #include <strsafe.h> //needed for StringCchPrintf
 #include "GFX\GFX.h"
 #include "Application\Application.h"
+#include "Application\DPIAPI.h"
+#include "Application\PerfCounters.h"
+#include "Application\Watchdog.h"
+#include "Utils\PhaseMarker.h"
 #include "Window\Window.h"
+#include "Window\DPICache.h"
+#include "Utils\TraceSpan.h"
 
 namespace {
-    long exceptionraised = 0;
+    volatile long exceptionraised = 0;
+
+    //messages handled by the switch in _WndProc - WM_USER + 1 is above MessageBits and always dispatched
+    WUIF::MessageBits BuiltinMessages()
+    {
+        WUIF::MessageBits bits;
+        bits.set<WM_GETMINMAXINFO>();
+        bits.set<WM_NCCREATE>();
+        bits.set<WM_CREATE>();
+        bits.set<WM_SYSKEYDOWN>();
+        #ifdef TRACESPANS
+        bits.set<WM_KEYDOWN>();
+        #endif
+        bits.set<WM_PAINT>();
+        bits.set<WM_WINDOWPOSCHANGED>();
+        bits.set<WM_DISPLAYCHANGE>();
+        bits.set<WM_DPICHANGED>();
+        bits.set<WM_DESTROY>();
+        bits.set<WM_NCDESTROY>();
+        return bits;
+    }
+    const WUIF::MessageBits builtinmessages = BuiltinMessages();
+
+    //keyboard, mouse, touch, pointer and raw input - tagged for Window::MeasureLatency
+    WUIF::MessageBits InputMessages()
+    {
+        WUIF::MessageBits bits;
+        for (UINT message = WM_KEYFIRST; message <= WM_KEYLAST; message++)
+        {
+            bits.set(message);
+        }
+        for (UINT message = WM_MOUSEFIRST; message <= WM_MOUSELAST; message++)
+        {
+            bits.set(message);
+        }
+        bits.set<WM_INPUT>();
+        bits.set<WM_TOUCH>();
+        bits.set<WM_POINTERDOWN>();
+        bits.set<WM_POINTERUP>();
+        bits.set<WM_POINTERUPDATE>();
+        bits.set<WM_POINTERWHEEL>();
+        bits.set<WM_POINTERHWHEEL>();
+        return bits;
+    }
+    const WUIF::MessageBits inputmessages = InputMessages();
+}
+
+namespace WUIF {
+    namespace App {
+        extern bool deferresize; //App::EndLayout is applying a DeferWindowPos batch
+    }
 }
 
 using namespace WUIF;
@@ -30,34 +86,75 @@ LRESULT CALLBACK Window::_WndProc(_In_ Window* pThis, _In_ HWND hWnd, _In_ UINT
 LRESULT CALLBACK Window::_WndProc(_In_ HWND hWnd, _In_ UINT message, _In_ WPARAM wParam, _In_ LPARAM lParam, _In_ Window* pThis)
 #endif
 {
+    WUIF_TRACE_SPAN_ARG("WndProc", message);
     LRESULT retval = 0;
+    pThis->dispatchstats.messages++;
+    PerfCounters::messages.Add();
+    Watchdog::Beat(); //nested modal loops (menus, sizing, dialogs) keep the watchdog quiet
+    if (pThis->latencystats.enabled() && (message < MessageBits::bits) && inputmessages.test(message))
+    {
+        pThis->TagInput(message, wParam);
+    }
+    //WM_INPUT is only batched with rawmouse, and only mouse input - other devices' input is dispatched
+    if ((pThis->inputroutine != nullptr) && (exceptionraised == 0) &&
+        ((message == WM_MOUSEMOVE) || (message == WM_POINTERUPDATE) || ((message == WM_INPUT) && pThis->rawmouse)) &&
+        pThis->BatchMessage(message, wParam, lParam))
+    {
+        //collected for the input routine - a sub-classed control still sees every message
+        pThis->dispatchstats.batched++;
+        if (pThis->cWndProc)
+        {
+            return CallWindowProc(pThis->cWndProc, hWnd, message, wParam, lParam);
+        }
+        //WM_INPUT needs DefWindowProc to clean up
+        return (message == WM_INPUT) ? DefWindowProc(hWnd, message, wParam, lParam) : 0;
+    }
+    /*most messages (mouse moves, hit tests, cursor updates...) have no handler - skip the exception
+    guard, the map lookups and the switch. exceptionraised is only non zero for the message after
+    an exception, which the guard swallows*/
+    if ((message < MessageBits::bits) && !builtinmessages.test(message) && !App::GWndProc_map.handles(message) &&
+        !pThis->WndProc_map.handles(message) && (exceptionraised == 0))
+    {
+        pThis->dispatchstats.fastpath++;
+        if (pThis->cWndProc)
+        {
+            return CallWindowProc(pThis->cWndProc, hWnd, message, wParam, lParam);
+        }
+        return DefWindowProc(hWnd, message, wParam, lParam);
+    }
     if (InterlockedDecrement(&exceptionraised) < 0)
     {
         InterlockedIncrement(&exceptionraised); //bring back to 0
         bool handled = false;
+        //what the watchdog reports if this message stalls the UI thread
+        Watchdog::Scope activity(Watchdog::detector, WatchActivity::Message, message, nullptr, hWnd);
+        WUIF_PHASE("dispatch");
         //exceptions are not propagated in WndProc
         try
         {
-            if (!App::GWndProc_map.empty())
+            if (App::GWndProc_map.handles(message))
             {
-                auto proc = App::GWndProc_map.count(message);
-                if (proc == 1)
+                const WNDPROC proc = App::GWndProc_map.find(message);
+                if (proc)
                 {
-                    handled = (WNDPROC)(App::GWndProc_map[message])(hWnd, message, wParam, lParam);
+                    activity.Handler(WatchActivity::Message, reinterpret_cast<const void*>(proc));
+                    handled = (proc(hWnd, message, wParam, lParam) != 0);
                 }
             }
-            if (!pThis->WndProc_map.empty())
+            if (pThis->WndProc_map.handles(message))
             {
-                auto proc = pThis->WndProc_map.count(message);
-                if (proc == 1)
+                const WndProc proc = pThis->WndProc_map.find(message);
+                if (proc)
                 {
+                    activity.Handler(WatchActivity::Message, reinterpret_cast<const void*>(proc));
                     //App::paintmutex.lock();
-                    handled = (WndProc)(pThis->WndProc_map[message])(hWnd, message, wParam, lParam, pThis);
+                    handled = proc(hWnd, message, wParam, lParam, pThis);
                     //App::paintmutex.unlock();
                 }
             }
             if (!handled)
             {
+                activity.Handler(WatchActivity::Message, nullptr);
                 switch (message)
                 {
                 case WM_GETMINMAXINFO:
@@ -96,37 +193,13 @@ LRESULT CALLBACK Window::_WndProc(_In_ HWND hWnd, _In_ UINT message, _In_ WPARAM
                     for top-level windows that are running as per-monitor DPI aware (This will have
                     no effect if the thread's DPI context is not per-monitor-DPI-aware). This API
                     should be called while processing WM_NCCREATE.*/
-                    if (App::winversion >= OSVersion::WIN10_1607)
+                    const DPIAPI &dpiAPI = App::DPI();
+                    if ((dpiAPI.AreDpiAwarenessContextsEqual) && (dpiAPI.EnableNonClientDpiScaling))
                     {
-                        if (App::processdpiawarenesscontext != nullptr)
+                        if (dpiAPI.AreDpiAwarenessContextsEqual(pThis->_threaddpiawarenesscontext,
+                                                                DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE))
                         {
-                            HMODULE lib = GetModuleHandle(TEXT("user32.dll"));
-                            if (lib)
-                            {
-                                using PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL =
-                                    BOOL(WINAPI*)(DPI_AWARENESS_CONTEXT, DPI_AWARENESS_CONTEXT);
-                                PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL pfnaredpiawarenesscontextsequal =
-                                    (PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL)GetProcAddress(lib, "AreDpiAwarenessContextsEqual");
-                                if (pfnaredpiawarenesscontextsequal)
-                                {
-                                    if (pfnaredpiawarenesscontextsequal(pThis->_threaddpiawarenesscontext,
-                                                                        DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE))
-                                    {
-                                        if (lib)
-                                        {
-                                            using PFN_ENABLE_NON_CLIENT_DPI_SCALING =
-                                                BOOL(WINAPI *)(HWND);
-                                            PFN_ENABLE_NON_CLIENT_DPI_SCALING pfnenablenonclientscaling =
-                                                (PFN_ENABLE_NON_CLIENT_DPI_SCALING)GetProcAddress(lib, "EnableNonClientDpiScaling");
-                                            if (pfnenablenonclientscaling)
-                                            {
-                                                pfnenablenonclientscaling(hWnd);
-                                            }
-                                        }
-                                    }
-                                }
-
-                            }
+                            dpiAPI.EnableNonClientDpiScaling(hWnd);
                         }
                     }
                 }
@@ -193,6 +266,12 @@ LRESULT CALLBACK Window::_WndProc(_In_ HWND hWnd, _In_ UINT message, _In_ WPARAM
                             pThis->_actualheight, SWP_NOZORDER | SWP_NOACTIVATE);
                     }
 
+                    //BatchInput was called before the window existed
+                    if (pThis->rawmouse)
+                    {
+                        pThis->RegisterRawMouse(true);
+                    }
+
                     handled = true;
                 }
                 break;
@@ -211,6 +290,18 @@ LRESULT CALLBACK Window::_WndProc(_In_ HWND hWnd, _In_ UINT message, _In_ WPARAM
                     }
                 }
                 break;
+                #ifdef TRACESPANS
+                case WM_KEYDOWN:
+                {
+                    //Ctrl+Shift+F12 writes the trace spans recorded so far
+                    if ((wParam == VK_F12) && (GetKeyState(VK_CONTROL) < 0) && (GetKeyState(VK_SHIFT) < 0))
+                    {
+                        TraceSpans::Dump(TEXT("WUIF_spans.json"));
+                        handled = true;
+                    }
+                }
+                break;
+                #endif
                 case WM_PAINT:
                 {
                     /*
@@ -271,76 +362,43 @@ LRESULT CALLBACK Window::_WndProc(_In_ HWND hWnd, _In_ UINT message, _In_ WPARAM
                             pThis->_width = MulDiv(newpos->cx, 100, pThis->scaleFactor); //width without scaling
                             pThis->_height = MulDiv(newpos->cy, 100, pThis->scaleFactor); //height without scaling
                         }
-                        //App::paintmutex.lock();
-                        pThis->CreateSwapChain();
-                        //setup D3D dependent resources
-                        if (App::GFXflags & FLAGS::D3D12)
-                        {
-                            //pThis->GFX->D3D12->CreateD12Resources();
-                        }
-                        else //use D3D11
+                        if (App::deferresize)
                         {
-                            pThis->CreateD3D11DeviceResources();
+                            //part of a layout batch - App::EndLayout resizes once every window has moved
+                            pThis->state.fetch_or(FLAGS::RESIZEPENDING, std::memory_order_release);
                         }
-                        if (App::GFXflags & FLAGS::D2D)
+                        else
                         {
-                            pThis->CreateD2DDeviceResources();
+                            pThis->ResizeSwapChain();
                         }
-                        //App::paintmutex.unlock();
                     }
                     handled = true;
                 }
                 break;
                 case WM_DISPLAYCHANGE:
                 {
+                    //resolution or monitor topology changed - cached monitor dpi values can't be trusted
+                    DPICache::InvalidateAll();
                     InvalidateRect(hWnd, nullptr, false);
                     handled = true;
                 }
                 break;
                 case WM_DPICHANGED:
                 {
-                    bool changedpi = false;
-                    if (App::winversion >= OSVersion::WIN10_1607)
-                    {
-                        if (App::processdpiawarenesscontext != nullptr)
-                        {
-                            HMODULE lib = GetModuleHandle(TEXT("user32.dll"));
-                            if (lib)
-                            {
-                                using PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL = BOOL(WINAPI*)(DPI_AWARENESS_CONTEXT, DPI_AWARENESS_CONTEXT);
-                                PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL pfnaredpiawarenesscontextsequal = (PFN_ARE_DPI_AWARENESS_CONTEXTS_EQUAL)GetProcAddress(lib, "AreDpiAwarenessContextsEqual");
-                                if (pfnaredpiawarenesscontextsequal)
-                                {
-                                    if (pfnaredpiawarenesscontextsequal(*App::processdpiawarenesscontext, DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2))
-                                    {
-                                        changedpi = true;
-                                    }
-                                    else
-                                    {
-                                        if (pfnaredpiawarenesscontextsequal(*App::processdpiawarenesscontext, DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE))
-                                        {
-                                            changedpi = true;
-                                        }
-                                    }
-                                }
-
-                            }
-                        }
-                    }
                     //only per monitor aware need to respond to WM_DPICHANGED
-                    if (changedpi || ((App::processdpiawareness) && (*App::processdpiawareness ==                                                                           PROCESS_PER_MONITOR_DPI_AWARE)))
+                    if (App::DPI().permonitoraware)
                     {
                         // This message tells the program that most of its window is on a monitor with a new DPI. The wParam contains
                         // the new DPI, and the lParam contains a rect which defines the window rectangle scaled to the new DPI.
-                        pThis->scaleFactor = MulDiv(LOWORD(wParam), 100, 96);
+                        // Get the window rectangle scaled for the new DPI, retrieved from the lParam
+                        LPRECT lprcNewScale = reinterpret_cast<LPRECT>(lParam);
+                        pThis->setWindowDPI(LOWORD(wParam), MonitorFromRect(lprcNewScale, MONITOR_DEFAULTTONEAREST));
                         if (pThis->d2dDeviceContext)
                         {
                             //App::paintmutex.lock();
                             pThis->d2dDeviceContext->SetDpi(LOWORD(wParam), LOWORD(wParam));
                             //App::paintmutex.unlock();
                         }
-                        // Get the window rectangle scaled for the new DPI, retrieved from the lParam
-                        LPRECT lprcNewScale = reinterpret_cast<LPRECT>(lParam);
                         pThis->_left = lprcNewScale->left;
                         pThis->_top = lprcNewScale->top;
                         pThis->_actualwidth = lprcNewScale->right - lprcNewScale->left;
@@ -396,15 +454,10 @@ LRESULT CALLBACK Window::_WndProc(_In_ HWND hWnd, _In_ UINT message, _In_ WPARAM
                 break;
                 case WM_USER+1: //For changing the window's Dpi Awareness Context
                 {
-                    HMODULE lib = GetModuleHandle(TEXT("user32.dll"));
-                    if (lib)
+                    const DPIAPI &dpiAPI = App::DPI();
+                    if (dpiAPI.SetThreadDpiAwarenessContext)
                     {
-                        using PFN_SET_THREAD_DPI_AWARENESS_CONTEXT = DPI_AWARENESS_CONTEXT(WINAPI*)(DPI_AWARENESS_CONTEXT);
-                        PFN_SET_THREAD_DPI_AWARENESS_CONTEXT pfnsetthreaddpiawarenesscontext = (PFN_SET_THREAD_DPI_AWARENESS_CONTEXT)GetProcAddress(lib, "SetThreadDpiAwarenessContext");
-                        if (pfnsetthreaddpiawarenesscontext)
-                        {
-                            retval = reinterpret_cast<LRESULT>(pfnsetthreaddpiawarenesscontext(pThis->_threaddpiawarenesscontext));
-                        }
+                        retval = reinterpret_cast<LRESULT>(dpiAPI.SetThreadDpiAwarenessContext(pThis->_threaddpiawarenesscontext));
                     }
                     handled = true;
                 }
@@ -0,0 +1,193 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*AllocStats accounting (Headers/Utils/AllocTag.h) through each way of tagging memory -
+AllocTagged classes, TaggedAllocator containers, NewArray and Record/Erase - and under concurrent
+use. The counters are process wide, every case compares snapshots taken before and after.*/
+#include <cstring>
+#include <map>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Utils/AllocTag.h"
+#include "Test.h"
+
+using WUIF::AllocStats;
+using WUIF::AllocTag;
+using WUIF::AllocTagged;
+using WUIF::TaggedAllocator;
+
+namespace
+{
+    struct WindowThing : AllocTagged<AllocTag::Window>
+    {
+        char data[100];
+    };
+
+    struct GFXThing : AllocTagged<AllocTag::GFX>
+    {
+        int value;
+    };
+
+    AllocStats::Difference Since(const AllocStats::Snapshot &before)
+    {
+        return AllocStats::Diff(before, AllocStats::Take());
+    }
+}
+
+TEST(TaggedClassNewAndDelete)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    WindowThing *thing = new WindowThing;
+    GFXThing *things   = new GFXThing[3];
+    AllocStats::Difference diff = Since(before);
+    CHECK_EQ(diff[AllocTag::Window].bytes, sizeof(WindowThing));
+    CHECK_EQ(diff[AllocTag::Window].blocks, 1);
+    CHECK_EQ(diff[AllocTag::Window].allocs, 1);
+    CHECK_EQ(diff[AllocTag::GFX].allocs, 1);
+    CHECK(diff[AllocTag::GFX].bytes >= static_cast<int64_t>(3 * sizeof(GFXThing)));
+    CHECK_EQ(diff[AllocTag::Thunk].allocs, 0);
+    CHECK(diff.Allocated());
+    delete thing;
+    delete[] things;
+    diff = Since(before);
+    CHECK_EQ(diff[AllocTag::Window].bytes, 0);
+    CHECK_EQ(diff[AllocTag::Window].blocks, 0);
+    CHECK_EQ(diff[AllocTag::Window].frees, 1);
+    CHECK_EQ(diff[AllocTag::GFX].bytes, 0);
+    //the high-water mark saw the allocation
+    CHECK(AllocStats::Take()[AllocTag::Window].peak >= before[AllocTag::Window].bytes + sizeof(WindowThing));
+}
+
+TEST(PlacementNewIsNotCounted)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    alignas(WindowThing) unsigned char storage[sizeof(WindowThing)];
+    WindowThing *thing = new (storage) WindowThing;
+    thing->data[0] = 1;
+    CHECK(!Since(before).Allocated());
+}
+
+TEST(ReturnedMemoryIsAlignedAndUsable)
+{
+    std::vector<void*> blocks;
+    for (size_t size = 1; size < 300; size += 7)
+    {
+        void *p = AllocStats::Allocate(size, AllocTag::App);
+        CHECK_EQ(reinterpret_cast<uintptr_t>(p) % 16, 0);
+        memset(p, 0xab, size);
+        blocks.push_back(p);
+    }
+    for (void *p : blocks)
+    {
+        AllocStats::Free(p);
+    }
+    AllocStats::Free(nullptr);
+}
+
+TEST(ContainersWithTaggedAllocator)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    {
+        std::vector<int, TaggedAllocator<int, AllocTag::App>> vector;
+        for (int i = 0; i < 1000; i++)
+        {
+            vector.push_back(i);
+        }
+        std::map<int, int, std::less<int>, TaggedAllocator<std::pair<const int, int>, AllocTag::App>> map;
+        map[1] = 2;
+        std::unordered_map<int, int, std::hash<int>, std::equal_to<int>,
+                           TaggedAllocator<std::pair<const int, int>, AllocTag::App>> hashed;
+        hashed[3] = 4;
+        const AllocStats::Difference diff = Since(before);
+        CHECK(diff[AllocTag::App].bytes >= static_cast<int64_t>(1000 * sizeof(int)));
+        CHECK(diff[AllocTag::App].blocks >= 3);
+        CHECK_EQ(diff[AllocTag::Window].allocs, 0);
+    }
+    const AllocStats::Difference diff = Since(before);
+    CHECK_EQ(diff[AllocTag::App].bytes, 0);
+    CHECK_EQ(diff[AllocTag::App].blocks, 0);
+    CHECK_EQ(diff[AllocTag::App].allocs, diff[AllocTag::App].frees);
+}
+
+TEST(ArraysAndOSMemory)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    std::unique_ptr<char, AllocStats::Deleter> name(AllocStats::NewArray<char>(33, AllocTag::Window));
+    AllocStats::Record(AllocTag::Thunk, 65536); //e.g. a mapped thunk block
+    AllocStats::Difference diff = Since(before);
+    CHECK_EQ(diff[AllocTag::Window].bytes, 33);
+    CHECK_EQ(diff[AllocTag::Thunk].bytes, 65536);
+    CHECK_EQ(diff[AllocTag::Thunk].blocks, 1);
+    name.reset();
+    AllocStats::Erase(AllocTag::Thunk, 65536);
+    diff = Since(before);
+    CHECK_EQ(diff[AllocTag::Window].bytes, 0);
+    CHECK_EQ(diff[AllocTag::Thunk].bytes, 0);
+    CHECK_EQ(diff[AllocTag::Thunk].frees, 1);
+}
+
+TEST(ResetPeak)
+{
+    GFXThing *big = new GFXThing[1000];
+    delete[] big;
+    CHECK(AllocStats::Take()[AllocTag::GFX].peak >= 1000 * sizeof(GFXThing));
+    AllocStats::ResetPeak();
+    const AllocStats::Snapshot now = AllocStats::Take();
+    CHECK_EQ(now[AllocTag::GFX].peak, now[AllocTag::GFX].bytes);
+}
+
+TEST(ConcurrentAllocations)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([]()
+        {
+            std::vector<WindowThing*> held;
+            for (int i = 0; i < 50000; i++)
+            {
+                held.push_back(new WindowThing);
+                if ((i & 1) != 0)
+                {
+                    delete held.back();
+                    held.pop_back();
+                }
+            }
+            for (WindowThing *thing : held)
+            {
+                delete thing;
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    const AllocStats::Difference diff = Since(before);
+    CHECK_EQ(diff[AllocTag::Window].allocs, 200000);
+    CHECK_EQ(diff[AllocTag::Window].frees, 200000);
+    CHECK_EQ(diff[AllocTag::Window].bytes, 0);
+    CHECK_EQ(diff[AllocTag::Window].blocks, 0);
+    //each thread held up to 25000 at once
+    CHECK(AllocStats::Take()[AllocTag::Window].peak >= 25000 * sizeof(WindowThing));
+}
+
+TEST(Names)
+{
+    CHECK(strcmp(AllocStats::Name(AllocTag::Window), "Window") == 0);
+    CHECK(strcmp(AllocStats::Name(AllocTag::Logging), "Logging") == 0);
+    CHECK(strcmp(AllocStats::Name(AllocTag::Count), "?") == 0);
+}
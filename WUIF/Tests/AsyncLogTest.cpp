@@ -0,0 +1,126 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*AsyncLog (Headers/Utils/AsyncLog.h) - formatting on the consumer, string copies of both character
+types, Flush, drop counting and Stop racing producers on other threads*/
+#include <atomic>
+#include <cstring>
+#include <cwchar>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils/AsyncLog.h"
+#include "Test.h"
+
+namespace
+{
+    typedef WUIF::AsyncLog<char> Log;
+
+    std::atomic<unsigned long> lines{ 0 };
+    std::string                last;
+
+    void Count(const char*) { lines.fetch_add(1); }
+    void Keep(const char *line)
+    {
+        last = line;
+        lines.fetch_add(1);
+    }
+
+    const char newline[] =
+    #if defined(_WIN32)
+        "\r\n";
+    #else
+        "\n";
+    #endif
+}
+
+TEST(LogIsFormattedAndStringsAreCopied)
+{
+    REQUIRE(Log::Start(Keep));
+    char name[16];
+    strcpy(name, "first");
+    CHECK(Log::Log("%s %d %.1f", name, 42, 2.5f));
+    strcpy(name, "changed");
+    CHECK(Log::Flush());
+    CHECK(last == std::string("first 42 2.5") + newline);
+    Log::Stop();
+    CHECK(!Log::Running());
+    CHECK(!Log::Log("after stop"));
+}
+
+TEST(WideStringsAreCopiedInACharLog)
+{
+    REQUIRE(Log::Start(Keep));
+    wchar_t name[16];
+    wcscpy(name, L"wide");
+    const int values[2] = { 1, 2 };
+    CHECK(Log::Log("%ls %p", name, static_cast<const void*>(values)));
+    wcscpy(name, L"changed");
+    CHECK(Log::Flush());
+    CHECK(last.compare(0, 5, "wide ") == 0);
+    Log::Stop();
+}
+
+TEST(FullRingDropsAndReports)
+{
+    lines = 0;
+    const Log::Statistics before = Log::GetStatistics();
+    REQUIRE(Log::Start(Count, 4096));
+    //a 4 KB ring holds about a hundred of these, a tight loop can outrun the consumer - every message is written or dropped
+    for (int i = 0; i < 10000; i++)
+    {
+        CHECK(Log::Log("message %d", i));
+    }
+    Log::Stop();
+    const Log::Statistics after = Log::GetStatistics();
+    CHECK_EQ(after.logged - before.logged + after.dropped - before.dropped, 10000);
+    CHECK_EQ(after.written - before.written, lines.load());
+}
+
+TEST(StopWritesEveryAcceptedMessage)
+{
+    //producers keep logging while Stop runs - whatever Log accepted must reach the sink
+    for (int round = 0; round < 1000; round++)
+    {
+        lines = 0;
+        const Log::Statistics before = Log::GetStatistics();
+        REQUIRE(Log::Start(Count, 1024 * 1024));
+        std::atomic<unsigned long> accepted{ 0 };
+        std::atomic<bool>          go{ false };
+        std::vector<std::thread>   producers;
+        for (int t = 0; t < 4; t++)
+        {
+            producers.emplace_back([&accepted, &go]()
+            {
+                while (!go.load())
+                    std::this_thread::yield();
+                for (int i = 0; i < 2000; i++)
+                {
+                    if (Log::Log("thread message %d", i))
+                        accepted.fetch_add(1);
+                }
+            });
+        }
+        go = true;
+        std::this_thread::yield();
+        Log::Stop();
+        for (std::thread &producer : producers)
+        {
+            producer.join();
+        }
+        const Log::Statistics after = Log::GetStatistics();
+        CHECK_EQ(after.dropped - before.dropped, 0);
+        CHECK_EQ(after.logged - before.logged, accepted.load());
+        CHECK_EQ(lines.load(), accepted.load());
+    }
+}
@@ -0,0 +1,208 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*BinaryTrace (Headers/Utils/BinaryTrace.h) - the records of events written by several threads at
+once, each thread's runs of slots, string arguments and their TEXT records, a full file and a file
+reopened after threads traced into the one before. The trace state is process wide, so the cases run
+in order.*/
+#if defined(_WIN32)
+#include <Windows.h> //BinaryTrace.h maps the file with CreateFileMapping
+#endif
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+#include "Utils/BinaryTrace.h"
+#include "Test.h"
+
+using WUIF::BinaryTrace;
+
+namespace
+{
+    #if defined(_WIN32)
+    const TCHAR path[]  = TEXT("BinaryTraceTest.trc");
+    const char  cpath[] = "BinaryTraceTest.trc";
+    #else
+    const char path[]   = "BinaryTraceTest.trc";
+    const char *cpath   = path;
+    #endif
+
+    const uint32_t site = 0x5173;
+
+    struct Trace
+    {
+        BinaryTrace::FileHeader         header;
+        std::vector<BinaryTrace::Record> records;
+    };
+
+    //reads back the records Close says were claimed
+    Trace Read()
+    {
+        Trace trace;
+        memset(&trace.header, 0, sizeof(trace.header));
+        FILE *file = fopen(cpath, "rb");
+        if (file == nullptr)
+        {
+            return trace;
+        }
+        if (fread(&trace.header, sizeof(trace.header), 1, file) == 1)
+        {
+            BinaryTrace::Record r;
+            while (((trace.records.size() + 1) < trace.header.used) && (fread(&r, sizeof(r), 1, file) == 1))
+            {
+                trace.records.push_back(r);
+            }
+        }
+        fclose(file);
+        remove(cpath);
+        return trace;
+    }
+
+    //thread t writes events numbered 0..count-1, every third with its name as a string argument
+    void Events(unsigned t, unsigned count)
+    {
+        const char *names[] = { "first thread", "second thread", "third thread", "fourth thread" };
+        for (unsigned i = 0; i < count; i++)
+        {
+            if ((i % 3) == 0)
+                BinaryTrace::Event(site, t, i, names[t]);
+            else
+                BinaryTrace::Event(site, t, i);
+        }
+    }
+}
+
+TEST(EventsOfEveryThreadAreWritten)
+{
+    static const bool defined = BinaryTrace::Define(site, __FILE__, __LINE__, "thread %u event %u %s");
+    (void)defined;
+    REQUIRE(BinaryTrace::Open(path, 4096));
+    const unsigned threads = 4, count = 500;
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+    {
+        workers.emplace_back(Events, t, count);
+    }
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    const BinaryTrace::Statistics stats = BinaryTrace::GetStatistics();
+    CHECK_EQ(stats.dropped, 0);
+    BinaryTrace::Close();
+    const Trace trace = Read();
+    CHECK_EQ(trace.header.used, stats.used);
+    CHECK(trace.header.frequency != 0);
+    //events of a thread are in order in the file and in time, each string is in the TEXT record after it
+    std::vector<unsigned> next(threads, 0);
+    std::map<unsigned, uint64_t> last;
+    unsigned sites = 0, texts = 0, empty = 0;
+    for (size_t i = 0; i < trace.records.size(); i++)
+    {
+        const BinaryTrace::Record &r = trace.records[i];
+        if (r.type == BinaryTrace::SITE)
+        {
+            //and the format and file name in the TEXT records after it
+            sites++;
+            while (((i + 1) < trace.records.size()) && (trace.records[i + 1].type == BinaryTrace::TEXT))
+            {
+                i++;
+                texts++;
+            }
+            continue;
+        }
+        if (r.type == BinaryTrace::EMPTY)
+        {
+            empty++;
+            continue;
+        }
+        if (!CHECK_EQ(r.type, BinaryTrace::EVENT))
+        {
+            break;
+        }
+        const unsigned t = static_cast<unsigned>(r.args[0]);
+        REQUIRE(t < threads);
+        CHECK_EQ(r.args[1], next[t]);
+        CHECK(r.timestamp >= last[r.thread]);
+        CHECK(r.timestamp >= trace.header.start);
+        last[r.thread] = r.timestamp;
+        if ((next[t] % 3) == 0)
+        {
+            REQUIRE(CHECK_EQ(r.count, 3) && ((i + 1) < trace.records.size()));
+            const BinaryTrace::Record &text = trace.records[++i];
+            CHECK_EQ(text.type, BinaryTrace::TEXT);
+            CHECK_EQ(text.count, r.args[2]);
+            CHECK_EQ(text.thread, r.thread);
+            const char *names[] = { "first thread", "second thread", "third thread", "fourth thread" };
+            CHECK(memcmp(text.args, names[t], text.count) == 0);
+        }
+        else
+        {
+            CHECK_EQ(r.count, 2);
+        }
+        next[t]++;
+    }
+    CHECK_EQ(sites, 1);
+    for (unsigned t = 0; t < threads; t++)
+    {
+        CHECK_EQ(next[t], count);
+    }
+    //only the ends of the last run of each thread are left unused
+    CHECK(empty < (threads * BinaryTrace::runrecords));
+    CHECK_EQ(1 + sites + texts + empty + (threads * count) + (threads * ((count + 2) / 3)), trace.header.used);
+}
+
+TEST(FullFileDropsEvents)
+{
+    REQUIRE(BinaryTrace::Open(path, 100));
+    for (unsigned i = 0; i < 200; i++)
+    {
+        BinaryTrace::Event(site, 0u, i);
+    }
+    const BinaryTrace::Statistics stats = BinaryTrace::GetStatistics();
+    BinaryTrace::Close();
+    CHECK_EQ(stats.used, 100);
+    const Trace trace = Read();
+    unsigned events = 0;
+    for (const BinaryTrace::Record &r : trace.records)
+    {
+        events += (r.type == BinaryTrace::EVENT) ? 1 : 0;
+    }
+    CHECK(events > 0);
+    CHECK_EQ(events + stats.dropped, 200);
+    CHECK_EQ(trace.header.dropped, stats.dropped);
+}
+
+TEST(ReopenedFileStartsNewRuns)
+{
+    //this thread still has slots of a run claimed in the last file
+    REQUIRE(BinaryTrace::Open(path, 256));
+    BinaryTrace::Event(site, 0u, 1u);
+    BinaryTrace::Close();
+    Read();
+    REQUIRE(BinaryTrace::Open(path, 256));
+    BinaryTrace::Event(site, 0u, 2u);
+    BinaryTrace::Close();
+    const Trace trace = Read();
+    //the site and its text, then the event at the start of a new run
+    size_t i = 1;
+    while ((i < trace.records.size()) && (trace.records[i].type == BinaryTrace::TEXT))
+    {
+        i++;
+    }
+    REQUIRE(i < trace.records.size());
+    CHECK_EQ(trace.records[0].type, BinaryTrace::SITE);
+    CHECK_EQ(trace.records[i].type, BinaryTrace::EVENT);
+    CHECK_EQ(trace.records[i].args[1], 2);
+}
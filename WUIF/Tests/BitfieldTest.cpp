@@ -0,0 +1,199 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*ATOMIC_BIT_FIELD (Headers/Bitfield.h) - the value each operation returns, and threads hammering
+their own bits of one shared word, a bit used as a lock and a bit used to publish data. Built twice,
+as BitfieldTest over plain integers and as BitfieldCheckedTest with _BITFIELD.*/
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "Bitfield.h"
+#include "Test.h"
+
+namespace
+{
+    BIT_FIELD(uint32_t, Flags);
+    BIT_MASK(Flags, A, 1);
+    BIT_MASK(Flags, B, 2);
+    BIT_MASK(Flags, C, 3);
+    BIT_MASK(Flags, D, 4);
+    BIT_MASK(Flags, E, 5);
+    BIT_MASK(Flags, F, 6);
+    BIT_MASK(Flags, G, 7);
+    BIT_MASK(Flags, H, 8);
+    BIT_MASK(Flags, LOCK,  31);
+    BIT_MASK(Flags, READY, 32);
+    ATOMIC_BIT_FIELD(Flags, AtomicFlags);
+    typedef decltype(A) Mask;
+
+    const Mask bits[] = { A, B, C, D, E, F, G, H };
+    const unsigned threadcount = sizeof(bits) / sizeof(bits[0]);
+
+    //true if exactly the bits of mask are set in field
+    bool Is(const Flags &field, const Flags &mask) { return (field == mask); }
+
+    void RunThreads(void (*body)(unsigned))
+    {
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadcount; t++)
+        {
+            threads.emplace_back(body, t);
+        }
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
+
+#ifdef _BITFIELD
+bitfield_unique_id ui_Flags;
+#endif
+
+TEST(OperationsReturnThePreviousField)
+{
+    AtomicFlags flags;
+    CHECK(!flags.load());
+    CHECK(!flags.fetch_or(A));
+    CHECK(Is(flags.fetch_or(B), A));
+    CHECK(Is(flags.fetch_xor(A), A | B));
+    CHECK(Is(flags.fetch_and(~B), B));
+    CHECK(!flags.load());
+    CHECK(!flags.test_and_set(C));
+    CHECK(flags.test_and_set(C));
+    CHECK(flags.test(C));
+    CHECK(!flags.test(D));
+    CHECK(flags.test_and_clear(C | D));
+    CHECK(!flags.test_and_clear(C | D));
+    flags.store(A | H);
+    CHECK(Is(flags.exchange(B), A | H));
+    CHECK(Is(flags.load(), B));
+    //a failed compare exchange hands back the current field
+    Flags expected = A;
+    CHECK(!flags.compare_exchange_strong(expected, C));
+    CHECK(Is(expected, B));
+    CHECK(flags.compare_exchange_strong(expected, C, std::memory_order_acq_rel, std::memory_order_relaxed));
+    CHECK(Is(flags.load(std::memory_order_relaxed), C));
+    AtomicFlags initialised(A | LOCK);
+    CHECK(initialised.test(LOCK));
+    CHECK(initialised.is_lock_free());
+}
+
+namespace
+{
+    unsigned long lostupdates[threadcount];
+
+    //each thread flips only its own bit with every kind of read-modify-write and checks it sees its
+    //own last write - an update lost to another thread's write of the same word would show here
+    AtomicFlags shared;
+
+    void OwnBit(unsigned t)
+    {
+        const Mask bit = bits[t];
+        for (int i = 0; i < 100000; i++)
+        {
+            unsigned long lost = 0;
+            lost += static_cast<bool>(shared.fetch_or(bit, std::memory_order_relaxed) & bit);
+            lost += !shared.test_and_clear(bit, std::memory_order_acq_rel);
+            lost += static_cast<bool>(shared.fetch_xor(bit) & bit);
+            lost += !static_cast<bool>(shared.fetch_and(~bit, std::memory_order_release) & bit);
+            lost += shared.test_and_set(bit);
+            Flags expected = shared.load(std::memory_order_relaxed);
+            while (!shared.compare_exchange_weak(expected, expected ^ bit, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+            }
+            lost += !static_cast<bool>(expected & bit);
+            lostupdates[t] += lost;
+        }
+    }
+}
+
+TEST(ThreadsOwningBitsOfOneWord)
+{
+    RunThreads(OwnBit);
+    for (unsigned t = 0; t < threadcount; t++)
+    {
+        CHECK_EQ(lostupdates[t], 0);
+    }
+    CHECK(!shared.load());
+}
+
+namespace
+{
+    AtomicFlags lockword;
+    unsigned long guarded;   //only written while LOCK is held
+    unsigned long released;  //test_and_clear found LOCK clear when releasing
+
+    void Locked(unsigned t)
+    {
+        for (int i = 0; i < 50000; i++)
+        {
+            while (lockword.test_and_set(LOCK, std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            //the other bits of the word keep changing while the lock is held
+            lockword.fetch_xor(bits[t], std::memory_order_relaxed);
+            guarded++;
+            if (!lockword.test_and_clear(LOCK, std::memory_order_release))
+            {
+                released++;
+            }
+        }
+    }
+}
+
+TEST(TestAndSetIsExclusive)
+{
+    RunThreads(Locked);
+    CHECK_EQ(guarded, threadcount * 50000);
+    CHECK_EQ(released, 0);
+    CHECK(!lockword.load()); //every bit was toggled an even number of times
+}
+
+TEST(ReleaseAcquirePublishes)
+{
+    //the RESIZEPENDING pattern - one thread sets a flag after writing, the other consumes it with
+    //test_and_clear before reading
+    AtomicFlags flags;
+    unsigned long payload = 0;
+    unsigned long mismatches = 0;
+    const unsigned long rounds = 20000;
+    std::thread producer([&]()
+    {
+        for (unsigned long i = 1; i <= rounds; i++)
+        {
+            while (flags.test(READY, std::memory_order_acquire))
+            {
+                std::this_thread::yield();
+            }
+            payload = i;
+            flags.fetch_or(READY, std::memory_order_release);
+        }
+    });
+    for (unsigned long i = 1; i <= rounds; i++)
+    {
+        while (!flags.test(READY, std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+        if (payload != i)
+        {
+            mismatches++;
+        }
+        flags.test_and_clear(READY, std::memory_order_release);
+    }
+    producer.join();
+    CHECK_EQ(mismatches, 0);
+}
@@ -0,0 +1,184 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*checked_bit_set (Headers/Bitset.h) against std::bitset - random sequences of every operation on
+sets whose size is at, just below and just above the 64 bit word and 128 bit block boundaries, so
+the bits past N and the padding words are exercised*/
+#include <bitset>
+#include <random>
+#include <vector>
+#include "Bitset.h"
+#include "Test.h"
+
+namespace
+{
+    BIT_SET(Set1, 1);
+    BIT_SET(Set63, 63);
+    BIT_SET(Set64, 64);
+    BIT_SET(Set65, 65);
+    BIT_SET(Set127, 127);
+    BIT_SET(Set128, 128);
+    BIT_SET(Set129, 129);
+    BIT_SET(Set1000, 1000);
+    BIT_SET(Set1024, 1024);
+    bitset_unique_id ui_Set1, ui_Set63, ui_Set64, ui_Set65, ui_Set127, ui_Set128, ui_Set129, ui_Set1000, ui_Set1024;
+
+    template <class Set>
+    struct Pair
+    {
+        Set                    set;
+        std::bitset<Set::bits> reference;
+    };
+
+    //every observer of set agrees with the reference
+    template <class Set>
+    bool Same(const Pair<Set> &p)
+    {
+        const size_t n = Set::bits;
+        bool ok = (p.set.count() == p.reference.count()) && (p.set.any() == p.reference.any()) &&
+                  (p.set.none() == p.reference.none());
+        std::vector<size_t> expected;
+        for (size_t i = 0; i < n; i++)
+        {
+            ok = ok && (p.set.test(i) == p.reference.test(i)) && (p.set[i] == p.reference[i]);
+            if (p.reference.test(i))
+            {
+                expected.push_back(i);
+            }
+        }
+        std::vector<size_t> iterated, visited;
+        for (size_t i : p.set)
+        {
+            iterated.push_back(i);
+        }
+        p.set.for_each([&visited](size_t i) { visited.push_back(i); });
+        ok = ok && (iterated == expected) && (visited == expected) &&
+             (p.set.find_first() == (expected.empty() ? n : expected.front()));
+        return ok;
+    }
+
+    template <class Set>
+    void Randomise(Pair<Set> &p, std::mt19937 &rng, unsigned density)
+    {
+        p.set.clear();
+        p.reference.reset();
+        for (size_t i = 0; i < Set::bits; i++)
+        {
+            if ((rng() % 100) < density)
+            {
+                p.set.set(i);
+                p.reference.set(i);
+            }
+        }
+    }
+
+    template <class Set>
+    bool Operations(unsigned seed)
+    {
+        const size_t n = Set::bits;
+        std::mt19937 rng(seed);
+        Pair<Set> a, b;
+        bool ok = Same(a);
+        for (int step = 0; ok && (step < 3000); step++)
+        {
+            const size_t i = rng() % n;
+            switch (rng() % 14)
+            {
+            case 0:  a.set.set(i); a.reference.set(i); break;
+            case 1:  a.set.reset(i); a.reference.reset(i); break;
+            case 2:  a.set.flip(i); a.reference.flip(i); break;
+            case 3:  a.set.set(i, (rng() & 1) != 0); a.reference.set(i, a.set.test(i)); break;
+            case 4:  Randomise(b, rng, rng() % 101); break;
+            case 5:  a.set &= b.set; a.reference &= b.reference; break;
+            case 6:  a.set |= b.set; a.reference |= b.reference; break;
+            case 7:  a.set ^= b.set; a.reference ^= b.reference; break;
+            case 8:  a.set.andnot(b.set); a.reference &= ~b.reference; break;
+            case 9:  a.set = ~a.set; a.reference = ~a.reference; break;
+            case 10: a.set = (a.set | b.set) ^ (a.set & b.set); a.reference = (a.reference | b.reference) ^ (a.reference & b.reference); break;
+            case 11: a.set.fill(); a.reference.set(); break;
+            case 12: a.set.clear(); a.reference.reset(); break;
+            default: Randomise(a, rng, rng() % 101); break;
+            }
+            ok = Same(a);
+            ok = ok && ((a.set == b.set) == (a.reference == b.reference)) &&
+                 ((a.set != b.set) == (a.reference != b.reference)) &&
+                 (a.set.intersects(b.set) == (a.reference & b.reference).any());
+            //find_next from every set bit and from a few clear ones
+            size_t expected = n;
+            for (size_t j = n; j-- > 0; )
+            {
+                ok = ok && (a.set.find_next(j) == expected);
+                if (a.reference.test(j))
+                {
+                    expected = j;
+                }
+            }
+            //a copy compares equal, and one changed bit makes it differ
+            Set copy(a.set);
+            ok = ok && (copy == a.set);
+            copy.flip(i);
+            ok = ok && (copy != a.set) && !(copy == a.set);
+        }
+        if (!ok)
+        {
+            fprintf(stderr, "%zu bit set differs from std::bitset (seed %u)\n", n, seed);
+        }
+        return ok;
+    }
+}
+
+TEST(MatchesStdBitset)
+{
+    CHECK(Operations<Set1>(1));
+    CHECK(Operations<Set63>(2));
+    CHECK(Operations<Set64>(3));
+    CHECK(Operations<Set65>(4));
+    CHECK(Operations<Set127>(5));
+    CHECK(Operations<Set128>(6));
+    CHECK(Operations<Set129>(7));
+    CHECK(Operations<Set1000>(8));
+    CHECK(Operations<Set1024>(9));
+}
+
+TEST(BitsPastTheEndStayClear)
+{
+    //~ and fill must not leak into the padding, or count and == would see it
+    Set65 full;
+    full.fill();
+    CHECK_EQ(full.count(), 65);
+    CHECK(~full == Set65());
+    CHECK_EQ((~Set65()).count(), 65);
+    Set1000 inverted = ~Set1000();
+    CHECK_EQ(inverted.count(), 1000);
+    CHECK_EQ(inverted.find_next(998), 999);
+    CHECK_EQ(inverted.find_next(999), 1000);
+    inverted.andnot(inverted);
+    CHECK(inverted.none());
+}
+
+TEST(CompileTimePositions)
+{
+    Set129 set;
+    set.set<0>();
+    set.set<64>();
+    set.set<128>();
+    CHECK(set.test<64>());
+    CHECK(!set.test<63>());
+    set.reset<64>();
+    CHECK_EQ(set.count(), 2);
+    CHECK_EQ(set.find_first(), 0);
+    CHECK_EQ(set.find_next(0), 128);
+    CHECK_EQ(Set129::words, 4);
+    CHECK_EQ(Set128::words, 2);
+    CHECK_EQ(Set1::words, 2);
+}
@@ -0,0 +1,408 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*CommandLine::Split/Parse/ParseUTF8 (Headers/Utils/CommandLineSplit.h) against a character at a
+time implementation of the CommandLineToArgvW rules, on fixed cases and on random command lines
+made of the characters the rules care about. CommandLineToArgvA is also compared with the version it
+replaced (OldCommandLineToArgvA.h) on random command lines, through the Win32 stand-ins.*/
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#if !defined(_WIN32)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+#include "Utils/CommandLineSplit.h"
+#include "Utils/CommandLineToArgvA.h"
+#include "OldCommandLineToArgvA.h"
+#include "Test.h"
+
+using WUIF::ArgView;
+using WUIF::CommandLine;
+
+namespace
+{
+    typedef std::vector<std::string> Args;
+
+    //the CommandLineToArgvW rules one character at a time - the reference the splitter must match
+    Args Reference(const std::string &cmdline)
+    {
+        Args args;
+        size_t i = 0;
+        const size_t n = cmdline.size();
+        //program name - the first character is taken even if it is a space or tab, after that
+        //quotes toggle and are removed, backslashes are literal
+        std::string name;
+        bool quoted = false;
+        if ((n != 0) && ((cmdline[0] == ' ') || (cmdline[0] == '\t')))
+        {
+            name += cmdline[i++];
+        }
+        for (; i < n; i++)
+        {
+            const char c = cmdline[i];
+            if (c == '"')
+            {
+                quoted = !quoted;
+            }
+            else if (!quoted && ((c == ' ') || (c == '\t')))
+            {
+                break;
+            }
+            else
+            {
+                name += c;
+            }
+        }
+        args.push_back(name);
+        for (;;)
+        {
+            while ((i < n) && ((cmdline[i] == ' ') || (cmdline[i] == '\t')))
+            {
+                i++;
+            }
+            if (i == n)
+            {
+                break;
+            }
+            std::string arg;
+            quoted = false;
+            while (i < n)
+            {
+                const char c = cmdline[i];
+                if (c == '\\')
+                {
+                    size_t slashes = 0;
+                    for (; (i < n) && (cmdline[i] == '\\'); i++)
+                    {
+                        slashes++;
+                    }
+                    if ((i < n) && (cmdline[i] == '"'))
+                    {
+                        //2N - N backslashes and the quote is handled below, 2N + 1 - N and a literal "
+                        arg.append(slashes / 2, '\\');
+                        if (slashes & 1)
+                        {
+                            arg += '"';
+                            i++;
+                        }
+                    }
+                    else
+                    {
+                        arg.append(slashes, '\\');
+                    }
+                }
+                else if (c == '"')
+                {
+                    if (quoted && (i + 1 < n) && (cmdline[i + 1] == '"'))
+                    {
+                        arg += '"';
+                        quoted = false;
+                        i += 2;
+                    }
+                    else
+                    {
+                        quoted = !quoted;
+                        i++;
+                    }
+                }
+                else if (!quoted && ((c == ' ') || (c == '\t')))
+                {
+                    break;
+                }
+                else
+                {
+                    arg += c;
+                    i++;
+                }
+            }
+            args.push_back(arg);
+        }
+        return args;
+    }
+
+    Args ViaSplit(const char *cmdline)
+    {
+        const size_t length = strlen(cmdline);
+        std::vector<char>    buffer(length + 1);
+        std::vector<ArgView> views(CommandLine::MaxArgs(length));
+        const size_t argc = CommandLine::Split(cmdline, buffer.data(), views.data(), views.size());
+        Args args;
+        if (!CHECK(argc <= views.size()))
+        {
+            return args;
+        }
+        for (size_t i = 0; i < argc; i++)
+        {
+            args.push_back(std::string(views[i].data, views[i].size));
+        }
+        return args;
+    }
+
+    //Parse and ParseUTF8 with terminate set - every argument must be followed by a null
+    template <bool UTF8>
+    Args ViaParse(const char *cmdline)
+    {
+        std::vector<char> buffer(strlen(cmdline) + 1);
+        std::vector<ArgView> views;
+        auto store = [&views](size_t i, char *begin, size_t size)
+        {
+            CHECK_EQ(i, views.size());
+            views.push_back({ begin, size });
+        };
+        const size_t argc = UTF8 ? CommandLine::ParseUTF8(cmdline, buffer.data(), true, store) :
+                                   CommandLine::Parse(cmdline, buffer.data(), true, store);
+        CHECK_EQ(argc, views.size());
+        Args args;
+        for (const ArgView &view : views)
+        {
+            CHECK_EQ(view.data[view.size], '\0');
+            args.push_back(std::string(view.data, view.size));
+        }
+        return args;
+    }
+
+    void Print(const char *what, const Args &args)
+    {
+        fprintf(stderr, "  %s:", what);
+        for (const std::string &arg : args)
+        {
+            fprintf(stderr, " <%s>", arg.c_str());
+        }
+        fprintf(stderr, "\n");
+    }
+
+    //checks every entry point against the reference for the command line at cmdline
+    bool Matches(const char *cmdline)
+    {
+        const Args expected = Reference(cmdline);
+        const Args split    = ViaSplit(cmdline);
+        const Args parsed   = ViaParse<false>(cmdline);
+        const Args utf8     = ViaParse<true>(cmdline);
+        if ((split == expected) && (parsed == expected) && (utf8 == expected))
+        {
+            return true;
+        }
+        fprintf(stderr, "mismatch for [%s]\n", cmdline);
+        Print("expected ", expected);
+        Print("Split    ", split);
+        Print("Parse    ", parsed);
+        Print("ParseUTF8", utf8);
+        return false;
+    }
+
+    //argv from CommandLineToArgvA or OldCommandLineToArgvA, released with HeapFree as callers do
+    Args ViaArgv(LPSTR* (*toargv)(LPCSTR, int*), const char *cmdline)
+    {
+        int argc = -1;
+        LPSTR *argv = toargv(cmdline, &argc);
+        Args args;
+        if (!CHECK(argv != nullptr))
+        {
+            return args;
+        }
+        for (int i = 0; i < argc; i++)
+        {
+            args.push_back(argv[i]);
+        }
+        CHECK(argv[argc] == nullptr);
+        HeapFree(GetProcessHeap(), 0, argv);
+        return args;
+    }
+
+    //the old version's copy pass writes up to 2 bytes past the block it sized
+    LPSTR* OldToArgv(LPCSTR cmdline, int *argc)
+    {
+        Fake::HeapSlack() = 2;
+        LPSTR *argv = OldCommandLineToArgvA(cmdline, argc);
+        Fake::HeapSlack() = 0;
+        return argv;
+    }
+
+    void Expect(const char *cmdline, const Args &expected)
+    {
+        CHECK(Reference(cmdline) == expected);
+        CHECK(Matches(cmdline));
+    }
+}
+
+TEST(EmptyCommandLine)
+{
+    //CommandLineToArgvA substitutes the module path, the splitter itself returns an empty name
+    Expect("", { "" });
+}
+
+TEST(ProgramName)
+{
+    Expect("prog", { "prog" });
+    Expect("\"C:\\Program Files\\app.exe\" -x", { "C:\\Program Files\\app.exe", "-x" });
+    Expect("C:\\dir\\\"a b\"\\app.exe x", { "C:\\dir\\a b\\app.exe", "x" });
+    //backslashes before a quote are not special in the program name
+    Expect("a\\\"b c\"d e", { "a\\b cd", "e" });
+    //a leading space or tab is taken as the first character of the name
+    Expect(" a b", { " a", "b" });
+    Expect("\ta", { "\ta" });
+    Expect("\"\" x", { "", "x" });
+    Expect("\"unterminated name", { "unterminated name" });
+}
+
+TEST(Separators)
+{
+    Expect("p a  b\t\tc \t", { "p", "a", "b", "c" });
+    Expect("p \"a b\" c\"d e\"f", { "p", "a b", "cd ef" });
+    Expect("p \"\" \"\"", { "p", "", "" });
+    Expect("p \"unterminated arg", { "p", "unterminated arg" });
+}
+
+TEST(Backslashes)
+{
+    //the table in the CommandLineToArgvW documentation
+    Expect("p \"abc\" d e", { "p", "abc", "d", "e" });
+    Expect("p a\\\\\\b d\"e f\"g h", { "p", "a\\\\\\b", "de fg", "h" });
+    Expect("p a\\\\\\\"b c d", { "p", "a\\\"b", "c", "d" });
+    Expect("p a\\\\\\\\\"b c\" d e", { "p", "a\\\\b c", "d", "e" });
+    //runs that don't end at a quote are literal, whatever their length
+    Expect("p \\ \\\\ \\\\\\ C:\\dir\\", { "p", "\\", "\\\\", "\\\\\\", "C:\\dir\\" });
+    Expect("p \"C:\\dir\\\\\" x", { "p", "C:\\dir\\", "x" });
+    Expect("p \\\"", { "p", "\"" });
+    Expect("p \\\\\"a b\"", { "p", "\\a b" });
+}
+
+TEST(DoubleQuoteInsideQuotes)
+{
+    //"" inside quotes is a literal quote and ends the quoted section
+    Expect("p a\"b\"\" c d", { "p", "ab\"", "c", "d" });
+    Expect("p \"a\"\"b\"", { "p", "a\"b" });
+    Expect("p \"\"\"\" x", { "p", "\" x" });
+    Expect("p \"\"\"a b\"", { "p", "\"a", "b" });
+    //outside of quotes "" is an empty quoted section
+    Expect("p a\"\"b", { "p", "ab" });
+}
+
+TEST(LongRuns)
+{
+    //runs longer than a vector, ending at every offset of the block
+    for (size_t length = 1; length < 80; length++)
+    {
+        const std::string run(length, 'x');
+        const std::string slashes(length, '\\');
+        CHECK(Matches(("p " + run + " \"" + run + " " + run + "\" " + run).c_str()));
+        CHECK(Matches(("p " + slashes + "\" " + run).c_str()));
+        CHECK(Matches(("\"" + run + " " + run + "\"" + run + " a").c_str()));
+    }
+}
+
+TEST(RandomCommandLines)
+{
+    const char alphabet[] = { 'a', 'b', ' ', '\t', '"', '"', '\\', '\\', 'x', '\xe9', '\x81' };
+    //copies are made at every alignment, on POSIX also right before an inaccessible page so a
+    //load past the terminator's block would fault
+    char *guard = nullptr;
+    size_t page = 0;
+    #if !defined(_WIN32)
+    page  = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    void *pages = mmap(nullptr, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if ((pages != MAP_FAILED) && (mprotect(static_cast<char*>(pages) + page, page, PROT_NONE) == 0))
+    {
+        guard = static_cast<char*>(pages) + page;
+    }
+    #endif
+    alignas(16) char aligned[256];
+    std::mt19937 rng(20180512);
+    unsigned long mismatches = 0;
+    for (int iteration = 0; (iteration < 200000) && (mismatches < 10); iteration++)
+    {
+        std::string cmdline;
+        const size_t length = rng() % 96;
+        for (size_t i = 0; i < length; i++)
+        {
+            cmdline += alphabet[rng() % sizeof(alphabet)];
+        }
+        char *copy = aligned + (iteration % 16);
+        if ((guard != nullptr) && (iteration & 1))
+        {
+            copy = guard - (cmdline.size() + 1);
+        }
+        memcpy(copy, cmdline.c_str(), cmdline.size() + 1);
+        if (!CHECK(Matches(copy)))
+        {
+            mismatches++;
+        }
+    }
+    #if !defined(_WIN32)
+    if (guard != nullptr)
+    {
+        munmap(guard - page, page * 2);
+    }
+    #endif
+}
+
+TEST(MatchesOldCommandLineToArgvA)
+{
+    const char alphabet[] = { 'a', 'b', ' ', '\t', '"', '"', '\\', '\\', 'x', '\xe9', '\x81' };
+    std::mt19937 rng(20180606);
+    unsigned long mismatches = 0, nameonly = 0;
+    for (int iteration = 0; (iteration < 100000) && (mismatches < 10); iteration++)
+    {
+        //not empty - the old version reads past the terminator of an empty command line
+        std::string cmdline;
+        const size_t length = 1 + (rng() % 95);
+        for (size_t i = 0; i < length; i++)
+        {
+            cmdline += alphabet[rng() % sizeof(alphabet)];
+        }
+        const Args current = ViaArgv(CommandLineToArgvA, cmdline.c_str());
+        Args old = ViaArgv(OldToArgv, cmdline.c_str());
+        //the old version gives a program name that runs to the terminator a second argument
+        if ((current.size() == 1) && (old.size() == 2))
+        {
+            old.pop_back();
+            nameonly++;
+        }
+        if (!CHECK(current == old))
+        {
+            fprintf(stderr, "differs from the old CommandLineToArgvA for [%s]\n", cmdline.c_str());
+            Print("current", current);
+            Print("old    ", old);
+            mismatches++;
+        }
+    }
+    //the exclusion above is for the odd line, not most of them
+    CHECK((nameonly != 0) && (nameonly < 20000));
+    //NULL and empty give the module path
+    CHECK(ViaArgv(CommandLineToArgvA, nullptr) == Args{ Fake::modulename });
+    CHECK(ViaArgv(CommandLineToArgvA, "") == Args{ Fake::modulename });
+    CHECK(ViaArgv(OldToArgv, nullptr) == Args{ Fake::modulename });
+}
+
+TEST(MaxArgs)
+{
+    //the densest command line - single characters separated by single spaces
+    for (size_t length = 0; length < 64; length++)
+    {
+        std::string cmdline;
+        for (size_t i = 0; i < length; i++)
+        {
+            cmdline += (i & 1) ? ' ' : 'a';
+        }
+        CHECK(Reference(cmdline).size() <= CommandLine::MaxArgs(length));
+        CHECK(Matches(cmdline.c_str()));
+    }
+    //Split stores at most maxargs but still counts them all
+    char buffer[16];
+    ArgView views[2];
+    CHECK_EQ(CommandLine::Split("p a b c", buffer, views, 2), 4);
+    CHECK((views[1].size == 1) && (views[1].data[0] == 'a'));
+}
@@ -0,0 +1,188 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*CounterRegistry and CounterReader (Headers/Utils/CounterRegistry.h) - registration rules,
+concurrent updates seen through a second read only mapping of the segment, layout checks, a full
+registry and Unpublish. The registry is process wide, so the cases run in order and build on each
+other.*/
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils/CounterRegistry.h"
+#include "Test.h"
+
+using WUIF::Counter;
+using WUIF::CounterReader;
+using WUIF::CounterRegistry;
+
+namespace
+{
+    Counter early; //constant initialised, usable before anything is registered
+
+    uint64_t ThisProcess()
+    {
+        #if defined(_WIN32)
+        return GetCurrentProcessId();
+        #else
+        return static_cast<uint64_t>(getpid());
+        #endif
+    }
+}
+
+TEST(UnregisteredCountersWriteToTheSink)
+{
+    CHECK(!early.registered());
+    early.Add(5);
+    early.Set(7);
+    CHECK(!Counter().registered());
+}
+
+TEST(RegistrationRules)
+{
+    const Counter frames = CounterRegistry::Register("frames.presented", CounterRegistry::COUNTER);
+    const Counter windows = CounterRegistry::Register("windows", CounterRegistry::GAUGE);
+    CHECK(frames.registered());
+    CHECK(windows.registered());
+    CHECK(CounterRegistry::Published());
+    CHECK_EQ(frames.value(), 0);
+    //the same name and kind is the same counter
+    Counter again = CounterRegistry::Register("frames.presented", CounterRegistry::COUNTER);
+    again.Add(3);
+    CHECK_EQ(frames.value(), 3);
+    CHECK(!CounterRegistry::Register("frames.presented", CounterRegistry::GAUGE).registered());
+    CHECK(!CounterRegistry::Register("", CounterRegistry::GAUGE).registered());
+    CHECK(!CounterRegistry::Register(nullptr, CounterRegistry::GAUGE).registered());
+    CHECK(!CounterRegistry::Register("bad.kind", CounterRegistry::EMPTY).registered());
+    CHECK(!CounterRegistry::Register(std::string(CounterRegistry::namesize, 'x').c_str(), CounterRegistry::GAUGE).registered());
+    CHECK(CounterRegistry::Register(std::string(CounterRegistry::namesize - 1, 'x').c_str(), CounterRegistry::GAUGE).registered());
+}
+
+TEST(ReaderSeesConcurrentUpdates)
+{
+    Counter frames = CounterRegistry::Register("frames.presented", CounterRegistry::COUNTER);
+    Counter windows = CounterRegistry::Register("windows", CounterRegistry::GAUGE);
+    frames.Set(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&frames]()
+        {
+            for (int i = 0; i < 100000; i++)
+            {
+                frames.Add();
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    windows.Set(3);
+    windows.Add(-1);
+    //a second, read only mapping as ops tooling would open it
+    CounterReader reader;
+    REQUIRE(reader.Open(ThisProcess()) == CounterReader::OPENED);
+    CHECK(reader.opened());
+    CHECK_EQ(reader.pid(), ThisProcess());
+    REQUIRE(reader.count() == 3);
+    CounterReader::Entry entry;
+    REQUIRE(reader.Read(0, entry));
+    CHECK(strcmp(entry.name, "frames.presented") == 0);
+    CHECK_EQ(entry.kind, CounterRegistry::COUNTER);
+    CHECK_EQ(entry.value, 400000);
+    REQUIRE(reader.Read(1, entry));
+    CHECK(strcmp(entry.name, "windows") == 0);
+    CHECK_EQ(entry.kind, CounterRegistry::GAUGE);
+    CHECK_EQ(entry.value, 2);
+    CHECK(!reader.Read(3, entry));
+    //later updates and registrations show up live
+    frames.Add(5);
+    CounterRegistry::Register("swapchain.created", CounterRegistry::COUNTER).Add();
+    REQUIRE(reader.count() == 4);
+    CHECK(reader.Read(0, entry) && (entry.value == 400005));
+    CHECK(reader.Read(3, entry) && (strcmp(entry.name, "swapchain.created") == 0) && (entry.value == 1));
+    reader.Close();
+    CHECK(!reader.opened());
+    CHECK_EQ(reader.count(), 0);
+}
+
+TEST(ReaderChecksTheSegment)
+{
+    CounterReader reader;
+    CHECK(reader.Open(0xfffffff0) == CounterReader::MISSING);
+    #if !defined(_WIN32)
+    //a segment written by something else
+    char name[64];
+    CounterRegistry::SegmentName(name, 0xfffffff1);
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    CHECK(ftruncate(fd, 4096) == 0);
+    void *p = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    REQUIRE(p != MAP_FAILED);
+    CounterRegistry::Header *header = static_cast<CounterRegistry::Header*>(p);
+    memcpy(header->magic, "WUIFCNTX", sizeof(header->magic));
+    CHECK(reader.Open(0xfffffff1) == CounterReader::INCOMPATIBLE);
+    //the right magic but more slots than the segment holds
+    memcpy(header->magic, "WUIFCNTR", sizeof(header->magic));
+    header->version  = CounterRegistry::version;
+    header->slotsize = CounterRegistry::slotsize;
+    header->capacity = 4096 / CounterRegistry::slotsize;
+    CHECK(reader.Open(0xfffffff1) == CounterReader::INCOMPATIBLE);
+    header->capacity--;
+    CHECK(reader.Open(0xfffffff1) == CounterReader::OPENED);
+    reader.Close();
+    //a version that changed the meaning of a field is refused rather than misread
+    header->version = CounterRegistry::version + 1;
+    CHECK(reader.Open(0xfffffff1) == CounterReader::INCOMPATIBLE);
+    munmap(p, 4096);
+    shm_unlink(name);
+    #endif
+}
+
+TEST(FullRegistry)
+{
+    const Counter windows = CounterRegistry::Register("windows", CounterRegistry::GAUGE);
+    CounterReader reader;
+    REQUIRE(reader.Open(ThisProcess()) == CounterReader::OPENED);
+    const size_t before = reader.count();
+    char name[32];
+    size_t registered = 0;
+    for (uint32_t i = 0; i < CounterRegistry::maxcounters + 10; i++)
+    {
+        snprintf(name, sizeof(name), "filler.%u", i);
+        registered += CounterRegistry::Register(name, CounterRegistry::COUNTER).registered() ? 1 : 0;
+    }
+    CHECK_EQ(reader.count(), CounterRegistry::maxcounters);
+    CHECK_EQ(registered, CounterRegistry::maxcounters - before);
+    //existing counters are still found
+    CHECK(CounterRegistry::Register("windows", CounterRegistry::GAUGE).registered());
+    CHECK(windows.registered());
+}
+
+TEST(Unpublish)
+{
+    Counter frames = CounterRegistry::Register("frames.presented", CounterRegistry::COUNTER);
+    CounterReader open;
+    REQUIRE(open.Open(ThisProcess()) == CounterReader::OPENED);
+    CounterRegistry::Unpublish();
+    CHECK(!CounterRegistry::Published());
+    //counters keep counting and a reader that has the segment open still sees them
+    frames.Add();
+    CounterReader::Entry entry;
+    CHECK(open.Read(0, entry) && (entry.value == frames.value()));
+    CounterReader gone;
+    CHECK(gone.Open(ThisProcess()) == CounterReader::MISSING);
+    CounterRegistry::Unpublish();
+}
@@ -0,0 +1,209 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*FrameArena and ArenaAllocator (Headers/Utils/FrameArena.h) - alignment, chunk growth, the
+collapse to one chunk on Reset, statistics, Reserve and the AllocStats accounting of its chunks*/
+#include <cstring>
+#include <new>
+#include <vector>
+#include "Utils/FrameArena.h"
+#include "Test.h"
+
+using WUIF::AllocStats;
+using WUIF::AllocTag;
+using WUIF::ArenaAllocator;
+using WUIF::FrameArena;
+
+namespace
+{
+    bool Aligned(const void *p, size_t align) { return ((reinterpret_cast<uintptr_t>(p) % align) == 0); }
+}
+
+TEST(NothingIsAllocatedUntilFirstUse)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    FrameArena arena;
+    arena.Reset();
+    const FrameArena::Statistics stats = arena.GetStatistics();
+    CHECK_EQ(stats.capacity, 0);
+    CHECK_EQ(stats.chunks, 0);
+    CHECK_EQ(stats.frames, 1);
+    CHECK(!AllocStats::Diff(before, AllocStats::Take()).Allocated());
+}
+
+TEST(AllocationsAreAlignedAndDisjoint)
+{
+    FrameArena arena(1024);
+    char   *c = arena.Allocate<char>(3);
+    double *d = arena.Allocate<double>(5);
+    void   *v = arena.Allocate(100, 64);
+    int    *i = arena.Allocate<int>(7);
+    CHECK(Aligned(d, alignof(double)));
+    CHECK(Aligned(v, 64));
+    CHECK(Aligned(i, alignof(int)));
+    CHECK(Aligned(arena.Allocate(1), alignof(std::max_align_t)));
+    memset(c, 1, 3);
+    memset(d, 2, 5 * sizeof(double));
+    memset(v, 3, 100);
+    memset(i, 4, 7 * sizeof(int));
+    CHECK((c[2] == 1) && (reinterpret_cast<unsigned char*>(d)[39] == 2) &&
+          (static_cast<unsigned char*>(v)[99] == 3) && (reinterpret_cast<unsigned char*>(i)[27] == 4));
+    CHECK(arena.GetStatistics().used >= 3 + 40 + 100 + 28);
+}
+
+TEST(GrowsAndCollapsesToOneChunk)
+{
+    FrameArena arena(1024);
+    arena.Allocate(600);
+    void *big = arena.Allocate(5000, 64);
+    CHECK(Aligned(big, 64));
+    FrameArena::Statistics stats = arena.GetStatistics();
+    CHECK_EQ(stats.chunks, 2);
+    CHECK_EQ(stats.grows, 1);
+    CHECK(stats.used >= 5600);
+    //the frame needed two chunks - Reset replaces them with one that holds all of it
+    arena.Reset();
+    stats = arena.GetStatistics();
+    CHECK_EQ(stats.chunks, 1);
+    CHECK_EQ(stats.used, 0);
+    CHECK(stats.peak >= 5600);
+    CHECK(stats.capacity >= stats.peak);
+    //the same frame again fits without growing or touching the heap
+    const AllocStats::Snapshot before = AllocStats::Take();
+    arena.Allocate(600);
+    arena.Allocate(5000, 64);
+    arena.Reset();
+    CHECK(!AllocStats::Diff(before, AllocStats::Take()).Allocated());
+    stats = arena.GetStatistics();
+    CHECK_EQ(stats.chunks, 1);
+    CHECK_EQ(stats.grows, 1);
+    CHECK_EQ(stats.frames, 2);
+}
+
+TEST(ChunksAtLeastDouble)
+{
+    FrameArena arena(256);
+    for (int i = 0; i < 64; i++)
+    {
+        arena.Allocate(100);
+    }
+    const FrameArena::Statistics stats = arena.GetStatistics();
+    //256 + 512 + 1024 + 2048 + 4096 holds 6400 bytes and padding
+    CHECK(stats.chunks <= 5);
+    CHECK(stats.capacity >= stats.used);
+}
+
+TEST(AlignmentAtTheEndOfAChunk)
+{
+    //aligning the top past the end of the chunk must grow, not overflow
+    FrameArena arena(64);
+    arena.Allocate(60, 1);
+    void *p = arena.Allocate(1, 16);
+    CHECK(Aligned(p, 16));
+    CHECK_EQ(arena.GetStatistics().chunks, 2);
+}
+
+TEST(FreeGivesBackOnlyTheLastAllocation)
+{
+    FrameArena arena(1024);
+    void *a = arena.Allocate(16);
+    void *b = arena.Allocate(32, 1);
+    const size_t used = arena.GetStatistics().used;
+    arena.Free(a, 16); //not the last one - kept until Reset
+    CHECK_EQ(arena.GetStatistics().used, used);
+    arena.Free(b, 32);
+    CHECK_EQ(arena.GetStatistics().used, used - 32);
+    CHECK(arena.Allocate(32, 1) == b);
+}
+
+TEST(ReserveAndRelease)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    {
+        FrameArena arena;
+        arena.Reserve(1 << 20);
+        FrameArena::Statistics stats = arena.GetStatistics();
+        CHECK(stats.capacity >= (1u << 20));
+        CHECK_EQ(stats.chunks, 1);
+        CHECK_EQ(AllocStats::Diff(before, AllocStats::Take())[AllocTag::Window].blocks, 1);
+        arena.Allocate(100);
+        arena.Release();
+        stats = arena.GetStatistics();
+        CHECK_EQ(stats.capacity, 0);
+        CHECK_EQ(AllocStats::Diff(before, AllocStats::Take())[AllocTag::Window].blocks, 0);
+        arena.Allocate(100); //starts again with the initial size
+        CHECK_EQ(arena.GetStatistics().capacity, FrameArena::defaultsize);
+    }
+    //the destructor frees the chunks
+    const AllocStats::Difference diff = AllocStats::Diff(before, AllocStats::Take());
+    CHECK_EQ(diff[AllocTag::Window].bytes, 0);
+    CHECK_EQ(diff[AllocTag::Window].blocks, 0);
+}
+
+TEST(PeakAcrossFrames)
+{
+    FrameArena arena(4096);
+    arena.Allocate(3000, 1);
+    arena.Reset();
+    arena.Allocate(100, 1);
+    CHECK_EQ(arena.GetStatistics().peak, 3000);
+    arena.ResetPeak();
+    CHECK_EQ(arena.GetStatistics().peak, 100);
+}
+
+TEST(OverflowingCountsThrow)
+{
+    FrameArena arena;
+    bool threw = false;
+    try
+    {
+        arena.Allocate<double>(static_cast<size_t>(-1) / 4);
+    }
+    catch (const std::bad_alloc&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    threw = false;
+    try
+    {
+        arena.Allocate(static_cast<size_t>(-1) - 8);
+    }
+    catch (const std::bad_alloc&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST(ContainersUseTheArena)
+{
+    FrameArena arena(1024);
+    arena.Allocate(1);
+    const AllocStats::Snapshot before = AllocStats::Take();
+    {
+        std::vector<int, ArenaAllocator<int>> values{ ArenaAllocator<int>(arena) };
+        for (int i = 0; i < 1000; i++)
+        {
+            values.push_back(i);
+        }
+        CHECK_EQ(values[999], 999);
+        CHECK(arena.GetStatistics().used >= 1000 * sizeof(int));
+        //only arena chunks come from the heap, never the vector's buffer itself
+        const AllocStats::Difference diff = AllocStats::Diff(before, AllocStats::Take());
+        CHECK_EQ(diff[AllocTag::Window].allocs, arena.GetStatistics().grows);
+    }
+    CHECK(ArenaAllocator<int>(arena) == ArenaAllocator<char>(arena));
+    FrameArena other;
+    CHECK(ArenaAllocator<int>(arena) != ArenaAllocator<int>(other));
+}
@@ -0,0 +1,200 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*InputBatch (Headers/Utils/InputBatch.h) coalescing rules - what merges, what starts a new sample,
+keepall, and the memory kept across Clear and given back by Release*/
+#include "Utils/InputBatch.h"
+#include "Test.h"
+
+using WUIF::AllocStats;
+using WUIF::AllocTag;
+using WUIF::InputBatch;
+using WUIF::InputSample;
+using WUIF::InputSource;
+
+namespace
+{
+    InputSample Sample(InputSource source, int32_t x, int32_t y, uint32_t time, uint32_t buttons = 0, uint32_t id = 0,
+                       uint16_t flags = 0)
+    {
+        InputSample s = {};
+        s.x       = x;
+        s.y       = y;
+        s.time    = time;
+        s.buttons = buttons;
+        s.id      = id;
+        s.flags   = flags;
+        s.source  = source;
+        s.count   = 99; //Add sets it
+        return s;
+    }
+
+    const uint32_t MK_LBUTTON         = 0x0001;
+    const uint32_t RI_MOUSE_LEFT_DOWN = 0x0001;
+    const uint32_t RI_MOUSE_LEFT_UP   = 0x0002;
+    const uint32_t RI_MOUSE_WHEEL     = 0x0400;
+}
+
+TEST(MouseMovesMergeIntoTheNewest)
+{
+    InputBatch batch;
+    CHECK(batch.empty());
+    for (int i = 0; i < 8; i++)
+    {
+        batch.Add(Sample(InputSource::Mouse, i, 2 * i, 100 + i));
+    }
+    REQUIRE(batch.size() == 1);
+    CHECK_EQ(batch[0].x, 7);
+    CHECK_EQ(batch[0].y, 14);
+    CHECK_EQ(batch[0].time, 107);
+    CHECK_EQ(batch[0].count, 8);
+    CHECK_EQ(batch.received(), 8);
+    CHECK(!batch.empty());
+    CHECK(batch.all().empty()); //keepall is off
+}
+
+TEST(ButtonChangesStartANewSample)
+{
+    InputBatch batch;
+    batch.Add(Sample(InputSource::Mouse, 0, 0, 1));
+    batch.Add(Sample(InputSource::Mouse, 1, 1, 2, MK_LBUTTON));
+    batch.Add(Sample(InputSource::Mouse, 2, 2, 3, MK_LBUTTON)); //a drag merges
+    batch.Add(Sample(InputSource::Mouse, 3, 3, 4));
+    REQUIRE(batch.size() == 3);
+    CHECK_EQ(batch[0].count, 1);
+    CHECK_EQ(batch[1].buttons, MK_LBUTTON);
+    CHECK_EQ(batch[1].x, 2);
+    CHECK_EQ(batch[1].count, 2);
+    CHECK_EQ(batch[2].buttons, 0);
+    //returning to an earlier button state doesn't merge with an older sample
+    batch.Add(Sample(InputSource::Mouse, 4, 4, 5, MK_LBUTTON));
+    CHECK_EQ(batch.size(), 4);
+}
+
+TEST(RawRelativeMotionIsSummed)
+{
+    InputBatch batch;
+    batch.Add(Sample(InputSource::RawMouse, 1, 1, 1));
+    batch.Add(Sample(InputSource::RawMouse, 2, -3, 2));
+    batch.Add(Sample(InputSource::RawMouse, -1, 0, 3));
+    REQUIRE(batch.size() == 1);
+    CHECK_EQ(batch[0].x, 2);
+    CHECK_EQ(batch[0].y, -2);
+    CHECK_EQ(batch[0].time, 3);
+    CHECK_EQ(batch[0].count, 3);
+}
+
+TEST(RawAbsolutePositionsTakeTheNewest)
+{
+    InputBatch batch;
+    batch.Add(Sample(InputSource::RawMouse, 5, 5, 1));
+    batch.Add(Sample(InputSource::RawMouse, 100, 100, 2, 0, 0, InputSample::absolute));
+    batch.Add(Sample(InputSource::RawMouse, 200, 300, 3, 0, 0, InputSample::absolute));
+    REQUIRE(batch.size() == 2); //relative and absolute don't mix
+    CHECK_EQ(batch[1].x, 200);
+    CHECK_EQ(batch[1].y, 300);
+    CHECK_EQ(batch[1].count, 2);
+}
+
+TEST(RawTransitionsAndWheelNeverMerge)
+{
+    InputBatch batch;
+    batch.Add(Sample(InputSource::RawMouse, 1, 0, 1));
+    batch.Add(Sample(InputSource::RawMouse, 0, 0, 2, RI_MOUSE_LEFT_DOWN));
+    batch.Add(Sample(InputSource::RawMouse, 0, 0, 2, RI_MOUSE_LEFT_DOWN)); //two presses stay two
+    batch.Add(Sample(InputSource::RawMouse, 0, 0, 3, RI_MOUSE_LEFT_UP));
+    batch.Add(Sample(InputSource::RawMouse, 0, 0, 4, RI_MOUSE_WHEEL, 120));
+    batch.Add(Sample(InputSource::RawMouse, 0, 0, 5, RI_MOUSE_WHEEL, 120));
+    batch.Add(Sample(InputSource::RawMouse, 1, 0, 6));
+    batch.Add(Sample(InputSource::RawMouse, 1, 0, 7));
+    REQUIRE(batch.size() == 7);
+    for (size_t i = 0; i < 6; i++)
+    {
+        CHECK_EQ(batch[i].count, 1);
+    }
+    CHECK_EQ(batch[6].x, 2);
+    CHECK_EQ(batch[6].count, 2);
+}
+
+TEST(SourcesAndPointersAreKeptApart)
+{
+    InputBatch batch;
+    batch.Add(Sample(InputSource::Pointer, 1, 1, 1, 6, 10));
+    batch.Add(Sample(InputSource::Pointer, 2, 2, 2, 6, 10));
+    batch.Add(Sample(InputSource::Pointer, 3, 3, 3, 6, 11)); //a second finger
+    batch.Add(Sample(InputSource::Pointer, 4, 4, 4, 6, 10));
+    batch.Add(Sample(InputSource::Mouse, 4, 4, 5));
+    batch.Add(Sample(InputSource::RawMouse, 4, 4, 5));
+    REQUIRE(batch.size() == 5);
+    CHECK_EQ(batch[0].count, 2);
+    CHECK_EQ(batch[0].x, 2);
+    CHECK_EQ(batch[1].id, 11);
+    CHECK_EQ(batch[2].id, 10);
+    uint32_t total = 0;
+    for (const InputSample &s : batch)
+    {
+        total += s.count;
+    }
+    CHECK_EQ(total, batch.received());
+}
+
+TEST(KeepAllKeepsEverySampleInOrder)
+{
+    InputBatch batch(true);
+    for (int i = 0; i < 5; i++)
+    {
+        batch.Add(Sample(InputSource::Pointer, i, -i, i, 6, 10));
+    }
+    CHECK_EQ(batch.size(), 1);
+    REQUIRE(batch.all().size() == 5);
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK_EQ(batch.all()[i].x, i);
+        CHECK_EQ(batch.all()[i].count, 1);
+    }
+    batch.keepall(false);
+    batch.Add(Sample(InputSource::Pointer, 5, -5, 5, 6, 10));
+    CHECK_EQ(batch.all().size(), 5);
+    CHECK_EQ(batch[0].count, 6);
+}
+
+TEST(ClearKeepsMemoryReleaseFreesIt)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    {
+        InputBatch batch(true);
+        for (int i = 0; i < 100; i++)
+        {
+            batch.Add(Sample(InputSource::Mouse, i, i, i, static_cast<uint32_t>(i & 1)));
+        }
+        CHECK_EQ(batch.size(), 100);
+        batch.Clear();
+        CHECK(batch.empty());
+        CHECK_EQ(batch.size(), 0);
+        CHECK_EQ(batch.received(), 0);
+        //the next frame reuses the vectors
+        const AllocStats::Snapshot cleared = AllocStats::Take();
+        for (int i = 0; i < 100; i++)
+        {
+            batch.Add(Sample(InputSource::Mouse, i, i, i, static_cast<uint32_t>(i & 1)));
+        }
+        CHECK(!AllocStats::Diff(cleared, AllocStats::Take()).Allocated());
+        CHECK_EQ(AllocStats::Diff(before, AllocStats::Take())[AllocTag::Window].blocks, 2);
+        batch.Release();
+        CHECK(batch.empty());
+        CHECK_EQ(batch.coalesced().capacity(), 0);
+        CHECK_EQ(batch.all().capacity(), 0);
+        CHECK_EQ(AllocStats::Diff(before, AllocStats::Take())[AllocTag::Window].blocks, 0);
+    }
+    CHECK_EQ(AllocStats::Diff(before, AllocStats::Take())[AllocTag::Window].bytes, 0);
+}
@@ -0,0 +1,188 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*LatencyHistogram and LatencyStats (Headers/Utils/Latency.h) - bucket bounds, percentiles, the
+input tag hand-off and matching frames to vblanks. Times are ticks of a 10 MHz counter, so
+10 ticks are 1 us.*/
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "Utils/Latency.h"
+#include "Test.h"
+
+using WUIF::LatencyHistogram;
+using WUIF::LatencyStats;
+
+namespace
+{
+    const long long frequency = 10000000;
+}
+
+TEST(BucketsCoverEveryValueOnce)
+{
+    bool ok = true;
+    for (uint32_t v = 0; v <= LatencyHistogram::maxvalue; v += (v < 100000) ? 1 : 997)
+    {
+        const size_t i = LatencyHistogram::index(v);
+        ok = ok && (i < LatencyHistogram::buckets) && (LatencyHistogram::lower(i) <= v) && (v <= LatencyHistogram::upper(i));
+    }
+    CHECK(ok);
+    CHECK_EQ(LatencyHistogram::index(LatencyHistogram::maxvalue), LatencyHistogram::buckets - 1);
+    //buckets are contiguous, exact below 16 and at most 12.5% wide above
+    for (size_t i = 0; i + 1 < LatencyHistogram::buckets; i++)
+    {
+        CHECK_EQ(LatencyHistogram::upper(i) + 1, LatencyHistogram::lower(i + 1));
+        if (i < 16)
+        {
+            CHECK_EQ(LatencyHistogram::lower(i), LatencyHistogram::upper(i));
+        }
+        else
+        {
+            CHECK((LatencyHistogram::upper(i) - LatencyHistogram::lower(i) + 1) * 8 <= LatencyHistogram::lower(i));
+        }
+    }
+}
+
+TEST(PercentilesWithinABucket)
+{
+    LatencyHistogram histogram;
+    CHECK_EQ(histogram.percentile(50), 0);
+    CHECK_EQ(histogram.min(), 0);
+    std::mt19937 rng(1);
+    std::vector<uint32_t> values;
+    for (int i = 0; i < 100000; i++)
+    {
+        values.push_back(rng() % 50000);
+        histogram.Add(values.back());
+    }
+    std::sort(values.begin(), values.end());
+    const double percentiles[] = { 1, 10, 50, 90, 99, 99.9, 100 };
+    for (double p : percentiles)
+    {
+        //the exact value's bucket
+        const size_t rank = std::min(values.size() - 1, static_cast<size_t>(p / 100.0 * values.size() + 0.999999) - 1);
+        const uint32_t exact = values[rank];
+        const uint32_t reported = histogram.percentile(p);
+        CHECK((reported >= exact) && (reported <= std::max(LatencyHistogram::upper(LatencyHistogram::index(exact)), exact)));
+    }
+    CHECK_EQ(histogram.percentile(100), histogram.max());
+    CHECK_EQ(histogram.min(), values.front());
+    CHECK_EQ(histogram.max(), values.back());
+    CHECK_EQ(histogram.count(), values.size());
+    //values past the range are counted at the top
+    histogram.Add(0xffffffff);
+    CHECK_EQ(histogram.max(), LatencyHistogram::maxvalue);
+    CHECK_EQ(histogram.bucket(LatencyHistogram::buckets - 1), 1);
+    histogram.Clear();
+    CHECK_EQ(histogram.count(), 0);
+    CHECK(histogram.mean() == 0.0);
+}
+
+TEST(OnlyTheFirstInputOfAFrameIsTagged)
+{
+    LatencyStats stats;
+    stats.Enable(frequency);
+    stats.Input(1000);
+    stats.Input(500);
+    CHECK_EQ(stats.pending(), 1000);
+    const long long input = stats.pending();
+    stats.Presented(input, 1000 + 160000, 5);
+    CHECK_EQ(stats.pending(), 0);
+    CHECK_EQ(stats.topresent().count(), 1);
+    CHECK_EQ(stats.topresent().max(), 16000);
+    //input arriving while the frame is drawn belongs to the next frame
+    stats.Input(10);
+    const long long drawn = stats.pending();
+    stats.Input(20);
+    stats.Presented(drawn, 100, 6);
+    stats.Input(30);
+    CHECK_EQ(stats.pending(), 30);
+    //a Present that showed no input records nothing
+    const uint64_t frames = stats.frames();
+    stats.Presented(0, 5, 7);
+    CHECK_EQ(stats.frames(), frames);
+}
+
+TEST(FramesMatchTheirVblank)
+{
+    LatencyStats stats;
+    stats.Enable(frequency);
+    stats.Input(1000);
+    stats.Presented(stats.pending(), 161000, 5);
+    stats.Input(200000);
+    stats.Presented(stats.pending(), 300000, 6);
+    stats.Input(400000);
+    stats.Presented(stats.pending(), 500000, 7);
+    CHECK(stats.waiting());
+    stats.Displayed(4, 0); //older than anything waiting
+    CHECK(stats.waiting());
+    CHECK_EQ(stats.missed(), 0);
+    stats.Displayed(6, 350000); //5 was never seen
+    CHECK_EQ(stats.missed(), 1);
+    CHECK_EQ(stats.tovblank().count(), 1);
+    CHECK_EQ(stats.tovblank().max(), 15000);
+    LatencyStats::Record records[8];
+    REQUIRE(stats.Recent(records, 8) == 3);
+    CHECK_EQ(records[0].presentid, 5);
+    CHECK_EQ(records[0].tovblank, LatencyStats::unknown);
+    CHECK_EQ(records[1].tovblank, 15000);
+    CHECK_EQ(records[2].tovblank, LatencyStats::unknown);
+    stats.Displayed(7, 520000);
+    CHECK(!stats.waiting());
+    CHECK_EQ(stats.Recent(records, 2), 2);
+    CHECK_EQ(records[1].presentid, 7);
+    CHECK_EQ(records[1].tovblank, 12000);
+}
+
+TEST(PresentCountWrapsAround)
+{
+    LatencyStats stats;
+    stats.Enable(frequency);
+    stats.Input(100);
+    stats.Presented(stats.pending(), 200, 0xffffffff);
+    stats.Input(300);
+    stats.Presented(stats.pending(), 400, 0);
+    stats.Displayed(0xfffffffe, 1000);
+    CHECK(stats.waiting());
+    stats.Displayed(0, 1000);
+    CHECK(!stats.waiting());
+    CHECK_EQ(stats.missed(), 1);
+    CHECK_EQ(stats.tovblank().count(), 1);
+}
+
+TEST(RingOverflow)
+{
+    LatencyStats stats;
+    stats.Enable(frequency);
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        stats.Input(1000000 + i);
+        stats.Presented(stats.pending(), 2000000 + i, 100 + i);
+    }
+    CHECK_EQ(stats.frames(), 200);
+    //only history records can wait, the rest are counted as missed
+    CHECK_EQ(stats.missed(), 200 - LatencyStats::history);
+    LatencyStats::Record records[LatencyStats::history + 8];
+    CHECK_EQ(stats.Recent(records, LatencyStats::history + 8), LatencyStats::history);
+    CHECK_EQ(records[0].presentid, 300 - LatencyStats::history);
+    CHECK_EQ(records[LatencyStats::history - 1].presentid, 299);
+    stats.Displayed(299, 2300000);
+    CHECK(!stats.waiting());
+    CHECK_EQ(stats.missed(), 199);
+    //Enable clears everything
+    stats.Enable(frequency);
+    CHECK_EQ(stats.frames(), 0);
+    CHECK_EQ(stats.Recent(records, 8), 0);
+    stats.Enable(0);
+    CHECK(!stats.enabled());
+}
@@ -0,0 +1,253 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*MulDivRound and MulDivArray (Headers/Utils/MulDivArray.h) against MulDiv as Wine implements it -
+exhaustively over small ranges, then on random values mixed with the edges of the int range. The
+array is checked through MulDivArray and through each of its scalar, SSE2 and (if the CPU has it)
+AVX2 paths.*/
+#include <climits>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "Utils/MulDivArray.h"
+#include "Test.h"
+
+namespace
+{
+    //MulDiv - the operands are widened before negating so INT_MIN doesn't overflow
+    int Reference(int multiplicand, int multiplier, int divisor)
+    {
+        if (divisor == 0)
+        {
+            return -1;
+        }
+        int64_t a = multiplicand;
+        int64_t d = divisor;
+        if (d < 0)
+        {
+            a = -a;
+            d = -d;
+        }
+        //round away from zero - add half the divisor if the result is positive, else subtract it
+        const int64_t product = a * multiplier;
+        const int64_t result  = (((a < 0) && (multiplier < 0)) || ((a >= 0) && (multiplier >= 0))) ?
+                                ((product + (d / 2)) / d) : ((product - (d / 2)) / d);
+        if ((result > 2147483647LL) || (result < -2147483647LL))
+        {
+            return -1;
+        }
+        return static_cast<int>(result);
+    }
+
+    typedef void (*ArrayFunction)(const int *in, int *out, size_t count, int numerator, int denominator);
+
+    void Dispatch(const int *in, int *out, size_t count, int numerator, int denominator)
+    {
+        WUIF::MulDivArray(in, out, count, numerator, denominator);
+    }
+
+    //the vector paths assume MulDivArray already sent negative numerators and non-positive
+    //denominators to the scalar function
+    void Scalar(const int *in, int *out, size_t count, int numerator, int denominator)
+    {
+        if ((numerator < 0) || (denominator <= 0))
+        {
+            return Dispatch(in, out, count, numerator, denominator);
+        }
+        const WUIF::MulDivDetail::Reciprocal rcp = WUIF::MulDivDetail::MakeReciprocal(
+            static_cast<uint32_t>(numerator), static_cast<uint32_t>(denominator));
+        WUIF::MulDivDetail::ArrayScalar(rcp, in, out, count, numerator, denominator);
+    }
+
+    #if defined(WUIF_MULDIV_SSE2)
+    void SSE2(const int *in, int *out, size_t count, int numerator, int denominator)
+    {
+        if ((numerator < 0) || (denominator <= 0))
+        {
+            return Dispatch(in, out, count, numerator, denominator);
+        }
+        const WUIF::MulDivDetail::Reciprocal rcp = WUIF::MulDivDetail::MakeReciprocal(
+            static_cast<uint32_t>(numerator), static_cast<uint32_t>(denominator));
+        WUIF::MulDivDetail::ArraySSE2(rcp, in, out, count, numerator, denominator);
+    }
+
+    void AVX2(const int *in, int *out, size_t count, int numerator, int denominator)
+    {
+        if ((numerator < 0) || (denominator <= 0))
+        {
+            return Dispatch(in, out, count, numerator, denominator);
+        }
+        const WUIF::MulDivDetail::Reciprocal rcp = WUIF::MulDivDetail::MakeReciprocal(
+            static_cast<uint32_t>(numerator), static_cast<uint32_t>(denominator));
+        WUIF::MulDivDetail::ArrayAVX2(rcp, in, out, count, numerator, denominator);
+    }
+    #endif
+
+    std::vector<ArrayFunction> ArrayFunctions()
+    {
+        std::vector<ArrayFunction> functions = { Dispatch, Scalar };
+        #if defined(WUIF_MULDIV_SSE2)
+        functions.push_back(SSE2);
+        if (WUIF::MulDivDetail::HasAVX2())
+        {
+            functions.push_back(AVX2);
+        }
+        #endif
+        return functions;
+    }
+
+    //checks every array path, out of place and in place, stops at the first wrong value
+    bool CheckArray(const std::vector<int> &in, int numerator, int denominator)
+    {
+        std::vector<int> expected(in.size());
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            expected[i] = Reference(in[i], numerator, denominator);
+        }
+        for (ArrayFunction function : ArrayFunctions())
+        {
+            std::vector<int> out(in.size(), 0x5a5a5a5a);
+            function(in.data(), out.data(), in.size(), numerator, denominator);
+            std::vector<int> inplace(in);
+            function(inplace.data(), inplace.data(), inplace.size(), numerator, denominator);
+            for (size_t i = 0; i < in.size(); i++)
+            {
+                if ((out[i] != expected[i]) || (inplace[i] != expected[i]))
+                {
+                    fprintf(stderr, "MulDiv(%d, %d, %d) expected %d got %d (in place %d)\n", in[i],
+                            numerator, denominator, expected[i], out[i], inplace[i]);
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    const int edges[] = { 0, 1, -1, 2, -2, 95, 96, 97, 100, -100, 32767, -32768, 65535, 65536,
+                          0x7fff, 0x8000, 0xffff, 0x10000, 0x7ffffffe, 0x7fffffff, -0x7fffffff,
+                          INT_MIN, INT_MIN + 1, 0x40000000, -0x40000000 };
+}
+
+TEST(KnownResults)
+{
+    //rounding is half away from zero
+    CHECK_EQ(WUIF::MulDivRound(5, 1, 2), 3);
+    CHECK_EQ(WUIF::MulDivRound(-5, 1, 2), -3);
+    CHECK_EQ(WUIF::MulDivRound(5, -1, 2), -3);
+    CHECK_EQ(WUIF::MulDivRound(5, 1, -2), -3);
+    CHECK_EQ(WUIF::MulDivRound(-5, -1, -2), -3);
+    CHECK_EQ(WUIF::MulDivRound(3, 1, 4), 1);
+    CHECK_EQ(WUIF::MulDivRound(-3, 1, 4), -1);
+    CHECK_EQ(WUIF::MulDivRound(1, 1, 3), 0);
+    CHECK_EQ(WUIF::MulDivRound(96, 125, 100), 120);
+    CHECK_EQ(WUIF::MulDivRound(101, 150, 100), 152);
+    CHECK_EQ(WUIF::MulDivRound(-101, 150, 100), -152);
+    //zero divisor
+    CHECK_EQ(WUIF::MulDivRound(10, 10, 0), -1);
+    CHECK_EQ(WUIF::MulDivRound(0, 0, 0), -1);
+    //results outside of +-2147483647 - INT_MIN itself is an overflow
+    CHECK_EQ(WUIF::MulDivRound(INT_MAX, 2, 1), -1);
+    CHECK_EQ(WUIF::MulDivRound(INT_MIN, 1, 1), -1);
+    CHECK_EQ(WUIF::MulDivRound(INT_MIN, -1, 1), -1);
+    CHECK_EQ(WUIF::MulDivRound(INT_MAX, 1, 1), INT_MAX);
+    CHECK_EQ(WUIF::MulDivRound(-INT_MAX, 1, 1), -INT_MAX);
+    CHECK_EQ(WUIF::MulDivRound(INT_MAX, INT_MAX, INT_MAX), INT_MAX);
+    CHECK_EQ(WUIF::MulDivRound(INT_MIN, INT_MIN, INT_MIN), -1);
+    CHECK_EQ(WUIF::MulDivRound(INT_MIN, 1, 2), -1073741824);
+    for (int number : edges)
+    {
+        for (int numerator : edges)
+        {
+            for (int denominator : edges)
+            {
+                if (!CHECK_EQ(WUIF::MulDivRound(number, numerator, denominator), Reference(number, numerator, denominator)))
+                {
+                    fprintf(stderr, "  MulDiv(%d, %d, %d)\n", number, numerator, denominator);
+                }
+            }
+        }
+    }
+}
+
+TEST(ExhaustiveSmallRanges)
+{
+    //every value in -1024..1024 (so every array path sees all of them) for each numerator and
+    //denominator in -40..160
+    std::vector<int> in;
+    for (int number = -1024; number <= 1024; number++)
+    {
+        in.push_back(number);
+    }
+    unsigned long failed = 0;
+    for (int numerator = -40; (numerator <= 160) && (failed < 10); numerator++)
+    {
+        for (int denominator = -40; denominator <= 160; denominator++)
+        {
+            if (!CHECK(CheckArray(in, numerator, denominator)))
+            {
+                failed++;
+            }
+        }
+    }
+}
+
+TEST(DPIScaleFactors)
+{
+    //the factors WindowProperties uses - logical to physical and back
+    const int scales[] = { 100, 120, 125, 140, 150, 160, 175, 180, 200, 225, 250, 300, 350, 400, 450, 500 };
+    std::vector<int> in;
+    for (int number = -70000; number <= 70000; number += 7)
+    {
+        in.push_back(number);
+    }
+    for (int edge : edges)
+    {
+        in.push_back(edge);
+    }
+    for (int scale : scales)
+    {
+        CHECK(CheckArray(in, scale, 100));
+        CHECK(CheckArray(in, 100, scale));
+        CHECK(CheckArray(in, scale, 96));
+        CHECK(CheckArray(in, 96, scale));
+    }
+}
+
+TEST(RandomValues)
+{
+    std::mt19937 rng(20180301);
+    auto value = [&rng]() -> int
+    {
+        switch (rng() % 4)
+        {
+        case 0:  return edges[rng() % (sizeof(edges) / sizeof(edges[0]))];
+        case 1:  return static_cast<int>(rng() % 4001) - 2000;
+        case 2:  return static_cast<int>(rng() % 200001) - 100000;
+        default: return static_cast<int>(rng());
+        }
+    };
+    unsigned long failed = 0;
+    for (int iteration = 0; (iteration < 20000) && (failed < 10); iteration++)
+    {
+        //lengths below, at and above each vector width to reach every tail
+        std::vector<int> in(rng() % 70);
+        for (int &number : in)
+        {
+            number = value();
+        }
+        if (!CHECK(CheckArray(in, value(), value())))
+        {
+            failed++;
+        }
+    }
+}
@@ -0,0 +1,232 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*StackHistogram (Headers/Utils/StackHistogram.h) and PhaseMarker (Headers/Utils/PhaseMarker.h) -
+deduplication against a std::map, the memory bound and dropped samples, the folded output and
+phase nesting on profiled and unprofiled threads*/
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "Utils/PhaseMarker.h"
+#include "Utils/StackHistogram.h"
+#include "Test.h"
+
+using WUIF::AllocStats;
+using WUIF::AllocTag;
+using WUIF::PhaseMarker;
+using WUIF::PhaseSlot;
+using WUIF::StackHistogram;
+
+namespace
+{
+    const char *const phasenames[] = { "dispatch", "present", "draw", "shadow pass" };
+
+    const void* Frame(uintptr_t address) { return reinterpret_cast<const void*>(address); }
+
+    void ThreadName(std::string &out, uint32_t thread) { out += (thread == 0) ? "UI" : "Render"; }
+    void FrameName(std::string &out, const void *frame)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "App.exe!%llx", static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(frame)));
+        out += name;
+    }
+
+    //folded lines keyed by stack
+    std::map<std::string, unsigned long long> Lines(const std::string &folded)
+    {
+        std::map<std::string, unsigned long long> lines;
+        std::istringstream in(folded);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            const size_t space = line.rfind(' ');
+            lines[line.substr(0, space)] += std::stoull(line.substr(space + 1));
+        }
+        return lines;
+    }
+}
+
+TEST(IdenticalSamplesShareAnEntry)
+{
+    StackHistogram histogram(16);
+    const char *phases[] = { phasenames[1], phasenames[2] };
+    const void *frames[] = { Frame(0x10), Frame(0x20), Frame(0x30) };
+    for (int i = 0; i < 5; i++)
+    {
+        CHECK(histogram.Add(0, phases, 2, frames, 3));
+    }
+    CHECK(histogram.Add(1, phases, 2, frames, 3));  //another thread
+    CHECK(histogram.Add(0, phases, 1, frames, 3));  //another phase depth
+    CHECK(histogram.Add(0, phases, 2, frames, 2));  //a shorter stack
+    CHECK(histogram.Add(0, nullptr, 0, nullptr, 0));
+    const StackHistogram::Statistics stats = histogram.statistics();
+    CHECK_EQ(stats.samples, 9);
+    CHECK_EQ(stats.stacks, 5);
+    CHECK_EQ(stats.dropped, 0);
+    CHECK_EQ(stats.words, 5 + 5 + 4 + 4 + 0);
+}
+
+TEST(FoldedIsOutermostFirst)
+{
+    StackHistogram histogram(16);
+    const char *phases[] = { "present", "draw;blur\npass" };
+    const void *frames[] = { Frame(0xb1), Frame(0xa1) }; //innermost first
+    histogram.Add(0, phases, 2, frames, 2);
+    histogram.Add(0, phases, 2, frames, 2);
+    histogram.Add(1, nullptr, 0, frames + 1, 1);
+    std::string folded;
+    histogram.Folded(folded, ThreadName, FrameName);
+    const std::map<std::string, unsigned long long> lines = Lines(folded);
+    REQUIRE(lines.size() == 2);
+    //';' and line breaks in names would split the stack - they become '_'
+    CHECK_EQ(lines.count("UI;present;draw_blur_pass;App.exe!a1;App.exe!b1"), 1);
+    CHECK_EQ(lines.at("UI;present;draw_blur_pass;App.exe!a1;App.exe!b1"), 2);
+    CHECK_EQ(lines.at("Render;App.exe!a1"), 1);
+}
+
+TEST(FullHistogramDropsAndReportsIt)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    StackHistogram histogram(4, 9);
+    const AllocStats::Snapshot constructed = AllocStats::Take();
+    CHECK(AllocStats::Diff(before, constructed)[AllocTag::Logging].bytes > 0);
+    const void *frames[] = { Frame(1), Frame(2), Frame(3), Frame(4) };
+    CHECK(histogram.Add(0, nullptr, 0, frames, 4));
+    CHECK(histogram.Add(0, nullptr, 0, frames, 3));
+    CHECK(!histogram.Add(0, nullptr, 0, frames + 1, 3)); //4 + 3 + 3 words don't fit in 9
+    CHECK(histogram.Add(0, nullptr, 0, frames, 1));
+    CHECK(histogram.Add(1, nullptr, 0, frames, 1));
+    CHECK(!histogram.Add(2, nullptr, 0, frames, 1));     //4 stacks already
+    CHECK(histogram.Add(0, nullptr, 0, frames, 4));      //existing stacks still count
+    //Add never allocates
+    CHECK(!AllocStats::Diff(constructed, AllocStats::Take()).Allocated());
+    StackHistogram::Statistics stats = histogram.statistics();
+    CHECK_EQ(stats.samples, 7);
+    CHECK_EQ(stats.dropped, 2);
+    CHECK_EQ(stats.stacks, 4);
+    CHECK_EQ(stats.capacity, 4);
+    std::string folded;
+    histogram.Folded(folded, ThreadName, FrameName);
+    CHECK_EQ(Lines(folded).at("[dropped]"), 2);
+    histogram.Clear();
+    stats = histogram.statistics();
+    CHECK_EQ(stats.samples, 0);
+    CHECK_EQ(stats.stacks, 0);
+    CHECK_EQ(stats.words, 0);
+    CHECK(histogram.Add(2, nullptr, 0, frames, 4));
+}
+
+TEST(RandomSamplesMatchAMap)
+{
+    typedef std::tuple<uint32_t, std::vector<const char*>, std::vector<const void*>> Key;
+    std::map<Key, unsigned long long> reference;
+    StackHistogram histogram(8192);
+    std::mt19937 rng(49);
+    for (int i = 0; i < 200000; i++)
+    {
+        //few enough distinct stacks that all of them fit
+        const uint32_t thread = rng() % 2;
+        std::vector<const char*> phases(rng() % 3);
+        for (const char *&phase : phases)
+        {
+            phase = phasenames[rng() % 4];
+        }
+        std::vector<const void*> frames(1 + rng() % 3);
+        for (const void *&frame : frames)
+        {
+            frame = Frame(0x1000 + (rng() % 4) * 16);
+        }
+        REQUIRE(histogram.Add(thread, phases.data(), phases.size(), frames.data(), frames.size()));
+        reference[Key(thread, phases, frames)]++;
+    }
+    CHECK_EQ(histogram.statistics().stacks, reference.size());
+    std::map<std::string, unsigned long long> expected;
+    for (const std::pair<const Key, unsigned long long> &entry : reference)
+    {
+        std::string line;
+        ThreadName(line, std::get<0>(entry.first));
+        for (const char *phase : std::get<1>(entry.first))
+        {
+            line += ';';
+            line += phase;
+        }
+        const std::vector<const void*> &frames = std::get<2>(entry.first);
+        for (size_t f = frames.size(); f-- > 0;)
+        {
+            line += ';';
+            FrameName(line, frames[f]);
+        }
+        expected[line] += entry.second;
+    }
+    std::string folded;
+    histogram.Folded(folded, ThreadName, FrameName);
+    CHECK(Lines(folded) == expected);
+}
+
+TEST(PhasesNestOnAProfiledThread)
+{
+    PhaseSlot slot = {};
+    PhaseMarker::Slot() = &slot;
+    {
+        WUIF_PHASE("present");
+        CHECK_EQ(slot.depth, 1);
+        {
+            WUIF_PHASE("draw");
+            WUIF_PHASE("shadow pass");
+            CHECK_EQ(slot.depth, 3);
+            CHECK(std::string(slot.names[2]) == "shadow pass");
+        }
+        CHECK_EQ(slot.depth, 1);
+        CHECK(std::string(slot.names[0]) == "present");
+    }
+    CHECK_EQ(slot.depth, 0);
+    //past maxdepth phases are counted but not named
+    {
+        std::vector<std::unique_ptr<PhaseMarker>> markers;
+        for (uint32_t i = 0; i < PhaseSlot::maxdepth + 3; i++)
+        {
+            markers.emplace_back(new PhaseMarker("deep"));
+        }
+        CHECK_EQ(slot.depth, PhaseSlot::maxdepth + 3);
+        markers.emplace_back(new PhaseMarker("too deep"));
+        CHECK(std::string(slot.names[PhaseSlot::maxdepth - 1]) == "deep");
+        while (!markers.empty())
+        {
+            markers.pop_back();
+        }
+    }
+    CHECK_EQ(slot.depth, 0);
+    PhaseMarker::Slot() = nullptr;
+}
+
+TEST(PhasesOnAnUnprofiledThreadAreIgnored)
+{
+    PhaseSlot slot = {};
+    PhaseMarker::Slot() = &slot;
+    bool ignored = false;
+    std::thread other([&ignored]()
+    {
+        WUIF_PHASE("dispatch");
+        ignored = (PhaseMarker::Slot() == nullptr);
+    });
+    other.join();
+    CHECK(ignored);
+    CHECK_EQ(slot.depth, 0);
+    PhaseMarker::Slot() = nullptr;
+}
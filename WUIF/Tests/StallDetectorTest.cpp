@@ -0,0 +1,170 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*StallDetector (Headers/Utils/StallDetector.h) driven by a fake clock - arming, the threshold, the
+sampling schedule, recovery, Disarm and WatchScope nesting*/
+#include <chrono>
+#include "Utils/StallDetector.h"
+#include "Test.h"
+
+using WUIF::WatchActivity;
+using WUIF::WatchScope;
+
+namespace
+{
+    //time only moves when the test says so - Poll and Next are given the time explicitly
+    struct FakeClock
+    {
+        typedef std::chrono::milliseconds                    duration;
+        typedef duration::rep                                rep;
+        typedef duration::period                             period;
+        typedef std::chrono::time_point<FakeClock, duration> time_point;
+        static const bool steady = true;
+        static time_point now() noexcept { return time_point(); }
+    };
+
+    typedef WUIF::StallDetector<FakeClock> Detector;
+    typedef Detector::Event                Event;
+    typedef std::chrono::milliseconds      ms;
+
+    FakeClock::time_point At(int milliseconds) { return FakeClock::time_point(ms(milliseconds)); }
+
+    //a detector with a 1 s threshold, 100 ms sample interval and 3 samples per stall
+    struct Fixture
+    {
+        Detector detector;
+        Fixture() : detector(ms(1000), ms(100), 3) {}
+    };
+}
+
+TEST(UnarmedUntilTheFirstBeat)
+{
+    Fixture f;
+    CHECK(f.detector.Poll(At(0)) == Event::None);
+    CHECK(f.detector.Poll(At(5000)) == Event::None);
+    CHECK(!f.detector.stalled());
+    //a quarter of the threshold while nothing is stalled
+    CHECK(f.detector.Next(At(5000)) == At(5250));
+}
+
+TEST(StallAfterTheThreshold)
+{
+    Fixture f;
+    f.detector.Beat();
+    CHECK(f.detector.Poll(At(5000)) == Event::None);
+    CHECK(f.detector.Poll(At(5999)) == Event::None);
+    CHECK(f.detector.Poll(At(6000)) == Event::Stalled);
+    CHECK(f.detector.stalled());
+    CHECK(f.detector.stallbegan() == At(5000));
+    CHECK_EQ(f.detector.samples(), 1);
+    CHECK_EQ(f.detector.stalls(), 1);
+    //polled again before the next sample is due
+    CHECK(f.detector.Poll(At(6000)) == Event::None);
+}
+
+TEST(SamplesAreSpacedAndCapped)
+{
+    Fixture f;
+    f.detector.Beat();
+    f.detector.Poll(At(0));
+    REQUIRE(f.detector.Poll(At(1000)) == Event::Stalled);
+    CHECK(f.detector.Next(At(1000)) == At(1100));
+    CHECK(f.detector.Poll(At(1050)) == Event::None);
+    CHECK(f.detector.Poll(At(1100)) == Event::Sample);
+    //the watchdog was late - one sample, not the three it missed
+    CHECK(f.detector.Poll(At(1450)) == Event::Sample);
+    CHECK_EQ(f.detector.samples(), 3);
+    //maxsamples reached, back to the normal period
+    CHECK(f.detector.Next(At(1450)) == At(1700));
+    CHECK(f.detector.Poll(At(1550)) == Event::None);
+    CHECK(f.detector.Poll(At(9000)) == Event::None);
+    CHECK_EQ(f.detector.samples(), 3);
+    CHECK(f.detector.stalled());
+}
+
+TEST(RecoveredWhenBeatsResume)
+{
+    Fixture f;
+    f.detector.Beat();
+    f.detector.Poll(At(5000));
+    REQUIRE(f.detector.Poll(At(6000)) == Event::Stalled);
+    f.detector.Beat();
+    CHECK(f.detector.Poll(At(7000)) == Event::Recovered);
+    CHECK(f.detector.lastduration() == ms(2000));
+    CHECK(!f.detector.stalled());
+    //a steady heartbeat never stalls, however long it runs
+    bool stalled = false;
+    for (int t = 7000; t < 60000; t += 250)
+    {
+        f.detector.Beat();
+        stalled = stalled || (f.detector.Poll(At(t)) != Event::None);
+    }
+    CHECK(!stalled);
+    CHECK_EQ(f.detector.stalls(), 1);
+    //a second stall starts its samples over
+    CHECK(f.detector.Poll(At(61000)) == Event::Stalled);
+    CHECK_EQ(f.detector.samples(), 1);
+    CHECK_EQ(f.detector.stalls(), 2);
+}
+
+TEST(DisarmStopsDetection)
+{
+    Fixture f;
+    f.detector.Beat();
+    f.detector.Poll(At(0));
+    f.detector.Disarm();
+    CHECK(f.detector.Poll(At(100)) == Event::None);
+    CHECK(f.detector.Poll(At(30000)) == Event::None);
+    //disarming during a stall - e.g. the message loop ended - ends it
+    f.detector.Beat();
+    f.detector.Poll(At(30000));
+    REQUIRE(f.detector.Poll(At(31000)) == Event::Stalled);
+    f.detector.Disarm();
+    CHECK(f.detector.Poll(At(31100)) == Event::Recovered);
+    CHECK(f.detector.Poll(At(40000)) == Event::None);
+}
+
+TEST(ScopesNestAndRestore)
+{
+    Fixture f;
+    int handler, draw, window;
+    CHECK_EQ(f.detector.activity().kind, WatchActivity::Idle);
+    {
+        WatchScope<Detector> message(f.detector, WatchActivity::Message, 0x111, &handler, &window);
+        CHECK_EQ(f.detector.activity().message, 0x111);
+        CHECK(f.detector.activity().handler == &handler);
+        {
+            //Present of another window from inside the handler
+            WatchScope<Detector> present(f.detector, WatchActivity::Present, 0, nullptr, nullptr);
+            present.Handler(WatchActivity::DrawRoutine, &draw);
+            CHECK_EQ(f.detector.activity().kind, WatchActivity::DrawRoutine);
+            CHECK(f.detector.activity().handler == &draw);
+        }
+        CHECK_EQ(f.detector.activity().kind, WatchActivity::Message);
+        CHECK(f.detector.activity().handler == &handler);
+        CHECK(f.detector.activity().target == &window);
+    }
+    CHECK_EQ(f.detector.activity().kind, WatchActivity::Idle);
+    CHECK(f.detector.activity().handler == nullptr);
+}
+
+TEST(ZeroThresholdStillAdvances)
+{
+    //Next must always move forward or the watchdog would spin
+    Detector detector(ms(0), ms(0), 1);
+    CHECK(detector.Next(At(10)) > At(10));
+    detector.Configure(ms(2000), ms(500), 5);
+    CHECK(detector.threshold() == ms(2000));
+    CHECK(detector.interval() == ms(500));
+    CHECK(detector.Next(At(0)) == At(500));
+}
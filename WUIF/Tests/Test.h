@@ -0,0 +1,82 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstdio>
+#include <vector>
+
+/*Test harness for the portable headers, kept free of dependencies so the tests build wherever the
+headers do.
+
+    TEST(name)      - defines a test case, registered with the executable it is linked into
+    CHECK(expr)     - records a failure (with file and line) and carries on if expr is false
+    REQUIRE(expr)   - as CHECK, but returns from the test case on failure
+    CHECK_EQ(a, b)  - CHECK(a == b) that prints both values as long long on failure
+
+TestMain.cpp runs the cases and returns non-zero if any check failed.*/
+namespace WUIF {
+    namespace Test {
+
+        struct Case
+        {
+            const char *name;
+            void      (*run)();
+        };
+
+        inline std::vector<Case>& Cases()
+        {
+            static std::vector<Case> cases;
+            return cases;
+        }
+
+        inline unsigned long& Failures()
+        {
+            static unsigned long failures = 0;
+            return failures;
+        }
+
+        struct Register
+        {
+            Register(const char *name, void (*run)()) { Cases().push_back({ name, run }); }
+        };
+
+        inline bool Check(bool ok, const char *file, int line, const char *expr)
+        {
+            if (!ok)
+            {
+                fprintf(stderr, "%s(%d): CHECK(%s) failed\n", file, line, expr);
+                Failures()++;
+            }
+            return ok;
+        }
+
+        inline bool CheckEqual(long long a, long long b, const char *file, int line, const char *expr)
+        {
+            if (a != b)
+            {
+                fprintf(stderr, "%s(%d): CHECK_EQ(%s) failed - %lld != %lld\n", file, line, expr, a, b);
+                Failures()++;
+            }
+            return (a == b);
+        }
+    }
+}
+
+#define TEST(name)                                                                   \
+    static void name();                                                              \
+    static const WUIF::Test::Register name##_registered(#name, name);                \
+    static void name()
+#define CHECK(expr)    WUIF::Test::Check(!!(expr), __FILE__, __LINE__, #expr)
+#define REQUIRE(expr)  do { if (!CHECK(expr)) return; } while (0)
+#define CHECK_EQ(a, b) WUIF::Test::CheckEqual(static_cast<long long>(a), static_cast<long long>(b), \
+                                              __FILE__, __LINE__, #a ", " #b)
@@ -0,0 +1,43 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*Runs the TESTs linked into the executable
+
+    <test> [name ...]
+
+Without names every case is run.*/
+#include <cstring>
+#include "Test.h"
+
+int main(int argc, char *argv[])
+{
+    unsigned long run = 0;
+    for (const WUIF::Test::Case &test : WUIF::Test::Cases())
+    {
+        bool selected = (argc < 2);
+        for (int i = 1; i < argc; i++)
+        {
+            selected |= (strcmp(argv[i], test.name) == 0);
+        }
+        if (!selected)
+        {
+            continue;
+        }
+        const unsigned long before = WUIF::Test::Failures();
+        test.run();
+        printf("%-48s %s\n", test.name, (WUIF::Test::Failures() == before) ? "ok" : "FAILED");
+        run++;
+    }
+    printf("%lu cases, %lu failed checks\n", run, WUIF::Test::Failures());
+    return ((WUIF::Test::Failures() == 0) && (run != 0)) ? 0 : 1;
+}
@@ -0,0 +1,251 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*ThunkEmitter (Headers/Utils/ThunkEmitter.h) - the bytes every back end emits, on any CPU, and
+calls through real thunks for the ABI of the machine running the test: SysV<Arg> on x86-64
+Linux/macOS, Win64<Arg> on x64 Windows, X86First on x86 Windows*/
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+#include "Utils/ThunkEmitter.h"
+#include "Test.h"
+
+using WUIF::ThunkSlab;
+namespace ThunkEmitter = WUIF::ThunkEmitter;
+
+namespace
+{
+    //code and data close together so rel32 reaches, as they are in a slab block
+    struct Buffer
+    {
+        unsigned char   code[ThunkSlab::codesize];
+        ThunkSlab::Data data;
+    };
+
+    int32_t Rel(const unsigned char *next, const void *target)
+    {
+        return static_cast<int32_t>(reinterpret_cast<const unsigned char*>(target) - next);
+    }
+
+    std::vector<unsigned char> Bytes(std::initializer_list<unsigned char> bytes) { return bytes; }
+
+    void Append32(std::vector<unsigned char> &v, uint32_t value)
+    {
+        unsigned char b[4];
+        memcpy(b, &value, sizeof(b));
+        v.insert(v.end(), b, b + 4);
+    }
+
+    //mov reg, [rip+object] ; [extra] ; jmp [rip+target], the rest int 3
+    std::vector<unsigned char> Expected64(const Buffer &buf, std::initializer_list<unsigned char> mov,
+                                          std::initializer_list<unsigned char> extra)
+    {
+        std::vector<unsigned char> v(mov);
+        Append32(v, static_cast<uint32_t>(Rel(buf.code + v.size() + 4, &buf.data.object)));
+        v.insert(v.end(), extra.begin(), extra.end());
+        v.push_back(0xff);
+        v.push_back(0x25);
+        Append32(v, static_cast<uint32_t>(Rel(buf.code + v.size() + 4, &buf.data.target)));
+        v.resize(ThunkSlab::codesize, 0xcc);
+        return v;
+    }
+
+    bool Emitted(const Buffer &buf, const std::vector<unsigned char> &expected)
+    {
+        return (memcmp(buf.code, expected.data(), ThunkSlab::codesize) == 0);
+    }
+}
+
+TEST(SysVEncoding)
+{
+    //rdi, rsi, rdx, rcx, r8, r9
+    Buffer buf;
+    ThunkEmitter::SysV<0>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x3d }, {})));
+    ThunkEmitter::SysV<1>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x35 }, {})));
+    ThunkEmitter::SysV<2>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x15 }, {})));
+    ThunkEmitter::SysV<3>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x0d }, {})));
+    ThunkEmitter::SysV<4>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x4c, 0x8b, 0x05 }, {})));
+    ThunkEmitter::SysV<5>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x4c, 0x8b, 0x0d }, {})));
+}
+
+TEST(Win64Encoding)
+{
+    //rcx, rdx, r8, r9, then the stack slot after the home space
+    Buffer buf;
+    ThunkEmitter::Win64<0>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x0d }, {})));
+    ThunkEmitter::Win64<1>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x15 }, {})));
+    ThunkEmitter::Win64<2>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x4c, 0x8b, 0x05 }, {})));
+    ThunkEmitter::Win64<3>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x4c, 0x8b, 0x0d }, {})));
+    ThunkEmitter::Win64<4>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x05 }, { 0x48, 0x89, 0x44, 0x24, 0x28 })));
+    ThunkEmitter::Win64<5>(buf.code, &buf.data);
+    CHECK(Emitted(buf, Expected64(buf, { 0x48, 0x8b, 0x05 }, { 0x48, 0x89, 0x44, 0x24, 0x30 })));
+}
+
+TEST(X86FirstEncoding)
+{
+    Buffer buf;
+    ThunkEmitter::X86First(buf.code, &buf.data);
+    std::vector<unsigned char> expected = Bytes({ 0xff, 0x34, 0x24, 0xa1 });
+    Append32(expected, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&buf.data.object)));
+    expected.insert(expected.end(), { 0x89, 0x44, 0x24, 0x04, 0xff, 0x25 });
+    Append32(expected, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&buf.data.target)));
+    expected.resize(ThunkSlab::codesize, 0xcc);
+    CHECK(Emitted(buf, expected));
+}
+
+#if defined(__x86_64__) && !defined(_WIN32)
+namespace
+{
+    uintptr_t received[6];
+
+    uintptr_t Collect(uintptr_t a0, uintptr_t a1, uintptr_t a2, uintptr_t a3, uintptr_t a4, uintptr_t a5)
+    {
+        received[0] = a0; received[1] = a1; received[2] = a2;
+        received[3] = a3; received[4] = a4; received[5] = a5;
+        return a0 ^ a1 ^ a2 ^ a3 ^ a4 ^ a5;
+    }
+
+    uintptr_t Other(uintptr_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t) { return 42; }
+
+    typedef uintptr_t (*Call6)(uintptr_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t);
+
+    //calls a SysV<Arg> thunk with 100..105 - parameter Arg must arrive as the bound object
+    template <unsigned Arg>
+    void CheckSysV()
+    {
+        ThunkSlab slab(ThunkEmitter::SysV<Arg>);
+        ThunkSlab::Slot slot;
+        REQUIRE(slab.Allocate(slot));
+        const uintptr_t object = 0x5eed0000 + Arg;
+        slot.data->object.store(object);
+        slot.data->target.store(reinterpret_cast<uintptr_t>(&Collect));
+        const Call6 thunk = reinterpret_cast<Call6>(slot.code);
+        thunk(100, 101, 102, 103, 104, 105);
+        for (unsigned i = 0; i < 6; i++)
+        {
+            CHECK_EQ(received[i], (i == Arg) ? object : 100 + i);
+        }
+        //rebinding is two stores, the code isn't touched
+        slot.data->object.store(object + 1);
+        thunk(0, 0, 0, 0, 0, 0);
+        CHECK_EQ(received[Arg], object + 1);
+        slot.data->target.store(reinterpret_cast<uintptr_t>(&Other));
+        CHECK_EQ(thunk(0, 0, 0, 0, 0, 0), 42);
+        slab.Free(slot);
+    }
+}
+
+TEST(SysVCalls)
+{
+    CheckSysV<0>();
+    CheckSysV<1>();
+    CheckSysV<2>();
+    CheckSysV<3>();
+    CheckSysV<4>();
+    CheckSysV<5>();
+}
+
+TEST(ManyThunksDispatchToTheirObjects)
+{
+    //the WndProc case - the caller doesn't know the object, the thunk it calls does
+    ThunkSlab slab(ThunkEmitter::Native<5>);
+    std::vector<ThunkSlab::Slot> slots(3000);
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        REQUIRE(slab.Allocate(slots[i]));
+        slots[i].data->object.store(i * 1000);
+        slots[i].data->target.store(reinterpret_cast<uintptr_t>(&Collect));
+    }
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        CHECK_EQ(reinterpret_cast<Call6>(slots[i].code)(1, 2, 4, 8, 16, 0), (i * 1000) ^ 31);
+        slab.Free(slots[i]);
+    }
+}
+#elif defined(_M_AMD64)
+namespace
+{
+    uintptr_t received[6];
+
+    uintptr_t Collect(uintptr_t a0, uintptr_t a1, uintptr_t a2, uintptr_t a3, uintptr_t a4, uintptr_t a5)
+    {
+        received[0] = a0; received[1] = a1; received[2] = a2;
+        received[3] = a3; received[4] = a4; received[5] = a5;
+        return a0 ^ a1 ^ a2 ^ a3 ^ a4 ^ a5;
+    }
+
+    typedef uintptr_t (*Call6)(uintptr_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t, uintptr_t);
+
+    //the caller passes all six parameters so the stack slot Win64<4> and <5> write is its own
+    template <unsigned Arg>
+    void CheckWin64()
+    {
+        ThunkSlab slab(ThunkEmitter::Win64<Arg>);
+        ThunkSlab::Slot slot;
+        REQUIRE(slab.Allocate(slot));
+        const uintptr_t object = 0x5eed0000 + Arg;
+        slot.data->object.store(object);
+        slot.data->target.store(reinterpret_cast<uintptr_t>(&Collect));
+        reinterpret_cast<Call6>(slot.code)(100, 101, 102, 103, 104, 105);
+        for (unsigned i = 0; i < 6; i++)
+        {
+            CHECK_EQ(received[i], (i == Arg) ? object : 100 + i);
+        }
+        slab.Free(slot);
+    }
+}
+
+TEST(Win64Calls)
+{
+    CheckWin64<0>();
+    CheckWin64<1>();
+    CheckWin64<2>();
+    CheckWin64<3>();
+    CheckWin64<4>();
+    CheckWin64<5>();
+}
+#elif defined(_M_IX86)
+namespace
+{
+    uintptr_t __stdcall Collect(uintptr_t object, uintptr_t a, uintptr_t b, uintptr_t c, uintptr_t d)
+    {
+        return (object == 0x5eed0000) ? (a + b + c + d) : 0;
+    }
+
+    typedef uintptr_t (__stdcall *Call4)(uintptr_t, uintptr_t, uintptr_t, uintptr_t);
+}
+
+TEST(X86FirstCalls)
+{
+    ThunkSlab slab(ThunkEmitter::X86First);
+    ThunkSlab::Slot slot;
+    REQUIRE(slab.Allocate(slot));
+    slot.data->object.store(0x5eed0000);
+    slot.data->target.store(reinterpret_cast<uintptr_t>(&Collect));
+    //the callee pops the extra parameter - calling twice checks the stack stays balanced
+    CHECK_EQ(reinterpret_cast<Call4>(slot.code)(1, 2, 3, 4), 10);
+    CHECK_EQ(reinterpret_cast<Call4>(slot.code)(5, 6, 7, 8), 26);
+    slab.Free(slot);
+}
+#endif
@@ -0,0 +1,240 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*ThunkSlab (Headers/Utils/ThunkSlab.h) - slot ownership, growth, reuse, W^X protection and
+accounting. The emitter writes the slot's Data address instead of code, so these tests don't
+depend on the CPU, ThunkEmitterTest calls through real thunks.*/
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils/ThunkSlab.h"
+#include "Test.h"
+
+using WUIF::AllocStats;
+using WUIF::AllocTag;
+using WUIF::ThunkSlab;
+
+namespace
+{
+    std::atomic<unsigned long> emitted(0);
+
+    void Record(unsigned char *code, const ThunkSlab::Data *data)
+    {
+        memset(code, 0xcc, ThunkSlab::codesize);
+        memcpy(code, &data, sizeof(data));
+        emitted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //true if the slot's code was emitted for its own Data
+    bool EmittedFor(const ThunkSlab::Slot &slot)
+    {
+        const ThunkSlab::Data *data;
+        memcpy(&data, slot.code, sizeof(data));
+        return (data == slot.data) && (slot.code[ThunkSlab::codesize - 1] == 0xcc);
+    }
+
+    #if defined(__linux__)
+    //permissions of the mapping holding address as in /proc/self/maps, e.g. "r-xp"
+    std::string Protection(const void *address)
+    {
+        const uintptr_t where = reinterpret_cast<uintptr_t>(address);
+        FILE *maps = fopen("/proc/self/maps", "r");
+        if (maps == nullptr)
+        {
+            return "";
+        }
+        char line[512];
+        std::string perms;
+        while (fgets(line, sizeof(line), maps) != nullptr)
+        {
+            unsigned long long start, end;
+            char flags[8];
+            if ((sscanf(line, "%llx-%llx %7s", &start, &end, flags) == 3) && (where >= start) && (where < end))
+            {
+                perms = flags;
+                break;
+            }
+        }
+        fclose(maps);
+        return perms;
+    }
+    #endif
+}
+
+TEST(SlotsAreDistinctAndEmittedOnce)
+{
+    const unsigned long before = emitted.load();
+    ThunkSlab slab(Record);
+    CHECK_EQ(slab.Blocks(), 0);
+    std::vector<ThunkSlab::Slot> slots(ThunkSlab::slotsperblock + 1);
+    std::set<uint32_t> indexes;
+    std::set<const void*> addresses;
+    for (ThunkSlab::Slot &slot : slots)
+    {
+        REQUIRE(slab.Allocate(slot));
+        CHECK(indexes.insert(slot.index).second);
+        CHECK(addresses.insert(slot.code).second);
+        CHECK(addresses.insert(slot.data).second);
+        CHECK(EmittedFor(slot));
+    }
+    //one block is filled, the next slot maps a second block - each slot's code is written once
+    CHECK_EQ(slab.Blocks(), 2);
+    CHECK_EQ(slab.InUse(), slots.size());
+    CHECK_EQ(emitted.load() - before, 2 * ThunkSlab::slotsperblock);
+    for (const ThunkSlab::Slot &slot : slots)
+    {
+        slab.Free(slot);
+    }
+    CHECK_EQ(slab.InUse(), 0);
+}
+
+TEST(FreedSlotsAreReused)
+{
+    ThunkSlab slab(Record);
+    std::vector<ThunkSlab::Slot> slots(100);
+    for (ThunkSlab::Slot &slot : slots)
+    {
+        REQUIRE(slab.Allocate(slot));
+    }
+    std::set<uint32_t> freed;
+    for (size_t i = 0; i < slots.size(); i += 2)
+    {
+        freed.insert(slots[i].index);
+        slab.Free(slots[i]);
+    }
+    for (size_t i = 0; i < slots.size(); i += 2)
+    {
+        ThunkSlab::Slot slot;
+        REQUIRE(slab.Allocate(slot));
+        CHECK(freed.erase(slot.index) == 1);
+        CHECK(EmittedFor(slot)); //the code is still there, only Data is rebound
+    }
+    CHECK(freed.empty());
+    CHECK_EQ(slab.Blocks(), 1);
+}
+
+TEST(DataIsBoundPerSlot)
+{
+    ThunkSlab slab(Record);
+    std::vector<ThunkSlab::Slot> slots(64);
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        REQUIRE(slab.Allocate(slots[i]));
+        slots[i].data->object.store(1000 + i);
+        slots[i].data->target.store(2000 + i);
+    }
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        CHECK_EQ(slots[i].data->object.load(), 1000 + i);
+        CHECK_EQ(slots[i].data->target.load(), 2000 + i);
+        slab.Free(slots[i]);
+    }
+}
+
+#if defined(__linux__)
+TEST(CodeIsNeverWritable)
+{
+    ThunkSlab slab(Record);
+    ThunkSlab::Slot slot;
+    REQUIRE(slab.Allocate(slot));
+    CHECK(Protection(slot.code) == "r-xp");
+    CHECK(Protection(slot.data) == "rw-p");
+    slab.Free(slot);
+}
+#endif
+
+TEST(BlocksAreAccountedToThunk)
+{
+    const AllocStats::Snapshot before = AllocStats::Take();
+    {
+        ThunkSlab slab(Record);
+        ThunkSlab::Slot slot;
+        REQUIRE(slab.Allocate(slot));
+        const AllocStats::Difference held = AllocStats::Diff(before, AllocStats::Take());
+        CHECK_EQ(held[AllocTag::Thunk].blocks, 1);
+        CHECK(held[AllocTag::Thunk].bytes >= static_cast<int64_t>(ThunkSlab::slotsperblock * (ThunkSlab::codesize + sizeof(ThunkSlab::Data))));
+        slab.Free(slot);
+    }
+    const AllocStats::Difference after = AllocStats::Diff(before, AllocStats::Take());
+    CHECK_EQ(after[AllocTag::Thunk].blocks, 0);
+    CHECK_EQ(after[AllocTag::Thunk].bytes, 0);
+}
+
+TEST(ConcurrentAllocateAndFree)
+{
+    //every thread marks the slots it holds - a slot handed to two threads at once shows up as a
+    //changed mark
+    ThunkSlab slab(Record);
+    std::atomic<unsigned long> lost(0);
+    std::vector<std::thread> threads;
+    for (uintptr_t t = 1; t <= 8; t++)
+    {
+        threads.emplace_back([&slab, &lost, t]()
+        {
+            std::vector<ThunkSlab::Slot> held;
+            for (unsigned i = 0; i < 50000; i++)
+            {
+                ThunkSlab::Slot slot;
+                if (!slab.Allocate(slot))
+                {
+                    lost++;
+                    continue;
+                }
+                slot.data->target.store(t);
+                held.push_back(slot);
+                if ((held.size() > 40) || ((i & 3) == 0))
+                {
+                    const ThunkSlab::Slot back = held.back();
+                    held.pop_back();
+                    if (back.data->target.load() != t)
+                    {
+                        lost++;
+                    }
+                    slab.Free(back);
+                }
+            }
+            for (const ThunkSlab::Slot &slot : held)
+            {
+                if (slot.data->target.load() != t)
+                {
+                    lost++;
+                }
+                slab.Free(slot);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    CHECK_EQ(lost.load(), 0);
+    CHECK_EQ(slab.InUse(), 0);
+    //the free list is intact - every slot of every block can be taken exactly once
+    const size_t capacity = slab.Blocks() * ThunkSlab::slotsperblock;
+    std::vector<ThunkSlab::Slot> all(capacity);
+    std::set<uint32_t> indexes;
+    for (ThunkSlab::Slot &slot : all)
+    {
+        REQUIRE(slab.Allocate(slot));
+        CHECK(indexes.insert(slot.index).second);
+    }
+    CHECK_EQ(slab.Blocks() * ThunkSlab::slotsperblock, capacity);
+    for (const ThunkSlab::Slot &slot : all)
+    {
+        slab.Free(slot);
+    }
+}
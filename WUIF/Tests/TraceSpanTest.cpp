@@ -0,0 +1,112 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*TraceSpans (Headers/Utils/TraceSpan.h) - Dump's timestamps, including the first span of the process,
+which begins before the State holding the base time exists, and the spans and names of a thread that
+has exited. The rings are process wide, so the cases run in order.*/
+#if defined(_WIN32)
+#include <Windows.h> //TraceSpan.h reads QueryPerformanceCounter
+#endif
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utils/TraceSpan.h"
+#include "Test.h"
+
+using WUIF::TraceSpan;
+using WUIF::TraceSpans;
+
+namespace
+{
+    #if defined(_WIN32)
+    const TCHAR path[]  = TEXT("TraceSpanTest.json");
+    const char  cpath[] = "TraceSpanTest.json";
+    #else
+    const char path[]   = "TraceSpanTest.json";
+    const char *cpath   = path;
+    #endif
+
+    std::string Dumped()
+    {
+        std::string json;
+        if (!TraceSpans::Dump(path))
+        {
+            return json;
+        }
+        FILE *file = fopen(cpath, "rb");
+        if (file != nullptr)
+        {
+            char buf[4096];
+            size_t read;
+            while ((read = fread(buf, 1, sizeof(buf), file)) != 0)
+            {
+                json.append(buf, read);
+            }
+            fclose(file);
+        }
+        remove(cpath);
+        return json;
+    }
+
+    //every "ts" in the trace, in microseconds
+    std::vector<double> Timestamps(const std::string &json)
+    {
+        std::vector<double> ts;
+        for (size_t at = json.find("\"ts\":"); at != std::string::npos; at = json.find("\"ts\":", at + 1))
+        {
+            ts.push_back(strtod(json.c_str() + at + 5, nullptr));
+        }
+        return ts;
+    }
+}
+
+TEST(FirstSpanIsNotBeforeTheBase)
+{
+    //nothing has traced yet, so writing this span makes the State
+    {
+        TraceSpan span("first");
+    }
+    {
+        TraceSpan span("second", 7);
+    }
+    const std::string json = Dumped();
+    REQUIRE(!json.empty());
+    CHECK(json.find("\"first\"") != std::string::npos);
+    CHECK(json.find("\"args\":{\"arg\":7}") != std::string::npos);
+    const std::vector<double> ts = Timestamps(json);
+    REQUIRE(ts.size() == 2);
+    //a begin before the base wraps to about 2^64 ticks
+    CHECK((ts[0] >= 0.0) && (ts[0] < 1000000.0));
+    CHECK((ts[1] >= ts[0]) && (ts[1] < 1000000.0));
+}
+
+TEST(ExitedThreadsAreWritten)
+{
+    std::thread worker([]()
+    {
+        TraceSpans::NameThread("worker");
+        TraceSpan span("on worker");
+    });
+    worker.join();
+    const std::string json = Dumped();
+    CHECK(json.find("\"thread_name\"") != std::string::npos);
+    CHECK(json.find("\"worker\"") != std::string::npos);
+    CHECK(json.find("\"on worker\"") != std::string::npos);
+    //the retired ring was freed by the first Dump
+    const std::string again = Dumped();
+    CHECK(again.find("\"on worker\"") == std::string::npos);
+    CHECK(again.find("\"second\"") != std::string::npos);
+}
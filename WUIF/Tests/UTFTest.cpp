@@ -0,0 +1,408 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*UTF-8 <-> UTF-16 conversion (Headers/Utils/UTF.h) against a byte at a time reference decoder
+that replaces each maximal ill-formed subpart with U+FFFD (the WHATWG decoder, which is what
+MultiByteToWideChar does), on fixed cases and on random mixes of valid and broken sequences long
+enough to reach the SSE2 paths*/
+#include <random>
+#include <string>
+#include <vector>
+#include "Utils/UTF.h"
+#include "Test.h"
+
+using WUIF::UTF;
+using WUIF::UTF16Char;
+using WUIF::UTF16Buffer;
+using WUIF::UTF8Buffer;
+
+namespace
+{
+    typedef std::basic_string<UTF16Char> String16;
+
+    void Append16(String16 &out, uint32_t cp)
+    {
+        if (cp >= 0x10000)
+        {
+            out += static_cast<UTF16Char>(0xd800 + ((cp - 0x10000) >> 10));
+            out += static_cast<UTF16Char>(0xdc00 + ((cp - 0x10000) & 0x3ff));
+        }
+        else
+        {
+            out += static_cast<UTF16Char>(cp);
+        }
+    }
+
+    //UTF-8 to UTF-16, valid is cleared if anything had to be replaced
+    String16 Reference16(const std::string &in, bool &valid)
+    {
+        String16 out;
+        valid = true;
+        unsigned needed = 0, seen = 0;
+        uint32_t cp = 0;
+        unsigned lower = 0x80, upper = 0xbf;
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            const unsigned b = static_cast<unsigned char>(in[i]);
+            if (needed == 0)
+            {
+                if (b <= 0x7f)
+                {
+                    out += static_cast<UTF16Char>(b);
+                }
+                else if ((b >= 0xc2) && (b <= 0xdf))
+                {
+                    needed = 1;
+                    cp     = b & 0x1f;
+                }
+                else if ((b >= 0xe0) && (b <= 0xef))
+                {
+                    lower  = (b == 0xe0) ? 0xa0 : 0x80; //overlong
+                    upper  = (b == 0xed) ? 0x9f : 0xbf; //surrogates
+                    needed = 2;
+                    cp     = b & 0x0f;
+                }
+                else if ((b >= 0xf0) && (b <= 0xf4))
+                {
+                    lower  = (b == 0xf0) ? 0x90 : 0x80; //overlong
+                    upper  = (b == 0xf4) ? 0x8f : 0xbf; //above U+10FFFF
+                    needed = 3;
+                    cp     = b & 0x07;
+                }
+                else
+                {
+                    out += static_cast<UTF16Char>(0xfffd);
+                    valid = false;
+                }
+                continue;
+            }
+            if ((b < lower) || (b > upper))
+            {
+                //the sequence so far is one maximal subpart, b starts over
+                out += static_cast<UTF16Char>(0xfffd);
+                valid  = false;
+                needed = seen = 0;
+                lower  = 0x80;
+                upper  = 0xbf;
+                i--;
+                continue;
+            }
+            lower = 0x80;
+            upper = 0xbf;
+            cp    = (cp << 6) | (b & 0x3f);
+            if (++seen == needed)
+            {
+                Append16(out, cp);
+                needed = seen = 0;
+            }
+        }
+        if (needed != 0)
+        {
+            out += static_cast<UTF16Char>(0xfffd);
+            valid = false;
+        }
+        return out;
+    }
+
+    //UTF-16 to UTF-8, each unpaired surrogate becomes U+FFFD
+    std::string Reference8(const String16 &in, bool &valid)
+    {
+        std::string out;
+        valid = true;
+        for (size_t i = 0; i < in.size(); i++)
+        {
+            uint32_t cp = static_cast<uint16_t>(in[i]);
+            if ((cp >= 0xd800) && (cp < 0xdc00) && (i + 1 < in.size()) &&
+                (static_cast<uint16_t>(in[i + 1]) >= 0xdc00) && (static_cast<uint16_t>(in[i + 1]) < 0xe000))
+            {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (static_cast<uint16_t>(in[++i]) - 0xdc00);
+            }
+            else if ((cp >= 0xd800) && (cp < 0xe000))
+            {
+                cp    = 0xfffd;
+                valid = false;
+            }
+            if (cp < 0x80)
+            {
+                out += static_cast<char>(cp);
+            }
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xc0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xe0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                out += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+            else
+            {
+                out += static_cast<char>(0xf0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+                out += static_cast<char>(0x80 | (cp & 0x3f));
+            }
+        }
+        return out;
+    }
+
+    //every UTF-8 to UTF-16 entry point against the reference
+    bool Matches8(const std::string &in)
+    {
+        bool valid;
+        const String16 expected = Reference16(in, valid);
+        //the destination is exactly the documented worst case, one unit per byte
+        std::vector<UTF16Char> strict(in.size() + 1), replaced(in.size() + 1);
+        const size_t strictsize   = UTF::ToUTF16(in.data(), in.size(), strict.data());
+        const size_t replacedsize = UTF::ToUTF16(in.data(), in.size(), replaced.data(), true);
+        bool ok = (replacedsize == expected.size()) &&
+                  (String16(replaced.data(), replacedsize) == expected) &&
+                  (UTF::UTF16Length(in.data(), in.size(), true) == expected.size()) &&
+                  (UTF::Validate(in.data(), in.size()) == valid);
+        if (valid)
+        {
+            ok = ok && (strictsize == expected.size()) && (String16(strict.data(), strictsize) == expected) &&
+                 (UTF::UTF16Length(in.data(), in.size()) == expected.size());
+        }
+        else
+        {
+            ok = ok && (strictsize == UTF::invalid) && (UTF::UTF16Length(in.data(), in.size()) == UTF::invalid);
+        }
+        UTF16Buffer<16> buffer(in.data(), in.size());
+        ok = ok && (buffer.valid() == valid) && (String16(buffer.c_str(), buffer.size()) == expected) &&
+             (buffer.c_str()[buffer.size()] == 0);
+        if (!ok)
+        {
+            fprintf(stderr, "UTF-8 input of %zu bytes:", in.size());
+            for (char c : in)
+            {
+                fprintf(stderr, " %02x", static_cast<unsigned char>(c));
+            }
+            fprintf(stderr, "\n");
+        }
+        return ok;
+    }
+
+    //every UTF-16 to UTF-8 entry point against the reference
+    bool Matches16(const String16 &in)
+    {
+        bool valid;
+        const std::string expected = Reference8(in, valid);
+        //the destination is exactly UTF8Length
+        std::vector<char> replaced(UTF::UTF8Length(in.data(), in.size(), true) + 1);
+        const size_t replacedsize = UTF::ToUTF8(in.data(), in.size(), replaced.data(), true);
+        bool ok = (replaced.size() == expected.size() + 1) && (replacedsize == expected.size()) &&
+                  (std::string(replaced.data(), replacedsize) == expected);
+        const size_t strictlength = UTF::UTF8Length(in.data(), in.size());
+        if (valid)
+        {
+            std::vector<char> strict(expected.size() + 1);
+            const size_t strictsize = UTF::ToUTF8(in.data(), in.size(), strict.data());
+            ok = ok && (strictlength == expected.size()) && (strictsize == expected.size()) &&
+                 (std::string(strict.data(), strictsize) == expected);
+        }
+        else
+        {
+            ok = ok && (strictlength == UTF::invalid);
+        }
+        UTF8Buffer<16> buffer(in.data(), in.size());
+        ok = ok && (buffer.valid() == valid) && (std::string(buffer.c_str(), buffer.size()) == expected) &&
+             (buffer.c_str()[buffer.size()] == 0);
+        if (!ok)
+        {
+            fprintf(stderr, "UTF-16 input of %zu units:", in.size());
+            for (UTF16Char c : in)
+            {
+                fprintf(stderr, " %04x", static_cast<unsigned>(static_cast<uint16_t>(c)));
+            }
+            fprintf(stderr, "\n");
+        }
+        return ok;
+    }
+
+    String16 U16(std::initializer_list<uint16_t> units)
+    {
+        String16 s;
+        for (uint16_t unit : units)
+        {
+            s += static_cast<UTF16Char>(unit);
+        }
+        return s;
+    }
+}
+
+TEST(WellFormedText)
+{
+    const std::string text = "ASCII, \xc3\xa9t\xc3\xa9, \xe2\x82\xac, \xe4\xb8\xad\xe6\x96\x87, \xf0\x9f\x98\x80";
+    bool valid;
+    const String16 expected = U16({ 'A', 'S', 'C', 'I', 'I', ',', ' ', 0xe9, 't', 0xe9, ',', ' ', 0x20ac, ',', ' ',
+                                    0x4e2d, 0x6587, ',', ' ', 0xd83d, 0xde00 });
+    CHECK(Reference16(text, valid) == expected);
+    CHECK(valid);
+    CHECK(Matches8(text));
+    CHECK(Matches16(expected));
+    //boundaries of each sequence length
+    CHECK(Matches8(std::string("\x7f\xc2\x80\xdf\xbf\xe0\xa0\x80\xef\xbf\xbf\xf0\x90\x80\x80\xf4\x8f\xbf\xbf")));
+    CHECK(Matches8(std::string("")));
+    CHECK(Matches16(String16()));
+    CHECK(Matches8(std::string("a\0b", 3))); //embedded nulls are converted, not terminators
+}
+
+TEST(IllFormedUTF8)
+{
+    bool valid;
+    //the example from the Unicode standard (U+FFFD substitution of maximal subparts)
+    const std::string example = "\x61\xf1\x80\x80\xe1\x80\xc2\x62\x80\x63\x80\xbf\x64";
+    CHECK(Reference16(example, valid) == U16({ 'a', 0xfffd, 0xfffd, 0xfffd, 'b', 0xfffd, 'c', 0xfffd, 0xfffd, 'd' }));
+    CHECK(!valid);
+    CHECK(Matches8(example));
+    CHECK(Matches8("\xc0\xaf"));             //overlong /
+    CHECK(Matches8("\xe0\x80\xaf"));         //overlong 3 byte
+    CHECK(Matches8("\xf0\x80\x80\xaf"));     //overlong 4 byte
+    CHECK(Matches8("\xed\xa0\x80"));         //encoded surrogate
+    CHECK(Matches8("\xf4\x90\x80\x80"));     //above U+10FFFF
+    CHECK(Matches8("\xf5\x80\x80\x80"));
+    CHECK(Matches8("\xff\xfe"));
+    CHECK(Matches8("abc\xe2\x82"));          //truncated at the end
+    CHECK(Matches8("\xe2\x82" "abcdefghijklmnopqrstuvwxyz"));
+    CHECK(Matches8("\x80\x80\x80"));         //lone continuations
+}
+
+TEST(UnpairedSurrogates)
+{
+    CHECK(Matches16(U16({ 0xd800 })));
+    CHECK(Matches16(U16({ 0xdc00, 'a' })));
+    CHECK(Matches16(U16({ 'a', 0xd83d })));
+    CHECK(Matches16(U16({ 0xd83d, 0xd83d, 0xde00 })));
+    CHECK(Matches16(U16({ 0xde00, 0xd83d })));
+    bool valid;
+    CHECK(Reference8(U16({ 'x', 0xd800, 'y' }), valid) == "x\xef\xbf\xbdy");
+    CHECK(!valid);
+}
+
+TEST(LongRunsAtEveryOffset)
+{
+    //the vector loops stop at the first non-ASCII unit whatever its position in the block
+    for (size_t run = 0; run < 70; run++)
+    {
+        const std::string ascii(run, 'x');
+        CHECK(Matches8(ascii));
+        CHECK(Matches8(ascii + "\xc3\xa9" + ascii));
+        CHECK(Matches8(ascii + "\xe2\x82" + ascii));
+        CHECK(Matches8(ascii + "\xf0\x9f\x98\x80"));
+        String16 wide(run, static_cast<UTF16Char>('y'));
+        CHECK(Matches16(wide));
+        CHECK(Matches16(wide + U16({ 0xe9 }) + wide));
+        CHECK(Matches16(wide + U16({ 0xd800 }) + wide));
+        CHECK(Matches16(wide + U16({ 0x80 }) + wide));
+    }
+}
+
+TEST(RandomUTF8)
+{
+    std::mt19937 rng(20180707);
+    //pieces biased towards the boundaries the decoder checks
+    const char *const pieces[] = { "a", "Z", " ", "\x7f", "\xc2\x80", "\xdf\xbf", "\xc3\xa9", "\xe0\xa0\x80",
+                                   "\xed\x9f\xbf", "\xee\x80\x80", "\xef\xbf\xbf", "\xf0\x90\x80\x80",
+                                   "\xf4\x8f\xbf\xbf", "\xf0\x9f\x98\x80", "\x80", "\xbf", "\xc0", "\xc1",
+                                   "\xe0", "\xed", "\xf0", "\xf4", "\xf5", "\xff", "\xe0\x9f", "\xed\xa0",
+                                   "\xf0\x8f", "\xf4\x90", "abcdefghijklmnopq" };
+    unsigned long failed = 0;
+    for (int iteration = 0; (iteration < 100000) && (failed < 10); iteration++)
+    {
+        std::string in;
+        const size_t count = rng() % 24;
+        for (size_t i = 0; i < count; i++)
+        {
+            if ((rng() % 8) == 0)
+            {
+                in += static_cast<char>(rng());
+            }
+            else
+            {
+                in += pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))];
+            }
+        }
+        if (!CHECK(Matches8(in)))
+        {
+            failed++;
+        }
+    }
+}
+
+TEST(RandomUTF16)
+{
+    std::mt19937 rng(20180708);
+    const uint16_t units[] = { 'a', ' ', 0x7f, 0x80, 0x7ff, 0x800, 0xe9, 0x20ac, 0xd7ff, 0xd800, 0xdbff,
+                               0xdc00, 0xdfff, 0xe000, 0xfffd, 0xffff };
+    unsigned long failed = 0;
+    for (int iteration = 0; (iteration < 100000) && (failed < 10); iteration++)
+    {
+        String16 in;
+        const size_t count = rng() % 48;
+        for (size_t i = 0; i < count; i++)
+        {
+            switch (rng() % 4)
+            {
+            case 0:  in += static_cast<UTF16Char>(rng()); break;
+            case 1:  in += String16(rng() % 20, static_cast<UTF16Char>('q')); break;
+            default: in += static_cast<UTF16Char>(units[rng() % (sizeof(units) / sizeof(units[0]))]); break;
+            }
+        }
+        if (!CHECK(Matches16(in)))
+        {
+            failed++;
+        }
+    }
+}
+
+TEST(RoundTrip)
+{
+    //every scalar value survives UTF-16 -> UTF-8 -> UTF-16
+    String16 all;
+    for (uint32_t cp = 0; cp < 0x110000; cp++)
+    {
+        if ((cp < 0xd800) || (cp >= 0xe000))
+        {
+            Append16(all, cp);
+        }
+    }
+    const size_t bytes = UTF::UTF8Length(all.data(), all.size());
+    REQUIRE(bytes != UTF::invalid);
+    std::vector<char> utf8(bytes);
+    CHECK_EQ(UTF::ToUTF8(all.data(), all.size(), utf8.data()), bytes);
+    std::vector<UTF16Char> back(bytes);
+    const size_t units = UTF::ToUTF16(utf8.data(), bytes, back.data());
+    CHECK_EQ(units, all.size());
+    CHECK(String16(back.data(), units) == all);
+}
+
+TEST(BuffersAllocateOnlyWhenLong)
+{
+    const WUIF::AllocStats::Snapshot before = WUIF::AllocStats::Take();
+    {
+        UTF16Buffer<16> shortcopy("short");
+        UTF8Buffer<16> shortcopy8(shortcopy.c_str());
+        CHECK_EQ(shortcopy8.size(), 5);
+        CHECK(!WUIF::AllocStats::Diff(before, WUIF::AllocStats::Take()).Allocated());
+        UTF16Buffer<16> longcopy("a string that does not fit in sixteen units");
+        CHECK_EQ(WUIF::AllocStats::Diff(before, WUIF::AllocStats::Take())[WUIF::AllocTag::App].blocks, 1);
+        CHECK_EQ(UTF::Length(longcopy.c_str()), longcopy.size());
+    }
+    CHECK_EQ(WUIF::AllocStats::Diff(before, WUIF::AllocStats::Take())[WUIF::AllocTag::App].blocks, 0);
+    UTF16Buffer<> null(static_cast<const char*>(nullptr));
+    CHECK_EQ(null.size(), 0);
+    CHECK(null.valid());
+}
@@ -0,0 +1,23 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+
+//stand-in for Window/Window.h - see Tests/Win32/stdafx.h
+namespace WUIF {
+    class Window
+    {
+    public:
+        static LRESULT CALLBACK T_SC_WindowProc(_In_ HWND, _In_ UINT, _In_ WPARAM, _In_ LPARAM) { return 0; }
+    };
+}
@@ -0,0 +1,107 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "stdafx.h"
+
+/*Stand-in for <Windows.h>, for headers that include it themselves (Utils/CommandLineToArgvA.h and
+the old version CommandLineSplitTest compares it with). Adds the process heap and GetModuleFileName
+to the fakes in stdafx.h. The heap is malloc - HEAP_GENERATE_EXCEPTIONS throws std::bad_alloc and a
+realloc in place keeps the block as it is.*/
+#define MAX_PATH                   260
+#define ERROR_INVALID_PARAMETER    87L
+#define HEAP_GENERATE_EXCEPTIONS   0x00000004
+#define HEAP_ZERO_MEMORY           0x00000008
+#define HEAP_REALLOC_IN_PLACE_ONLY 0x00000010
+
+typedef char        CHAR;
+typedef char       *LPSTR;
+typedef const char *LPCSTR;
+#if defined(_WIN32)
+typedef wchar_t     WCHAR;
+#else
+typedef char16_t    WCHAR; //as WUIF::UTF16Char
+#endif
+typedef const WCHAR *LPCWSTR;
+typedef void       *HANDLE;
+typedef void       *LPVOID;
+typedef size_t      SIZE_T;
+typedef HINSTANCE   HMODULE;
+
+namespace Fake {
+
+    //bytes added to every HeapAlloc block, for code known to write past what it asked for
+    inline size_t& HeapSlack()
+    {
+        static size_t slack = 0;
+        return slack;
+    }
+
+    //what GetModuleFileName returns
+    const char modulename[] = "C:\\WUIF\\Tests\\Test.exe";
+}
+
+inline HANDLE GetProcessHeap() { return reinterpret_cast<HANDLE>(static_cast<uintptr_t>(1)); }
+
+inline LPVOID HeapAlloc(HANDLE, DWORD flags, SIZE_T bytes)
+{
+    bytes += Fake::HeapSlack();
+    void *block = (flags & HEAP_ZERO_MEMORY) ? calloc(1, bytes) : malloc(bytes);
+    if ((block == nullptr) && (flags & HEAP_GENERATE_EXCEPTIONS))
+    {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+inline LPVOID HeapReAlloc(HANDLE, DWORD flags, LPVOID block, SIZE_T)
+{
+    return (flags & HEAP_REALLOC_IN_PLACE_ONLY) ? block : nullptr;
+}
+
+inline BOOL HeapFree(HANDLE, DWORD, LPVOID block)
+{
+    free(block);
+    return 1;
+}
+
+inline DWORD GetModuleFileNameA(HMODULE, LPSTR name, DWORD size)
+{
+    const DWORD length = static_cast<DWORD>(sizeof(Fake::modulename) - 1);
+    if (size <= length)
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return 0;
+    }
+    memcpy(name, Fake::modulename, length + 1);
+    return length;
+}
+
+inline DWORD GetModuleFileNameW(HMODULE, WCHAR *name, DWORD size)
+{
+    const DWORD length = static_cast<DWORD>(sizeof(Fake::modulename) - 1);
+    if (size <= length)
+    {
+        SetLastError(ERROR_INSUFFICIENT_BUFFER);
+        return 0;
+    }
+    for (DWORD i = 0; i <= length; i++)
+    {
+        name[i] = static_cast<WCHAR>(Fake::modulename[i]);
+    }
+    return length;
+}
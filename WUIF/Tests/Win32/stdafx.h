@@ -0,0 +1,161 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+#pragma once
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include "Utils/AllocTag.h"
+#include "Utils/MulDivArray.h"
+
+/*Stand-in for the framework's stdafx.h, so sources that use only a few Win32 functions
+(WindowClassCache.cpp, DPICache.cpp) can be built into tests and benchmarks on any platform. Only
+what those sources use is declared. The functions are fakes that keep their state in Fake::, and
+tests inspect and steer that state. The headers next to this one stand in for
+Application/Application.h and Window/Window.h.*/
+#define CRT_NEW new
+#define _In_
+#define _Out_
+#define CALLBACK
+#define TEXT(s)       s
+#define ARRAYSIZE(a)  (sizeof(a) / sizeof((a)[0]))
+#define FAILED(hr)    ((hr) < 0)
+#define MAKEINTATOM(atom) reinterpret_cast<LPCTSTR>(static_cast<uintptr_t>(static_cast<ATOM>(atom)))
+#define COLOR_WINDOW  5
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_CLASS_HAS_WINDOWS   1412L
+#define ERROR_CLASS_ALREADY_EXISTS 1410L
+
+typedef int           BOOL;
+typedef unsigned int  UINT;
+typedef uint16_t      ATOM;
+typedef unsigned long DWORD;
+typedef long          HRESULT;
+typedef char          TCHAR;
+typedef const char   *LPCTSTR;
+typedef intptr_t      LRESULT;
+typedef intptr_t      LPARAM;
+typedef uintptr_t     WPARAM;
+#define WUIF_FAKE_HANDLE(name) struct name##__ { int unused; }; typedef name##__ *name;
+WUIF_FAKE_HANDLE(HINSTANCE)
+WUIF_FAKE_HANDLE(HICON)
+WUIF_FAKE_HANDLE(HCURSOR)
+WUIF_FAKE_HANDLE(HBRUSH)
+WUIF_FAKE_HANDLE(HWND)
+WUIF_FAKE_HANDLE(HMONITOR)
+#undef WUIF_FAKE_HANDLE
+typedef LRESULT (CALLBACK *WNDPROC)(HWND, UINT, WPARAM, LPARAM);
+
+struct WNDCLASSEX
+{
+    UINT      cbSize;
+    UINT      style;
+    WNDPROC   lpfnWndProc;
+    int       cbClsExtra;
+    int       cbWndExtra;
+    HINSTANCE hInstance;
+    HICON     hIcon;
+    HCURSOR   hCursor;
+    HBRUSH    hbrBackground;
+    LPCTSTR   lpszMenuName;
+    LPCTSTR   lpszClassName;
+    HICON     hIconSm;
+};
+
+namespace Fake {
+
+    //a class registered with RegisterClassEx
+    struct Class
+    {
+        std::string name;
+        WNDCLASSEX  wndclass;
+        unsigned    windows; //windows using the class - UnregisterClass fails while not 0
+    };
+
+    struct State
+    {
+        std::mutex             lock;
+        std::map<ATOM, Class>  classes;
+        ATOM                   nextatom     = 0xC000;
+        bool                   failregister = false; //RegisterClassEx fails with ERROR_CLASS_ALREADY_EXISTS
+        unsigned long          registercalls   = 0;
+        unsigned long          unregistercalls = 0;
+    };
+
+    inline State& Get()
+    {
+        static State state;
+        return state;
+    }
+
+    inline DWORD& LastError()
+    {
+        static thread_local DWORD error = 0;
+        return error;
+    }
+}
+
+inline void  SetLastError(DWORD error) { Fake::LastError() = error; }
+inline DWORD GetLastError()            { return Fake::LastError(); }
+
+inline ATOM RegisterClassEx(const WNDCLASSEX *wndclass)
+{
+    Fake::State &state = Fake::Get();
+    std::lock_guard<std::mutex> guard(state.lock);
+    state.registercalls++;
+    if (state.failregister)
+    {
+        SetLastError(ERROR_CLASS_ALREADY_EXISTS);
+        return 0;
+    }
+    const ATOM atom = state.nextatom++;
+    state.classes[atom] = { wndclass->lpszClassName, *wndclass, 0 };
+    state.classes[atom].wndclass.lpszClassName = nullptr; //the caller's buffer, the copy is in name
+    return atom;
+}
+
+inline BOOL UnregisterClass(LPCTSTR name, HINSTANCE)
+{
+    Fake::State &state = Fake::Get();
+    std::lock_guard<std::mutex> guard(state.lock);
+    state.unregistercalls++;
+    auto it = state.classes.find(static_cast<ATOM>(reinterpret_cast<uintptr_t>(name)));
+    if (it == state.classes.end())
+    {
+        return 0;
+    }
+    if (it->second.windows != 0)
+    {
+        SetLastError(ERROR_CLASS_HAS_WINDOWS);
+        return 0;
+    }
+    state.classes.erase(it);
+    return 1;
+}
+
+inline HRESULT StringCchPrintf(TCHAR *dest, size_t size, const TCHAR *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    const int written = vsnprintf(dest, size, format, args);
+    va_end(args);
+    return ((written >= 0) && (static_cast<size_t>(written) < size)) ? 0 : static_cast<HRESULT>(0x8007007AL);
+}
+
+inline int MulDiv(int number, int numerator, int denominator)
+{
+    return WUIF::MulDivRound(number, numerator, denominator);
+}
@@ -0,0 +1,226 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*WindowClassCache (Source/Window/WindowClassCache.cpp) built against the fake Win32 functions in
+Tests/Win32 - sharing, reference counting, classes that still have windows when released and
+Detach. The cache is process wide, so every case uses its own handles and compares statistics
+before and after.*/
+#include <string>
+#include <thread>
+#include <vector>
+#include "stdafx.h"
+#include "Window/Window.h"
+#include "Window/WindowClassCache.h"
+#include "Test.h"
+
+using WUIF::WindowClassCache;
+
+namespace WUIF {
+    namespace App {
+        extern const volatile HINSTANCE hInstance = reinterpret_cast<HINSTANCE>(static_cast<uintptr_t>(0x400000));
+    }
+}
+
+namespace
+{
+    template <class Handle>
+    Handle MakeHandle(uintptr_t value) { return reinterpret_cast<Handle>(value * 16); }
+
+    bool Registered(ATOM atom)
+    {
+        std::lock_guard<std::mutex> guard(Fake::Get().lock);
+        return (Fake::Get().classes.count(atom) != 0);
+    }
+
+    void SetWindows(ATOM atom, unsigned windows)
+    {
+        std::lock_guard<std::mutex> guard(Fake::Get().lock);
+        Fake::Get().classes[atom].windows = windows;
+    }
+
+    Fake::Class ClassOf(ATOM atom)
+    {
+        std::lock_guard<std::mutex> guard(Fake::Get().lock);
+        return Fake::Get().classes[atom];
+    }
+}
+
+TEST(SameAttributesShareOneClass)
+{
+    const HICON   icon   = MakeHandle<HICON>(1);
+    const HICON   iconsm = MakeHandle<HICON>(2);
+    const HCURSOR cursor = MakeHandle<HCURSOR>(3);
+    const WindowClassCache::Statistics before = WindowClassCache::GetStatistics();
+    const ATOM first  = WindowClassCache::Acquire(icon, iconsm, cursor, 0x20);
+    const ATOM second = WindowClassCache::Acquire(icon, iconsm, cursor, 0x20);
+    REQUIRE(first != 0);
+    CHECK_EQ(first, second);
+    const WindowClassCache::Statistics after = WindowClassCache::GetStatistics();
+    CHECK_EQ(after.registered - before.registered, 1);
+    CHECK_EQ(after.shared - before.shared, 1);
+    CHECK_EQ(after.live - before.live, 1);
+    //the class is registered with the requested attributes and the shared WndProc
+    const Fake::Class registered = ClassOf(first);
+    CHECK(registered.wndclass.hIcon == icon);
+    CHECK(registered.wndclass.hIconSm == iconsm);
+    CHECK(registered.wndclass.hCursor == cursor);
+    CHECK_EQ(registered.wndclass.style, 0x20);
+    CHECK(registered.wndclass.lpfnWndProc == &WUIF::Window::T_SC_WindowProc);
+    CHECK(registered.wndclass.hInstance == WUIF::App::hInstance);
+    CHECK(registered.name.compare(0, 4, "WUIF") == 0);
+    WindowClassCache::Release(first);
+    CHECK(Registered(first));
+    WindowClassCache::Release(second);
+    CHECK(!Registered(first));
+    CHECK_EQ(WindowClassCache::GetStatistics().unregistered - before.unregistered, 1);
+    CHECK_EQ(WindowClassCache::GetStatistics().live, before.live);
+}
+
+TEST(EachAttributeSelectsAClass)
+{
+    const HICON   icon   = MakeHandle<HICON>(11);
+    const HICON   iconsm = MakeHandle<HICON>(12);
+    const HCURSOR cursor = MakeHandle<HCURSOR>(13);
+    std::vector<ATOM> atoms;
+    atoms.push_back(WindowClassCache::Acquire(icon, iconsm, cursor, 0));
+    atoms.push_back(WindowClassCache::Acquire(MakeHandle<HICON>(14), iconsm, cursor, 0));
+    atoms.push_back(WindowClassCache::Acquire(icon, MakeHandle<HICON>(14), cursor, 0));
+    atoms.push_back(WindowClassCache::Acquire(icon, iconsm, MakeHandle<HCURSOR>(14), 0));
+    atoms.push_back(WindowClassCache::Acquire(icon, iconsm, cursor, 0x8));
+    std::vector<std::string> names;
+    for (size_t i = 0; i < atoms.size(); i++)
+    {
+        CHECK(atoms[i] != 0);
+        names.push_back(ClassOf(atoms[i]).name);
+        for (size_t j = 0; j < i; j++)
+        {
+            CHECK(atoms[i] != atoms[j]);
+            CHECK(names[i] != names[j]);
+        }
+    }
+    for (ATOM atom : atoms)
+    {
+        WindowClassCache::Release(atom);
+        CHECK(!Registered(atom));
+    }
+}
+
+TEST(ClassWithWindowsStaysRegisteredUntilUnused)
+{
+    /*the last Release normally comes from ~Window during WM_NCDESTROY while the window still
+    exists - UnregisterClass fails, the class is kept and can be shared again*/
+    const HICON icon = MakeHandle<HICON>(21);
+    const WindowClassCache::Statistics before = WindowClassCache::GetStatistics();
+    const ATOM atom = WindowClassCache::Acquire(icon, nullptr, nullptr, 0);
+    REQUIRE(atom != 0);
+    SetWindows(atom, 1);
+    WindowClassCache::Release(atom);
+    CHECK(Registered(atom));
+    CHECK_EQ(WindowClassCache::GetStatistics().live - before.live, 1);
+    //shared again without registering
+    CHECK_EQ(WindowClassCache::Acquire(icon, nullptr, nullptr, 0), atom);
+    CHECK_EQ(WindowClassCache::GetStatistics().registered - before.registered, 1);
+    WindowClassCache::Release(atom);
+    CHECK(Registered(atom));
+    //the window is gone - the next Acquire of any class sweeps it
+    SetWindows(atom, 0);
+    const ATOM other = WindowClassCache::Acquire(MakeHandle<HICON>(22), nullptr, nullptr, 0);
+    CHECK(!Registered(atom));
+    CHECK_EQ(WindowClassCache::GetStatistics().unregistered - before.unregistered, 1);
+    WindowClassCache::Release(other);
+    CHECK_EQ(WindowClassCache::GetStatistics().live, before.live);
+}
+
+TEST(DetachedClassIsNotShared)
+{
+    const HCURSOR cursor = MakeHandle<HCURSOR>(31);
+    const ATOM atom = WindowClassCache::Acquire(nullptr, nullptr, cursor, 0);
+    REQUIRE(atom != 0);
+    //the class cursor is about to change - windows created afterwards get their own class
+    WindowClassCache::Detach(atom);
+    const ATOM fresh = WindowClassCache::Acquire(nullptr, nullptr, cursor, 0);
+    CHECK(fresh != atom);
+    //releasing the detached class must not drop the new class from the lookup
+    WindowClassCache::Release(atom);
+    CHECK(!Registered(atom));
+    CHECK_EQ(WindowClassCache::Acquire(nullptr, nullptr, cursor, 0), fresh);
+    WindowClassCache::Release(fresh);
+    WindowClassCache::Release(fresh);
+    CHECK(!Registered(fresh));
+    //detaching twice or an unknown atom is harmless
+    WindowClassCache::Detach(atom);
+    WindowClassCache::Detach(0x1234);
+}
+
+TEST(FailedRegistration)
+{
+    const WindowClassCache::Statistics before = WindowClassCache::GetStatistics();
+    {
+        std::lock_guard<std::mutex> guard(Fake::Get().lock);
+        Fake::Get().failregister = true;
+    }
+    SetLastError(0);
+    CHECK_EQ(WindowClassCache::Acquire(MakeHandle<HICON>(41), nullptr, nullptr, 0), 0);
+    CHECK_EQ(GetLastError(), ERROR_CLASS_ALREADY_EXISTS);
+    {
+        std::lock_guard<std::mutex> guard(Fake::Get().lock);
+        Fake::Get().failregister = false;
+    }
+    const WindowClassCache::Statistics after = WindowClassCache::GetStatistics();
+    CHECK_EQ(after.registered, before.registered);
+    CHECK_EQ(after.live, before.live);
+    //the failure isn't cached
+    const ATOM atom = WindowClassCache::Acquire(MakeHandle<HICON>(41), nullptr, nullptr, 0);
+    CHECK(atom != 0);
+    WindowClassCache::Release(atom);
+}
+
+TEST(UnknownAtomsAreIgnored)
+{
+    const WindowClassCache::Statistics before = WindowClassCache::GetStatistics();
+    WindowClassCache::Release(0);
+    WindowClassCache::Release(0x1234);
+    const ATOM atom = WindowClassCache::Acquire(MakeHandle<HICON>(51), nullptr, nullptr, 0);
+    WindowClassCache::Release(atom);
+    WindowClassCache::Release(atom); //one more than acquired
+    const WindowClassCache::Statistics after = WindowClassCache::GetStatistics();
+    CHECK_EQ(after.unregistered - before.unregistered, 1);
+    CHECK_EQ(after.live, before.live);
+}
+
+TEST(ConcurrentAcquireAndRelease)
+{
+    const WindowClassCache::Statistics before = WindowClassCache::GetStatistics();
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; t++)
+    {
+        threads.emplace_back([]()
+        {
+            for (unsigned i = 0; i < 2000; i++)
+            {
+                //four attribute sets shared between the threads
+                const ATOM atom = WindowClassCache::Acquire(MakeHandle<HICON>(60 + (i & 3)), nullptr, nullptr, 0);
+                CHECK(atom != 0);
+                WindowClassCache::Release(atom);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    const WindowClassCache::Statistics after = WindowClassCache::GetStatistics();
+    CHECK_EQ(after.live, before.live);
+    CHECK_EQ(after.registered - before.registered, after.unregistered - before.unregistered);
+    CHECK_EQ((after.registered - before.registered) + (after.shared - before.shared), 8000);
+}
@@ -0,0 +1,226 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*WindowUpdate::Apply (Headers/Window/WindowUpdate.h) with a sink that records its calls instead
+of calling Win32*/
+#include <string>
+#include <vector>
+#include "Window/WindowUpdate.h"
+#include "Test.h"
+
+using WUIF::WindowUpdate;
+
+namespace
+{
+    struct RecordingSink
+    {
+        std::vector<std::string> calls;
+        WindowUpdate::Position   position;
+        unsigned long            styleerror = 0; //returned by SetStyle
+        unsigned long            poserror   = 0; //returned by SetPosition
+
+        unsigned long SetStyle(uint32_t)            { calls.push_back("style");   return styleerror; }
+        unsigned long SetExStyle(uint32_t)          { calls.push_back("exstyle"); return 0; }
+        unsigned long SetCursor(void*)              { calls.push_back("cursor");  return 0; }
+        unsigned long SetIcon(bool big, void*)      { calls.push_back(big ? "icon" : "iconsm"); return 0; }
+        unsigned long SetPosition(const WindowUpdate::Position &pos)
+        {
+            calls.push_back("position");
+            position = pos;
+            return poserror;
+        }
+    };
+
+    int icon1, icon2, cursor1, cursor2; //addresses stand in for handles
+
+    WindowUpdate::State Current()
+    {
+        WindowUpdate::State state;
+        state.style   = 0x10cf0000;
+        state.exstyle = 0x100;
+        state.left    = 10;
+        state.top     = 20;
+        state.width   = 800;
+        state.height  = 600;
+        state.icon    = &icon1;
+        state.iconsm  = &icon1;
+        state.cursor  = &cursor1;
+        return state;
+    }
+
+    typedef std::vector<std::string> Calls;
+}
+
+TEST(EmptyUpdateMakesNoCalls)
+{
+    WindowUpdate update;
+    CHECK(update.empty());
+    RecordingSink sink;
+    const WindowUpdate::Result res = update.Apply(Current(), sink);
+    CHECK(sink.calls.empty());
+    CHECK_EQ(res.calls, 0);
+    CHECK_EQ(res.applied, 0);
+    CHECK_EQ(res.error, 0);
+}
+
+TEST(MoveAndSizeCollapseIntoOneSetWindowPos)
+{
+    WindowUpdate update;
+    update.left(30);
+    update.top(40);
+    update.width(1024);
+    update.height(768);
+    update.left(50); //the last value wins
+    RecordingSink sink;
+    const WindowUpdate::Result res = update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "position" }));
+    CHECK_EQ(res.calls, 1);
+    CHECK_EQ(res.applied, WindowUpdate::LEFT | WindowUpdate::TOP | WindowUpdate::WIDTH | WindowUpdate::HEIGHT);
+    CHECK_EQ(sink.position.x, 50);
+    CHECK_EQ(sink.position.y, 40);
+    CHECK_EQ(sink.position.cx, 1024);
+    CHECK_EQ(sink.position.cy, 768);
+    CHECK(sink.position.move && sink.position.size);
+    CHECK(!sink.position.zorder && !sink.position.framechanged && !sink.position.show);
+}
+
+TEST(OnlyChangedCoordinatesAreTaken)
+{
+    WindowUpdate update;
+    update.width(900);
+    RecordingSink sink;
+    update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "position" }));
+    CHECK_EQ(sink.position.x, 10);
+    CHECK_EQ(sink.position.y, 20);
+    CHECK_EQ(sink.position.cx, 900);
+    CHECK_EQ(sink.position.cy, 600);
+    CHECK(!sink.position.move && sink.position.size);
+}
+
+TEST(UnchangedValuesAreDropped)
+{
+    const WindowUpdate::State current = Current();
+    WindowUpdate update;
+    update.left(current.left);
+    update.top(current.top);
+    update.width(current.width);
+    update.style(current.style);
+    update.exstyle(current.exstyle);
+    update.icon(current.icon);
+    update.iconsm(current.iconsm);
+    update.cursor(current.cursor);
+    RecordingSink sink;
+    const WindowUpdate::Result res = update.Apply(current, sink);
+    CHECK(sink.calls.empty());
+    CHECK_EQ(res.calls, 0);
+    CHECK_EQ(res.applied, update.changed());
+}
+
+TEST(StylesComeFirstAndSetFrameChanged)
+{
+    WindowUpdate update;
+    update.left(0);
+    update.style(0x16cf0000);
+    update.exstyle(0x300);
+    RecordingSink sink;
+    const WindowUpdate::Result res = update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "style", "exstyle", "position" }));
+    CHECK(sink.position.framechanged);
+    CHECK(sink.position.move && !sink.position.size);
+    CHECK_EQ(res.applied, WindowUpdate::LEFT | WindowUpdate::STYLE | WindowUpdate::EXSTYLE);
+}
+
+TEST(StyleAloneStillCallsSetWindowPos)
+{
+    //cached style data only takes effect with SWP_FRAMECHANGED
+    WindowUpdate update;
+    update.style(0x16cf0000);
+    RecordingSink sink;
+    update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "style", "position" }));
+    CHECK(sink.position.framechanged && !sink.position.move && !sink.position.size);
+}
+
+TEST(SmallIconBeforeBigIcon)
+{
+    WindowUpdate update;
+    update.icon(&icon2);
+    update.iconsm(&icon2);
+    RecordingSink sink;
+    const WindowUpdate::Result res = update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "iconsm", "icon" }));
+    CHECK_EQ(res.applied, WindowUpdate::ICON | WindowUpdate::ICONSM);
+}
+
+TEST(CursorRefreshesThePosition)
+{
+    WindowUpdate update;
+    update.cursor(&cursor2);
+    RecordingSink sink;
+    update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "cursor", "position" }));
+    CHECK(!sink.position.move && !sink.position.size && !sink.position.framechanged);
+}
+
+TEST(ZOrderShowAndRefresh)
+{
+    int after;
+    WindowUpdate update;
+    update.zorder(&after);
+    update.show();
+    RecordingSink sink;
+    WindowUpdate::Result res = update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "position" }));
+    CHECK(sink.position.zorder && sink.position.show);
+    CHECK(sink.position.insertafter == &after);
+    CHECK_EQ(res.applied, WindowUpdate::ZORDER | WindowUpdate::SHOW);
+
+    WindowUpdate refresh;
+    refresh.refresh();
+    RecordingSink refreshsink;
+    res = refresh.Apply(Current(), refreshsink);
+    CHECK(refreshsink.calls == Calls({ "position" }));
+    CHECK_EQ(res.applied, WindowUpdate::REFRESH);
+}
+
+TEST(FailuresAreReportedAndDoNotStopOtherCalls)
+{
+    WindowUpdate update;
+    update.style(0x16cf0000);
+    update.exstyle(0x300);
+    update.width(1000);
+    RecordingSink sink;
+    sink.styleerror = 5;  //ERROR_ACCESS_DENIED
+    sink.poserror   = 87; //ERROR_INVALID_PARAMETER
+    const WindowUpdate::Result res = update.Apply(Current(), sink);
+    CHECK(sink.calls == Calls({ "style", "exstyle", "position" }));
+    CHECK_EQ(res.calls, 3);
+    CHECK_EQ(res.error, 5); //the first error
+    CHECK_EQ(res.applied, WindowUpdate::EXSTYLE);
+    //only the exstyle call succeeded, it alone sets SWP_FRAMECHANGED
+    CHECK(sink.position.framechanged);
+}
+
+TEST(ClearDropsPendingChanges)
+{
+    int after;
+    WindowUpdate update;
+    update.width(1);
+    update.zorder(&after);
+    update.clear();
+    CHECK(update.empty());
+    RecordingSink sink;
+    update.Apply(Current(), sink);
+    CHECK(sink.calls.empty());
+}
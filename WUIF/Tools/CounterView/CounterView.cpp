@@ -0,0 +1,261 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*CounterView - prints the performance counters of running WUIF processes (see
+Headers/Utils/CounterRegistry.h and Headers/Application/PerfCounters.h)
+
+    CounterView [-i seconds] [-n samples] [-csv] [pid ...]
+
+Without pids every process that publishes counters is shown. Without -i the counters are printed
+once; with -i they are printed every interval (forever, or -n times) and COUNTERs get a per second
+rate over the interval. Processes that start while CounterView runs are picked up, processes that
+exit are reported once and dropped. -csv writes time,pid,name,kind,value,rate lines.*/
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <tlhelp32.h>
+#else
+    #include <dirent.h>
+    #include <signal.h>
+#endif
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../../Headers/Utils/CounterRegistry.h"
+
+using WUIF::CounterReader;
+using WUIF::CounterRegistry;
+
+namespace
+{
+    //a counter's value at the previous sample
+    struct Previous
+    {
+        int64_t value;
+        double  time;
+    };
+
+    //pids of every process with a counter segment
+    std::vector<uint64_t> Enumerate()
+    {
+        std::vector<uint64_t> pids;
+        #if defined(_WIN32)
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+        if (snapshot == INVALID_HANDLE_VALUE)
+        {
+            return pids;
+        }
+        PROCESSENTRY32 entry;
+        entry.dwSize = sizeof(entry);
+        for (BOOL more = Process32First(snapshot, &entry); more; more = Process32Next(snapshot, &entry))
+        {
+            char name[64];
+            CounterRegistry::SegmentName(name, entry.th32ProcessID);
+            HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+            if (mapping != NULL)
+            {
+                CloseHandle(mapping);
+                pids.push_back(entry.th32ProcessID);
+            }
+        }
+        CloseHandle(snapshot);
+        #else
+        //shm_open names live in /dev/shm without the leading '/'
+        DIR *dir = opendir("/dev/shm");
+        if (dir == nullptr)
+        {
+            return pids;
+        }
+        static const char prefix[] = "WUIF.Counters.";
+        while (dirent *entry = readdir(dir))
+        {
+            if (strncmp(entry->d_name, prefix, sizeof(prefix) - 1) == 0)
+            {
+                char *end = nullptr;
+                const unsigned long long pid = strtoull(entry->d_name + sizeof(prefix) - 1, &end, 10);
+                if ((end != nullptr) && (*end == '\0'))
+                {
+                    pids.push_back(pid);
+                }
+            }
+        }
+        closedir(dir);
+        #endif
+        return pids;
+    }
+
+    //false if the process is gone - a crashed process can leave its segment behind on POSIX systems
+    bool Alive(uint64_t pid)
+    {
+        #if defined(_WIN32)
+        (void)pid;
+        return true; //the segment disappears with the process
+        #else
+        return ((kill(static_cast<pid_t>(pid), 0) == 0) || (errno == EPERM));
+        #endif
+    }
+
+    const char* KindName(CounterRegistry::Kind kind)
+    {
+        switch (kind)
+        {
+        case CounterRegistry::COUNTER: return "counter";
+        case CounterRegistry::GAUGE:   return "gauge";
+        default:                       return "?";
+        }
+    }
+
+    //prints one process's counters, returns false if it has none (exited)
+    bool Print(uint64_t pid, double now, bool csv, std::map<std::pair<uint64_t, std::string>, Previous> &previous)
+    {
+        CounterReader reader;
+        const CounterReader::Status status = reader.Open(pid);
+        if ((status == CounterReader::OPENED) && !Alive(pid))
+        {
+            reader.Close();
+            return false;
+        }
+        if (status != CounterReader::OPENED)
+        {
+            if (status == CounterReader::INCOMPATIBLE)
+            {
+                fprintf(stderr, "CounterView: pid %llu publishes an unknown counter layout\n", static_cast<unsigned long long>(pid));
+            }
+            return false;
+        }
+        if (!csv)
+        {
+            printf("pid %llu\n", static_cast<unsigned long long>(pid));
+        }
+        CounterReader::Entry entry;
+        for (size_t i = 0; reader.Read(i, entry); i++)
+        {
+            char rate[32] = "";
+            const std::pair<uint64_t, std::string> key(pid, entry.name);
+            auto it = previous.find(key);
+            if ((entry.kind == CounterRegistry::COUNTER) && (it != previous.end()) && (now > it->second.time))
+            {
+                snprintf(rate, sizeof(rate), "%.1f", static_cast<double>(entry.value - it->second.value) / (now - it->second.time));
+            }
+            previous[key] = { entry.value, now };
+            if (csv)
+            {
+                printf("%.3f,%llu,%s,%s,%lld,%s\n", now, static_cast<unsigned long long>(pid), entry.name, KindName(entry.kind),
+                       static_cast<long long>(entry.value), rate);
+            }
+            else
+            {
+                printf("  %-32s %-8s %20lld", entry.name, KindName(entry.kind), static_cast<long long>(entry.value));
+                if (rate[0] != '\0')
+                {
+                    printf(" %14s/s", rate);
+                }
+                printf("\n");
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    double interval = 0;
+    long   samples  = 0;
+    bool   csv      = false;
+    std::vector<uint64_t> pids;
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-i") == 0) && (i + 1 < argc))
+        {
+            interval = atof(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc))
+        {
+            samples = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-csv") == 0)
+        {
+            csv = true;
+        }
+        else if ((argv[i][0] >= '0') && (argv[i][0] <= '9'))
+        {
+            pids.push_back(strtoull(argv[i], nullptr, 10));
+        }
+        else
+        {
+            fprintf(stderr, "usage: CounterView [-i seconds] [-n samples] [-csv] [pid ...]\n");
+            return 1;
+        }
+    }
+    if (interval <= 0)
+    {
+        samples = 1;
+    }
+    const bool all = pids.empty();
+    if (csv)
+    {
+        printf("time,pid,name,kind,value,rate\n");
+    }
+    std::map<std::pair<uint64_t, std::string>, Previous> previous;
+    std::set<uint64_t> live;    //processes shown at the last sample
+    std::set<uint64_t> dropped; //pids given on the command line that have no counters
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long sample = 0; (samples <= 0) || (sample < samples); sample++)
+    {
+        if (sample != 0)
+        {
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(interval * static_cast<double>(sample))));
+        }
+        const double now = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const std::vector<uint64_t> current = all ? Enumerate() : pids;
+        size_t shown = 0;
+        for (uint64_t pid : current)
+        {
+            if (dropped.count(pid) != 0)
+            {
+                continue;
+            }
+            if (Print(pid, now, csv, previous))
+            {
+                live.insert(pid);
+                shown++;
+            }
+            else if ((live.erase(pid) != 0) || !all)
+            {
+                fprintf(stderr, "CounterView: pid %llu has no counters (exited or not a WUIF process)\n", static_cast<unsigned long long>(pid));
+                if (!all)
+                {
+                    dropped.insert(pid);
+                }
+            }
+        }
+        if ((shown == 0) && all && (sample == 0))
+        {
+            fprintf(stderr, "CounterView: no process publishes counters\n");
+        }
+        if (!csv && (interval > 0))
+        {
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -0,0 +1,341 @@
+/*Copyright (c) 2018 Jonathan Campbell
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.*/
+/*TraceDecode - turns a BinaryTrace file (see Headers/Utils/BinaryTrace.h) back into text
+
+    TraceDecode <trace file> [-csv]
+
+Text output is one line per event: milliseconds since the file was opened, thread, source
+location and the formatted message. -csv writes the same fields as CSV. Events are listed in
+timestamp order - each thread fills the slots it claimed in runs, so file order is only time order
+within a thread.*/
+#if defined(_WIN32)
+    #include <windows.h>
+#endif
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "../../Headers/Utils/BinaryTrace.h"
+
+using WUIF::BinaryTrace;
+
+namespace
+{
+    struct Site
+    {
+        std::string format;
+        std::string file;
+        unsigned long long line;
+    };
+
+    //an EVENT or SITE with its string arguments gathered from the TEXT records after it
+    struct Entry
+    {
+        BinaryTrace::Record      record;
+        std::vector<std::string> strings; //UTF-8, one per argument (empty for non strings)
+    };
+
+    inline unsigned Kind(const BinaryTrace::Record &r, unsigned i) { return ((r.kinds >> (i * 4)) & 0xf); }
+
+    void AppendUTF8(std::string &out, unsigned long cp)
+    {
+        if (cp < 0x80)
+        {
+            out += static_cast<char>(cp);
+        }
+        else if (cp < 0x800)
+        {
+            out += static_cast<char>(0xc0 | (cp >> 6));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else if (cp < 0x10000)
+        {
+            out += static_cast<char>(0xe0 | (cp >> 12));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+        else
+        {
+            out += static_cast<char>(0xf0 | (cp >> 18));
+            out += static_cast<char>(0x80 | ((cp >> 12) & 0x3f));
+            out += static_cast<char>(0x80 | ((cp >> 6) & 0x3f));
+            out += static_cast<char>(0x80 | (cp & 0x3f));
+        }
+    }
+
+    std::string ToUTF8(const std::string &bytes, unsigned kind)
+    {
+        if (kind != BinaryTrace::STRING16)
+        {
+            return bytes;
+        }
+        std::string out;
+        for (size_t i = 0; (i + 1) < bytes.size(); i += 2)
+        {
+            unsigned long cp = static_cast<unsigned char>(bytes[i]) | (static_cast<unsigned char>(bytes[i + 1]) << 8);
+            if ((cp >= 0xd800) && (cp < 0xdc00) && ((i + 3) < bytes.size()))
+            {
+                unsigned long lo = static_cast<unsigned char>(bytes[i + 2]) | (static_cast<unsigned char>(bytes[i + 3]) << 8);
+                if ((lo >= 0xdc00) && (lo < 0xe000))
+                {
+                    cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                    i += 2;
+                }
+            }
+            AppendUTF8(out, cp);
+        }
+        return out;
+    }
+
+    /*formats a printf style format with the recorded arguments - the length modifiers of each
+    conversion are replaced by the ones matching the recorded argument kind*/
+    std::string Format(const std::string &format, const Entry &e, unsigned first)
+    {
+        std::string out;
+        unsigned arg = first;
+        char buf[512];
+        for (size_t i = 0; i < format.size(); i++)
+        {
+            if (format[i] != '%')
+            {
+                out += format[i];
+                continue;
+            }
+            if (((i + 1) < format.size()) && (format[i + 1] == '%'))
+            {
+                out += '%';
+                i++;
+                continue;
+            }
+            //%[flags][width][.precision][length]conversion
+            std::string spec = "%";
+            size_t j = i + 1;
+            while ((j < format.size()) && strchr("-+ #0", format[j]))
+                spec += format[j++];
+            while ((j < format.size()) && (isdigit(static_cast<unsigned char>(format[j])) || (format[j] == '.')))
+                spec += format[j++];
+            while ((j < format.size()) && strchr("hlLjztIw0123456789", format[j]))
+                j++;
+            if (j >= format.size())
+            {
+                out += format.substr(i);
+                break;
+            }
+            const char conv = format[j];
+            i = j;
+            if (arg >= e.record.count)
+            {
+                out += "<missing>";
+                continue;
+            }
+            const unsigned kind  = Kind(e.record, arg);
+            const uint64_t value = e.record.args[arg];
+            int n = -1;
+            switch (kind)
+            {
+                case BinaryTrace::INT:
+                case BinaryTrace::UINT:
+                {
+                    if (strchr("diouxXc", conv))
+                    {
+                        if (conv == 'c')
+                            n = snprintf(buf, sizeof(buf), (spec + "c").c_str(), static_cast<int>(value));
+                        else if ((kind == BinaryTrace::INT) && ((conv == 'd') || (conv == 'i')))
+                            n = snprintf(buf, sizeof(buf), (spec + "lld").c_str(), static_cast<long long>(value));
+                        else
+                            n = snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(), static_cast<unsigned long long>(value));
+                    }
+                }
+                break;
+                case BinaryTrace::REAL:
+                {
+                    if (strchr("eEfFgGaA", conv))
+                    {
+                        double v;
+                        memcpy(&v, &value, sizeof(v));
+                        n = snprintf(buf, sizeof(buf), (spec + conv).c_str(), v);
+                    }
+                }
+                break;
+                case BinaryTrace::POINTER:
+                {
+                    n = snprintf(buf, sizeof(buf), "0x%016llx", static_cast<unsigned long long>(value));
+                }
+                break;
+                case BinaryTrace::STRING8:
+                case BinaryTrace::STRING16:
+                {
+                    if ((conv == 's') || (conv == 'S'))
+                    {
+                        n = snprintf(buf, sizeof(buf), (spec + "s").c_str(), e.strings[arg].c_str());
+                    }
+                }
+                break;
+            }
+            if (n < 0)
+            {
+                out += "<?>"; //conversion does not match the recorded argument
+            }
+            else
+            {
+                out += buf;
+            }
+            arg++;
+        }
+        return out;
+    }
+
+    std::string Quote(const std::string &s)
+    {
+        std::string out = "\"";
+        for (char c : s)
+        {
+            if (c == '"')
+                out += '"';
+            out += c;
+        }
+        return out + "\"";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: TraceDecode <trace file> [-csv]\n");
+        return 1;
+    }
+    const bool csv = ((argc > 2) && (strcmp(argv[2], "-csv") == 0));
+    FILE *f = fopen(argv[1], "rb");
+    if (f == nullptr)
+    {
+        fprintf(stderr, "TraceDecode: cannot open %s\n", argv[1]);
+        return 1;
+    }
+    BinaryTrace::FileHeader header;
+    if ((fread(&header, sizeof(header), 1, f) != 1) || (memcmp(header.magic, "WUIFTRC1", 8) != 0) ||
+        (header.version != BinaryTrace::version) || (header.recordsize != BinaryTrace::recordsize))
+    {
+        fprintf(stderr, "TraceDecode: %s is not a WUIF trace file\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+    //gather entries - records being written when the process stopped are EMPTY and skipped
+    std::vector<Entry> entries;
+    BinaryTrace::Record r;
+    size_t textarg = 0; //argument the next TEXT record belongs to
+    while (fread(&r, sizeof(r), 1, f) == 1)
+    {
+        if ((r.type == BinaryTrace::EVENT) || (r.type == BinaryTrace::SITE))
+        {
+            Entry e;
+            e.record = r;
+            e.strings.resize(r.count);
+            entries.push_back(e);
+            textarg = 0;
+        }
+        else if ((r.type == BinaryTrace::TEXT) && !entries.empty())
+        {
+            Entry &e = entries.back();
+            //next string argument that is still missing data
+            while ((textarg < e.record.count) &&
+                   (((Kind(e.record, static_cast<unsigned>(textarg)) != BinaryTrace::STRING8) &&
+                     (Kind(e.record, static_cast<unsigned>(textarg)) != BinaryTrace::STRING16)) ||
+                    (e.strings[textarg].size() >= e.record.args[textarg])))
+            {
+                textarg++;
+            }
+            if (textarg < e.record.count)
+            {
+                e.strings[textarg].append(reinterpret_cast<const char*>(r.args), (r.count < BinaryTrace::textbytes) ? r.count : BinaryTrace::textbytes);
+            }
+        }
+    }
+    fclose(f);
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b)
+    {
+        return (a.record.timestamp < b.record.timestamp);
+    });
+    std::map<uint32_t, Site> sites;
+    for (Entry &e : entries)
+    {
+        for (unsigned i = 0; i < e.record.count; i++)
+        {
+            e.strings[i] = ToUTF8(e.strings[i], Kind(e.record, i));
+        }
+        if ((e.record.type == BinaryTrace::SITE) && (e.record.count >= 3))
+        {
+            Site &site  = sites[e.record.site];
+            site.line   = e.record.args[0];
+            site.format = e.strings[1];
+            site.file   = e.strings[2];
+        }
+    }
+    if (csv)
+    {
+        printf("time_ms,thread,site,file,line,message\n");
+    }
+    unsigned long long events = 0;
+    for (const Entry &e : entries)
+    {
+        if (e.record.type != BinaryTrace::EVENT)
+        {
+            continue;
+        }
+        events++;
+        const double ms = (header.frequency != 0) ?
+            (static_cast<double>(e.record.timestamp - header.start) * 1000.0 / static_cast<double>(header.frequency)) : 0.0;
+        auto it = sites.find(e.record.site);
+        std::string message;
+        std::string file;
+        unsigned long long line = 0;
+        if (it != sites.end())
+        {
+            message = Format(it->second.format, e, 0);
+            file    = it->second.file;
+            line    = it->second.line;
+        }
+        else
+        {
+            //site record missing - print the raw arguments
+            char buf[64];
+            snprintf(buf, sizeof(buf), "<site %08x>", e.record.site);
+            message = buf;
+            for (unsigned i = 0; i < e.record.count; i++)
+            {
+                snprintf(buf, sizeof(buf), " %llx", static_cast<unsigned long long>(e.record.args[i]));
+                message += (e.strings[i].empty()) ? std::string(buf) : (" " + e.strings[i]);
+            }
+        }
+        if (e.record.flags & BinaryTrace::TRUNCATED)
+        {
+            message += " [truncated]";
+        }
+        if (csv)
+        {
+            printf("%.6f,%u,%08x,%s,%llu,%s\n", ms, e.record.thread, e.record.site, Quote(file).c_str(), line, Quote(message).c_str());
+        }
+        else
+        {
+            printf("%12.6f ms [%5u] %s(%llu): %s\n", ms, e.record.thread, file.c_str(), line, message.c_str());
+        }
+    }
+    fprintf(stderr, "TraceDecode: %llu events, %llu records used of %llu, %llu events dropped\n",
+            events, static_cast<unsigned long long>(header.used), static_cast<unsigned long long>(header.capacity),
+            static_cast<unsigned long long>(header.dropped));
+    return 0;
+}